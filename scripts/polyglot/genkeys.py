@@ -0,0 +1,67 @@
+import argparse
+import re
+import sys
+
+"""
+    Extracts the 781 Polyglot Random64 keys from a reference implementation and
+    writes them to src/luna/polyglotkeys.inc, the table polyglot.cpp is built with.
+"""
+
+KEY_COUNT = 781
+
+# First and last keys of the table, as listed by the Polyglot book format specification.
+# Used to make sure the keys were extracted from the right place and in the right order.
+FIRST_KEY = 0x9D39247E33776D41
+LAST_KEY  = 0xF8D626AAAF278509
+
+KEY_REGEX = re.compile(r'0x([0-9a-fA-F]{16})')
+
+
+def extract_keys(source):
+    """
+        Returns the keys of the first run of KEY_COUNT 64-bit hexadecimal literals
+        that starts with FIRST_KEY.
+    """
+    keys = [int(m, 16) for m in KEY_REGEX.findall(source)]
+    try:
+        start = keys.index(FIRST_KEY)
+    except ValueError:
+        raise RuntimeError('The Polyglot key table was not found in the source file.')
+
+    keys = keys[start:start + KEY_COUNT]
+    if len(keys) != KEY_COUNT:
+        raise RuntimeError(f'Expected {KEY_COUNT} keys, found {len(keys)}.')
+    if keys[-1] != LAST_KEY:
+        raise RuntimeError('The last extracted key doesn\'t match the Polyglot table.')
+    return keys
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generates the Polyglot key table used by Luna. '
+                                                 'The source can be any file that lists the Random64 '
+                                                 'table in order, such as Polyglot\'s pg_key.c or '
+                                                 'python-chess\'s polyglot.py.')
+    parser.add_argument('source', help='Path to the file that contains the key table.')
+    parser.add_argument('-o', '--output', default='src/luna/polyglotkeys.inc',
+                        help='Path to the generated file (default: src/luna/polyglotkeys.inc).')
+    args = parser.parse_args()
+
+    with open(args.source, 'r') as f:
+        source = f.read()
+
+    try:
+        keys = extract_keys(source)
+    except RuntimeError as e:
+        print(f'Error: {e}', file=sys.stderr)
+        sys.exit(1)
+
+    with open(args.output, 'w') as f:
+        f.write('// Polyglot Random64 keys, generated by scripts/polyglot/genkeys.py. Do not edit.\n')
+        for i in range(0, KEY_COUNT, 4):
+            f.write(' '.join(f'0x{k:016X},' for k in keys[i:i + 4]) + '\n')
+
+    print(f'Wrote {KEY_COUNT} keys to {args.output}.')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,157 @@
+import argparse
+import re
+import statistics
+import subprocess
+import time
+
+"""
+    Replays the 'position'/'go' commands of a saved UCI session against an engine
+    and reports how much of its clock the engine used on each move.
+"""
+
+# Matches commands in plain UCI logs as well as in logs that prefix each line
+# with the engine name, such as cutechess-cli debug output ("123 >luna(0): go ...").
+COMMAND_REGEX = re.compile(r'(?:^|[>:]\s*)((?:position|go)\s.*)$')
+
+
+def parse_session(path):
+    """
+        Returns a list of (position command, go command) pairs, in the order
+        they appear in the file. Go commands without time controls are skipped.
+    """
+    pairs = []
+    position = None
+    with open(path, 'r') as f:
+        for line in f:
+            match = COMMAND_REGEX.search(line.strip())
+            if not match:
+                continue
+
+            cmd = match.group(1).strip()
+            if cmd.startswith('position'):
+                position = cmd
+            elif position is not None and ('wtime' in cmd or 'btime' in cmd):
+                pairs.append((position, cmd))
+    return pairs
+
+
+def side_to_move(position_cmd):
+    tokens = position_cmd.split()
+    n_moves = len(tokens) - tokens.index('moves') - 1 if 'moves' in tokens else 0
+
+    white = True
+    if 'fen' in tokens:
+        white = tokens[tokens.index('fen') + 2] == 'w'
+
+    if n_moves % 2 == 1:
+        white = not white
+    return 'w' if white else 'b'
+
+
+def parse_go(go_cmd):
+    tokens = go_cmd.split()
+    values = {}
+    for key in ('wtime', 'btime', 'winc', 'binc', 'movestogo'):
+        if key in tokens:
+            values[key] = int(tokens[tokens.index(key) + 1])
+    return values
+
+
+class Engine:
+    def __init__(self, cmd, options):
+        self.process = subprocess.Popen(cmd, shell=True, text=True, bufsize=1,
+                                        stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                        stderr=subprocess.DEVNULL)
+        self.send('uci')
+        self.wait_for('uciok')
+        for name, value in options:
+            self.send(f'setoption name {name} value {value}')
+        self.send('isready')
+        self.wait_for('readyok')
+
+    def send(self, cmd):
+        self.process.stdin.write(cmd + '\n')
+        self.process.stdin.flush()
+
+    def wait_for(self, prefix):
+        while True:
+            line = self.process.stdout.readline()
+            if line == '':
+                raise Exception(f'Engine exited while waiting for "{prefix}".')
+            if line.startswith(prefix):
+                return line.strip()
+
+    def quit(self):
+        self.send('quit')
+        self.process.wait()
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replays saved go wtime/btime commands and reports time usage.')
+    parser.add_argument('engine', help='command that starts the engine')
+    parser.add_argument('sessions', nargs='+', help='UCI logs to replay')
+    parser.add_argument('-o', '--option', action='append', default=[],
+                        help='UCI option to set, as Name=Value (may be repeated)')
+    parser.add_argument('--csv', help='also write the measurements of every move to this file')
+    args = parser.parse_args()
+
+    options = [tuple(o.split('=', 1)) for o in args.option]
+    engine = Engine(args.engine, options)
+
+    rows = []
+    for session in args.sessions:
+        for position, go in parse_session(session):
+            color = side_to_move(position)
+            tc = parse_go(go)
+            remaining = tc.get(f'{color}time')
+            increment = tc.get(f'{color}inc', 0)
+            if remaining is None:
+                continue
+
+            engine.send(position)
+            start = time.perf_counter()
+            engine.send(go)
+            engine.wait_for('bestmove')
+            used = (time.perf_counter() - start) * 1000
+
+            rows.append({
+                'session': session,
+                'remaining': remaining,
+                'increment': increment,
+                'used': used,
+                'fraction': used / max(1, remaining),
+            })
+            print(f'\r{len(rows)} moves replayed...', end='', flush=True)
+    print()
+    engine.quit()
+
+    if len(rows) == 0:
+        print('No go commands with time controls were found.')
+        return
+
+    used      = [r['used'] for r in rows]
+    fractions = [r['fraction'] for r in rows]
+    overruns  = [r for r in rows if r['used'] > r['remaining']]
+
+    print(f'Moves:                     {len(rows)}')
+    print(f'Time used (ms):            mean {statistics.mean(used):.1f}, median {statistics.median(used):.1f}, '
+          f'p90 {percentile(used, 0.9):.1f}, max {max(used):.1f}')
+    print(f'Fraction of clock used:    mean {statistics.mean(fractions):.2%}, '
+          f'p90 {percentile(fractions, 0.9):.2%}, max {max(fractions):.2%}')
+    print(f'Time used over increment:  {sum(r["used"] - r["increment"] for r in rows) / len(rows):.1f} ms/move')
+    print(f'Moves that would flag:     {len(overruns)}')
+
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write('session,remaining,increment,used,fraction\n')
+            for r in rows:
+                f.write(f'{r["session"]},{r["remaining"]},{r["increment"]},{r["used"]:.1f},{r["fraction"]:.5f}\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,204 @@
+/**
+ * Generates the KPK bitbase embedded in Luna.
+ *
+ * This runs as a build step before Luna itself is compiled, so it can't use Luna's
+ * library and works with plain integer squares (a1 = 0, b1 = 1, ..., h8 = 63).
+ *
+ * Positions are indexed by the side to move, both king squares and the pawn square,
+ * with the strong side playing up the board and the pawn on files a to d:
+ *
+ *     index = strongToMove | weakKing << 1 | strongKing << 7 | pawnFile << 13 | (6 - pawnRank) << 15
+ *
+ * where strongToMove is 0 when the strong side is to move. Each position takes a bit,
+ * set if the strong side wins.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr int N_POSITIONS = 2 * 64 * 64 * 4 * 6;
+
+enum Result : uint8_t {
+    INVALID = 0,
+    UNKNOWN = 1,
+    DRAW    = 2,
+    WIN     = 4,
+};
+
+int fileOf(int sq) { return sq % 8; }
+int rankOf(int sq) { return sq / 8; }
+
+int distance(int a, int b) {
+    int df = std::abs(fileOf(a) - fileOf(b));
+    int dr = std::abs(rankOf(a) - rankOf(b));
+    return df > dr ? df : dr;
+}
+
+uint64_t kingAttacks(int sq) {
+    uint64_t ret = 0;
+    for (int df = -1; df <= 1; ++df) {
+        for (int dr = -1; dr <= 1; ++dr) {
+            int f = fileOf(sq) + df;
+            int r = rankOf(sq) + dr;
+            if ((df != 0 || dr != 0) && f >= 0 && f < 8 && r >= 0 && r < 8) {
+                ret |= uint64_t(1) << (r * 8 + f);
+            }
+        }
+    }
+    return ret;
+}
+
+uint64_t pawnAttacks(int sq) {
+    uint64_t ret = 0;
+    int f = fileOf(sq);
+    int r = rankOf(sq) + 1;
+    if (r < 8 && f > 0) {
+        ret |= uint64_t(1) << (r * 8 + f - 1);
+    }
+    if (r < 8 && f < 7) {
+        ret |= uint64_t(1) << (r * 8 + f + 1);
+    }
+    return ret;
+}
+
+bool contains(uint64_t bb, int sq) {
+    return (bb >> sq) & 1;
+}
+
+int index(int strongToMove, int weakKing, int strongKing, int pawn) {
+    return strongToMove | (weakKing << 1) | (strongKing << 7) |
+           (fileOf(pawn) << 13) | ((6 - rankOf(pawn)) << 15);
+}
+
+struct KPKPosition {
+    int strongToMove;
+    int strongKing;
+    int weakKing;
+    int pawn;
+    Result result;
+
+    explicit KPKPosition(int idx) {
+        strongToMove = idx & 1;
+        weakKing     = (idx >> 1) & 63;
+        strongKing   = (idx >> 7) & 63;
+        pawn         = (6 - ((idx >> 15) & 7)) * 8 + ((idx >> 13) & 3);
+
+        if (distance(strongKing, weakKing) <= 1 ||
+            strongKing == pawn || weakKing == pawn ||
+            (strongToMove == 0 && contains(pawnAttacks(pawn), weakKing))) {
+            // Kings next to each other, overlapping pieces or the weak king in
+            // check with the strong side to move.
+            result = INVALID;
+        }
+        else if (strongToMove == 0 && rankOf(pawn) == 6 &&
+                 strongKing != pawn + 8 &&
+                 (distance(weakKing, pawn + 8) > 1 || distance(strongKing, pawn + 8) == 1)) {
+            // The pawn promotes and the new queen can't be captured.
+            result = WIN;
+        }
+        else if (strongToMove == 1 &&
+                 ((kingAttacks(weakKing) & ~(kingAttacks(strongKing) | pawnAttacks(pawn))) == 0 ||
+                  contains(kingAttacks(weakKing) & ~kingAttacks(strongKing), pawn))) {
+            // Stalemate, or the weak king captures the pawn.
+            result = DRAW;
+        }
+        else {
+            result = UNKNOWN;
+        }
+    }
+
+    /**
+     * Works out the result from the results of the positions reachable in one move.
+     */
+    Result classify(const std::vector<KPKPosition>& db) const {
+        // The side to move wins (for the strong side) or draws (for the weak side) if
+        // any move reaches such a position. If all moves are bad, the position is bad.
+        Result good = strongToMove == 0 ? WIN : DRAW;
+        Result bad  = strongToMove == 0 ? DRAW : WIN;
+
+        int r = INVALID;
+        if (strongToMove == 0) {
+            uint64_t moves = kingAttacks(strongKing);
+            for (int s = 0; s < 64; ++s) {
+                if (contains(moves, s)) {
+                    r |= db[index(1, weakKing, s, pawn)].result;
+                }
+            }
+
+            if (rankOf(pawn) < 6) {
+                r |= db[index(1, weakKing, strongKing, pawn + 8)].result;
+            }
+            if (rankOf(pawn) == 1 && pawn + 8 != strongKing && pawn + 8 != weakKing) {
+                r |= db[index(1, weakKing, strongKing, pawn + 16)].result;
+            }
+        }
+        else {
+            uint64_t moves = kingAttacks(weakKing);
+            for (int s = 0; s < 64; ++s) {
+                if (contains(moves, s)) {
+                    r |= db[index(0, s, strongKing, pawn)].result;
+                }
+            }
+        }
+
+        if (r & good) {
+            return good;
+        }
+        if (r & UNKNOWN) {
+            return UNKNOWN;
+        }
+        return bad;
+    }
+};
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: kpkgen <output file>\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<KPKPosition> db;
+    db.reserve(N_POSITIONS);
+    for (int i = 0; i < N_POSITIONS; ++i) {
+        db.emplace_back(i);
+    }
+
+    // Positions are classified from the ones that are already known until nothing
+    // changes. Whatever is still unknown by then is a draw.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (KPKPosition& pos: db) {
+            if (pos.result == UNKNOWN) {
+                pos.result = pos.classify(db);
+                changed   |= pos.result != UNKNOWN;
+            }
+        }
+    }
+
+    std::vector<uint32_t> bits(N_POSITIONS / 32);
+    for (int i = 0; i < N_POSITIONS; ++i) {
+        if (db[i].result == WIN) {
+            bits[i / 32] |= uint32_t(1) << (i % 32);
+        }
+    }
+
+    FILE* out = std::fopen(argv[1], "w");
+    if (out == nullptr) {
+        std::fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    std::fprintf(out, "// KPK bitbase, generated by kpkgen at build time. Do not edit.\n");
+    for (size_t i = 0; i < bits.size(); ++i) {
+        std::fprintf(out, "0x%08X,%c", bits[i], (i % 8 == 7) ? '\n' : ' ');
+    }
+    std::fclose(out);
+
+    return EXIT_SUCCESS;
+}
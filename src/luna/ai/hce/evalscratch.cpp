@@ -0,0 +1,55 @@
+#include "evalscratch.h"
+
+namespace lunachess::ai {
+
+void EvalScratch::build(const Position& pos) {
+    Bitboard occ = pos.getCompositeBitboard();
+
+    for (Color c = CL_WHITE; c < CL_COUNT; ++c) {
+        Bitboard byOne = 0;
+        Bitboard byTwo = 0;
+        auto addAttacks = [&](Square s, Bitboard atks) {
+            pieceAttacks[s] = atks;
+            byTwo |= byOne & atks;
+            byOne |= atks;
+        };
+
+        for (Square s: pos.getBitboard(Piece(c, PT_PAWN))) {
+            addAttacks(s, bbs::getPawnAttacks(s, c));
+        }
+        for (Square s: pos.getBitboard(Piece(c, PT_KNIGHT))) {
+            addAttacks(s, bbs::getKnightAttacks(s));
+        }
+        for (Square s: pos.getBitboard(Piece(c, PT_BISHOP))) {
+            addAttacks(s, bbs::getBishopAttacks(s, occ));
+        }
+        for (Square s: pos.getBitboard(Piece(c, PT_ROOK))) {
+            addAttacks(s, bbs::getRookAttacks(s, occ));
+        }
+        for (Square s: pos.getBitboard(Piece(c, PT_QUEEN))) {
+            addAttacks(s, bbs::getQueenAttacks(s, occ));
+        }
+        Square kingSquare = pos.getKingSquare(c);
+        addAttacks(kingSquare, bbs::getKingAttacks(kingSquare));
+
+        attackedBy[c]    = byOne;
+        attackedByTwo[c] = byTwo;
+
+        // Queens reuse the lookups of bishops and rooks.
+        Color them      = getOppositeColor(c);
+        Bitboard bishop = bbs::getBishopAttacks(kingSquare, occ);
+        Bitboard rook   = bbs::getRookAttacks(kingSquare, occ);
+
+        kingRing[c] = pieceAttacks[kingSquare];
+
+        attacksFromKing[c][PT_NONE]   = 0;
+        attacksFromKing[c][PT_PAWN]   = bbs::getPieceAttacks(kingSquare, occ, Piece(them, PT_PAWN));
+        attacksFromKing[c][PT_KNIGHT] = bbs::getKnightAttacks(kingSquare);
+        attacksFromKing[c][PT_BISHOP] = bishop;
+        attacksFromKing[c][PT_ROOK]   = rook;
+        attacksFromKing[c][PT_QUEEN]  = bishop | rook;
+        attacksFromKing[c][PT_KING]   = kingRing[c];
+    }
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef LUNA_AI_HCE_EVALSCRATCH_H
+#define LUNA_AI_HCE_EVALSCRATCH_H
+
+#include "../../bitboard.h"
+#include "../../position.h"
+#include "../../types.h"
+
+namespace lunachess::ai {
+
+/**
+ * Attack data shared by the evaluation features. It is built once per evaluation,
+ * so that features looking at the same attacks don't repeat the lookups.
+ *
+ * Attacks are computed on the full occupancy of the position. Features that see
+ * through pieces (like mobility, which ignores our own pieces) still do their
+ * own lookups.
+ */
+struct EvalScratch {
+    /**
+     * Attacks of the piece on each square. Squares without a piece are left unset.
+     * Pawn attacks are not masked by the occupancy.
+     */
+    Bitboard pieceAttacks[SQ_COUNT];
+
+    /** Squares attacked by at least one piece of each color. */
+    Bitboard attackedBy[CL_COUNT];
+
+    /** Squares attacked by at least two pieces of each color. */
+    Bitboard attackedByTwo[CL_COUNT];
+
+    /** Squares adjacent to the king of each color. */
+    Bitboard kingRing[CL_COUNT];
+
+    /**
+     * Attacks that a piece of each type of the opponent of 'c' would have if it stood
+     * on the square of c's king, as in bbs::getPieceAttacks. For knights and sliders,
+     * these are the squares they would give check from.
+     */
+    Bitboard attacksFromKing[CL_COUNT][PT_COUNT];
+
+    void build(const Position& pos);
+};
+
+}
+
+#endif // LUNA_AI_HCE_EVALSCRATCH_H
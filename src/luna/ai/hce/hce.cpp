@@ -4,9 +4,7 @@
 
 namespace lunachess::ai {
 
-i32 HandCraftedEvaluator::getGamePhaseFactor() const {
-    auto& pos = getPosition();
-
+static i32 computeGamePhaseFactor(const Position& pos) {
     constexpr i32 KNIGHT_VAL = GPF_PIECE_VALUE_TABLE[PT_KNIGHT];
     constexpr i32 BISHOP_VAL = GPF_PIECE_VALUE_TABLE[PT_BISHOP];
     constexpr i32 ROOK_VAL   = GPF_PIECE_VALUE_TABLE[PT_ROOK];
@@ -26,6 +24,117 @@ i32 HandCraftedEvaluator::getGamePhaseFactor() const {
     return ret;
 }
 
+i32 HandCraftedEvaluator::getGamePhaseFactor() const {
+    return probeMaterial(getPosition()).gpf;
+}
+
+const MaterialEntry& HandCraftedEvaluator::probeMaterial(const Position& pos) const {
+    ui64 key = pos.getMaterialKey();
+    MaterialEntry& entry = m_MaterialTable.getSlot(key);
+    if (entry.key != key) {
+        computeMaterialEntry(pos, entry);
+        entry.key = key;
+    }
+    return entry;
+}
+
+/**
+ * Values used to compare the non-pawn material of both sides when scaling.
+ */
+static constexpr i32 SCALE_PIECE_VALUES[] = { 0, 0, 3, 3, 5, 9, 0 };
+
+static i32 getNonPawnMaterial(const Position& pos, Color c) {
+    i32 total = 0;
+    for (PieceType pt: { PT_KNIGHT, PT_BISHOP, PT_ROOK, PT_QUEEN }) {
+        total += pos.getBitboard(Piece(c, pt)).count() * SCALE_PIECE_VALUES[pt];
+    }
+    return total;
+}
+
+void HandCraftedEvaluator::computeMaterialEntry(const Position& pos, MaterialEntry& entry) const {
+    entry = MaterialEntry();
+    entry.gpf     = computeGamePhaseFactor(pos);
+    entry.endgame = endgame::identify(pos);
+
+    switch (entry.endgame.type) {
+        case EG_KR_KN:
+        case EG_KR_KB:
+        case EG_KR_KR:
+        case EG_KQ_KQ:
+            entry.endgameFunction = &HandCraftedEvaluator::evaluateDrawnEndgame;
+            break;
+
+        case EG_KBP_K:
+            entry.endgameFunction = &HandCraftedEvaluator::evaluateKBPK;
+            break;
+
+        case EG_KP_K:
+            entry.endgameFunction = &HandCraftedEvaluator::evaluateKPK;
+            break;
+
+        case EG_KBN_K:
+            entry.endgameFunction = &HandCraftedEvaluator::evaluateKBNK;
+            break;
+
+        default:
+            // Not implemented endgame, resort to default evaluation.
+            break;
+    }
+
+    if (entry.endgameFunction == nullptr ||
+        entry.endgameFunction == &HandCraftedEvaluator::evaluateDrawnEndgame) {
+        // Bitbases know better than both the classic evaluation and our guess of a draw.
+        Color firstSide;
+        entry.bitbase = bitbase::findBitbase(pos.getMaterialKey(), firstSide);
+        if (entry.bitbase != nullptr) {
+            entry.endgame.lhs     = firstSide;
+            entry.endgameFunction = &HandCraftedEvaluator::evaluateBitbase;
+        }
+    }
+
+    for (Color c: { CL_WHITE, CL_BLACK }) {
+        Color them     = getOppositeColor(c);
+        i32 ourNpm     = getNonPawnMaterial(pos, c);
+        i32 theirNpm   = getNonPawnMaterial(pos, them);
+        i32 ourPawns   = pos.getBitboard(Piece(c, PT_PAWN)).count();
+        i32 theirPawns = pos.getBitboard(Piece(them, PT_PAWN)).count();
+
+        if (ourPawns == 0 && ourNpm - theirNpm <= SCALE_PIECE_VALUES[PT_BISHOP]) {
+            // Without pawns, being up to a minor piece ahead is rarely enough to win, and
+            // a lone minor piece can't mate at all.
+            entry.scaleFactor[c] = ourNpm < SCALE_PIECE_VALUES[PT_ROOK]
+                                   ? SCALE_FACTOR_DRAW
+                                   : SCALE_FACTOR_NORMAL / 4;
+        }
+        else if (ourPawns == 0 && theirPawns == 0 &&
+                 pos.getBitboard(Piece(c, PT_KNIGHT)).count() == 2 &&
+                 ourNpm == 2 * SCALE_PIECE_VALUES[PT_KNIGHT]) {
+            // Two knights can't force mate against a bare king.
+            entry.scaleFactor[c] = SCALE_FACTOR_DRAW;
+        }
+
+        bool onlyBishops = ourNpm == SCALE_PIECE_VALUES[PT_BISHOP] && theirNpm == SCALE_PIECE_VALUES[PT_BISHOP] &&
+                           pos.getBitboard(Piece(c, PT_BISHOP)).count() == 1 &&
+                           pos.getBitboard(Piece(them, PT_BISHOP)).count() == 1;
+        if (onlyBishops) {
+            entry.scalingFunction[c] = &HandCraftedEvaluator::scaleOppositeBishops;
+        }
+        else if (ourPawns > 0 && theirNpm == 0 &&
+                 (ourNpm == 0 || (ourNpm == SCALE_PIECE_VALUES[PT_BISHOP] &&
+                                  pos.getBitboard(Piece(c, PT_BISHOP)).count() == 1))) {
+            entry.scalingFunction[c] = &HandCraftedEvaluator::scaleRookPawns;
+        }
+    }
+}
+
+i32 HandCraftedEvaluator::getScaleFactor(const Position& pos, const MaterialEntry& material, Color strongSide) const {
+    ScalingFunction fn = material.scalingFunction[strongSide];
+    if (fn != nullptr) {
+        return (this->*fn)(pos, strongSide);
+    }
+    return material.scaleFactor[strongSide];
+}
+
 void HandCraftedEvaluator::refreshPawns() {
     const auto& pos = getPosition();
 
@@ -41,6 +150,13 @@ void HandCraftedEvaluator::refreshPawns() {
 
 void HandCraftedEvaluator::onSetPosition(const Position& pos) {
     refreshPawns();
+
+    // Material entries point to the bitbases that were loaded when they were computed.
+    ui32 bitbaseGeneration = bitbase::getGeneration();
+    if (bitbaseGeneration != m_BitbaseGeneration) {
+        m_MaterialTable.clear();
+        m_BitbaseGeneration = bitbaseGeneration;
+    }
 }
 
 static bool shouldRefreshPawnStructureCache(Move move) {
@@ -64,25 +180,52 @@ i32 HandCraftedEvaluator::evaluate() const {
     const auto& pos = getPosition();
 
     // First, check if we are facing a known endgame
-    EndgameData eg = endgame::identify(pos);
-    if (eg.type == EG_UNKNOWN) {
+    const MaterialEntry& material = probeMaterial(pos);
+    if (material.endgameFunction == nullptr) {
         // Not a known endgame
-        return evaluateClassic(pos, pos.getColorToMove());
+        return evaluateClassic(pos, material, pos.getColorToMove());
     }
-    if (eg.lhs == pos.getColorToMove()) {
+
+    i32 score = (this->*material.endgameFunction)(pos, material, material.endgame.lhs);
+    if (material.endgame.lhs == pos.getColorToMove()) {
         // Evaluate the endgame on our perspective
-        return evaluateEndgame(pos, eg);
+        return score;
     }
     // Evaluate the endgame on their perspective
-    return -evaluateEndgame(pos, eg);
+    return -score;
 }
 
-i32 HandCraftedEvaluator::evaluateClassic(const Position& pos, Color us) const {
-    i32 gpf    = getGamePhaseFactor();
+i32 HandCraftedEvaluator::evaluate(HCETrace& trace) const {
+    const auto& pos = getPosition();
+
+    const MaterialEntry& material = probeMaterial(pos);
+    if (material.endgameFunction != nullptr) {
+        // Known endgames have their own evaluation functions, which
+        // are not expressed in terms of the weights.
+        trace.reset(m_Weights, material.gpf, pos.getColorToMove());
+        trace.markNonLinear();
+        return evaluate();
+    }
+
+    m_Trace   = &trace;
+    i32 score = evaluateClassic<true>(pos, material, pos.getColorToMove());
+    m_Trace   = nullptr;
+
+    return score;
+}
+
+template <bool TRACE>
+i32 HandCraftedEvaluator::evaluateClassic(const Position& pos, const MaterialEntry& material, Color us) const {
+    i32 gpf    = material.gpf;
     i32 tempo  = m_Weights->tempoScore.get(gpf);
     i32 total  = us == pos.getColorToMove() ? tempo : -tempo;
     Color them = getOppositeColor(us);
 
+    if constexpr (TRACE) {
+        m_Trace->reset(m_Weights, gpf, us);
+        m_Trace->add(m_Weights->tempoScore, pos.getColorToMove());
+    }
+
     if (m_PawnsDirty) {
         const_cast<HandCraftedEvaluator*>(this)->refreshPawns();
     }
@@ -96,47 +239,73 @@ i32 HandCraftedEvaluator::evaluateClassic(const Position& pos, Color us) const {
     Bitboard theirPassers = m_Passers[them];
     Bitboard allPassers   = ourPassers | theirPassers;
 
+    EvalScratch scratch;
+    scratch.build(pos);
+
     // Compute evaluation features
-    total += getMaterialScore(gpf, us) - getMaterialScore(gpf, them);
-    total += getMobilityScore(gpf, us) - getMobilityScore(gpf, them);
-    total += getPlacementScore(gpf, us) - getPlacementScore(gpf, them);
-    total += getKingAttackScore(gpf, us) - getKingAttackScore(gpf, them);
-    total += getIsolatedPawnsScore(gpf, us) - getIsolatedPawnsScore(gpf, them);
-    total += getKnightOutpostScore(gpf, us) - getKnightOutpostScore(gpf, them);
-    total += getBlockingPawnsScore(gpf, us) - getBlockingPawnsScore(gpf, them);
-    total += getBackwardPawnsScore(gpf, us) - getBackwardPawnsScore(gpf, them);
-    total += getBishopPairScore(gpf, us) - getBishopPairScore(gpf, them);
-    total += getKingPawnDistanceScore(gpf, us, allPassers) - getKingPawnDistanceScore(gpf, them, allPassers);
+    total += getMaterialScore<TRACE>(gpf, us) - getMaterialScore<TRACE>(gpf, them);
+    total += getMobilityScore<TRACE>(gpf, us, scratch) - getMobilityScore<TRACE>(gpf, them, scratch);
+    total += getPlacementScore<TRACE>(gpf, us) - getPlacementScore<TRACE>(gpf, them);
+    total += getKingAttackScore<TRACE>(gpf, us, scratch) - getKingAttackScore<TRACE>(gpf, them, scratch);
+    total += getIsolatedPawnsScore<TRACE>(gpf, us) - getIsolatedPawnsScore<TRACE>(gpf, them);
+    total += getKnightOutpostScore<TRACE>(gpf, us) - getKnightOutpostScore<TRACE>(gpf, them);
+    total += getBlockingPawnsScore<TRACE>(gpf, us) - getBlockingPawnsScore<TRACE>(gpf, them);
+    total += getBackwardPawnsScore<TRACE>(gpf, us) - getBackwardPawnsScore<TRACE>(gpf, them);
+    total += getBishopPairScore<TRACE>(gpf, us) - getBishopPairScore<TRACE>(gpf, them);
+    total += getKingPawnDistanceScore<TRACE>(gpf, us, allPassers) - getKingPawnDistanceScore<TRACE>(gpf, them, allPassers);
 //    total += getBishopPawnColorComplexScore(gpf, us) - getBishopPawnColorComplexScore(gpf, them);
-    total += getRooksScore(gpf, us, ourPassers) - getRooksScore(gpf, them, theirPassers);
-    total += getPassedPawnsScore(gpf, us, ourPassers) - getPassedPawnsScore(gpf, them, theirPassers);
+    total += getRooksScore<TRACE>(gpf, us, ourPassers, scratch) - getRooksScore<TRACE>(gpf, them, theirPassers, scratch);
+    total += getPassedPawnsScore<TRACE>(gpf, us, ourPassers) - getPassedPawnsScore<TRACE>(gpf, them, theirPassers);
+
+    // Drawish material pulls the score of the side that's ahead towards zero.
+    i32 scaleFactor = getScaleFactor(pos, material, total >= 0 ? us : them);
+    if (scaleFactor != SCALE_FACTOR_NORMAL) {
+        total = total * scaleFactor / SCALE_FACTOR_NORMAL;
+
+        if constexpr (TRACE) {
+            m_Trace->markNonLinear();
+        }
+    }
 
     return total;
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getMaterialScore(i32 gpf, Color c) const {
     const auto& pos = getPosition();
     i32 total = 0;
 
     for (PieceType pt: { PT_PAWN, PT_KNIGHT, PT_BISHOP, PT_ROOK, PT_QUEEN } ) {
-        total += pos.getBitboard(Piece(c, pt)).count() * m_Weights->material[pt].get(gpf);
+        i32 count = pos.getBitboard(Piece(c, pt)).count();
+        total += count * m_Weights->material[pt].get(gpf);
+
+        if constexpr (TRACE) {
+            m_Trace->add(m_Weights->material[pt], c, count);
+        }
     }
 
     return total;
 }
 
+template <bool TRACE>
 static i32 evaluatePST(Bitboard bb, Color c,
                        const PieceSquareTable& mg,
                        const PieceSquareTable& eg,
-                       i32 gpf) {
+                       i32 gpf,
+                       HCETrace* trace) {
     i32 total = 0;
     for (auto s: bb) {
         HCEWeight weight(mg.valueAt(s, c), eg.valueAt(s, c));
         total += weight.get(gpf);
+
+        if constexpr (TRACE) {
+            trace->add(mg.valueRefAt(s, c), eg.valueRefAt(s, c), c);
+        }
     }
     return total;
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getPlacementScore(i32 gpf, Color c) const {
     const auto& pos = getPosition();
     i32 total = 0;
@@ -147,7 +316,7 @@ i32 HandCraftedEvaluator::getPlacementScore(i32 gpf, Color c) const {
     const PieceSquareTable& kingMgPST = m_Weights->kingPstMg;
     const PieceSquareTable& kingEgPST = m_Weights->kingPstEg;
 
-    total += evaluatePST(kingBB, c, kingMgPST, kingEgPST, gpf);
+    total += evaluatePST<TRACE>(kingBB, c, kingMgPST, kingEgPST, gpf, m_Trace);
 
     KingsDistribution kingsDistribution = staticanalysis::getKingsDistribution(pos, c);
 
@@ -158,7 +327,7 @@ i32 HandCraftedEvaluator::getPlacementScore(i32 gpf, Color c) const {
         const PieceSquareTable& knightMgPST = m_Weights->knightPstsMg[kingsDistribution];
         const PieceSquareTable& knightEgPST = m_Weights->knightPstsEg[kingsDistribution];
 
-        total += evaluatePST(knightBB, c, knightMgPST, knightEgPST, gpf);
+        total += evaluatePST<TRACE>(knightBB, c, knightMgPST, knightEgPST, gpf, m_Trace);
     }
 
     // Bishops
@@ -168,7 +337,7 @@ i32 HandCraftedEvaluator::getPlacementScore(i32 gpf, Color c) const {
         const PieceSquareTable& bishopMgPST = m_Weights->bishopPstsMg[kingsDistribution];
         const PieceSquareTable& bishopEgPST = m_Weights->bishopPstsEg[kingsDistribution];
 
-        total += evaluatePST(bishopBB, c, bishopMgPST, bishopEgPST, gpf);
+        total += evaluatePST<TRACE>(bishopBB, c, bishopMgPST, bishopEgPST, gpf, m_Trace);
     }
 
     // Rooks
@@ -178,7 +347,7 @@ i32 HandCraftedEvaluator::getPlacementScore(i32 gpf, Color c) const {
         const PieceSquareTable& rookMgPST = m_Weights->rookPstsMg[kingsDistribution];
         const PieceSquareTable& rookEgPST = m_Weights->rookPstsEg[kingsDistribution];
 
-        total += evaluatePST(rookBB, c, rookMgPST, rookEgPST, gpf);
+        total += evaluatePST<TRACE>(rookBB, c, rookMgPST, rookEgPST, gpf, m_Trace);
     }
 
     // Queens
@@ -188,7 +357,7 @@ i32 HandCraftedEvaluator::getPlacementScore(i32 gpf, Color c) const {
         const PieceSquareTable& queenMgPST = m_Weights->queenPstsMg[kingsDistribution];
         const PieceSquareTable& queenEgPST = m_Weights->queenPstsEg[kingsDistribution];
 
-        total += evaluatePST(queenBB, c, queenMgPST, queenEgPST, gpf);
+        total += evaluatePST<TRACE>(queenBB, c, queenMgPST, queenEgPST, gpf, m_Trace);
     }
 
     // Pawns
@@ -197,13 +366,14 @@ i32 HandCraftedEvaluator::getPlacementScore(i32 gpf, Color c) const {
     const PieceSquareTable& pawnMgPST = m_Weights->pawnPstsMg[kingsDistribution];
     const PieceSquareTable& pawnEgPST = m_Weights->pawnPstsEg[kingsDistribution];
 
-    total += evaluatePST(pawnBB, c, pawnMgPST, pawnEgPST, gpf);
+    total += evaluatePST<TRACE>(pawnBB, c, pawnMgPST, pawnEgPST, gpf, m_Trace);
 
 
     return total;
 }
 
-i32 HandCraftedEvaluator::getMobilityScore(i32 gpf, Color us) const {
+template <bool TRACE>
+i32 HandCraftedEvaluator::getMobilityScore(i32 gpf, Color us, const EvalScratch& scratch) const {
     const auto& pos = getPosition();
     i32 total = 0;
 
@@ -227,15 +397,23 @@ i32 HandCraftedEvaluator::getMobilityScore(i32 gpf, Color us) const {
 
         i32 scoreIdx = std::min(bits::popcount(validSquares), m_Weights->bishopMobilityScore.size() - 1);
         total += m_Weights->bishopMobilityScore[scoreIdx].get(gpf);
+
+        if constexpr (TRACE) {
+            m_Trace->add(m_Weights->bishopMobilityScore[scoreIdx], us);
+        }
     }
 
     // Evaluate knights
     auto ourKnights = pos.getBitboard(Piece(us, PT_KNIGHT));
     for (auto s: ourKnights) {
-        auto validSquares = bbs::getKnightAttacks(s) & targetSquares;
+        auto validSquares = scratch.pieceAttacks[s] & targetSquares;
 
         i32 scoreIdx = std::min(bits::popcount(validSquares), m_Weights->knightMobilityScore.size() - 1);
         total += m_Weights->knightMobilityScore[scoreIdx].get(gpf);
+
+        if constexpr (TRACE) {
+            m_Trace->add(m_Weights->knightMobilityScore[scoreIdx], us);
+        }
     }
 
     // Evaluate rooks
@@ -250,29 +428,45 @@ i32 HandCraftedEvaluator::getMobilityScore(i32 gpf, Color us) const {
 
         i32 verticalScoreIdx = std::min(bits::popcount(validVerticalSquares), m_Weights->rookVerticalMobilityScore.size() - 1);
         total += m_Weights->rookVerticalMobilityScore[verticalScoreIdx].get(gpf);
+
+        if constexpr (TRACE) {
+            m_Trace->add(m_Weights->rookHorizontalMobilityScore[horizontalScoreIdx], us);
+            m_Trace->add(m_Weights->rookVerticalMobilityScore[verticalScoreIdx], us);
+        }
     }
 
     return total;
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getKnightOutpostScore(i32 gpf, Color c) const {
     const auto& pos = getPosition();
 
     Bitboard theirHalf = bbs::getBoardHalf(getOppositeColor(c));
     Bitboard knightOutposts = staticanalysis::getPieceOutposts(pos, Piece(c, PT_KNIGHT)) & theirHalf;
 
+    if constexpr (TRACE) {
+        m_Trace->add(m_Weights->knightOutpostScore, c, knightOutposts.count());
+    }
+
     return knightOutposts.count() * m_Weights->knightOutpostScore.get(gpf);
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getBlockingPawnsScore(i32 gpf, Color c) const {
     const auto& pos = getPosition();
 
 //    Bitboard blockingPawns = staticanalysis::getBlockingPawns(pos, c);
     Bitboard blockingPawns = m_BlockingPawns[c];
 
+    if constexpr (TRACE) {
+        m_Trace->add(m_Weights->blockingPawnsScore, c, blockingPawns.count());
+    }
+
     return blockingPawns.count() * m_Weights->blockingPawnsScore.get(gpf);
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getIsolatedPawnsScore(i32 gpf, Color c) const {
     const auto& pos = getPosition();
 
@@ -282,9 +476,14 @@ i32 HandCraftedEvaluator::getIsolatedPawnsScore(i32 gpf, Color c) const {
 
     Bitboard isolatedPawns = allPawns & ~connectedPawns;
 
+    if constexpr (TRACE) {
+        m_Trace->add(m_Weights->isolatedPawnScore, c, isolatedPawns.count());
+    }
+
     return isolatedPawns.count() * m_Weights->isolatedPawnScore.get(gpf);
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getPassedPawnsScore(i32 gpf, Color c, Bitboard passedPawns) const {
     i32 total = 0;
 
@@ -297,6 +496,10 @@ i32 HandCraftedEvaluator::getPassedPawnsScore(i32 gpf, Color c, Bitboard passedP
                     ->passedPawnScore[idx]
                     .get(gpf);
 
+        if constexpr (TRACE) {
+            m_Trace->add(m_Weights->passedPawnScore[idx], c);
+        }
+
 //        if (connectedPassers.contains(s)) {
 //            total += m_Weights->connectedPassersScore[idx].get(gpf);
 //        }
@@ -305,15 +508,21 @@ i32 HandCraftedEvaluator::getPassedPawnsScore(i32 gpf, Color c, Bitboard passedP
     return total;
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getBackwardPawnsScore(i32 gpf, Color c) const {
     const auto& pos = getPosition();
 
 //    Bitboard backwardPawns = staticanalysis::getBackwardPawns(pos, c);
     Bitboard backwardPawns = m_BackwardPawns[c];
 
+    if constexpr (TRACE) {
+        m_Trace->add(m_Weights->backwardPawnScore, c, backwardPawns.count());
+    }
+
     return backwardPawns.count() * m_Weights->backwardPawnScore.get(gpf);
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getKingPawnDistanceScore(i32 gpf, Color c, Bitboard allPassers) const {
     const auto& pos = getPosition();
     i32 total = 0;
@@ -327,14 +536,22 @@ i32 HandCraftedEvaluator::getKingPawnDistanceScore(i32 gpf, Color c, Bitboard al
     for (auto s: pawns) {
         auto distance = getChebyshevDistance(s, ourKingSquare);
         total += distance * individualScore;
+        if constexpr (TRACE) {
+            m_Trace->add(m_Weights->kingPawnDistanceScore, c, distance);
+        }
+
         if (allPassers.contains(s)) {
             total += distance * passerIndividualScore;
+            if constexpr (TRACE) {
+                m_Trace->add(m_Weights->kingPasserDistanceScore, c, distance);
+            }
         }
     }
 
     return total;
 }
 
+template <bool TRACE>
 i32 HandCraftedEvaluator::getBishopPairScore(i32 gpf, Color c) const {
     const auto& pos = getPosition();
 
@@ -342,14 +559,18 @@ i32 HandCraftedEvaluator::getBishopPairScore(i32 gpf, Color c) const {
     Bitboard lsBishops  = ourBishops & bbs::LIGHT_SQUARES;
     Bitboard dsBishops  = ourBishops & bbs::DARK_SQUARES;
 
+    if constexpr (TRACE) {
+        m_Trace->add(m_Weights->bishopPairScore, c, std::min(lsBishops.count(), dsBishops.count()));
+    }
+
     return m_Weights->bishopPairScore.get(gpf) * std::min(lsBishops.count(), dsBishops.count());
 }
 
-i32 HandCraftedEvaluator::getRooksScore(i32 gpf, Color c, Bitboard passers) const {
+template <bool TRACE>
+i32 HandCraftedEvaluator::getRooksScore(i32 gpf, Color c, Bitboard passers, const EvalScratch& scratch) const {
     const auto& pos = getPosition();
     i32 total = 0;
 
-    Bitboard occ      = pos.getCompositeBitboard();
     Bitboard ourRooks = pos.getBitboard(Piece(c, PT_ROOK));
     if (ourRooks == 0) {
         return 0;
@@ -366,12 +587,18 @@ i32 HandCraftedEvaluator::getRooksScore(i32 gpf, Color c, Bitboard passers) cons
 
         if (filePawns == 0) {
             total += openFileScore;
+            if constexpr (TRACE) {
+                m_Trace->add(m_Weights->rookOnOpenFile, c);
+            }
         }
 
-        Bitboard rookFileAtks = bbs::getRookAttacks(s, occ) & fileBB;
+        Bitboard rookFileAtks = scratch.pieceAttacks[s] & fileBB;
 
         if ((rookFileAtks & passers) != 0) {
             total += behindPasserScore;
+            if constexpr (TRACE) {
+                m_Trace->add(m_Weights->rookBehindPasser, c);
+            }
         }
     }
 
@@ -379,11 +606,10 @@ i32 HandCraftedEvaluator::getRooksScore(i32 gpf, Color c, Bitboard passers) cons
 }
 
 
-i32 HandCraftedEvaluator::getCheckPower(i32 gpf, Color us) const {
+i32 HandCraftedEvaluator::getCheckPower(i32 gpf, Color us, const EvalScratch& scratch) const {
     const auto& pos = getPosition();
     Color them = getOppositeColor(us);
 
-    Square theirKingSquare = pos.getKingSquare(getOppositeColor(us));
     Bitboard occ = pos.getCompositeBitboard();
     i32 total    = 0;
 
@@ -392,11 +618,14 @@ i32 HandCraftedEvaluator::getCheckPower(i32 gpf, Color us) const {
         Bitboard theirDefendedSquares = staticanalysis::getDefendedSquares(pos, them, pt);
         Piece p(us, pt);
         Bitboard pieceBB = pos.getBitboard(p);
-        Bitboard atksFromKing = bbs::getPieceAttacks(theirKingSquare, occ, p);
+        Bitboard atksFromKing = scratch.attacksFromKing[them][pt];
         i32 checkPower = m_Weights->pieceCheckPower[pt].get(gpf);
 
+        // Pawns only count the squares they could capture on.
+        Bitboard atksMask = pt == PT_PAWN ? occ : Bitboard(~ui64(0));
+
         for (Square s: pieceBB) {
-            Bitboard atks = bbs::getPieceAttacks(s, occ, p) & (~theirDefendedSquares);
+            Bitboard atks = scratch.pieceAttacks[s] & atksMask & (~theirDefendedSquares);
 
             // Compute checks
             if ((atksFromKing & atks) != 0 && p.getType() != PT_KING) {
@@ -408,14 +637,13 @@ i32 HandCraftedEvaluator::getCheckPower(i32 gpf, Color us) const {
     return total;
 }
 
-i32 HandCraftedEvaluator::getQueenTouchPower(i32 gpf, Color us) const {
+i32 HandCraftedEvaluator::getQueenTouchPower(i32 gpf, Color us, const EvalScratch& scratch) const {
     const auto& pos = getPosition();
     Color them = getOppositeColor(us);
-    Square theirKingSquare = pos.getKingSquare(getOppositeColor(us));
 
     // Add attack power if our queen can "touch" the opponent's
     // king without being captured
-    Bitboard theirKingAtks      = bbs::getKingAttacks(theirKingSquare);
+    Bitboard theirKingAtks      = scratch.kingRing[them];
     Bitboard ourQueensAttacks   = pos.getAttacks(us, PT_QUEEN);
     Bitboard ourOpponentAttacks = staticanalysis::getDefendedSquares(pos, them, PT_QUEEN);
     Bitboard queenTouchSquares  = theirKingAtks & ourQueensAttacks & (~ourOpponentAttacks) &
@@ -428,14 +656,21 @@ i32 HandCraftedEvaluator::getQueenTouchPower(i32 gpf, Color us) const {
     return 0;
 }
 
-i32 HandCraftedEvaluator::getKingAttackScore(i32 gpf, Color us) const {
+template <bool TRACE>
+i32 HandCraftedEvaluator::getKingAttackScore(i32 gpf, Color us, const EvalScratch& scratch) const {
     i32 totalAttackPower = 0;
 
-    totalAttackPower += getQueenTouchPower(gpf, us);
-    totalAttackPower += getCheckPower(gpf, us);
+    totalAttackPower += getQueenTouchPower(gpf, us, scratch);
+    totalAttackPower += getCheckPower(gpf, us, scratch);
 
     size_t idx = std::max(size_t(0), std::min(size_t(totalAttackPower) >> 4, m_Weights->kingAttackScore.size() - 1));
 
+    // The attack powers select which king attack weight is used, but they don't
+    // contribute to the score linearly. Only the selected weight is traced.
+    if constexpr (TRACE) {
+        m_Trace->add(m_Weights->kingAttackScore[idx], us);
+    }
+
     return m_Weights->kingAttackScore[idx];
 }
 
@@ -495,50 +730,27 @@ i32 HandCraftedEvaluator::evaluateKingAndPawns(const Position& pos, Color c) con
     return total;
 }
 
-i32 HandCraftedEvaluator::evaluateEndgame(const Position& pos, EndgameData egData) const {
-    switch (egData.type) {
-        // Drawn endgames
-        case EG_KR_KN:
-        case EG_KR_KB:
-        case EG_KR_KR:
-        case EG_KQ_KQ:
-            return 0;
-
-        case EG_KBP_K:
-            return evaluateKBPK(pos, egData.lhs);
-
-        case EG_KP_K:
-            return evaluateKPK(pos, egData.lhs);
-
-        case EG_KBN_K:
-            return evaluateKBNK(pos, egData.lhs);
-
-        default:
-            // Not implemented endgame, resort to default evaluation:
-            return evaluateClassic(pos, egData.lhs);
-    }
-
+// Unnamed parameters, this only matches the EndgameFunction signature.
+i32 HandCraftedEvaluator::evaluateDrawnEndgame(const Position&, const MaterialEntry&, Color) const {
+    return 0;
 }
 
-i32 HandCraftedEvaluator::evaluateKPK(const Position &pos, Color lhs) const {
+i32 HandCraftedEvaluator::evaluateKPK(const Position &pos, const MaterialEntry&, Color lhs) const {
     i32 queenValue = m_Weights->material[PT_QUEEN].get(0);
 
-    Color rhs = getOppositeColor(lhs);
-    Square pawnSquare      = *pos.getBitboard(Piece(lhs, PT_PAWN)).begin();
-    Square enemyKingSquare = pos.getKingSquare(rhs);
-
-    if (!endgame::isInsideTheSquare(pawnSquare, enemyKingSquare, lhs, pos.getColorToMove())) {
-        // King outside of square, pawn can promote freely.
-        BoardRank promRank = getPromotionRank(lhs);
-        BoardRank pawnRank = getRank(pawnSquare);
-        i32 dist = std::abs(promRank - pawnRank);
-        return queenValue - dist * 100;
+    if (!bitbase::probeKPK(pos, lhs)) {
+        return 0;
     }
 
-    return evaluateClassic(pos, lhs);
+    // Won, push the pawn.
+    Square pawnSquare  = *pos.getBitboard(Piece(lhs, PT_PAWN)).begin();
+    BoardRank promRank = getPromotionRank(lhs);
+    BoardRank pawnRank = getRank(pawnSquare);
+    i32 dist = std::abs(promRank - pawnRank);
+    return queenValue - dist * 100;
 }
 
-i32 HandCraftedEvaluator::evaluateKBPK(const Position& pos, Color lhs) const {
+i32 HandCraftedEvaluator::evaluateKBPK(const Position& pos, const MaterialEntry&, Color lhs) const {
     constexpr Bitboard A_H_FILES   = bbs::getFileBitboard(FL_A) | bbs::getFileBitboard(FL_H);
 
     Bitboard pawnBB   = pos.getBitboard(Piece(lhs, PT_PAWN));
@@ -546,7 +758,7 @@ i32 HandCraftedEvaluator::evaluateKBPK(const Position& pos, Color lhs) const {
     i32 winningScore  = (m_Weights->material[PT_BISHOP].eg + m_Weights->material[PT_PAWN].eg) * 2 +
             (5 - stepsFromPromotion(pawnSquare, lhs)) * 400;
 
-    if (!A_H_FILES.contains(pawnBB)) {
+    if (!(A_H_FILES & pawnBB)) {
         // Winning for the side with the bishop
         return winningScore;
     }
@@ -584,7 +796,26 @@ i32 HandCraftedEvaluator::evaluateKBPK(const Position& pos, Color lhs) const {
            getPlacementScore(0, lhs) - getPlacementScore(0, rhs);
 }
 
-i32 HandCraftedEvaluator::evaluateKBNK(const Position &pos, Color lhs) const {
+i32 HandCraftedEvaluator::evaluateBitbase(const Position& pos, const MaterialEntry& material, Color lhs) const {
+    bitbase::WDL wdl = material.bitbase->probe(pos, lhs);
+    if (pos.getColorToMove() != lhs) {
+        wdl = bitbase::invertWDL(wdl);
+    }
+
+    switch (wdl) {
+        case bitbase::WDL_WIN:
+            // Let the classic evaluation guide the winning side towards mate or promotion.
+            return ENDGAME_WIN_BASE_SCORE + evaluateClassic(pos, material, lhs);
+
+        case bitbase::WDL_LOSS:
+            return -ENDGAME_WIN_BASE_SCORE + evaluateClassic(pos, material, lhs);
+
+        default:
+            return 0;
+    }
+}
+
+i32 HandCraftedEvaluator::evaluateKBNK(const Position &pos, const MaterialEntry&, Color lhs) const {
     constexpr i32 LONE_KING_BONUS_DS[] {
             0, 1, 2, 3, 4, 5, 6, 7,
             1, 2, 3, 4, 5, 6, 7, 6,
@@ -624,6 +855,48 @@ i32 HandCraftedEvaluator::evaluateKBNK(const Position &pos, Color lhs) const {
     return base - theirKingBonus * 50;
 }
 
+i32 HandCraftedEvaluator::scaleOppositeBishops(const Position& pos, Color strongSide) const {
+    Bitboard bishops = pos.getBitboard(WHITE_BISHOP) | pos.getBitboard(BLACK_BISHOP);
+    bool oppositeColors = (bishops & bbs::LIGHT_SQUARES) && (bishops & bbs::DARK_SQUARES);
+    if (!oppositeColors) {
+        return SCALE_FACTOR_NORMAL;
+    }
+
+    // Opposite colored bishops are drawish even a couple of pawns down,
+    // unless the side that's ahead has several passed pawns.
+    i32 nPassers = m_Passers[strongSide].count();
+    return std::min(SCALE_FACTOR_NORMAL, SCALE_FACTOR_NORMAL / 4 + nPassers * SCALE_FACTOR_NORMAL / 8);
+}
+
+i32 HandCraftedEvaluator::scaleRookPawns(const Position& pos, Color strongSide) const {
+    Bitboard pawns = pos.getBitboard(Piece(strongSide, PT_PAWN));
+    BoardFile file;
+    if ((pawns & bbs::getFileBitboard(FL_A)) == pawns) {
+        file = FL_A;
+    }
+    else if ((pawns & bbs::getFileBitboard(FL_H)) == pawns) {
+        file = FL_H;
+    }
+    else {
+        return SCALE_FACTOR_NORMAL;
+    }
+
+    // A bishop that controls the promotion square wins.
+    Square promSquare = getPromotionSquare(strongSide, file);
+    Bitboard bishops  = pos.getBitboard(Piece(strongSide, PT_BISHOP));
+    if (bishops) {
+        Bitboard promComplex = bbs::LIGHT_SQUARES.contains(promSquare) ? bbs::LIGHT_SQUARES : bbs::DARK_SQUARES;
+        if (bishops & promComplex) {
+            return SCALE_FACTOR_NORMAL;
+        }
+    }
 
+    // Otherwise, a defending king that reaches the corner can't be driven out of it.
+    Square theirKing = pos.getKingSquare(getOppositeColor(strongSide));
+    if (getChebyshevDistance(theirKing, promSquare) <= 1) {
+        return SCALE_FACTOR_DRAW;
+    }
+    return SCALE_FACTOR_NORMAL;
+}
 
-}
\ No newline at end of file
+}
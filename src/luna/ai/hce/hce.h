@@ -14,7 +14,10 @@
 
 #include "../../endgame.h"
 
+#include "evalscratch.h"
 #include "hceweights.h"
+#include "hcetrace.h"
+#include "material.h"
 
 namespace lunachess::ai {
 
@@ -38,6 +41,12 @@ public:
 
     i32 evaluate() const override;
 
+    /**
+     * Evaluates the position just like evaluate(), but also records in 'trace'
+     * which weights contributed to the score.
+     */
+    i32 evaluate(HCETrace& trace) const;
+
     inline i32 getDrawScore(Color pov) const override {
         return (pov == getPosition().getColorToMove() ? -m_Contempt : m_Contempt);
     }
@@ -68,38 +77,57 @@ private:
 
     bool m_PawnsDirty = false;
 
+    mutable MaterialTable m_MaterialTable;
+
+    /** Bitbase generation the material table was filled with. */
+    ui32 m_BitbaseGeneration = 0;
+
+    /** Trace being recorded. Only used by the TRACE instantiations of the evaluation features. */
+    mutable HCETrace* m_Trace = nullptr;
+
     // Evaluation functions
-    i32 evaluateClassic(const Position& pos, Color us) const;
+    template <bool TRACE = false>
+    i32 evaluateClassic(const Position& pos, const MaterialEntry& material, Color us) const;
+
+    // Material
+    const MaterialEntry& probeMaterial(const Position& pos) const;
+    void computeMaterialEntry(const Position& pos, MaterialEntry& entry) const;
+    i32 getScaleFactor(const Position& pos, const MaterialEntry& material, Color strongSide) const;
 
     // Solved endgames evaluation functions
-    i32 evaluateEndgame(const Position& pos, EndgameData egData) const;
-    i32 evaluateKPK(const Position& pos, Color lhs) const;
-    i32 evaluateKBPK(const Position& pos, Color lhs) const;
-    i32 evaluateKBNK(const Position& pos, Color lhs) const;
+    i32 evaluateDrawnEndgame(const Position& pos, const MaterialEntry& material, Color lhs) const;
+    i32 evaluateKPK(const Position& pos, const MaterialEntry& material, Color lhs) const;
+    i32 evaluateKBPK(const Position& pos, const MaterialEntry& material, Color lhs) const;
+    i32 evaluateKBNK(const Position& pos, const MaterialEntry& material, Color lhs) const;
+    i32 evaluateBitbase(const Position& pos, const MaterialEntry& material, Color lhs) const;
+
+    // Scaling functions
+    i32 scaleOppositeBishops(const Position& pos, Color strongSide) const;
+    i32 scaleRookPawns(const Position& pos, Color strongSide) const;
 
     // Specialized evaluations
     i32 evaluateKingAndPawns(const Position& pos, Color c) const;
 
     // Evaluation features
-    i32 getMaterialScore(i32 gpf, Color c) const;
-    i32 getMobilityScore(i32 gpf, Color c) const;
-    i32 getPlacementScore(i32 gpf, Color c) const;
-    i32 getKnightOutpostScore(i32 gpf, Color c) const;
-    i32 getBlockingPawnsScore(i32 gpf, Color c) const;
-    i32 getIsolatedPawnsScore(i32 gpf, Color c) const;
-    i32 getPassedPawnsScore(i32 gpf, Color c, Bitboard passers) const;
-    i32 getBackwardPawnsScore(i32 gpf, Color c) const;
-    i32 getKingPawnDistanceScore(i32 gpf, Color c, Bitboard allPassers) const;
-    i32 getBishopPairScore(i32 gpf, Color c) const;
+    template <bool TRACE = false> i32 getMaterialScore(i32 gpf, Color c) const;
+    template <bool TRACE = false> i32 getMobilityScore(i32 gpf, Color c, const EvalScratch& scratch) const;
+    template <bool TRACE = false> i32 getPlacementScore(i32 gpf, Color c) const;
+    template <bool TRACE = false> i32 getKnightOutpostScore(i32 gpf, Color c) const;
+    template <bool TRACE = false> i32 getBlockingPawnsScore(i32 gpf, Color c) const;
+    template <bool TRACE = false> i32 getIsolatedPawnsScore(i32 gpf, Color c) const;
+    template <bool TRACE = false> i32 getPassedPawnsScore(i32 gpf, Color c, Bitboard passers) const;
+    template <bool TRACE = false> i32 getBackwardPawnsScore(i32 gpf, Color c) const;
+    template <bool TRACE = false> i32 getKingPawnDistanceScore(i32 gpf, Color c, Bitboard allPassers) const;
+    template <bool TRACE = false> i32 getBishopPairScore(i32 gpf, Color c) const;
     i32 getBishopPawnColorComplexScore(i32 gpf, Color c) const;
-    i32 getKingAttackScore(i32 gpf, Color us) const;
-    i32 getRooksScore(i32 gpf, Color c, Bitboard passers) const;
+    template <bool TRACE = false> i32 getKingAttackScore(i32 gpf, Color us, const EvalScratch& scratch) const;
+    template <bool TRACE = false> i32 getRooksScore(i32 gpf, Color c, Bitboard passers, const EvalScratch& scratch) const;
 
     i32 computeBishopPawnComplexScore(i32 gpf, Bitboard complexPawns, Bitboard complexBishops) const;
 
     // King-attack related functions
-    i32 getCheckPower(i32 gpf, Color us) const;
-    i32 getQueenTouchPower(i32 gpf, Color us) const;
+    i32 getCheckPower(i32 gpf, Color us, const EvalScratch& scratch) const;
+    i32 getQueenTouchPower(i32 gpf, Color us, const EvalScratch& scratch) const;
 
 public:
     inline const HCEWeightTable& getWeights() const {
@@ -0,0 +1,73 @@
+#include "hcetrace.h"
+
+#include <unordered_map>
+
+namespace lunachess::ai {
+
+static std::vector<std::string> generateSlotNames() {
+    // Serialize a table in which every weight holds its own slot index, then
+    // look the indexes up in the flattened JSON.
+    HCEWeightTable table;
+    int* slots = reinterpret_cast<int*>(&table);
+    for (size_t i = 0; i < HCE_WEIGHT_SLOT_COUNT; ++i) {
+        slots[i] = static_cast<int>(i);
+    }
+
+    std::vector<std::string> names(HCE_WEIGHT_SLOT_COUNT);
+    nlohmann::json flat = nlohmann::json(table).flatten();
+    for (const auto& item: flat.items()) {
+        int slot = item.value();
+        names[slot] = item.key();
+    }
+    return names;
+}
+
+const std::string& getHCEWeightSlotName(size_t slot) {
+    static const std::vector<std::string> s_SlotNames = generateSlotNames();
+    return s_SlotNames[slot];
+}
+
+void HCETrace::reset(const HCEWeightTable* weights, i32 gpf, Color us) {
+    m_Weights = weights;
+    m_Gpf     = gpf;
+    m_Us      = us;
+    m_Linear  = true;
+    m_Terms.clear();
+}
+
+void HCETrace::addTerm(ui16 mgSlot, ui16 egSlot, Color c, i32 n) {
+    if (n == 0) {
+        return;
+    }
+
+    for (Term& term: m_Terms) {
+        if (term.mgSlot == mgSlot && term.egSlot == egSlot) {
+            term.count[c] += n;
+            return;
+        }
+    }
+
+    Term term = { mgSlot, egSlot, { 0, 0 } };
+    term.count[c] = n;
+    m_Terms.push_back(term);
+}
+
+i32 HCETrace::getTermScore(const Term& term, const HCEWeightTable& weights) const {
+    const int* slots = reinterpret_cast<const int*>(&weights);
+
+    i32 value = term.isTapered()
+                ? HCEWeight(slots[term.mgSlot], slots[term.egSlot]).get(m_Gpf)
+                : slots[term.mgSlot];
+
+    return (term.count[m_Us] - term.count[getOppositeColor(m_Us)]) * value;
+}
+
+i32 HCETrace::computeScore(const HCEWeightTable& weights) const {
+    i32 total = 0;
+    for (const Term& term: m_Terms) {
+        total += getTermScore(term, weights);
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef LUNA_AI_HCETRACE_H
+#define LUNA_AI_HCETRACE_H
+
+#include <string>
+#include <vector>
+
+#include "hceweights.h"
+
+namespace lunachess::ai {
+
+/**
+ * Number of integer weights in a HCEWeightTable. Weights are identified by their
+ * offset (or 'slot') in the table, when viewed as an array of ints.
+ */
+inline constexpr size_t HCE_WEIGHT_SLOT_COUNT = sizeof(HCEWeightTable) / sizeof(int);
+static_assert(sizeof(HCEWeightTable) % sizeof(int) == 0, "HCEWeightTable must only contain ints.");
+static_assert(HCE_WEIGHT_SLOT_COUNT < 0xffff, "HCE weight slots must fit in 16 bits.");
+
+/**
+ * Returns the path of a weight slot in the flattened weights JSON, such as "/material/1/mg".
+ */
+const std::string& getHCEWeightSlotName(size_t slot);
+
+/**
+ * Records which weights of a HCEWeightTable contributed to an evaluation and how many
+ * times they did so for each color.
+ *
+ * Terms are stored sparsely, one per distinct weight. A tapered weight (an HCEWeight, or
+ * a pair of middlegame/endgame PSTs) is stored as a single term referring to both of its
+ * slots, so the score can be rebuilt with the same rounding done by the evaluator.
+ */
+class HCETrace {
+public:
+    static constexpr ui16 NO_SLOT = 0xffff;
+
+    struct Term {
+        /** Slot of the middlegame weight, or of the weight itself if it's not tapered. */
+        ui16 mgSlot;
+
+        /** Slot of the endgame weight. NO_SLOT if the weight is not tapered. */
+        ui16 egSlot;
+
+        /** How many times the weight was applied for each color. */
+        i16 count[CL_COUNT];
+
+        inline bool isTapered() const { return egSlot != NO_SLOT; }
+    };
+
+    /**
+     * Clears the trace for a new evaluation of a table of weights.
+     * 'us' is the color whose perspective the evaluation is done from.
+     */
+    void reset(const HCEWeightTable* weights, i32 gpf, Color us);
+
+    inline void add(const HCEWeight& weight, Color c, i32 n = 1) {
+        addTerm(getSlot(weight.mg), getSlot(weight.eg), c, n);
+    }
+
+    inline void add(const int& mg, const int& eg, Color c, i32 n = 1) {
+        addTerm(getSlot(mg), getSlot(eg), c, n);
+    }
+
+    inline void add(const int& weight, Color c, i32 n = 1) {
+        addTerm(getSlot(weight), NO_SLOT, c, n);
+    }
+
+    /**
+     * Flags that the score did not come out of the classic evaluation (e.g. a
+     * known endgame was evaluated), so it cannot be rebuilt from the terms.
+     */
+    inline void markNonLinear() { m_Linear = false; }
+
+    inline bool isLinear() const { return m_Linear; }
+
+    inline i32 getGamePhaseFactor() const { return m_Gpf; }
+
+    inline Color getPerspective() const { return m_Us; }
+
+    inline const std::vector<Term>& getTerms() const { return m_Terms; }
+
+    /**
+     * Returns the contribution of a single term to the score, in the perspective
+     * of the traced evaluation.
+     */
+    i32 getTermScore(const Term& term, const HCEWeightTable& weights) const;
+
+    /**
+     * Rebuilds the classic evaluation score from the recorded terms with the
+     * given weights. Only matches the evaluator's score if isLinear().
+     */
+    i32 computeScore(const HCEWeightTable& weights) const;
+
+private:
+    const HCEWeightTable* m_Weights = nullptr;
+    std::vector<Term> m_Terms;
+    i32   m_Gpf    = 0;
+    Color m_Us     = CL_WHITE;
+    bool  m_Linear = true;
+
+    inline ui16 getSlot(const int& weight) const {
+        return static_cast<ui16>(&weight - reinterpret_cast<const int*>(m_Weights));
+    }
+
+    void addTerm(ui16 mgSlot, ui16 egSlot, Color c, i32 n);
+};
+
+}
+
+#endif // LUNA_AI_HCETRACE_H
@@ -0,0 +1,102 @@
+#ifndef LUNA_AI_HCE_MATERIAL_H
+#define LUNA_AI_HCE_MATERIAL_H
+
+#include <algorithm>
+#include <memory>
+
+#include "../../bitbase.h"
+#include "../../endgame.h"
+#include "../../types.h"
+
+namespace lunachess::ai {
+
+class HandCraftedEvaluator;
+struct MaterialEntry;
+
+/**
+ * Evaluates a known endgame in the 'lhs' perspective. 'material' is the entry
+ * of the position's material, which holds the function.
+ */
+using EndgameFunction = i32 (HandCraftedEvaluator::*)(const Position& pos, const MaterialEntry& material, Color lhs) const;
+
+/**
+ * Returns the scale factor of a position's score when 'strongSide' is ahead.
+ */
+using ScalingFunction = i32 (HandCraftedEvaluator::*)(const Position& pos, Color strongSide) const;
+
+/**
+ * Scale factors are applied to the score of the side that's ahead, as in
+ * score * scaleFactor / SCALE_FACTOR_NORMAL.
+ */
+inline constexpr i32 SCALE_FACTOR_DRAW   = 0;
+inline constexpr i32 SCALE_FACTOR_NORMAL = 64;
+
+/**
+ * Everything the evaluation needs to know about a material configuration.
+ */
+struct MaterialEntry {
+    ui64 key = 0;
+
+    /** Game phase factor of the material. */
+    i32 gpf = 0;
+
+    /** Known endgame of the material, if any. */
+    EndgameData endgame;
+
+    /** Function that evaluates the known endgame. If null, the classic evaluation is used. */
+    EndgameFunction endgameFunction = nullptr;
+
+    /** Scale factor for each side when it's ahead. Only depends on the material. */
+    i32 scaleFactor[CL_COUNT] = { SCALE_FACTOR_NORMAL, SCALE_FACTOR_NORMAL };
+
+    /**
+     * Function that computes the scale factor for each side when it's ahead, for
+     * material configurations in which it depends on where the pieces are.
+     * Overrides scaleFactor when set.
+     */
+    ScalingFunction scalingFunction[CL_COUNT] = { nullptr, nullptr };
+
+    /** Bitbase of the material, if one was loaded. Its first side is endgame.lhs. */
+    const bitbase::Bitbase* bitbase = nullptr;
+};
+
+/**
+ * Cache of material entries, indexed by material key.
+ * Games go through few material configurations, so a small table is enough.
+ */
+class MaterialTable {
+public:
+    static constexpr size_t N_ENTRIES = 4096;
+
+    /**
+     * Returns the slot of a material key. The slot may hold another key.
+     */
+    inline MaterialEntry& getSlot(ui64 key) {
+        return m_Entries[key & (N_ENTRIES - 1)];
+    }
+
+    inline void clear() {
+        std::fill(m_Entries.get(), m_Entries.get() + N_ENTRIES, MaterialEntry());
+    }
+
+    inline MaterialTable()
+        : m_Entries(std::make_unique<MaterialEntry[]>(N_ENTRIES)) {
+    }
+
+    inline MaterialTable(const MaterialTable& other)
+        : MaterialTable() {
+        std::copy(other.m_Entries.get(), other.m_Entries.get() + N_ENTRIES, m_Entries.get());
+    }
+
+    inline MaterialTable& operator=(const MaterialTable& other) {
+        std::copy(other.m_Entries.get(), other.m_Entries.get() + N_ENTRIES, m_Entries.get());
+        return *this;
+    }
+
+private:
+    std::unique_ptr<MaterialEntry[]> m_Entries;
+};
+
+}
+
+#endif // LUNA_AI_HCE_MATERIAL_H
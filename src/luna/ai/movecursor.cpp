@@ -125,7 +125,7 @@ static int getMoveDangerScore(Move move, const Position& pos) {
     return 0;
 }
 
-int MoveOrderingData::scoreQuietMove(Move move, const Position& pos) const {
+int MoveOrderingData::scoreQuietMove(Move move, const Position& pos, int ply) const {
     int total = 0;
 
     if (isCounterMove(pos.getLastMove(), move)) {
@@ -133,6 +133,7 @@ int MoveOrderingData::scoreQuietMove(Move move, const Position& pos) const {
     }
 
     total += getMoveHistory(move) * 32;
+    total += getContinuationHistory(move, ply) * 8;
     total += getHotmapDelta(move);
     total += getMoveDangerScore(move, pos) * 4;
 
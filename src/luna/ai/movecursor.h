@@ -1,7 +1,9 @@
 #ifndef LUNA_MOVECURSOR_H
 #define LUNA_MOVECURSOR_H
 
+#include <algorithm>
 #include <cstring>
+#include <memory>
 
 #include "../position.h"
 #include "../movegen.h"
@@ -27,6 +29,19 @@ enum MoveCursorStage {
 static_assert(MCS_BAD_CAPTURES > MCS_GOOD_CAPTURES, "Bad captures must come after good captures.");
 static_assert(MCS_QUIET > MCS_KILLERS, "Quiet moves must come after killer moves.");
 
+/** Number of distinct values of Piece::getRaw(). */
+inline constexpr int PIECE_INDEX_COUNT = PT_COUNT * CL_COUNT;
+
+/**
+ * Bound of the continuation and capture history values. These are updated with
+ * a gravity formula, which keeps them in [-HISTORY_MAX, HISTORY_MAX] and makes
+ * old values fade as new updates come in.
+ */
+inline constexpr int HISTORY_MAX = 16384;
+
+/** Number of previous plies a quiet move is paired with in continuation history. */
+inline constexpr int CONT_HISTORY_PLIES = 2;
+
 class MoveOrderingData {
 public:
     inline void storeKillerMove(Move move, int ply) {
@@ -63,7 +78,57 @@ public:
         return m_Killers[ply][index];
     }
 
-    int scoreQuietMove(Move move, const Position& pos) const;
+    /**
+     * Records the move played at the given ply, so that the continuation history
+     * of later plies can refer to it. Null moves must be stored as MOVE_INVALID.
+     */
+    inline void setPlayedMove(int ply, Move move) {
+        m_PlayedMoves[ply] = move;
+    }
+
+    /**
+     * Returns the continuation history of a quiet move played at 'ply', which is the
+     * sum of its history when following the moves of the previous CONT_HISTORY_PLIES plies.
+     */
+    inline int getContinuationHistory(Move move, int ply) const {
+        int total = 0;
+        for (int i = 0; i < CONT_HISTORY_PLIES && i < ply; ++i) {
+            Move prev = m_PlayedMoves[ply - i - 1];
+            if (prev != MOVE_INVALID) {
+                total += continuationEntry(i, prev, move);
+            }
+        }
+        return total;
+    }
+
+    /**
+     * Updates the continuation history of a quiet move played at 'ply' with the given
+     * bonus (or penalty, if negative).
+     */
+    inline void updateContinuationHistory(Move move, int ply, int bonus) {
+        for (int i = 0; i < CONT_HISTORY_PLIES && i < ply; ++i) {
+            Move prev = m_PlayedMoves[ply - i - 1];
+            if (prev != MOVE_INVALID) {
+                applyGravity(continuationEntry(i, prev, move), bonus);
+            }
+        }
+    }
+
+    inline int getCaptureHistory(Move move) const {
+        return m_CaptureHistory[move.getSourcePiece().getRaw()][move.getDest()][move.getDestPiece().getType()];
+    }
+
+    /** Updates the history of a capture with the given bonus (or penalty, if negative). */
+    inline void updateCaptureHistory(Move move, int bonus) {
+        applyGravity(m_CaptureHistory[move.getSourcePiece().getRaw()][move.getDest()][move.getDestPiece().getType()], bonus);
+    }
+
+    /** Returns the bonus used to update continuation and capture histories after a cutoff. */
+    static inline int getHistoryBonus(int depth) {
+        return std::min(depth * depth * 32, 1536);
+    }
+
+    int scoreQuietMove(Move move, const Position& pos, int ply) const;
 
     inline void resetCountermoves() {
         std::memset(m_CounterMoves, 0, sizeof(m_CounterMoves));
@@ -77,22 +142,69 @@ public:
         std::memset(m_Killers, 0, sizeof(m_Killers));
     }
 
+    inline void resetContinuationHistory() {
+        std::memset(m_ContHistory.get(), 0, sizeof(ContinuationHistory));
+        std::fill(std::begin(m_PlayedMoves), std::end(m_PlayedMoves), MOVE_INVALID);
+    }
+
+    inline void resetCaptureHistory() {
+        std::memset(m_CaptureHistory, 0, sizeof(m_CaptureHistory));
+    }
+
     inline void resetAll() {
         resetKillers();
         resetHistory();
         resetCountermoves();
+        resetContinuationHistory();
+        resetCaptureHistory();
     }
 
-    inline MoveOrderingData() {
+    inline MoveOrderingData()
+        : m_ContHistory(std::make_unique<ContinuationHistory>()) {
         resetAll();
     }
 
 private:
+    struct ContinuationHistory {
+        i16 entries[CONT_HISTORY_PLIES][PIECE_INDEX_COUNT][SQ_COUNT][PIECE_INDEX_COUNT][SQ_COUNT];
+    };
+
     Move m_Killers[128][2];
     Move m_CounterMoves[SQ_COUNT][SQ_COUNT];
     int  m_History[CL_COUNT][SQ_COUNT][SQ_COUNT] = {};
+    Move m_PlayedMoves[128];
+
+    // Takes a few megabytes, so it lives on the heap to keep searchers small
+    // enough to be created on the stack.
+    std::unique_ptr<ContinuationHistory> m_ContHistory;
+    i16  m_CaptureHistory[PIECE_INDEX_COUNT][SQ_COUNT][PT_COUNT];
+
+    inline i16& continuationEntry(int pliesAgo, Move prev, Move move) {
+        return m_ContHistory->entries[pliesAgo][prev.getSourcePiece().getRaw()][prev.getDest()]
+                                     [move.getSourcePiece().getRaw()][move.getDest()];
+    }
+
+    inline i16 continuationEntry(int pliesAgo, Move prev, Move move) const {
+        return m_ContHistory->entries[pliesAgo][prev.getSourcePiece().getRaw()][prev.getDest()]
+                                     [move.getSourcePiece().getRaw()][move.getDest()];
+    }
+
+    static inline void applyGravity(i16& entry, int bonus) {
+        bonus = std::clamp(bonus, -HISTORY_MAX, HISTORY_MAX);
+        entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
+    }
 };
 
+/**
+ * A move paired with the score used to order it.
+ */
+struct ScoredMove {
+    Move move;
+    int score;
+};
+
+using ScoredMoveList = StaticList<ScoredMove, MoveList::MAX_ELEMS>;
+
 template <bool NOISY_ONLY = false>
 class MoveCursor {
 public:
@@ -100,199 +212,198 @@ public:
         return m_Stage;
     }
 
+    /**
+     * Returns the next move to be searched, or MOVE_INVALID if there are no moves left.
+     * The same hash move must be passed on every call, since it is skipped when found
+     * in the later stages.
+     */
     Move next(const Position& pos,
               const MoveOrderingData& moveOrderingData,
               int ply,
               Move hashMove = MOVE_INVALID) {
-        // We start by checking if we still have more moves to
-        // use from the current stage. If we don't, we need to
-        // advance to the next stage.
-        while (m_Remaining <= 0) {
-            if (m_Stage >= MCS_END) {
-                // We are done with this position.
-                return MOVE_INVALID;
+        while (true) {
+            // We start by checking if we still have more moves to
+            // use from the current stage. If we don't, we need to
+            // advance to the next stage.
+            while (m_Cur >= m_End) {
+                if (m_Stage >= MCS_END) {
+                    // We are done with this position.
+                    return MOVE_INVALID;
+                }
+                advanceStage(pos, moveOrderingData, ply, hashMove);
             }
-            advanceStage(pos, moveOrderingData, ply, hashMove);
-        }
-        m_Remaining--;
 
-        Move move;
-        switch (m_Stage) {
-            case MCS_HASH_MOVE:
-                return hashMove;
+            Move move;
+            switch (m_Stage) {
+                case MCS_HASH_MOVE:
+                    m_Cur++;
+                    return hashMove;
 
-            case MCS_QUIET:
-                move = nextQuiet(pos, moveOrderingData, ply);
-                break;
+                case MCS_GOOD_CAPTURES:
+                    move = nextGoodCapture(pos);
+                    break;
 
-            default:
-                move = *m_Iter++;
-                break;
-        }
-        if (move == MOVE_INVALID || !pos.isMoveLegal(move) || move == hashMove) {
-            // Illegal move, try the next one.
-            // The call to next is likely going to get
-            // tail-call optimized.
-            return next(pos, moveOrderingData, ply);
-        }
+                case MCS_QUIET:
+                    move = nextQuiet(moveOrderingData, ply);
+                    break;
 
-        return move;
+                default:
+                    move = m_Moves[m_Cur++].move;
+                    break;
+            }
+
+            if (move != MOVE_INVALID && move != hashMove && pos.isMoveLegal(move)) {
+                return move;
+            }
+        }
     }
 
 private:
     MoveCursorStage m_Stage = MCS_NOT_STARTED;
-    MoveList m_Moves;
-    MoveList::Iterator m_Iter = m_Moves.begin();
-    MoveList::Iterator m_SimpleCapturesBegin;
-    int m_NGoodCaptures = 0;
-    int m_NBadCaptures  = 0;
+    ScoredMoveList m_Moves;
+
+    /** Index of the next move of the current stage and the end of the stage in m_Moves. */
+    int m_Cur = 0;
+    int m_End = 0;
 
-    /** Number of moves remaining in the current stage. */
-    int m_Remaining = 0;
+    /**
+     * Simple captures are stored in [m_CapturesBegin, m_CapturesEnd). Captures found to
+     * have a bad SEE while picking good captures are moved to [m_CapturesBegin, m_BadCapturesEnd).
+     */
+    int m_CapturesBegin   = 0;
+    int m_CapturesEnd     = 0;
+    int m_BadCapturesEnd  = 0;
 
     void advanceStage(const Position& pos,
                       const MoveOrderingData& moveOrderingData,
                       int ply,
-                      Move hashMove = MOVE_INVALID) {
+                      Move hashMove) {
         m_Stage = static_cast<MoveCursorStage>(m_Stage + 1);
+        m_Cur   = m_Moves.size();
 
         switch (m_Stage) {
             case MCS_HASH_MOVE:
-                m_Remaining = hashMove != MOVE_INVALID;
+                m_End = m_Cur + (hashMove != MOVE_INVALID);
                 break;
 
             case MCS_PROM_CAPTURES:
-                m_Iter      = m_Moves.end();
-                m_Remaining = movegen::generate<bits::makeMask<MT_PROMOTION_CAPTURE>(), PTM_ALL, true>(pos, m_Moves);
+                m_End = generate<bits::makeMask<MT_PROMOTION_CAPTURE>(), PTM_ALL>(pos);
                 break;
 
             case MCS_PROMOTIONS:
-                m_Iter      = m_Moves.end();
-                m_Remaining = movegen::generate<bits::makeMask<MT_SIMPLE_PROMOTION>(), PTM_ALL, true>(pos, m_Moves);
+                m_End = generate<bits::makeMask<MT_SIMPLE_PROMOTION>(), PTM_ALL>(pos);
                 break;
 
             case MCS_GOOD_CAPTURES:
-                m_Iter = m_Moves.end();
-                generateSimpleCaptures(pos, moveOrderingData);
-                m_Remaining = m_NGoodCaptures;
+                m_End = generate<bits::makeMask<MT_SIMPLE_CAPTURE>(), PTM_ALL>(pos);
+                m_CapturesBegin  = m_Cur;
+                m_CapturesEnd    = m_End;
+                m_BadCapturesEnd = m_Cur;
+                for (int i = m_Cur; i < m_End; ++i) {
+                    m_Moves[i].score = scoreCapture(m_Moves[i].move, moveOrderingData);
+                }
                 break;
 
             case MCS_EN_PASSANTS:
-                m_Iter      = m_Moves.end();
-                m_Remaining = movegen::generate<bits::makeMask<MT_EN_PASSANT_CAPTURE>(), BIT(PT_PAWN), true>(pos, m_Moves);
+                m_End = generate<bits::makeMask<MT_EN_PASSANT_CAPTURE>(), BIT(PT_PAWN)>(pos);
                 break;
 
-            case MCS_KILLERS: {
-                if constexpr (NOISY_ONLY) {
-                    advanceStage(pos, moveOrderingData, hashMove);
-                    return;
-                }
-
-                m_Iter      = m_Moves.end();
-                m_Remaining = 0;
-                for (int i = 0; i < 2; ++i) {
-                    Move killer = moveOrderingData.getKillerMove(ply, i);
+            case MCS_KILLERS:
+                if constexpr (!NOISY_ONLY) {
+                    for (int i = 0; i < 2; ++i) {
+                        Move killer = moveOrderingData.getKillerMove(ply, i);
 
-                    if (pos.isMovePseudoLegal(killer)) {
-                        m_Remaining++;
-                        m_Moves.add(killer);
+                        if (pos.isMovePseudoLegal(killer)) {
+                            m_Moves.add({ killer, 0 });
+                        }
                     }
                 }
+                m_End = m_Moves.size();
                 break;
-            }
 
             case MCS_BAD_CAPTURES:
-                m_Iter      = m_SimpleCapturesBegin + m_NGoodCaptures;
-                m_Remaining = m_NBadCaptures;
+                m_Cur = m_CapturesBegin;
+                m_End = m_BadCapturesEnd;
                 break;
 
             case MCS_QUIET:
-                if constexpr (NOISY_ONLY) {
-                    advanceStage(pos, moveOrderingData, hashMove);
-                    return;
+                if constexpr (!NOISY_ONLY) {
+                    m_End = generate<MTM_QUIET, PTM_ALL>(pos);
+                    for (int i = m_Cur; i < m_End; ++i) {
+                        m_Moves[i].score = moveOrderingData.scoreQuietMove(m_Moves[i].move, pos, ply);
+                    }
+                }
+                else {
+                    m_End = m_Cur;
                 }
-
-                m_Iter      = m_Moves.end();
-                m_Remaining = generateQuietMoves(pos, moveOrderingData);
                 break;
 
             default:
-                m_Remaining = 0;
+                m_End = m_Cur;
                 break;
         }
     }
 
-    Move nextQuiet(const Position& pos,
-                   const MoveOrderingData& moveOrderingData,
-                   int ply) {
-        // Skip killer moves
-        while (moveOrderingData.isKillerMove(*m_Iter, ply) &&
-               m_Remaining > 0) {
-            m_Iter++;
-            m_Remaining--;
+    /**
+     * Generates moves at the end of m_Moves, with a score of zero.
+     * Returns the new size of m_Moves.
+     */
+    template <MoveTypeMask MOVE_TYPES, PieceTypeMask PIECE_TYPES>
+    int generate(const Position& pos) {
+        MoveList generated;
+        movegen::generate<MOVE_TYPES, PIECE_TYPES, true>(pos, generated);
+        for (Move m: generated) {
+            m_Moves.add({ m, 0 });
         }
-        return *m_Iter++;
+        return m_Moves.size();
     }
 
-    /**
-     * Generates simple captures, sorts them and sets m_NGoodCaptures, m_NBadCaptures
-     * and m_SimpleCapturesBegin.
-     */
-    void generateSimpleCaptures(const Position& pos,
-                                const MoveOrderingData& moveOrderingData) {
-        m_SimpleCapturesBegin = m_Moves.end();
-        movegen::generate<bits::makeMask<MT_SIMPLE_CAPTURE>(), PTM_ALL, true>(pos, m_Moves);
-
-        bool seeTable[SQ_COUNT][SQ_COUNT];
-        for (auto it = m_SimpleCapturesBegin; it != m_Moves.end(); ++it) {
-            Move m = *it;
-            if (staticanalysis::hasGoodSEE(pos, m)) {
-                seeTable[m.getSource()][m.getDest()] = true;
-                m_NGoodCaptures++;
-            }
-            else {
-                seeTable[m.getSource()][m.getDest()] = false;
-                m_NBadCaptures++;
+    /** Swaps the highest scored move in [m_Cur, m_End) into m_Cur. */
+    void pickBest() {
+        int best = m_Cur;
+        for (int i = m_Cur + 1; i < m_End; ++i) {
+            if (m_Moves[i].score > m_Moves[best].score) {
+                best = i;
             }
         }
+        std::swap(m_Moves[m_Cur], m_Moves[best]);
+    }
 
-        // Sort the captures in see > mvv-lva order
-        utils::insertionSort(m_SimpleCapturesBegin, m_Moves.end(), [&seeTable](Move a, Move b) {
-            bool aHasGoodSEE = seeTable[a.getSource()][a.getDest()];
-            bool bHasGoodSEE = seeTable[b.getSource()][b.getDest()];
-            if (aHasGoodSEE && !bHasGoodSEE) {
-                return true;
-            }
-            if (!aHasGoodSEE && bHasGoodSEE) {
-                return false;
-            }
+    Move nextGoodCapture(const Position& pos) {
+        pickBest();
+        Move move = m_Moves[m_Cur].move;
+
+        // Only compute the SEE of captures we actually reach.
+        // Bad captures are deferred to MCS_BAD_CAPTURES, keeping their relative order.
+        if (!staticanalysis::hasGoodSEE(pos, move)) {
+            std::swap(m_Moves[m_Cur], m_Moves[m_BadCapturesEnd]);
+            m_BadCapturesEnd++;
+            m_Cur++;
+            return MOVE_INVALID;
+        }
 
-            return compareMvvLva(a, b);
-        });
+        m_Cur++;
+        return move;
     }
 
-    /** Generates and sorts quiet moves. Returns the number of generated quiet moves. */
-    int generateQuietMoves(const Position& pos,
-                           const MoveOrderingData& moveOrderingData) {
-        auto quietBegin = m_Moves.end();
-        int ret = movegen::generate<MTM_QUIET, PTM_ALL, true>(pos, m_Moves);
+    Move nextQuiet(const MoveOrderingData& moveOrderingData, int ply) {
+        pickBest();
+        Move move = m_Moves[m_Cur++].move;
 
-        int scores[SQ_COUNT][SQ_COUNT];
-        for (auto it = quietBegin; it != m_Moves.end(); ++it) {
-            Move m = *it;
-            scores[m.getSource()][m.getDest()] = moveOrderingData.scoreQuietMove(m, pos);
+        // Killers were already searched.
+        if (moveOrderingData.isKillerMove(move, ply)) {
+            return MOVE_INVALID;
         }
+        return move;
+    }
 
-        utils::insertionSort(quietBegin, m_Moves.end(), [&scores](Move a, Move b) {
-            int aScore = scores[a.getSource()][a.getDest()];
-            int bScore = scores[b.getSource()][b.getDest()];
-            return aScore > bScore;
-        });
-
-        return ret;
+    static int scoreCapture(Move move, const MoveOrderingData& moveOrderingData) {
+        // A capture history of HISTORY_MAX is worth about as much as
+        // capturing a piece of the next higher value.
+        return getMvvLvaScore(move) + moveOrderingData.getCaptureHistory(move) / 128;
     }
 
-    static bool compareMvvLva(Move a, Move b) {
+    static int getMvvLvaScore(Move move) {
         constexpr int MVV_LVA[PT_COUNT][PT_COUNT] {
                 /*         x-    xP    xN    xB    xR    xQ    xK  */
                 /* -- */ { 0,    0,    0,    0,    0,    0,    0   },
@@ -304,8 +415,7 @@ private:
                 /* Kx */ { 0,   100,  200,  300,  400,  500,  9999 },
         };
 
-        return MVV_LVA[a.getSourcePiece().getType()][a.getDestPiece().getType()] >
-               MVV_LVA[b.getSourcePiece().getType()][b.getDestPiece().getType()];
+        return MVV_LVA[move.getSourcePiece().getType()][move.getDestPiece().getType()];
     }
 };
 
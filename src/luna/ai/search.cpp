@@ -9,11 +9,19 @@ namespace lunachess::ai {
 #define TRACE_PUSH(move)              if constexpr (TRACE) { m_Tracer.push(move); }
 #define TRACE_POP()                   if constexpr (TRACE) { m_Tracer.pop(); }
 #define TRACE_DEPTH(depth)            if constexpr (TRACE) { m_Tracer.setRequestedDepth(depth); }
+#define TRACE_SET_WINDOW(a, b)        if constexpr (TRACE) { m_Tracer.setWindow(a, b); }
 #define TRACE_ADD_FLAGS(flags)        if constexpr (TRACE) { m_Tracer.addFlags(flags); }
 #define TRACE_SET_SCORES(score, a, b) if constexpr (TRACE) { m_Tracer.setScores(score, a, b); }
 #define TRACE_SET_STATEVAL(eval)      if constexpr (TRACE) { m_Tracer.setStaticEval(eval); }
 #define TRACE_UPDATE_BEST_MOVE(move)  if constexpr (TRACE) { m_Tracer.updateBestMove(move); }
-#define TRACE_FINISH_TREE(out)        if constexpr (TRACE) { out = m_Tracer.finishTree(); }
+#define TRACE_SET_PV(moves)           if constexpr (TRACE) { m_Tracer.setPrincipalVariation(moves); }
+#define TRACE_FINISH_TREE()           if constexpr (TRACE) { m_Tracer.finishTree(); }
+
+#ifdef LUNA_SEARCH_STATS
+#define STATS_INC(counter) (m_Stats.counter++)
+#else
+#define STATS_INC(counter) ((void)0)
+#endif
 
 /**
  * Pseudo-exception to be thrown when the search must be interrupted.
@@ -44,19 +52,43 @@ void AlphaBetaSearcher::interruptSearchIfNecessary() {
    if (m_ShouldStop) {
        throw SearchInterrupt();
    }
+   if (nodeLimitReached() && m_CurrDepth >= m_Settings.minDepth) {
+       throw SearchInterrupt();
+   }
    if (m_Results.visitedNodes % CHECK_TIME_NODE_INTERVAL == 0) {
+       checkPonderhit();
        if (m_TimeManager.timeIsUp() && m_CurrDepth >= m_Settings.minDepth) {
            throw SearchInterrupt();
        }
    }
 }
 
-template <bool TRACE>
+bool AlphaBetaSearcher::mateFound() const {
+    if (m_Settings.mateIn == 0 || m_Results.bestScore < FORCED_MATE_THRESHOLD) {
+        return false;
+    }
+    int pliesToMate = MATE_SCORE - m_Results.bestScore;
+    return (pliesToMate + 1) / 2 <= m_Settings.mateIn;
+}
+
+void AlphaBetaSearcher::checkPonderhit() {
+    if (m_TimeManager.pondering() && m_PonderHit) {
+        m_TimeManager.ponderhit();
+    }
+}
+
+template <bool TRACE, bool COLLECT_PV>
 int AlphaBetaSearcher::quiesce(int ply, int alpha, int beta) {
     TRACE_DEPTH(0);
+    TRACE_SET_WINDOW(alpha, beta);
+
+    if constexpr (COLLECT_PV) {
+        m_PvLength[ply] = 0;
+    }
 
     const Position& pos = m_Eval->getPosition();
     m_Results.visitedNodes++;
+    STATS_INC(qsearchNodes);
 
     interruptSearchIfNecessary();
 
@@ -113,7 +145,7 @@ int AlphaBetaSearcher::quiesce(int ply, int alpha, int beta) {
         TRACE_PUSH(move);
         m_Eval->makeMove(move);
 
-        int score = -quiesce<TRACE>(ply + 1, -beta, -alpha);
+        int score = -quiesce<TRACE, COLLECT_PV>(ply + 1, -beta, -alpha);
 
         m_Eval->undoMove();
         TRACE_POP();
@@ -131,6 +163,9 @@ int AlphaBetaSearcher::quiesce(int ply, int alpha, int beta) {
 
             if (score > alpha) {
                 alpha = score;
+                if constexpr (COLLECT_PV) {
+                    updatePv(ply, move);
+                }
             }
         }
     }
@@ -139,10 +174,68 @@ int AlphaBetaSearcher::quiesce(int ply, int alpha, int beta) {
     return alpha;
 }
 
+int AlphaBetaSearcher::quiescenceSearch(const Position& argPos, std::vector<Move>* pv) {
+    m_Settings   = {};
+    m_Results    = {};
+    m_ShouldStop = false;
+    m_CurrDepth  = 0;
+    m_TimeManager.start(TimeControl());
+    m_Eval->setPosition(argPos);
+    m_RootColor = argPos.getColorToMove();
+
+    if (pv == nullptr) {
+        return quiesce<false>(0, -HIGH_BETA, HIGH_BETA);
+    }
+
+    int score = quiesce<false, true>(0, -HIGH_BETA, HIGH_BETA);
+    pv->assign(m_PvTable[0], m_PvTable[0] + m_PvLength[0]);
+    return score;
+}
+
 bool AlphaBetaSearcher::isBadCapture(Move move) const {
     return !staticanalysis::hasGoodSEE(m_Eval->getPosition(), move);
 }
 
+void AlphaBetaSearcher::updatePv(int ply, Move move) {
+    Move* pv       = m_PvTable[ply];
+    const Move* childPv = m_PvTable[ply + 1];
+    int childLength     = m_PvLength[ply + 1];
+
+    pv[0] = move;
+    std::copy(childPv, childPv + childLength, pv + 1);
+    m_PvLength[ply] = childLength + 1;
+}
+
+void AlphaBetaSearcher::extendPvFromTT(std::vector<Move>& pv) {
+    const Position& pos = m_Eval->getPosition();
+    for (Move move: pv) {
+        m_Eval->makeMove(move);
+    }
+
+    // TT moves may come from another position with the same key, so check them.
+    TranspositionTable::Entry ttEntry;
+    while (pv.size() < size_t(MAX_SEARCH_DEPTH) &&
+           !pos.isRepetitionDraw() &&
+           m_TT.probe(pos, ttEntry) &&
+           ttEntry.move != MOVE_INVALID &&
+           pos.isMovePseudoLegal(ttEntry.move) &&
+           pos.isMoveLegal(ttEntry.move)) {
+        pv.push_back(ttEntry.move);
+        m_Eval->makeMove(ttEntry.move);
+    }
+
+    for (size_t i = 0; i < pv.size(); ++i) {
+        m_Eval->undoMove();
+    }
+}
+
+RootMove* AlphaBetaSearcher::findRootMove(Move move) {
+    auto it = std::find_if(m_RootMoves.begin(), m_RootMoves.end(), [move](const RootMove& rm) {
+        return rm.move == move;
+    });
+    return it != m_RootMoves.end() ? &*it : nullptr;
+}
+
 static bool hasOnlyPawns(const Position& pos) {
     Bitboard occ = pos.getCompositeBitboard();
     Bitboard w   = pos.getBitboard(Piece(CL_WHITE, PT_PAWN)) | pos.getBitboard(Piece(CL_WHITE, PT_KING));
@@ -180,7 +273,9 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
     constexpr bool DO_NMP  = !BIT_INTERSECTS(FLAGS, SKIP_NULL);
 
     m_Results.selDepth = std::max(m_Results.selDepth, ply);
+    m_PvLength[ply]    = 0;
     TRACE_DEPTH(depth);
+    TRACE_SET_WINDOW(alpha, beta);
     const Position& pos = m_Eval->getPosition();
 
     // Check for draws.
@@ -210,8 +305,10 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
     ttEntry.move       = MOVE_INVALID;
 
     bool foundInTT = m_TT.probe(posKey, ttEntry);
+    STATS_INC(ttProbes);
     if (foundInTT) {
         // We found the current position on the TT.
+        STATS_INC(ttHits);
         ttEntry.score = convertTTScoreToSearch(ttEntry.score, ply);
         staticEval = ttEntry.staticEval;
 
@@ -219,7 +316,7 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
 
         // We need to respect the restriction of root moves list in case we're in the
         // root of the search.
-        if (!IS_ROOT || m_RootMoves.contains(ttEntry.move)) {
+        if (!IS_ROOT || findRootMove(ttEntry.move) != nullptr) {
             hashMove = ttEntry.move;
             LUNA_ASSERT(pos.isMovePseudoLegal(hashMove),
                         "Hash move " << hashMove << " is not pseudo legal.");
@@ -233,6 +330,7 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
                 // when she finds mate scores in TT entries.
                 if (ttEntry.type == TranspositionTable::EXACT) {
                     m_Results.visitedNodes++;
+                    STATS_INC(ttCutoffs);
 
                     TRACE_UPDATE_BEST_MOVE(ttEntry.move);
                     TRACE_SET_SCORES(ttEntry.score, alpha, beta);
@@ -248,6 +346,7 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
 
                 if (alpha >= beta) {
                     m_Results.visitedNodes++;
+                    STATS_INC(ttCutoffs);
 
                     TRACE_UPDATE_BEST_MOVE(ttEntry.move);
                     TRACE_SET_SCORES(ttEntry.score, alpha, beta);
@@ -310,6 +409,7 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
         staticEval - rfpMargin > beta) {
         TRACE_SET_SCORES(staticEval - rfpMargin, alpha, beta);
         TRACE_ADD_FLAGS(STF_RFP_CUTOFF);
+        STATS_INC(rfpPrunes);
         return staticEval - rfpMargin;
     }
     // #----------------------------------------
@@ -330,6 +430,7 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
         if (quiesceScore < evalPlusMargin) {
             TRACE_SET_SCORES(quiesceScore, alpha, beta);
             depth = (depth * 2) / 3;
+            STATS_INC(razorReductions);
         }
     }
     // #----------------------------------------
@@ -351,8 +452,10 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
             int reduction = std::max(depth, std::min(2, 2 + (staticEval - beta) / 2000));
 
             // Null move pruning allowed
+            STATS_INC(nullMoveTries);
             TRACE_PUSH(MOVE_INVALID);
             m_Eval->makeNullMove();
+            m_MvOrderData.setPlayedMove(ply, MOVE_INVALID);
 
             int score = -pvs<TRACE, SKIP_NULL>(depth - reduction - 1, ply + 1, -beta, -beta + 1);
             if (score >= beta) {
@@ -362,6 +465,7 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
                 TRACE_SET_SCORES(beta, alpha, beta);
                 TRACE_ADD_FLAGS(STF_BETA_CUTOFF);
                 TRACE_ADD_FLAGS(STF_NMP_BETA_CUTOFF);
+                STATS_INC(nullMoveCutoffs);
                 return beta; // Prune
             }
 
@@ -381,18 +485,26 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
     bool hasLegalMoves  = false;
     MoveList searchedMoves;
 
+    // In the root, moves are searched in the order of the root moves list, skipping
+    // the ones already searched as other variations in this iteration.
     MoveCursor moveCursor;
-    Move bestMove = moveCursor.next(pos, m_MvOrderData, ply, hashMove);
+    int rootMoveIdx = m_PvIdx;
+    auto nextMove = [&]() {
+        if constexpr (IS_ROOT) {
+            return rootMoveIdx < static_cast<int>(m_RootMoves.size())
+                   ? m_RootMoves[rootMoveIdx++].move
+                   : MOVE_INVALID;
+        }
+        else {
+            return moveCursor.next(pos, m_MvOrderData, ply, hashMove);
+        }
+    };
+    Move bestMove = nextMove();
 
     for (Move move = bestMove;
          move != MOVE_INVALID;
-         move = moveCursor.next(pos, m_MvOrderData, ply, depth)) {
+         move = nextMove()) {
         hasLegalMoves = true;
-        if (IS_ROOT &&
-            !m_RootMoves.contains(move)) {
-            // Don't search for unrequested moves
-            continue;
-        }
 
         if (move == moveToSkip) {
             continue;
@@ -431,6 +543,7 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
             (ttEntry.type == TranspositionTable::EXACT || ttEntry.type == TranspositionTable::LOWERBOUND) &&
             move == hashMove) {
             int seBeta = std::min(beta, ttEntry.score);
+            STATS_INC(singularSearches);
 
             int score = pvs<TRACE, ZW>((depth - 1) / 2, ply + 1, seBeta - 1, seBeta, move);
             if (score < seBeta) {
@@ -438,6 +551,7 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
                 extendedSingular = true;
                 fullIterationDepth++;
                 TRACE_ADD_FLAGS(STF_EXTENDED_SINGULAR);
+                STATS_INC(singularExtensions);
             }
             else if (score >= beta) {
                 TRACE_ADD_FLAGS(STF_SE_BETA_CUTOFF);
@@ -470,12 +584,14 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
             depth <= 6 &&
             !isCheck   &&
             ((move.is<MTM_CAPTURE>() && moveCursor.getCurrentStage() == MCS_BAD_CAPTURES ) || !staticanalysis::hasGoodSEE(pos, move, -depth + 1))) {
+            STATS_INC(seePrunes);
             continue;
         }
         // #----------------------------------------
 
         TRACE_PUSH(move);
         m_Eval->makeMove(move);
+        m_MvOrderData.setPlayedMove(ply, move);
         m_TT.prefetch(pos.getZobrist());
 
         // #----------------------------------------
@@ -502,11 +618,17 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
             // Prune
             m_Eval->undoMove();
             TRACE_POP();
+            STATS_INC(futilityPrunes);
             continue;
         }
         // #----------------------------------------
 
         int iterationDepth = fullIterationDepth;
+        ui64 nodesBefore   = m_Results.visitedNodes;
+        int selDepthBefore = m_Results.selDepth;
+        if constexpr (IS_ROOT) {
+            m_Results.selDepth = 0;
+        }
 
         // #----------------------------------------
         // # LATE MOVE REDUCTIONS
@@ -521,6 +643,9 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
                 (move.is<MTM_QUIET>() || (isBadCapture(move)))) {
                 int reduction   = getLMRReduction(iterationDepth, searchedMoves.size());
                 iterationDepth -= std::max(0, reduction);
+                if (reduction > 0) {
+                    STATS_INC(lmrReductions);
+                }
             }
         }
         // #----------------------------------------
@@ -536,6 +661,9 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
             // with the full window.
             score = -pvs<TRACE, ZW>(iterationDepth - 1, ply + 1, -alpha - 1, -alpha);
             if (score > alpha) {
+                if (iterationDepth != fullIterationDepth) {
+                    STATS_INC(lmrResearches);
+                }
                 iterationDepth = fullIterationDepth;
                 score = -pvs<TRACE>(iterationDepth - 1, ply + 1, -beta, -alpha);
             }
@@ -545,8 +673,26 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
         TRACE_POP();
 
         if constexpr (IS_ROOT) {
+            RootMove& rootMove = m_RootMoves[rootMoveIdx - 1];
+            rootMove.nodes   += m_Results.visitedNodes - nodesBefore;
+            rootMove.selDepth = m_Results.selDepth;
+            m_Results.selDepth = std::max(selDepthBefore, m_Results.selDepth);
+
+            if (shouldSearchPV || score > alpha) {
+                rootMove.score        = score;
+                rootMove.scoreSum += score;
+                rootMove.scoreCount++;
+                rootMove.averageScore = static_cast<int>(rootMove.scoreSum / rootMove.scoreCount);
+                rootMove.pv.assign(1, move);
+                rootMove.pv.insert(rootMove.pv.end(), m_PvTable[1], m_PvTable[1] + m_PvLength[1]);
+            }
+            else {
+                // Only an upperbound is known, keep the order of the previous iteration.
+                rootMove.score = -HIGH_BETA;
+            }
+
             // Update results best move.
-            if (score > alpha) {
+            if (score > alpha && m_PvIdx == 0) {
                 m_Results.bestScore  = score;
                 m_Results.bestMove   = move;
                 m_Results.cached     = move == hashMove && ttEntry.depth >= originalDepth;
@@ -561,23 +707,46 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
             searchedDepth = iterationDepth;
             TRACE_UPDATE_BEST_MOVE(move);
 
+            if (!IS_ZW && score > alpha) {
+                updatePv(ply, move);
+            }
+
             if (score >= beta) {
                 // Beta cutoff, fail high
                 TRACE_ADD_FLAGS(STF_BETA_CUTOFF);
+                STATS_INC(betaCutoffs);
+                if (shouldSearchPV) {
+                    STATS_INC(firstMoveCutoffs);
+                }
 
                 alpha    = beta;
                 bestMove = move;
 
+                int historyBonus = MoveOrderingData::getHistoryBonus(depth);
                 if (bestMove.is<MTM_QUIET>()) {
                     m_MvOrderData.incrementHistory(bestMove, searchedDepth);
                     m_MvOrderData.storeKillerMove(bestMove, ply);
                     m_MvOrderData.storeCounterMove(lastMove, bestMove);
+                    m_MvOrderData.updateContinuationHistory(bestMove, ply, historyBonus);
 
                     // Penalize history for all moves besides the best move.
                     // The best move will always be the one at the last index,
                     // so we just skip it in the loop below.
                     for (int i = 0; i < searchedMoves.size() - 1; ++i) {
                         m_MvOrderData.penalizeHistory(searchedMoves[i], depth);
+                        if (searchedMoves[i].is<MTM_QUIET>()) {
+                            m_MvOrderData.updateContinuationHistory(searchedMoves[i], ply, -historyBonus);
+                        }
+                    }
+                }
+                else if (bestMove.is<MTM_CAPTURE>()) {
+                    m_MvOrderData.updateCaptureHistory(bestMove, historyBonus);
+                }
+
+                // Captures searched before the best move failed to produce a cutoff.
+                for (int i = 0; i < searchedMoves.size() - 1; ++i) {
+                    if (searchedMoves[i].is<MTM_CAPTURE>()) {
+                        m_MvOrderData.updateCaptureHistory(searchedMoves[i], -historyBonus);
                     }
                 }
                 break;
@@ -601,6 +770,13 @@ int AlphaBetaSearcher::pvs(int depth, int ply,
         return drawScore;
     }
 
+    if (IS_ROOT && m_PvIdx > 0) {
+        // The best moves of the root were excluded from this search, don't
+        // let its result replace theirs in the TT.
+        TRACE_SET_SCORES(alpha, alpha, beta);
+        return alpha;
+    }
+
     // Store search data in transposition table
     if (alpha <= originalAlpha) {
         // Fail low
@@ -651,6 +827,7 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
     try {
         // Reset everything
         m_TT.newGeneration();
+        m_Stats      = {};
         m_Searching  = true;
         m_ShouldStop = false;
         m_MvOrderData.resetAll();
@@ -664,22 +841,27 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
         int maxDepth        = std::min(MAX_SEARCH_DEPTH, settings.maxDepth);
 
         // Try to generate moves in the position before we search
-        m_RootMoves.clear();
-        movegen::generate(pos, m_RootMoves);
+        MoveList legalMoves;
+        movegen::generate(pos, legalMoves);
 
         // Filter out undesired moves (usually as specified by UCI 'searchmoves')
-        filterMoves(m_RootMoves, settings.moveFilter);
+        filterMoves(legalMoves, settings.moveFilter);
+
+        m_RootMoves.clear();
+        for (Move move: legalMoves) {
+            m_RootMoves.emplace_back(move);
+        }
 
         // Setup results object
         m_Results.visitedNodes = 1;
         m_Results.searchStart  = Clock::now();
+        m_Results.searchTime   = 0;
         m_Results.selDepth     = 0;
-        m_Results.bestMove     = m_RootMoves[0];
         m_Results.searchedVariations.clear();
-        m_Results.searchedVariations.resize(settings.multiPvCount);
+        m_Results.searchedVariations.resize(std::min<size_t>(settings.multiPvCount, m_RootMoves.size()));
 
         // Check for stalemate/checkmate position
-        if (m_RootMoves.size() == 0) {
+        if (m_RootMoves.empty()) {
             int score = pos.isCheck()
                         ? -MATE_SCORE // Checkmate
                         : drawScore;  // Stalemate
@@ -690,13 +872,15 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
 
             return std::move(m_Results);
         }
+        m_Results.bestMove = m_RootMoves[0].move;
 
         // Notify the time manager that we're starting a search
-        m_TimeManager.start(settings.ourTimeControl);
+        m_TimeManager.start(settings.ourTimeControl, settings.moveOverhead, settings.ponder);
 
         // Perform iterative deepening, starting at depth 1
         for (m_CurrDepth = 1; m_CurrDepth <= maxDepth; m_CurrDepth++) {
-            if (m_TimeManager.timeIsUp() || m_ShouldStop) {
+            checkPonderhit();
+            if (m_TimeManager.timeIsUp() || m_ShouldStop || nodeLimitReached()) {
                 break;
             }
 
@@ -707,9 +891,15 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
                 break;
             }
 
-            // Caller might be asking for a multi-pv search. Search the number of pvs requested
-            // or until all moves were searched
-            for (int multipv = 0; multipv < settings.multiPvCount && m_RootMoves.size() > 0; ++multipv) {
+            for (RootMove& rootMove: m_RootMoves) {
+                rootMove.previousScore = rootMove.score;
+            }
+
+            // Caller might be asking for a multi-pv search. Each variation is searched
+            // excluding the root moves of the previous ones, which stay at the start of
+            // the root moves list.
+            int pvCount = static_cast<int>(m_Results.searchedVariations.size());
+            for (m_PvIdx = 0; m_PvIdx < pvCount; ++m_PvIdx) {
                 if (m_TimeManager.timeIsUp() || m_ShouldStop) {
                     break;
                 }
@@ -720,21 +910,19 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
 
                 // Perform the search
                 try {
-                    TranspositionTable::Entry ttEntry;
-
                     constexpr int ASPIRATION_WINDOWS_MIN_DEPTH = 4;
                     constexpr int MAX_ASPIRATION_ITERATIONS    = 16;
 
                     m_CurrMove = MOVE_INVALID;
 
                     int score;
-                    int lastScore = m_Results.bestScore;
+                    int lastScore = m_RootMoves[m_PvIdx].previousScore;
 
                     int alpha = -HIGH_BETA;
                     int beta  = HIGH_BETA;
                     int delta = 100;
 
-                    if (m_CurrDepth > ASPIRATION_WINDOWS_MIN_DEPTH) {
+                    if (m_CurrDepth > ASPIRATION_WINDOWS_MIN_DEPTH && lastScore != -HIGH_BETA) {
                         alpha = std::max(-MATE_SCORE, lastScore - delta);
                         beta  = std::min(MATE_SCORE, lastScore + delta);
                     }
@@ -750,15 +938,20 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
                         TRACE_NEW_TREE(pos, m_CurrDepth);
 
                         score = pvs<TRACE, ROOT>(m_CurrDepth, 0, alpha, beta);
+
+                        // Bring the best move of this variation to the front, so that
+                        // re-searches start with it.
+                        std::stable_sort(m_RootMoves.begin() + m_PvIdx, m_RootMoves.end());
+
                         if (score <= alpha) {
                             // Fail low, widen lower bound.
-                            TRACE_FINISH_TREE(m_Results.traceTree);
+                            TRACE_FINISH_TREE();
                             beta  = (alpha + beta) / 2;
                             alpha = std::max(-MATE_SCORE, alpha - delta);
                         }
                         else if (score >= beta) {
                             // Fail high, increase lower bound
-                            TRACE_FINISH_TREE(m_Results.traceTree);
+                            TRACE_FINISH_TREE();
                             beta = std::min(MATE_SCORE, beta + delta);
                         }
                         else {
@@ -768,47 +961,22 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
                         delta += delta / 2;
                     }
 
-                    m_TT.probe(pos, ttEntry);
-
-                    m_RootMoves.remove(ttEntry.move);
-
-
                     // We finished the search on this variation at this depth.
                     // Now, properly fill the searched variation object for this pv
                     // in the results object.
-                    auto &pv = m_Results.searchedVariations[multipv];
-                    pv.score = ttEntry.score;
+                    const RootMove& rootMove = m_RootMoves[m_PvIdx];
+                    auto &pv = m_Results.searchedVariations[m_PvIdx];
+                    pv.score = rootMove.score;
                     pv.type  = TranspositionTable::EXACT;
+                    pv.moves = rootMove.pv;
+                    extendPvFromTT(pv.moves);
 
-                    // Check for moves on the PV in transposition table
-                    pv.moves.clear();
-                    while (m_TT.probe(pos, ttEntry) && ttEntry.move != MOVE_INVALID) {
-                        TRACE_PUSH(ttEntry.move);
-                        TRACE_ADD_FLAGS(STF_PV);
-                        pv.moves.push_back(ttEntry.move);
-                        m_Eval->makeMove(ttEntry.move);
-
-                        if (pos.isRepetitionDraw()) {
-                            break;
-                        }
-                    }
-
-                    // Undo all moves
-                    for (int i = 0; i < pv.moves.size(); ++i) {
-                        TRACE_POP();
-                        m_Eval->undoMove();
-                    }
-
-                    // When using multi PVs, we need to clear the entry of the initial
-                    // search position.
-                    if (settings.multiPvCount > 1) {
-                        m_TT.remove(pos);
-                    }
+                    TRACE_SET_PV(pv.moves);
 
                     // Notify handler
+                    m_Results.searchTime = deltaMs(Clock::now(), m_Results.searchStart);
                     if (settings.onPvFinish != nullptr) {
-                        m_Results.searchTime = deltaMs(Clock::now(), m_Results.searchStart);
-                        settings.onPvFinish(m_Results, multipv);
+                        settings.onPvFinish(m_Results, m_PvIdx);
                     }
                 }
                 catch (const SearchInterrupt &) {
@@ -816,24 +984,54 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
                     break;
                 }
 
-                TRACE_FINISH_TREE(m_Results.traceTree);
+                TRACE_FINISH_TREE();
             }
 
-            m_RootMoves.clear();
-            movegen::generate(pos, m_RootMoves);
-            filterMoves(m_RootMoves, settings.moveFilter);
+            if (m_PvIdx == pvCount && pvCount > 1) {
+                // All variations were searched, sort them.
+                std::stable_sort(m_RootMoves.begin(), m_RootMoves.begin() + pvCount);
+                std::stable_sort(m_Results.searchedVariations.begin(), m_Results.searchedVariations.end(),
+                                 [](const SearchedVariation& a, const SearchedVariation& b) {
+                    return a.score > b.score;
+                });
+                m_Results.bestMove  = m_RootMoves[0].move;
+                m_Results.bestScore = m_RootMoves[0].score;
+            }
 
-            m_TimeManager.onNewDepth(m_Results);
+            m_TimeManager.onNewDepth(m_Results, m_RootMoves[0].nodes);
             if (settings.onDepthFinish != nullptr) {
                 settings.onDepthFinish(m_Results);
             }
+
+            if (m_PvIdx == pvCount && mateFound()) {
+                // We were asked for a mate and just proved one.
+                break;
+            }
         }
 
-        m_Searching = false;
+        // A ponder search must not return before a ponderhit or stop, even if
+        // it has nothing left to search.
+        while (m_TimeManager.pondering() && !m_ShouldStop) {
+            checkPonderhit();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        if constexpr (TRACE) {
+            m_Tracer.close();
+        }
+
+        m_Results.searchTime = deltaMs(Clock::now(), m_Results.searchStart);
+        m_Stats.nodes = m_Results.visitedNodes;
+        m_PonderHit   = false;
+        m_Searching   = false;
 
         return m_Results;
     }
     catch (const std::exception &e) {
+        if constexpr (TRACE) {
+            m_Tracer.close();
+        }
+        m_PonderHit = false;
         m_Searching = false;
         std::cerr << e.what() << std::endl;
         throw;
@@ -842,7 +1040,10 @@ SearchResults AlphaBetaSearcher::searchInternal(const Position &argPos, SearchSe
 
 SearchResults AlphaBetaSearcher::search(const Position &argPos, SearchSettings settings) {
     if (settings.trace) {
-        return searchInternal<true>(argPos, settings);
+        if (m_Tracer.open(settings.traceFile, settings.traceFilter)) {
+            return searchInternal<true>(argPos, settings);
+        }
+        std::cerr << "Could not open search trace file " << settings.traceFile << ", searching without tracing." << std::endl;
     }
     return searchInternal<false>(argPos, settings);
 }
@@ -14,6 +14,7 @@
 #include "hce/hce.h"
 #include "timemanager.h"
 #include "searchtrace.h"
+#include "searchstats.h"
 
 #include "../clock.h"
 #include "../position.h"
@@ -25,6 +26,53 @@ constexpr int FORCED_MATE_THRESHOLD = 25000000;
 constexpr int MATE_SCORE = 30000000;
 constexpr int HIGH_BETA = MATE_SCORE + 1;
 
+/**
+ * A move of the root position, with the statistics gathered about it
+ * during the iterations of the search.
+ */
+struct RootMove {
+    Move move = MOVE_INVALID;
+
+    /**
+     * The score of the move in the current iteration, or -HIGH_BETA if the
+     * move couldn't be proven better than the best move.
+     */
+    int score = -HIGH_BETA;
+
+    /** The score of the move in the previous iteration. */
+    int previousScore = -HIGH_BETA;
+
+    /**
+     * Average of the scores given to the move over all iterations, including
+     * aspiration re-searches, or -HIGH_BETA if it was never given one.
+     */
+    int averageScore = -HIGH_BETA;
+
+    /** Sum and number of the scores averaged in averageScore. */
+    i64 scoreSum   = 0;
+    int scoreCount = 0;
+
+    /** The maximum ply reached while searching this move in its last search. */
+    int selDepth = 0;
+
+    /** The number of nodes spent searching this move, over all iterations. */
+    ui64 nodes = 0;
+
+    /** The principal variation that follows this move, starting with the move itself. */
+    std::vector<Move> pv;
+
+    inline explicit RootMove(Move move)
+        : move(move), pv(1, move) {
+    }
+
+    /** Root moves are sorted by score, then by their previous score, from best to worst. */
+    inline bool operator<(const RootMove& other) const {
+        return score != other.score
+               ? score > other.score
+               : previousScore > other.previousScore;
+    }
+};
+
 struct SearchedVariation {
     /**
      * The moves played in this variation.
@@ -113,13 +161,6 @@ struct SearchResults {
         }
         return MOVE_INVALID;
     }
-
-    /**
-     * Data structure that contains all paths taken by this search and results found along the way.
-     * This tree is only created if "trace" is set to true in search settings. Otherwise, this is set
-     * to nullptr.
-     */
-    std::shared_ptr<SearchTree> traceTree = nullptr;
 };
 
 struct SearchSettings {
@@ -132,6 +173,19 @@ struct SearchSettings {
     /** The minimum depth to search. Search won't be stopped (unless explicitly requested via stop(). */
     int minDepth = 1;
 
+    /**
+     * The maximum number of nodes to visit, including quiescence search nodes.
+     * Unlike time limits, the same node limit always yields the same search.
+     * Zero means no limit.
+     */
+    ui64 maxNodes = 0;
+
+    /**
+     * If not zero, searches for a forced mate and stops as soon as a mate in at
+     * most 'mateIn' moves is proven.
+     */
+    int mateIn = 0;
+
     /**
      * Predicate that must return true only to moves that should be searched in the root node.
      * If moveFilter == nullptr, the search will not filter out any moves.
@@ -144,6 +198,9 @@ struct SearchSettings {
     TimeControl ourTimeControl;
     TimeControl theirTimeControl;
 
+    /** Time in milliseconds reserved on each move for communication delays. */
+    i64 moveOverhead = TimeManager::DEFAULT_MOVE_OVERHEAD;
+
     //
     // Event handlers
     //
@@ -152,7 +209,22 @@ struct SearchSettings {
     std::function<void(const SearchResults&, Move move, int moveNumber)> onNewMove;
     i64 onNewMoveMinElapsedTime = 3000;
 
+    /**
+     * If true, the trees explored by the search are written to 'traceFile'.
+     * See SearchTracer.
+     */
     bool trace = false;
+    std::filesystem::path traceFile = "search.lunatrace";
+
+    /** Selects which nodes are written to the trace. */
+    SearchTraceFilter traceFilter;
+
+    /**
+     * Whether this is a ponder search, done on the opponent's time. A ponder search
+     * ignores the time controls and does not return until it is either stopped or
+     * AlphaBetaSearcher::ponderhit() is called, after which 'ourTimeControl' applies.
+     */
+    bool ponder = false;
 };
 
 class AlphaBetaSearcher {
@@ -165,8 +237,26 @@ public:
         return m_Searching;
     }
 
+    /**
+     * Notifies an ongoing ponder search that the opponent played the expected move.
+     * The search goes on with everything it found so far, but is now bound to the
+     * time controls it was started with.
+     */
+    inline void ponderhit() {
+        m_PonderHit = true;
+    }
+
     SearchResults search(const Position& pos, SearchSettings settings = SearchSettings());
 
+    /**
+     * Runs only the quiescence search on the given position, without time limits.
+     * Returns the score in the perspective of the side to move.
+     *
+     * If 'pv' is not null, it receives the sequence of noisy moves that leads
+     * from the given position to the quiet position the score refers to.
+     */
+    int quiescenceSearch(const Position& pos, std::vector<Move>* pv = nullptr);
+
     inline AlphaBetaSearcher()
         : m_Eval(new HandCraftedEvaluator()) {
     }
@@ -190,20 +280,51 @@ public:
         return *m_Eval;
     }
 
+    /**
+     * The moves of the root position of the current (or last) search, sorted
+     * from best to worst as of the last finished iteration.
+     */
+    inline const std::vector<RootMove>& getRootMoves() const {
+        return m_RootMoves;
+    }
+
+    /**
+     * Statistics of the last search. Only the node count is filled in
+     * unless compiled with LUNA_SEARCH_STATS.
+     */
+    inline const SearchStats& getStats() const {
+        return m_Stats;
+    }
+
 private:
     TranspositionTable m_TT;
     SearchResults      m_Results;
     MoveOrderingData   m_MvOrderData;
     TimeManager        m_TimeManager;
     SearchTracer       m_Tracer;
+    SearchStats        m_Stats;
     Color              m_RootColor;
-    MoveList           m_RootMoves;
+    std::vector<RootMove> m_RootMoves;
     SearchSettings     m_Settings;
     std::shared_ptr<Evaluator> m_Eval;
     int                m_CurrDepth;
     Move               m_CurrMove;
 
-    bool m_ShouldStop = false;
+    /**
+     * Index of the root move whose variation is being searched. Root moves
+     * before it were already searched as other variations in this iteration.
+     */
+    int                m_PvIdx = 0;
+
+    /**
+     * Triangular table with the principal variation found at each ply.
+     * m_PvTable[ply] holds m_PvLength[ply] moves.
+     */
+    Move m_PvTable[MAX_SEARCH_DEPTH * 2][MAX_SEARCH_DEPTH * 2];
+    int  m_PvLength[MAX_SEARCH_DEPTH * 2] = {};
+
+    std::atomic<bool> m_ShouldStop { false };
+    std::atomic<bool> m_PonderHit  { false };
     bool m_Searching  = false;
 
     enum SearchFlags {
@@ -218,7 +339,11 @@ private:
     template <bool TRACE, SearchFlags FLAGS = NO_SEARCH_FLAGS>
     int pvs(int depth, int ply, int alpha, int beta, Move moveToSkip = MOVE_INVALID);
 
-    template <bool TRACE>
+    /**
+     * If COLLECT_PV is set, fills the PV table like pvs() does. The main search
+     * doesn't need the noisy tail of its variations, so it leaves it unset.
+     */
+    template <bool TRACE, bool COLLECT_PV = false>
     int quiesce(int ply, int alpha, int beta);
 
     /**
@@ -228,8 +353,32 @@ private:
      */
     void interruptSearchIfNecessary();
 
+    /**
+     * Converts a ponder search into a timed search if ponderhit() was called.
+     */
+    void checkPonderhit();
+
+    /** Whether the search visited as many nodes as it was allowed to. */
+    inline bool nodeLimitReached() const {
+        return m_Settings.maxNodes != 0 && m_Results.visitedNodes >= m_Settings.maxNodes;
+    }
+
+    /** Whether the search was asked for a mate and found a short enough one. */
+    bool mateFound() const;
+
     bool isBadCapture(Move move) const;
 
+    /** Sets the PV of 'ply' to 'move' followed by the PV of the next ply. */
+    void updatePv(int ply, Move move);
+
+    /**
+     * Continues a PV that was cut short by a TT cutoff with the moves stored in the
+     * TT, until a move is missing or illegal, or a position repeats.
+     */
+    void extendPvFromTT(std::vector<Move>& pv);
+
+    RootMove* findRootMove(Move move);
+
     template <bool TRACE>
     SearchResults searchInternal(const Position& argPos, SearchSettings settings = SearchSettings());
 };
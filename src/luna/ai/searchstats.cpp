@@ -0,0 +1,81 @@
+#include "searchstats.h"
+
+#include <iomanip>
+#include <utility>
+
+namespace lunachess::ai {
+
+using Counter = ui64 SearchStats::*;
+
+static const std::pair<const char*, Counter> s_Counters[] = {
+    { "nodes",              &SearchStats::nodes },
+    { "qsearchNodes",       &SearchStats::qsearchNodes },
+    { "ttProbes",           &SearchStats::ttProbes },
+    { "ttHits",             &SearchStats::ttHits },
+    { "ttCutoffs",          &SearchStats::ttCutoffs },
+    { "nullMoveTries",      &SearchStats::nullMoveTries },
+    { "nullMoveCutoffs",    &SearchStats::nullMoveCutoffs },
+    { "rfpPrunes",          &SearchStats::rfpPrunes },
+    { "futilityPrunes",     &SearchStats::futilityPrunes },
+    { "seePrunes",          &SearchStats::seePrunes },
+    { "razorReductions",    &SearchStats::razorReductions },
+    { "lmrReductions",      &SearchStats::lmrReductions },
+    { "lmrResearches",      &SearchStats::lmrResearches },
+    { "singularSearches",   &SearchStats::singularSearches },
+    { "singularExtensions", &SearchStats::singularExtensions },
+    { "betaCutoffs",        &SearchStats::betaCutoffs },
+    { "firstMoveCutoffs",   &SearchStats::firstMoveCutoffs },
+};
+
+static double ratio(ui64 num, ui64 den) {
+    return den == 0 ? 0.0 : static_cast<double>(num) / static_cast<double>(den);
+}
+
+double SearchStats::getTTHitRate() const {
+    return ratio(ttHits, ttProbes);
+}
+
+double SearchStats::getFirstMoveCutoffRate() const {
+    return ratio(firstMoveCutoffs, betaCutoffs);
+}
+
+double SearchStats::getQSearchNodeShare() const {
+    return ratio(qsearchNodes, nodes);
+}
+
+SearchStats& SearchStats::operator+=(const SearchStats& other) {
+    for (const auto& [name, counter]: s_Counters) {
+        this->*counter += other.*counter;
+    }
+    return *this;
+}
+
+void to_json(nlohmann::json& j, const SearchStats& stats) {
+    j = nlohmann::json::object();
+    j["enabled"] = SearchStats::ENABLED;
+    for (const auto& [name, counter]: s_Counters) {
+        j[name] = stats.*counter;
+    }
+    j["ttHitRate"]           = stats.getTTHitRate();
+    j["firstMoveCutoffRate"] = stats.getFirstMoveCutoffRate();
+    j["qsearchNodeShare"]    = stats.getQSearchNodeShare();
+}
+
+std::ostream& operator<<(std::ostream& stream, const SearchStats& stats) {
+    std::ios::fmtflags flags = stream.flags();
+
+    stream << std::left;
+    for (const auto& [name, counter]: s_Counters) {
+        stream << std::setw(24) << name << stats.*counter << std::endl;
+    }
+
+    stream << std::fixed << std::setprecision(2);
+    stream << std::setw(24) << "ttHitRate"           << stats.getTTHitRate() * 100 << "%" << std::endl;
+    stream << std::setw(24) << "firstMoveCutoffRate" << stats.getFirstMoveCutoffRate() * 100 << "%" << std::endl;
+    stream << std::setw(24) << "qsearchNodeShare"    << stats.getQSearchNodeShare() * 100 << "%" << std::endl;
+
+    stream.flags(flags);
+    return stream;
+}
+
+}
@@ -0,0 +1,77 @@
+#ifndef LUNA_AI_SEARCHSTATS_H
+#define LUNA_AI_SEARCHSTATS_H
+
+#include <ostream>
+
+#include <nlohmann/json.hpp>
+
+#include "../types.h"
+
+namespace lunachess::ai {
+
+/**
+ * Counters of what happened during a search, such as how often each pruning
+ * technique fired. Useful to understand why the tree size or the NPS changed
+ * between two builds.
+ *
+ * Counting only happens in builds with LUNA_SEARCH_STATS defined (see the
+ * CMake option of the same name). Otherwise, only 'nodes' is filled in.
+ *
+ * Each searcher owns its own counters, so no synchronization is needed while
+ * searching. Counters of different searchers can be merged with operator+=.
+ */
+struct SearchStats {
+#ifdef LUNA_SEARCH_STATS
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    /** Total number of visited nodes, including quiescence search nodes. */
+    ui64 nodes = 0;
+
+    /** Number of nodes visited by the quiescence search. */
+    ui64 qsearchNodes = 0;
+
+    ui64 ttProbes  = 0;
+    ui64 ttHits    = 0;
+    ui64 ttCutoffs = 0;
+
+    ui64 nullMoveTries   = 0;
+    ui64 nullMoveCutoffs = 0;
+
+    ui64 rfpPrunes      = 0;
+    ui64 futilityPrunes = 0;
+    ui64 seePrunes      = 0;
+
+    /** Razoring reduces the depth of the node instead of pruning it. */
+    ui64 razorReductions = 0;
+
+    ui64 lmrReductions = 0;
+    ui64 lmrResearches = 0;
+
+    ui64 singularSearches   = 0;
+    ui64 singularExtensions = 0;
+
+    ui64 betaCutoffs      = 0;
+    ui64 firstMoveCutoffs = 0;
+
+    /** Fraction of the TT probes that found an entry. */
+    double getTTHitRate() const;
+
+    /** Fraction of the beta cutoffs that were caused by the first searched move. */
+    double getFirstMoveCutoffRate() const;
+
+    /** Fraction of the visited nodes that were visited by the quiescence search. */
+    double getQSearchNodeShare() const;
+
+    SearchStats& operator+=(const SearchStats& other);
+};
+
+void to_json(nlohmann::json& j, const SearchStats& stats);
+
+std::ostream& operator<<(std::ostream& stream, const SearchStats& stats);
+
+}
+
+#endif // LUNA_AI_SEARCHSTATS_H
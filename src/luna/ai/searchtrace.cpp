@@ -1,59 +1,305 @@
 #include "searchtrace.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
+#include <optional>
+#include <stdexcept>
+
+#include "../movegen.h"
 
 namespace lunachess::ai {
 
-void SearchTracer::newTree(const Position& pos, int expectedDepth) {
-    // Reference position for Luna 1.0 dev-5:
-    // r1b2rk1/1pp2p1p/2np1np1/pB2b1q1/4P3/NP3N2/P1PB1PPP/2RQ1K1R b - - 4 11
-    constexpr int DEPTH_SIZE_TABLE[] {
-        1, 250, 450, 1300, 2100, 5000, 11000,
-        25000, 50000, 90000, 165000, 275000, 450000,
-        875000, 1550000,
-    };
+//
+// Move compression
+//
+
+ui16 compressTraceMove(Move move) {
+    if (move == MOVE_INVALID) {
+        return 0;
+    }
+    return static_cast<ui16>(move.getSource()
+                             | (move.getDest() << 6)
+                             | (move.getPromotionPiece() << 12));
+}
+
+Move decompressTraceMove(const Position& pos, ui16 move) {
+    if (move == 0) {
+        return MOVE_INVALID;
+    }
+
+    MoveList moves;
+    movegen::generate(pos, moves);
+    for (Move m: moves) {
+        if (compressTraceMove(m) == move) {
+            return m;
+        }
+    }
+    throw std::runtime_error("Traced move does not match any legal move of " + pos.toFen() + ".");
+}
+
+//
+// Tracer
+//
+
+bool SearchTracer::open(const std::filesystem::path& path, const SearchTraceFilter& filter) {
+    close();
+
+    m_Filter = filter;
+
+    m_Out.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_Out) {
+        return false;
+    }
+
+    SearchTraceHeader header = {};
+    std::memcpy(header.magic, SearchTraceHeader::MAGIC, sizeof(header.magic));
+    header.version  = SearchTraceHeader::VERSION;
+    header.nodeSize = sizeof(Node);
+    m_Out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    m_Chunk.reserve(CHUNK_NODE_COUNT);
+    return true;
+}
+
+void SearchTracer::close() {
+    if (!isOpen()) {
+        return;
+    }
+    finishTree();
+    m_Out.close();
+}
+
+void SearchTracer::newTree(const Position& rootPos, int depth) {
+    finishTree();
+
+    writeBlock(SearchTraceBlock::TREE, depth);
 
-    int expectedNodes = DEPTH_SIZE_TABLE[std::min(expectedDepth, int(sizeof(DEPTH_SIZE_TABLE)/sizeof(*DEPTH_SIZE_TABLE)))];
-    m_SearchTree = std::make_shared<SearchTree>(pos, expectedNodes);
+    PackedPosition packed = rootPos.toPacked();
+    m_Out.write(reinterpret_cast<const char*>(&packed), sizeof(packed));
 
     // Add root node
-    m_SearchTree->m_Nodes.emplace_back();
+    m_NodeCount    = 0;
+    m_SkippedDepth = 0;
+    m_SampledPly   = -1;
+    m_PrincipalVariation.clear();
+    m_Path.emplace_back();
+    m_Rng.seed(depth);
+}
+
+void SearchTracer::finishTree() {
+    if (m_Path.empty()) {
+        return;
+    }
+
+    m_SkippedDepth = 0;
+    while (!m_Path.empty()) {
+        finishNode();
+    }
+    flushChunk();
+
+    if (!m_PrincipalVariation.empty()) {
+        writeBlock(SearchTraceBlock::PV, m_PrincipalVariation.size());
+        m_Out.write(reinterpret_cast<const char*>(m_PrincipalVariation.data()),
+                    m_PrincipalVariation.size() * sizeof(ui16));
+    }
+
+    writeBlock(SearchTraceBlock::TREE_END, m_NodeCount);
+    m_Out.flush();
 }
 
 void SearchTracer::push(Move move) {
-    for (ui32 i = 0; i < current().nChildren; ++i) {
-        ui32 childIdx = current().childIndexes[i];
-        auto& child = m_SearchTree->m_Nodes[childIdx];
+    if (m_SkippedDepth > 0) {
+        m_SkippedDepth++;
+        return;
+    }
+
+    int ply = static_cast<int>(m_Path.size());
+    if ((m_Filter.maxPly > 0 && ply > m_Filter.maxPly) ||
+        (ply == 1 && m_Filter.rootMove != MOVE_INVALID &&
+         compressTraceMove(move) != compressTraceMove(m_Filter.rootMove))) {
+        // Skip the whole subtree of this node.
+        m_SkippedDepth = 1;
+        return;
+    }
+
+    if (m_Filter.sampleRate > 1 && m_SampledPly < 0 && m_Rng() % m_Filter.sampleRate == 0) {
+        m_SampledPly = ply;
+    }
+
+    Node& node    = m_Path.emplace_back();
+    node.lastMove = compressTraceMove(move);
+}
+
+void SearchTracer::pop() {
+    if (m_SkippedDepth > 0) {
+        m_SkippedDepth--;
+        return;
+    }
+    finishNode();
+}
 
-        if (child.lastMove == move) {
-            // A child with the same move already existed. Overwrite it.
-            m_CurrNodeIdx = childIdx;
+void SearchTracer::setPrincipalVariation(const std::vector<Move>& pv) {
+    m_PrincipalVariation.clear();
+    for (Move move: pv) {
+        m_PrincipalVariation.push_back(compressTraceMove(move));
+    }
+}
+
+bool SearchTracer::shouldWriteNode(const Node& node, int ply) const {
+    if (ply == 0) {
+        // Always write the root, so that the tree can be read back.
+        return true;
+    }
+    if (m_Filter.pvNodesOnly && !BIT_INTERSECTS(node.flags, STF_OPEN_WINDOW)) {
+        return false;
+    }
+    if (m_Filter.sampleRate > 1) {
+        // Only write sampled subtrees and their ancestors.
+        return m_SampledPly >= 0 || node.lastChild != Node::NO_NODE;
+    }
+    return true;
+}
+
+void SearchTracer::finishNode() {
+    Node node = m_Path.back();
+    m_Path.pop_back();
+
+    int ply    = static_cast<int>(m_Path.size());
+    bool write = shouldWriteNode(node, ply);
+    if (ply == m_SampledPly) {
+        m_SampledPly = -1;
+    }
+    if (!write) {
+        return;
+    }
+
+    ui32 nodeIdx = m_NodeCount++;
+    if (!m_Path.empty()) {
+        // Link the node to its parent, which is still being searched.
+        Node& parent     = m_Path.back();
+        node.prevSibling = parent.lastChild;
+        parent.lastChild = nodeIdx;
+    }
+
+    m_Chunk.push_back(node);
+    if (m_Chunk.size() >= CHUNK_NODE_COUNT) {
+        flushChunk();
+    }
+}
+
+void SearchTracer::flushChunk() {
+    if (m_Chunk.empty()) {
+        return;
+    }
+    writeBlock(SearchTraceBlock::NODES, m_Chunk.size());
+    m_Out.write(reinterpret_cast<const char*>(m_Chunk.data()), m_Chunk.size() * sizeof(Node));
+    m_Chunk.clear();
+}
+
+void SearchTracer::writeBlock(const char (&tag)[4], ui32 count) {
+    SearchTraceBlock block;
+    std::memcpy(block.tag, tag, sizeof(block.tag));
+    block.count = count;
+    m_Out.write(reinterpret_cast<const char*>(&block), sizeof(block));
+}
+
+//
+// Reader
+//
+
+static void markPrincipalVariation(std::vector<SearchTraceNode>& nodes, const std::vector<ui16>& pv) {
+    SearchTraceNode* node = &nodes.back();
+    node->flags = SearchTreeFlags(node->flags | STF_PV);
+
+    for (ui16 move: pv) {
+        // Walking from the last child, the first match is the last search of the move.
+        ui32 childIdx = node->lastChild;
+        while (childIdx != SearchTraceNode::NO_NODE && nodes[childIdx].lastMove != move) {
+            childIdx = nodes[childIdx].prevSibling;
+        }
+        if (childIdx == SearchTraceNode::NO_NODE) {
+            // The rest of the PV came from the TT.
             return;
         }
+
+        node = &nodes[childIdx];
+        node->flags = SearchTreeFlags(node->flags | STF_PV);
     }
+}
 
-    // Create the node in the tree
-    ui32 parentIdx  = m_CurrNodeIdx;
-    ui32 newNodeIdx = m_SearchTree->m_Nodes.size();
-    m_SearchTree->m_Nodes.emplace_back(); // adds empty node
+std::vector<SearchTree> readSearchTrace(std::istream& stream) {
+    SearchTraceHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, SearchTraceHeader::MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not a search trace file.");
+    }
+    if (header.version != SearchTraceHeader::VERSION) {
+        throw std::runtime_error("Unsupported search trace version " + std::to_string(header.version) + ".");
+    }
+    if (header.nodeSize != sizeof(SearchTraceNode)) {
+        throw std::runtime_error("Unexpected search trace node size " + std::to_string(header.nodeSize) + ".");
+    }
 
-    // Reference it
-    Node& parent = current();
-    m_CurrNodeIdx = newNodeIdx;
-    Node& curr = current();
-    curr.lastMove = move;
+    std::vector<SearchTree> trees;
+
+    std::optional<Position> rootPos;
+    int depth = 0;
+    std::vector<SearchTraceNode> nodes;
+    std::vector<ui16> pv;
+
+    SearchTraceBlock block;
+    while (stream.read(reinterpret_cast<char*>(&block), sizeof(block))) {
+        if (std::memcmp(block.tag, SearchTraceBlock::TREE, sizeof(block.tag)) == 0) {
+            PackedPosition packed;
+            if (!stream.read(reinterpret_cast<char*>(&packed), sizeof(packed))) {
+                break;
+            }
+
+            rootPos = Position::fromPacked(packed);
+            if (!rootPos.has_value()) {
+                throw std::runtime_error("Invalid root position in search trace.");
+            }
+            depth = block.count;
+            nodes.clear();
+            pv.clear();
+        }
+        else if (std::memcmp(block.tag, SearchTraceBlock::NODES, sizeof(block.tag)) == 0) {
+            size_t first = nodes.size();
+            nodes.resize(first + block.count);
+            if (!stream.read(reinterpret_cast<char*>(nodes.data() + first), block.count * sizeof(SearchTraceNode))) {
+                break;
+            }
+        }
+        else if (std::memcmp(block.tag, SearchTraceBlock::PV, sizeof(block.tag)) == 0) {
+            pv.resize(block.count);
+            if (!stream.read(reinterpret_cast<char*>(pv.data()), block.count * sizeof(ui16))) {
+                break;
+            }
+        }
+        else if (std::memcmp(block.tag, SearchTraceBlock::TREE_END, sizeof(block.tag)) == 0) {
+            if (!rootPos.has_value() || nodes.size() != block.count || nodes.empty()) {
+                throw std::runtime_error("Corrupted tree in search trace.");
+            }
+            markPrincipalVariation(nodes, pv);
+            trees.emplace_back(std::move(*rootPos), depth, std::move(nodes));
+            rootPos.reset();
+            nodes = {};
+        }
+        else {
+            throw std::runtime_error("Unknown block in search trace.");
+        }
+    }
 
-    // Set correct values
-    curr.parentIndex = parentIdx;
-    parent.childIndexes[parent.nChildren++] = newNodeIdx;
+    return trees;
 }
 
-void SearchTracer::pop() {
-    m_CurrNodeIdx = current().parentIndex;
-}
+//
+// JSON serialization
+//
 
 std::ostream& operator<<(std::ostream& stream, const SearchTree& tree) {
-    const SearchTree::Node& rootNode = tree.m_Nodes[0];
+    const SearchTree::Node& rootNode = tree.m_Nodes.back();
     Position pos = tree.m_RootPos;
 
     stream << std::setw(2);
@@ -123,18 +369,32 @@ void SearchTree::serializeNode(std::ostream& stream, const Node& node, Position&
     stream << Indent(indent) << Field("staticEval", node.staticEval) << '\n';
     stream << Indent(indent) << Field("alpha", node.alpha) << '\n';
     stream << Indent(indent) << Field("beta", node.beta) << '\n';
-    if (node.bestMove != MOVE_INVALID) {
-        stream << Indent(indent) << Field<Move>("bestMove", node.bestMove) << '\n';
+    if (node.bestMove != 0) {
+        stream << Indent(indent) << Field<Move>("bestMove", decompressTraceMove(pos, node.bestMove)) << '\n';
     }
     stream << Indent(indent) << Field<bool>("betaCutoff", BIT_INTERSECTS(node.flags, STF_BETA_CUTOFF)) << '\n';
     stream << Indent(indent) << Field<bool>("pv", BIT_INTERSECTS(node.flags, STF_PV)) << '\n';
+    stream << Indent(indent) << Field<bool>("openWindow", BIT_INTERSECTS(node.flags, STF_OPEN_WINDOW)) << '\n';
+
+    // Children are linked from last to first. If a move was searched more than
+    // once in this node (re-searches), only its last search is kept.
+    std::vector<ui32> children;
+    for (ui32 childIdx = node.lastChild; childIdx != Node::NO_NODE; childIdx = m_Nodes[childIdx].prevSibling) {
+        ui16 move = m_Nodes[childIdx].lastMove;
+        bool searchedLater = std::any_of(children.begin(), children.end(), [&](ui32 idx) {
+            return m_Nodes[idx].lastMove == move;
+        });
+        if (!searchedLater) {
+            children.push_back(childIdx);
+        }
+    }
+    std::reverse(children.begin(), children.end());
 
     stream << Indent(indent) << "\"children\": {" << '\n';
     indent++;
-    for (ui32 i = 0; i < node.nChildren; ++i) {
-        ui32 childIdx     = node.childIndexes[i];
-        const Node& child = m_Nodes[childIdx];
-        Move move         = child.lastMove;
+    for (size_t i = 0; i < children.size(); ++i) {
+        const Node& child = m_Nodes[children[i]];
+        Move move         = decompressTraceMove(pos, child.lastMove);
 
         stream << Indent(indent) << '"' << move << "\": ";
         if (move != MOVE_INVALID) {
@@ -153,7 +413,7 @@ void SearchTree::serializeNode(std::ostream& stream, const Node& node, Position&
             pos.undoNullMove();
         }
 
-        if (i < node.nChildren - 1) {
+        if (i < children.size() - 1) {
             stream << ','; // Commma for non-last childs
         }
         stream << '\n';
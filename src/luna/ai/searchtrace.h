@@ -1,18 +1,17 @@
 #ifndef LUNA_SEARCHTRACE_H
 #define LUNA_SEARCHTRACE_H
 
-#include <memory>
-#include <vector>
+#include <filesystem>
+#include <fstream>
+#include <istream>
 #include <ostream>
-
-#include <nlohmann/json.hpp>
+#include <random>
+#include <vector>
 
 #include "../position.h"
 
 namespace lunachess::ai {
 
-constexpr int MAX_CHILDREN_PER_NODE = 256;
-
 enum SearchTreeFlags: ui8 {
 
     STF_NONE              = 0,
@@ -22,100 +21,290 @@ enum SearchTreeFlags: ui8 {
     STF_EXTENDED_CHECK    = BIT(3),
     STF_SE_BETA_CUTOFF    = BIT(4),
     STF_NMP_BETA_CUTOFF   = BIT(5),
-    STF_RFP_CUTOFF        = BIT(6)
+    STF_RFP_CUTOFF        = BIT(6),
+
+    /** The node was searched with an open window, i.e. it is a PV node. */
+    STF_OPEN_WINDOW       = BIT(7)
+
+};
+
+/**
+ * Selects which nodes of the search get recorded by a SearchTracer. Recording fewer
+ * nodes keeps the trace of a long search small and the tracing overhead low.
+ */
+struct SearchTraceFilter {
+    /**
+     * Only record nodes searched with an open window (PV nodes). Nodes searched
+     * with a null window are left out, along with their subtrees.
+     */
+    bool pvNodesOnly = false;
+
+    /** If set, only record the subtree of this root move. */
+    Move rootMove = MOVE_INVALID;
+
+    /** Don't record nodes deeper than this ply. Zero means no limit. */
+    int maxPly = 0;
 
+    /**
+     * Record each subtree with a 1 in 'sampleRate' chance. Ancestors of recorded
+     * subtrees are always recorded, so that they can be reached from the root.
+     * The sample is the same for searches of the same tree.
+     */
+    int sampleRate = 1;
 };
 
+/**
+ * A node of a traced search tree, as stored in search trace files.
+ *
+ * Nodes are written once their search is over, so a node always comes after
+ * all of its children. Because of that, children are linked from the last one
+ * to the first: a node points to its last child, and each child to its previous
+ * sibling. Indexes are relative to the first node of the tree, and the root is
+ * the last node of the tree.
+ */
+struct SearchTraceNode {
+    static constexpr ui32 NO_NODE = 0xffffffff;
+
+    ui32 lastChild   = NO_NODE;
+    ui32 prevSibling = NO_NODE;
+    i32  staticEval  = 0;
+    i32  score       = 0;
+    i32  alpha       = 0;
+    i32  beta        = 0;
+
+    /** Compressed moves, see compressTraceMove. Zero stands for a null move (or no move). */
+    ui16 lastMove = 0;
+    ui16 bestMove = 0;
+
+    ui8  requestedDepth   = 0;
+    SearchTreeFlags flags = STF_NONE;
+    ui8  reserved[2]      = {};
+};
+static_assert(sizeof(SearchTraceNode) == 32, "Search trace nodes must be 32 bytes long.");
+
+/**
+ * Search trace files start with this header. It is followed by blocks, each
+ * starting with a SearchTraceBlock:
+ *   - TREE: a new tree is starting. 'count' holds its requested depth, and the block
+ *           is followed by its root position as a PackedPosition.
+ *   - NODE: 'count' nodes of the current tree follow.
+ *   - PV:   the principal variation of the current tree, 'count' compressed moves follow.
+ *   - TEND: the current tree is over. 'count' holds its total number of nodes.
+ *
+ * A file holds every tree searched in a search (one per iteration and aspiration window).
+ * Data is written in the native byte order.
+ */
+struct SearchTraceHeader {
+    static constexpr char MAGIC[4] = { 'L', 'S', 'T', 'R' };
+    static constexpr ui32 VERSION  = 2;
+
+    char magic[4];
+    ui32 version;
+    ui32 nodeSize;
+    ui32 reserved;
+};
+
+struct SearchTraceBlock {
+    static constexpr char TREE[4]     = { 'T', 'R', 'E', 'E' };
+    static constexpr char NODES[4]    = { 'N', 'O', 'D', 'E' };
+    static constexpr char PV[4]       = { 'P', 'V', ' ', ' ' };
+    static constexpr char TREE_END[4] = { 'T', 'E', 'N', 'D' };
+
+    char tag[4];
+    ui32 count;
+};
+
+/**
+ * Compresses a move into the 16 bits stored by trace nodes (source, destination and
+ * promotion piece type). The full move can be recovered with the position it was
+ * played in.
+ */
+ui16 compressTraceMove(Move move);
+
+/**
+ * Finds the legal move of 'pos' that matches a compressed move. Returns MOVE_INVALID
+ * for null moves.
+ */
+Move decompressTraceMove(const Position& pos, ui16 move);
+
+/**
+ * A search tree loaded from a search trace file. Nodes in its principal variation
+ * are flagged with STF_PV.
+ */
 class SearchTree {
-    friend class SearchTracer;
     friend std::ostream& operator<<(std::ostream& stream, const SearchTree& tree);
 
 public:
-    inline explicit SearchTree(Position rootPos, int expectedNodeCount = 24000)
-        : m_RootPos(std::move(rootPos)), m_Nodes(expectedNodeCount) {}
+    using Node = SearchTraceNode;
+
+    inline SearchTree(Position rootPos, int depth, std::vector<Node> nodes)
+        : m_RootPos(std::move(rootPos)), m_Depth(depth), m_Nodes(std::move(nodes)) {}
 
-    inline const Position& getRootPosition() {
+    inline const Position& getRootPosition() const {
         return m_RootPos;
     }
 
+    inline int getDepth() const {
+        return m_Depth;
+    }
+
     inline int getNodeCount() const {
         return m_Nodes.size();
     }
 
-private:
-    struct Node {
-
-        Move lastMove         = MOVE_INVALID;
-        Move bestMove         = MOVE_INVALID;
-        ui32 parentIndex      = 0;
-        i32 staticEval        = 0;
-        i32 score             = 0;
-        i32 alpha             = alpha;
-        i32 beta              = beta;
-        ui32 childIndexes[MAX_CHILDREN_PER_NODE] = {}; // zero-initialized
-        ui8 nChildren         = 0;
-        ui8 requestedDepth    = 0;
-        SearchTreeFlags flags = STF_NONE;
-
-    };
+    inline const std::vector<Node>& getNodes() const {
+        return m_Nodes;
+    }
 
+private:
     Position m_RootPos;
+    int m_Depth;
     std::vector<Node> m_Nodes;
 
     void serializeNode(std::ostream& stream, const Node& node, Position& pos, int indent = 0) const;
 
 };
 
+/**
+ * Serializes the tree as JSON.
+ */
 std::ostream& operator<<(std::ostream& stream, const SearchTree& tree);
 
+/**
+ * Reads all trees of a search trace file. A tree that was not finished (for
+ * instance, if the engine was killed while writing it) is left out.
+ * Throws std::runtime_error if the stream doesn't contain a valid trace.
+ */
+std::vector<SearchTree> readSearchTrace(std::istream& stream);
+
+/**
+ * Records the trees explored by a search and streams them to a file, in the
+ * format described in SearchTraceHeader.
+ *
+ * Only the nodes in the path from the root to the current node are kept in memory.
+ * Finished nodes are buffered and written to the file in chunks.
+ */
 class SearchTracer {
 public:
     /**
-     * Starts constructing a new tree. The expected depth serves as a hint
-     * to preallocate memory for nodes.
+     * Opens the file the trees will be written to. Returns false if it could
+     * not be opened.
+     */
+    bool open(const std::filesystem::path& path, const SearchTraceFilter& filter = {});
+
+    /**
+     * Finishes the current tree, if any, and closes the file.
      */
-    void newTree(const Position& rootPos, int expectedDepth);
-    inline std::shared_ptr<SearchTree> finishTree() {
-        return std::move(m_SearchTree);
+    void close();
+
+    inline bool isOpen() const {
+        return m_Out.is_open();
     }
 
+    /**
+     * Starts a new tree, finishing the previous one if it wasn't.
+     */
+    void newTree(const Position& rootPos, int depth);
+
+    /**
+     * Finishes the current tree. Nodes that were not popped (for instance, if
+     * the search was interrupted) are finished as they are.
+     */
+    void finishTree();
+
     void push(Move move);
     void pop();
 
+    /**
+     * Sets the principal variation found in the current tree. Since nodes are written
+     * as soon as they are finished, they are only flagged as PV nodes when read back.
+     */
+    void setPrincipalVariation(const std::vector<Move>& pv);
+
     inline void addFlags(SearchTreeFlags flags) {
-        current().flags = SearchTreeFlags(current().flags | flags);
+        if (m_SkippedDepth == 0) {
+            current().flags = SearchTreeFlags(current().flags | flags);
+        }
+    }
+
+    /** Sets the window the current node is searched with. */
+    inline void setWindow(i32 alpha, i32 beta) {
+        if (m_SkippedDepth == 0) {
+            Node& curr = current();
+            curr.alpha = alpha;
+            curr.beta  = beta;
+            if (beta - alpha > 1) {
+                curr.flags = SearchTreeFlags(curr.flags | STF_OPEN_WINDOW);
+            }
+        }
     }
 
     inline void setScores(i32 score, i32 alpha, i32 beta) {
-        Node& curr = current();
-        curr.score = score;
-        curr.alpha = alpha;
-        curr.beta  = beta;
+        if (m_SkippedDepth == 0) {
+            Node& curr = current();
+            curr.score = score;
+            curr.alpha = alpha;
+            curr.beta  = beta;
+        }
     }
 
     inline void updateBestMove(Move move) {
-        current().bestMove = move;
+        if (m_SkippedDepth == 0) {
+            current().bestMove = compressTraceMove(move);
+        }
     }
 
     inline void setStaticEval(i32 eval) {
-        current().staticEval = eval;
+        if (m_SkippedDepth == 0) {
+            current().staticEval = eval;
+        }
     }
 
     inline void setRequestedDepth(ui8 depth) {
-        current().requestedDepth = depth;
+        if (m_SkippedDepth == 0) {
+            current().requestedDepth = depth;
+        }
     }
 
 private:
-    using Node = SearchTree::Node;
+    using Node = SearchTraceNode;
+
+    static constexpr size_t CHUNK_NODE_COUNT = 4096;
+
+    std::ofstream m_Out;
+
+    /** Nodes from the root to the current node. Their search is not over yet. */
+    std::vector<Node> m_Path;
+
+    /** Finished nodes that were not written yet. */
+    std::vector<Node> m_Chunk;
+
+    /** Number of finished nodes of the current tree. */
+    ui32 m_NodeCount = 0;
+
+    std::vector<ui16> m_PrincipalVariation;
+
+    SearchTraceFilter m_Filter;
+    std::mt19937 m_Rng;
+
+    /**
+     * Number of plies pushed under a node that was filtered out. Nodes in the
+     * subtree of a filtered out node are neither kept in the path nor written.
+     */
+    int m_SkippedDepth = 0;
+
+    /** Ply of the root of the sampled subtree we're in, or -1 if we're not in one. */
+    int m_SampledPly = -1;
+
+    inline Node& current() { return m_Path.back(); }
 
-    std::shared_ptr<SearchTree> m_SearchTree = nullptr;
-    ui32 m_CurrNodeIdx = 0;
+    bool shouldWriteNode(const Node& node, int ply) const;
 
-    inline Node& current() { return m_SearchTree->m_Nodes[m_CurrNodeIdx]; }
-    inline Node& parent()  { return m_SearchTree->m_Nodes[current().parentIndex]; }
-    inline Node& root()    { return m_SearchTree->m_Nodes[0]; }
+    void finishNode();
+    void flushChunk();
+    void writeBlock(const char (&tag)[4], ui32 count);
 };
 
 }
 
-#endif // LUNA_SEARCHTRACE_H
\ No newline at end of file
+#endif // LUNA_SEARCHTRACE_H
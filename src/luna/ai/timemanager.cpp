@@ -1,87 +1,124 @@
 #include "timemanager.h"
 
+#include <algorithm>
+
 #include "search.h"
 
 namespace lunachess::ai {
 
-void TimeManager::start(const TimeControl& tc) {
+void TimeManager::start(const TimeControl& tc, i64 moveOverhead, bool ponder) {
     m_Tc = tc;
     m_Start = Clock::now();
+    m_MoveOverhead = moveOverhead;
+    m_Pondering = ponder;
+    m_Stop = false;
+
+    m_LastBestMove = MOVE_INVALID;
+    m_LastBestScore = 0;
+    m_Iterations = 0;
+    m_BestMoveChanges = 0;
 
-    m_BestItMove = MOVE_INVALID;
-    m_ItMoveReps = 0;
+    computeLimits();
+}
+
+void TimeManager::ponderhit() {
+    if (!m_Pondering) {
+        return;
+    }
+
+    m_Pondering = false;
+    m_Start = Clock::now();
+    computeLimits();
+}
+
+void TimeManager::computeLimits() {
+    i64 available = std::max<i64>(1, m_Tc.time - m_MoveOverhead);
 
-    // Calculate target time
     switch (m_Tc.mode) {
         case TC_MOVETIME:
-            m_TargetTime = tc.time - 80;
+            m_SoftLimit = available;
+            m_HardLimit = available;
             break;
 
         case TC_TOURNAMENT:
-            m_TargetTime = std::min(tc.time - 80, tc.time / 14 + tc.increment * 2);
-            m_OriginalTargetTime = m_TargetTime;
+            // The soft limit is the time we'd like to spend on an average move.
+            // The hard limit lets unstable searches take a few times longer, but
+            // never more than a fraction of what is left on the clock.
+            m_SoftLimit = std::min<i64>(available, m_Tc.time / 20 + m_Tc.increment * 3 / 4);
+            m_HardLimit = std::min<i64>(available / 3 + m_Tc.increment, m_SoftLimit * 5);
+            m_HardLimit = std::max<i64>(1, std::min(m_HardLimit, available));
+            m_SoftLimit = std::min(m_SoftLimit, m_HardLimit);
             break;
 
         default:
             break;
     }
+    m_ScaledSoftLimit = static_cast<double>(m_SoftLimit);
 }
 
-void TimeManager::onNewDepth(const SearchResults& res) {
+double TimeManager::getSoftLimitScale(double nodeFraction, int scoreDrop, double bestMoveChanges) {
+    // The more effort went into the best move, the more certain we are it's the best one.
+    double nodeScale = 0.5 + 1.5 * (1.0 - std::clamp(nodeFraction, 0.0, 1.0));
+
+    // Spend more time if the score is dropping. Scores are measured in thousandths
+    // of a pawn, so a drop of one pawn doubles the time.
+    double scoreScale = std::clamp(1.0 + scoreDrop / 1000.0, 0.75, 2.0);
+
+    // Spend more time if the best move keeps changing.
+    double instabilityScale = 1.0 + bestMoveChanges * 0.5;
+
+    return nodeScale * scoreScale * instabilityScale;
+}
+
+void TimeManager::onNewDepth(const SearchResults& res, ui64 bestMoveNodes) {
     if (m_Tc.mode != TC_TOURNAMENT) {
         // Nothing to do
         return;
     }
 
-    if (std::abs(res.bestScore) >= FORCED_MATE_THRESHOLD && res.bestMove != MOVE_INVALID) {
-        // We found a mate, stop searching.
-        m_TargetTime = 0;
+    m_Iterations++;
+
+    // Track best move instability, even while pondering so that it counts after a ponderhit.
+    m_BestMoveChanges /= 2;
+    if (res.bestMove != m_LastBestMove && m_LastBestMove != MOVE_INVALID) {
+        m_BestMoveChanges += 1;
     }
 
-    if (res.depth < 2) {
-        // Always search to depth 2, at least.
+    int scoreDrop   = m_Iterations > 1 ? m_LastBestScore - res.bestScore : 0;
+    m_LastBestMove  = res.bestMove;
+    m_LastBestScore = res.bestScore;
+
+    if (m_Pondering) {
+        // Our clock isn't running yet.
         return;
     }
 
-    if (res.bestMove == m_BestItMove) {
-        m_ItMoveReps += res.depth;
-        if (m_ItMoveReps >= 96) {
-            m_TargetTime = m_TargetTime * 2 / 3;
-            m_ItMoveReps = 0;
-        }
+    if (std::abs(res.bestScore) >= FORCED_MATE_THRESHOLD && res.bestMove != MOVE_INVALID) {
+        // We found a mate, stop searching.
+        m_Stop = true;
+        return;
     }
-    else {
-        m_BestItMove = res.bestMove;
-        m_TargetTime = m_OriginalTargetTime;
-        m_ItMoveReps = 0;
+
+    if (res.depth < 4) {
+        // Shallow iterations are too noisy to make decisions on.
+        return;
     }
 
-    // We have a target time that we want to reach.
-    // In 'movetime' modes, we want to use it as much as possible,
-    // since for every move we will have the same time to
-    // spend again.
-    // In Tournament time controls, however, if we think we are not going
-    // to finish the search in our speculated target time, it is better
-    // to not go further onto the search.
-
-    int expectedBranchFactor = 3;
-    i64 depthTime = res.getCurrDepthTime();
-    i64 totalTime = res.searchTime;
-
-    if (totalTime + (depthTime * expectedBranchFactor) >= m_TargetTime) {
-        // Setting the target time to 0 will make the next call to
-        // timeIsUp() return true.
-        m_TargetTime = 0;
+    double nodeFraction = res.visitedNodes > 0
+                          ? static_cast<double>(bestMoveNodes) / static_cast<double>(res.visitedNodes)
+                          : 0.0;
+    m_ScaledSoftLimit = m_SoftLimit * getSoftLimitScale(nodeFraction, scoreDrop, m_BestMoveChanges);
+    if (getElapsed() >= std::min<double>(m_ScaledSoftLimit, m_HardLimit)) {
+        m_Stop = true;
     }
 }
 
 bool TimeManager::timeIsUp() const {
-    if (m_Tc.mode == TC_INFINITE) {
+    if (m_Tc.mode == TC_INFINITE || m_Pondering) {
         return false;
     }
 
-    i64 delta = deltaMs(Clock::now(), m_Start);
-    return delta >= m_TargetTime;
+    return m_Stop || getElapsed() >= m_HardLimit;
 }
 
-}
\ No newline at end of file
+}
@@ -9,20 +9,82 @@ namespace lunachess::ai {
 
 class SearchResults;
 
+/**
+ * Decides how much time a search can take.
+ *
+ * A search has two limits. The hard limit is checked during the search and
+ * interrupts it no matter what. The soft limit is checked after each iteration,
+ * and is scaled by how confident we are in the best move: the fraction of nodes
+ * spent on it, how much the score dropped since the last iteration and how
+ * often the best move changed.
+ */
 class TimeManager {
 public:
-    void start(const TimeControl& tc);
-    void onNewDepth(const SearchResults& res);
+    /** Default time, in milliseconds, reserved for communication delays on each move. */
+    static constexpr i64 DEFAULT_MOVE_OVERHEAD = 80;
+
+    /**
+     * Starts managing the time of a new search.
+     * 'moveOverhead' is subtracted from the available time to account for communication delays.
+     * If 'ponder' is true, the search is running on the opponent's time: time is
+     * never up until ponderhit() is called, which starts the clock for 'tc'.
+     */
+    void start(const TimeControl& tc, i64 moveOverhead = DEFAULT_MOVE_OVERHEAD, bool ponder = false);
+
+    /**
+     * Called after each finished iteration. 'bestMoveNodes' is the number of nodes
+     * spent so far searching the best root move.
+     */
+    void onNewDepth(const SearchResults& res, ui64 bestMoveNodes);
+
+    /**
+     * Converts a ponder search into a regular timed search. Our clock starts
+     * running at this point, but the best move stability gathered while
+     * pondering is kept.
+     */
+    void ponderhit();
+
+    inline bool pondering() const { return m_Pondering; }
 
     bool timeIsUp() const;
 
+    /** Elapsed time since our clock started, in milliseconds. */
+    inline i64 getElapsed() const { return deltaMs(Clock::now(), m_Start); }
+
+    inline i64 getSoftLimit() const { return m_SoftLimit; }
+    inline i64 getHardLimit() const { return m_HardLimit; }
+
+    /** Soft limit scaled after the last iteration, see getSoftLimitScale(). */
+    inline double getScaledSoftLimit() const { return m_ScaledSoftLimit; }
+
+    /** Decaying count of best move changes between iterations. */
+    inline double getBestMoveChanges() const { return m_BestMoveChanges; }
+
+    /**
+     * Factor the soft limit is scaled by after an iteration. 'nodeFraction' is the
+     * fraction of nodes spent on the best move, 'scoreDrop' how much its score dropped
+     * since the last iteration and 'bestMoveChanges' the decaying count of best move
+     * changes.
+     */
+    static double getSoftLimitScale(double nodeFraction, int scoreDrop, double bestMoveChanges);
+
 private:
     TimePoint m_Start;
-    i64 m_TargetTime;
-    i64 m_OriginalTargetTime;
+    bool m_Pondering = false;
+    bool m_Stop = false;
     TimeControl m_Tc;
-    Move m_BestItMove;
-    int m_ItMoveReps;
+    i64 m_MoveOverhead = DEFAULT_MOVE_OVERHEAD;
+    i64 m_SoftLimit = 0;
+    i64 m_HardLimit = 0;
+    double m_ScaledSoftLimit = 0;
+
+    Move m_LastBestMove = MOVE_INVALID;
+    int m_LastBestScore = 0;
+    int m_Iterations = 0;
+
+    double m_BestMoveChanges = 0;
+
+    void computeLimits();
 };
 
 }
@@ -1,7 +1,324 @@
 #include "transpositiontable.h"
 
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+#include "../threadpool.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LUNA_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#define LUNA_HAS_MADV_HUGEPAGE
+#endif
+
 namespace lunachess::ai {
 
+static constexpr char TABLE_FILE_MAGIC[4] = { 'L', 'U', 'T', 'T' };
+
+/** Tables are written and read in chunks of this size. */
+static constexpr size_t IO_CHUNK_SIZE = 64 * 1024 * 1024;
+
+/** Size of the pages used with transparent huge pages on x86-64 and most ARM64 systems. */
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/** Tables of this size or more are zeroed by several threads, in chunks of ZERO_CHUNK_SIZE. */
+static constexpr size_t PARALLEL_ZERO_MIN_SIZE = 256 * 1024 * 1024;
+static constexpr size_t ZERO_CHUNK_SIZE        = 16 * 1024 * 1024;
+
+std::string_view TranspositionTable::getPageModeName(PageMode mode) {
+    switch (mode) {
+        case PAGES_HUGE: return "huge pages";
+        case PAGES_FILE: return "file mapping";
+        default:         return "regular pages";
+    }
+}
+
+#ifdef LUNA_HAS_MADV_HUGEPAGE
+/**
+ * Whether transparent huge pages can be used with madvise. When they are set to
+ * "always", the kernel uses them without being asked, and when set to "never",
+ * asking for them has no effect.
+ */
+static bool transparentHugePagesEnabled() {
+    static const bool enabled = []() {
+        std::ifstream stream("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string mode;
+        return std::getline(stream, mode) && mode.find("[never]") == std::string::npos;
+    }();
+    return enabled;
+}
+#endif
+
+void TranspositionTable::allocate(size_t capacity) {
+    size_t size = capacity * sizeof(Bucket);
+
+#ifdef LUNA_HAS_MADV_HUGEPAGE
+    // Large tables are mapped at a huge page boundary and the kernel is asked to
+    // back them with huge pages, which saves a TLB miss on most probes.
+    if (size >= HUGE_PAGE_SIZE && transparentHugePagesEnabled()) {
+        size_t mappedSize = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        void* addr = ::mmap(nullptr, mappedSize + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr != MAP_FAILED) {
+            // Trim the mapping down to the aligned range.
+            ui8* raw       = static_cast<ui8*>(addr);
+            ui8* aligned   = reinterpret_cast<ui8*>((reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+            size_t headLen = aligned - raw;
+            size_t tailLen = HUGE_PAGE_SIZE - headLen;
+            if (headLen > 0) {
+                ::munmap(raw, headLen);
+            }
+            if (tailLen > 0) {
+                ::munmap(aligned + mappedSize, tailLen);
+            }
+
+            m_Buckets    = reinterpret_cast<Bucket*>(aligned);
+            m_Capacity   = capacity;
+            m_MappedSize = mappedSize;
+            m_PageMode   = ::madvise(aligned, mappedSize, MADV_HUGEPAGE) == 0 ? PAGES_HUGE : PAGES_REGULAR;
+            zeroBuckets();
+            return;
+        }
+    }
+#endif
+
+    m_Buckets = static_cast<Bucket*>(std::calloc(capacity, sizeof(Bucket)));
+    if (m_Buckets == nullptr) {
+        throw std::bad_alloc();
+    }
+    m_Capacity = capacity;
+    m_PageMode = PAGES_REGULAR;
+}
+
+/**
+ * Pool shared by all tables to zero large ones. It's only created once a large
+ * table is zeroed, and kept around for the next time.
+ */
+static ThreadPool& getZeroingPool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void TranspositionTable::zeroBuckets() {
+    Bucket* buckets = m_Buckets;
+    size_t size     = m_Capacity * sizeof(Bucket);
+    if (size < PARALLEL_ZERO_MIN_SIZE) {
+        std::fill(buckets, buckets + m_Capacity, Bucket());
+        return;
+    }
+
+    // Zeroing a fresh mapping from several threads also takes its page faults in
+    // parallel, and spreads its pages over the memory nodes of the threads on NUMA
+    // systems.
+    size_t bucketsPerChunk = ZERO_CHUNK_SIZE / sizeof(Bucket);
+    getZeroingPool().parallelFor(0, m_Capacity, bucketsPerChunk, [buckets](size_t first, size_t last) {
+        std::fill(buckets + first, buckets + last, Bucket());
+    });
+}
+
+void TranspositionTable::clear() {
+    m_Gen   = 0;
+    m_Count = 0;
+    zeroBuckets();
+}
+
+void TranspositionTable::resize(size_t hashSizeBytes) {
+    release();
+
+    m_Gen   = 0;
+    m_Count = 0;
+    allocate(hashSizeBytes / sizeof(Bucket));
+}
+
+void TranspositionTable::release() {
+    if (m_MappedHeader != nullptr) {
+#ifdef LUNA_HAS_MMAP
+        *m_MappedHeader = makeHeader();
+        ::munmap(m_MappedHeader, sizeof(FileHeader) + m_Capacity * sizeof(Bucket));
+#endif
+        m_MappedHeader = nullptr;
+    }
+    else if (m_MappedSize > 0) {
+#ifdef LUNA_HAS_MMAP
+        ::munmap(m_Buckets, m_MappedSize);
+#endif
+    }
+    else if (m_Buckets != nullptr) {
+        std::free(m_Buckets);
+    }
+    m_Buckets    = nullptr;
+    m_Capacity   = 0;
+    m_MappedSize = 0;
+    m_PageMode   = PAGES_REGULAR;
+}
+
+TranspositionTable::FileHeader TranspositionTable::makeHeader() const {
+    FileHeader header = {};
+    std::copy(std::begin(TABLE_FILE_MAGIC), std::end(TABLE_FILE_MAGIC), header.magic);
+    header.version    = FileHeader::VERSION;
+    header.bucketSize = sizeof(Bucket);
+    header.generation = m_Gen;
+    header.capacity   = m_Capacity;
+    header.count      = m_Count;
+    return header;
+}
+
+bool TranspositionTable::isValidHeader(const FileHeader& header) const {
+    return std::equal(std::begin(TABLE_FILE_MAGIC), std::end(TABLE_FILE_MAGIC), header.magic) &&
+           header.version    == FileHeader::VERSION &&
+           header.bucketSize == sizeof(Bucket) &&
+           header.capacity   > 0 &&
+           header.count      <= header.capacity;
+}
+
+bool TranspositionTable::save(const std::filesystem::path& path) const {
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+
+    {
+        std::ofstream stream(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            return false;
+        }
+
+        FileHeader header = makeHeader();
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        const char* data = reinterpret_cast<const char*>(m_Buckets);
+        size_t size      = m_Capacity * sizeof(Bucket);
+        for (size_t offset = 0; offset < size && stream; offset += IO_CHUNK_SIZE) {
+            stream.write(data + offset, static_cast<std::streamsize>(std::min(IO_CHUNK_SIZE, size - offset)));
+        }
+
+        if (!stream.flush()) {
+            stream.close();
+            std::filesystem::remove(tmpPath);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool TranspositionTable::load(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    FileHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || !isValidHeader(header)) {
+        return false;
+    }
+
+    std::error_code ec;
+    size_t size = header.capacity * sizeof(Bucket);
+    if (std::filesystem::file_size(path, ec) != sizeof(FileHeader) + size || ec) {
+        return false;
+    }
+
+    // Entries are read straight into the table, which is only reallocated if the
+    // sizes differ. The header and size were checked, so reading only fails on
+    // I/O errors, after which the table is left empty.
+    if (header.capacity != m_Capacity) {
+        release();
+        allocate(header.capacity);
+    }
+
+    char* data = reinterpret_cast<char*>(m_Buckets);
+    for (size_t offset = 0; offset < size && stream; offset += IO_CHUNK_SIZE) {
+        stream.read(data + offset, static_cast<std::streamsize>(std::min(IO_CHUNK_SIZE, size - offset)));
+    }
+    if (!stream) {
+        clear();
+        return false;
+    }
+
+    m_Count = header.count;
+    m_Gen   = static_cast<ui8>(header.generation);
+    return true;
+}
+
+bool TranspositionTable::mapFile(const std::filesystem::path& path, size_t hashSizeBytes) {
+#ifdef LUNA_HAS_MMAP
+    size_t capacity = hashSizeBytes / sizeof(Bucket);
+    size_t fileSize = sizeof(FileHeader) + capacity * sizeof(Bucket);
+    if (capacity == 0) {
+        return false;
+    }
+
+    // The header of a mapped table is only kept up to date on release(). Write it
+    // now, so that remapping the file the table is mapped to reads the live counters.
+    if (m_MappedHeader != nullptr) {
+        *m_MappedHeader = makeHeader();
+        ::msync(m_MappedHeader, sizeof(FileHeader), MS_SYNC);
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // Only empty files and tables are ever overwritten. Anything else is probably
+    // a file that was picked by mistake, and must be left alone.
+    FileHeader header;
+    bool isTable = ::pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+                   isValidHeader(header);
+    if (st.st_size != 0 && !isTable) {
+        ::close(fd);
+        return false;
+    }
+
+    // Keep the entries of a table of the same size, start from scratch otherwise.
+    bool reuse = isTable && header.capacity == capacity;
+    if (!reuse || static_cast<size_t>(st.st_size) != fileSize) {
+        reuse = false;
+        // Truncating first zeroes every bucket, which marks them all as invalid.
+        if (::ftruncate(fd, 0) != 0 || ::ftruncate(fd, static_cast<off_t>(fileSize)) != 0) {
+            ::close(fd);
+            return false;
+        }
+    }
+
+    void* addr = ::mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    release();
+    m_MappedHeader = static_cast<FileHeader*>(addr);
+    m_Buckets      = reinterpret_cast<Bucket*>(m_MappedHeader + 1);
+    m_Capacity     = capacity;
+    m_PageMode     = PAGES_FILE;
+    m_Count        = reuse ? header.count : 0;
+    m_Gen          = reuse ? static_cast<ui8>(header.generation) : 0;
+    *m_MappedHeader = makeHeader();
+    return true;
+#else
+    return false;
+#endif
+}
+
 bool TranspositionTable::maybeAdd(const Entry& entry) {
     Bucket& b = getBucket(entry.zobristKey);
     if (!b.isValid()) {
@@ -2,6 +2,8 @@
 #define LUNA_AI_TRANSPOSITIONTABLE_H
 
 #include <cstring>
+#include <filesystem>
+#include <string_view>
 
 #include "../position.h"
 #include "../types.h"
@@ -14,6 +16,19 @@ class TranspositionTable {
 public:
     static constexpr size_t DEFAULT_SIZE_MB = 32;
 
+    /** Kind of memory backing the table. */
+    enum PageMode {
+        PAGES_REGULAR,
+
+        /** Transparent huge pages were requested for the table. */
+        PAGES_HUGE,
+
+        /** The table is a mapping of a file, see mapFile(). */
+        PAGES_FILE
+    };
+
+    static std::string_view getPageModeName(PageMode mode);
+
     enum EntryType : ui8 {
         // For PV-Nodes
         EXACT,
@@ -75,7 +90,7 @@ private:
 
     private:
         Entry m_Entry;
-        ui8   m_Data;
+        ui8   m_Data = 0;
     };
 
 public:
@@ -91,6 +106,11 @@ public:
         return m_Count;
     }
 
+    /** Memory taken by the entries, in bytes. */
+    inline size_t getSizeBytes() const {
+        return m_Capacity * sizeof(Bucket);
+    }
+
     /**
         Adds a given entry to the transposition table, except if
         an entry for the same position with higher depth exists.
@@ -126,9 +146,10 @@ public:
         remove(pos.getZobrist());
     }
 
-    inline void clear() {
-        resize(m_Capacity * sizeof(Bucket));
-    }
+    /**
+     * Deletes all entries, keeping the size of the table.
+     */
+    void clear();
 
     inline void prefetch(ui64 key) {
         __builtin_prefetch(&getBucket(key));
@@ -136,37 +157,103 @@ public:
 
     /**
      * Resizes the transposition table. Deletes all entries.
+     * If the table was backed by a file, it is moved back to memory.
+     * Tables of a few megabytes or more are put on huge pages where supported.
      */
-    inline void resize(size_t hashSizeBytes) {
-        m_Gen = 0;
-        if (m_Buckets != nullptr) {
-            std::free(m_Buckets);
-        }
+    void resize(size_t hashSizeBytes);
 
-        m_Count    = 0;
-        m_Capacity = hashSizeBytes / sizeof(Bucket);
-        m_Buckets  = static_cast<Bucket*>(std::calloc(m_Capacity, sizeof(Bucket)));
-        if (m_Buckets == nullptr) {
-            throw std::bad_alloc();
-        }
+    /**
+     * Writes the table to a file, in the format described by FileHeader.
+     * The file is written next to its destination and renamed over it once
+     * complete, so readers never see a partial table.
+     * Returns false if the file couldn't be written.
+     */
+    bool save(const std::filesystem::path& path) const;
+
+    /**
+     * Replaces the contents of the table with a table written by save() or backed by
+     * a file. The table takes the size of the saved one. If the sizes match, a file
+     * backed table stays backed by its file and receives the loaded entries.
+     * Returns false if the file isn't a valid table, leaving the table untouched,
+     * or if reading it failed midway, leaving the table empty.
+     */
+    bool load(const std::filesystem::path& path);
+
+    /**
+     * Backs the table with a shared, writable mapping of a file, so that entries
+     * outlive the process. If the file already holds a table of the requested size,
+     * its entries are kept. Otherwise, if the file is empty or holds a table of
+     * another size, it is recreated empty.
+     * Returns false, leaving the table and the file untouched, if the file is neither
+     * empty nor a table, if it couldn't be mapped or if the platform doesn't support
+     * mappings.
+     */
+    bool mapFile(const std::filesystem::path& path, size_t hashSizeBytes);
+
+    inline bool isFileBacked() const {
+        return m_MappedHeader != nullptr;
+    }
+
+    inline PageMode getPageMode() const {
+        return m_PageMode;
     }
 
     inline TranspositionTable(size_t hashSizeBytes = DEFAULT_SIZE_MB * 1024 * 1024) {
         resize(hashSizeBytes);
     }
 
+    TranspositionTable(const TranspositionTable& other) = delete;
+    TranspositionTable& operator=(const TranspositionTable& other) = delete;
+
     inline ~TranspositionTable() {
-        if (m_Buckets != nullptr) {
-            std::free(m_Buckets);
-        }
+        release();
     }
 
 private:
+    /**
+     * Header of saved and file backed tables, followed by the bucket array.
+     * Values are stored in the byte order of the machine that wrote them.
+     */
+    struct FileHeader {
+        static constexpr ui32 VERSION = 1;
+
+        char magic[4];
+        ui32 version;
+        ui32 bucketSize;
+        ui32 generation;
+        ui64 capacity;
+        ui64 count;
+        ui8  reserved[32];
+    };
+    static_assert(sizeof(FileHeader) == 64);
+
     Bucket* m_Buckets  = nullptr;
     size_t  m_Capacity = 0;
     size_t  m_Count    = 0;
     ui8     m_Gen      = 0;
 
+    /** Start of the file mapping when the table is backed by a file, nullptr otherwise. */
+    FileHeader* m_MappedHeader = nullptr;
+
+    /** Size of the anonymous mapping holding the buckets, zero if they were allocated with calloc. */
+    size_t   m_MappedSize = 0;
+    PageMode m_PageMode   = PAGES_REGULAR;
+
+    /**
+     * Allocates and zeroes an array of 'capacity' buckets, on huge pages if possible.
+     * The table must be released first.
+     */
+    void allocate(size_t capacity);
+
+    /** Zeroes every bucket, spreading the work over threads for large tables. */
+    void zeroBuckets();
+
+    FileHeader makeHeader() const;
+    bool isValidHeader(const FileHeader& header) const;
+
+    /** Frees the bucket array, or writes back the header and unmaps the file. */
+    void release();
+
     inline Bucket& getBucket(ui64 key) const {
         return m_Buckets[key % m_Capacity];
     }
@@ -0,0 +1,671 @@
+#include "bitbase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "bitboard.h"
+#include "zobrist.h"
+
+namespace lunachess::bitbase {
+
+//
+// KPK
+//
+
+// One bit per KPK position, set if the side with the pawn wins. Generated by
+// src/kpkgen at build time, see its description for the indexing scheme.
+static constexpr ui32 KPK_BITBASE[] = {
+#include "kpk.inc"
+};
+
+static_assert(sizeof(KPK_BITBASE) == 2 * 64 * 64 * 4 * 6 / 8, "Unexpected KPK bitbase size.");
+
+bool probeKPK(const Position& pos, Color strongSide) {
+    Color weakSide    = getOppositeColor(strongSide);
+    Square strongKing = pos.getKingSquare(strongSide);
+    Square weakKing   = pos.getKingSquare(weakSide);
+    Square pawn       = *pos.getBitboard(Piece(strongSide, PT_PAWN)).begin();
+
+    // The bitbase has the strong side playing up the board with the pawn on files a to d.
+    if (strongSide == CL_BLACK) {
+        strongKing = mirrorVertically(strongKing);
+        weakKing   = mirrorVertically(weakKing);
+        pawn       = mirrorVertically(pawn);
+    }
+    if (getFile(pawn) >= FL_E) {
+        strongKing = mirrorHorizontally(strongKing);
+        weakKing   = mirrorHorizontally(weakKing);
+        pawn       = mirrorHorizontally(pawn);
+    }
+
+    ui32 strongToMove = pos.getColorToMove() == strongSide ? 0 : 1;
+    ui32 idx = strongToMove | (weakKing << 1) | (strongKing << 7) |
+               (getFile(pawn) << 13) | ((6 - getRank(pawn)) << 15);
+
+    return (KPK_BITBASE[idx / 32] >> (idx % 32)) & 1;
+}
+
+//
+// Material
+//
+
+std::optional<BitbaseMaterial> BitbaseMaterial::parse(std::string_view name) {
+    if (name.empty() || name[0] != 'K') {
+        return std::nullopt;
+    }
+    size_t secondKing = name.find('K', 1);
+    if (secondKing == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    BitbaseMaterial ret;
+    bool hasPawns[CL_COUNT] = { false, false };
+    for (size_t i = 0; i < name.size(); ++i) {
+        Color c = i < secondKing ? CL_WHITE : CL_BLACK;
+        Piece p = Piece::fromIdentifier(name[i]);
+        if (p == PIECE_NONE || p.getColor() != CL_WHITE) {
+            return std::nullopt;
+        }
+        if (p.getType() == PT_KING && i != 0 && i != secondKing) {
+            return std::nullopt;
+        }
+        hasPawns[c] |= p.getType() == PT_PAWN;
+        ret.m_Pieces.push_back(Piece(c, p.getType()));
+    }
+
+    if (ret.m_Pieces.size() > MAX_PIECES || (hasPawns[CL_WHITE] && hasPawns[CL_BLACK])) {
+        return std::nullopt;
+    }
+    return ret;
+}
+
+std::string BitbaseMaterial::getName() const {
+    std::string ret;
+    for (Piece p: m_Pieces) {
+        ret += Piece(CL_WHITE, p.getType()).getIdentifier();
+    }
+    return ret;
+}
+
+ui64 BitbaseMaterial::getMaterialKey() const {
+    // Same as Position::getMaterialKey(), which hashes the number of pieces of each kind.
+    ui64 key = 0;
+    int counts[PT_COUNT][CL_COUNT] = {};
+    for (Piece p: m_Pieces) {
+        key ^= zobrist::getMaterialKey(p, counts[p.getType()][p.getColor()]++);
+    }
+    return key;
+}
+
+BitbaseMaterial BitbaseMaterial::flipped() const {
+    BitbaseMaterial ret;
+    auto blackKing = std::find(m_Pieces.begin() + 1, m_Pieces.end(), BLACK_KING);
+    for (auto it = blackKing; it != m_Pieces.end(); ++it) {
+        ret.m_Pieces.push_back(Piece(CL_WHITE, it->getType()));
+    }
+    for (auto it = m_Pieces.begin(); it != blackKing; ++it) {
+        ret.m_Pieces.push_back(Piece(CL_BLACK, it->getType()));
+    }
+    return ret;
+}
+
+BitbaseMaterial BitbaseMaterial::withoutPiece(size_t idx) const {
+    BitbaseMaterial ret = *this;
+    ret.m_Pieces.erase(ret.m_Pieces.begin() + idx);
+    return ret;
+}
+
+BitbaseMaterial BitbaseMaterial::withPiece(size_t idx, Piece newPiece) const {
+    BitbaseMaterial ret = *this;
+    ret.m_Pieces[idx] = newPiece;
+    return ret;
+}
+
+//
+// Files
+//
+// Bitbase files start with a header:
+//
+//     magic        4 bytes, "LBB1"
+//     material     8 bytes, such as "KRKP", padded with zeros
+//     block count  4 bytes
+//     offsets      4 bytes per block plus one, where each block's data starts and ends
+//
+// followed by the data of each block. Blocks hold BLOCK_SIZE positions each, run length
+// encoded: each byte has a result in its lower 2 bits and a run length minus one in the
+// upper 6 bits. All numbers are little endian.
+//
+
+static constexpr char MAGIC[4] = { 'L', 'B', 'B', '1' };
+static constexpr size_t NAME_SIZE   = 8;
+static constexpr size_t HEADER_SIZE = sizeof(MAGIC) + NAME_SIZE + 4;
+static constexpr size_t MAX_RUN     = 64;
+
+static ui32 readUI32(const ui8* data) {
+    return ui32(data[0]) | (ui32(data[1]) << 8) | (ui32(data[2]) << 16) | (ui32(data[3]) << 24);
+}
+
+static void writeUI32(std::ostream& stream, ui32 val) {
+    ui8 data[4] = { ui8(val), ui8(val >> 8), ui8(val >> 16), ui8(val >> 24) };
+    stream.write(reinterpret_cast<const char*>(data), sizeof(data));
+}
+
+bool Bitbase::write(const std::filesystem::path& path, const BitbaseMaterial& material,
+                    const std::vector<WDL>& results) {
+    size_t nBlocks = (results.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    std::vector<ui8> data;
+    std::vector<ui32> offsets;
+    for (size_t block = 0; block < nBlocks; ++block) {
+        offsets.push_back(static_cast<ui32>(data.size()));
+
+        size_t end = std::min(results.size(), (block + 1) * BLOCK_SIZE);
+        size_t i = block * BLOCK_SIZE;
+        while (i < end) {
+            size_t len = 1;
+            while (i + len < end && len < MAX_RUN && results[i + len] == results[i]) {
+                len++;
+            }
+            data.push_back(static_cast<ui8>(results[i] | ((len - 1) << 2)));
+            i += len;
+        }
+    }
+    offsets.push_back(static_cast<ui32>(data.size()));
+
+    std::ofstream stream(path, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    char name[NAME_SIZE] = {};
+    std::string materialName = material.getName();
+    std::memcpy(name, materialName.data(), std::min(materialName.size(), NAME_SIZE));
+
+    stream.write(MAGIC, sizeof(MAGIC));
+    stream.write(name, sizeof(name));
+    writeUI32(stream, static_cast<ui32>(nBlocks));
+    for (ui32 offset: offsets) {
+        writeUI32(stream, offset);
+    }
+    stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+    return static_cast<bool>(stream);
+}
+
+bool Bitbase::open(const std::filesystem::path& path) {
+    m_Material.reset();
+    if (!m_File.open(path)) {
+        return false;
+    }
+
+    const ui8* data = m_File.data();
+    size_t size     = m_File.size();
+    if (size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        m_File.close();
+        return false;
+    }
+
+    const char* name = reinterpret_cast<const char*>(data + sizeof(MAGIC));
+    auto material = BitbaseMaterial::parse(std::string_view(name, std::find(name, name + NAME_SIZE, '\0') - name));
+    size_t nBlocks = readUI32(data + sizeof(MAGIC) + NAME_SIZE);
+    size_t dataBegin = HEADER_SIZE + (nBlocks + 1) * 4;
+    if (!material.has_value() ||
+        nBlocks != (material->getPositionCount() + BLOCK_SIZE - 1) / BLOCK_SIZE ||
+        size < dataBegin) {
+        m_File.close();
+        return false;
+    }
+
+    // Probing trusts the offsets, so every block must lie within the data.
+    size_t dataSize = size - dataBegin;
+    ui32 prevOffset = 0;
+    for (size_t i = 0; i <= nBlocks; ++i) {
+        ui32 offset = readUI32(data + HEADER_SIZE + i * 4);
+        if (offset < prevOffset || offset > dataSize) {
+            m_File.close();
+            return false;
+        }
+        prevOffset = offset;
+    }
+
+    m_Material     = std::move(material);
+    m_NBlocks      = nBlocks;
+    m_BlockOffsets = data + HEADER_SIZE;
+    m_Data         = data + dataBegin;
+    return true;
+}
+
+WDL Bitbase::probe(size_t idx) const {
+    size_t block  = idx / BLOCK_SIZE;
+    size_t remain = idx % BLOCK_SIZE;
+
+    const ui8* it  = m_Data + readUI32(m_BlockOffsets + block * 4);
+    const ui8* end = m_Data + readUI32(m_BlockOffsets + (block + 1) * 4);
+    for (; it != end; ++it) {
+        size_t len = (*it >> 2) + 1;
+        if (remain < len) {
+            return static_cast<WDL>(*it & 3);
+        }
+        remain -= len;
+    }
+
+    // Corrupted file.
+    return WDL_DRAW;
+}
+
+WDL Bitbase::probe(const Position& pos, Color firstSide) const {
+    // Bitbases are generated with the first side as white, flip the board if needed.
+    Square squares[BitbaseMaterial::MAX_PIECES];
+    Bitboard used = 0;
+    const auto& pieces = m_Material->getPieces();
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        Color c  = firstSide == CL_WHITE ? pieces[i].getColor() : getOppositeColor(pieces[i].getColor());
+        Bitboard bb = pos.getBitboard(Piece(c, pieces[i].getType())) & ~used;
+
+        // Pieces of the same kind are interchangeable, take any that wasn't taken yet.
+        Square s = *bb.begin();
+        used.add(s);
+        squares[i] = firstSide == CL_WHITE ? s : mirrorVertically(s);
+    }
+
+    Color stm = firstSide == CL_WHITE ? pos.getColorToMove() : getOppositeColor(pos.getColorToMove());
+    return probe(m_Material->getIndex(squares, stm));
+}
+
+//
+// Registry
+//
+
+static struct {
+    std::mutex mutex;
+
+    std::vector<std::unique_ptr<Bitbase>> bitbases;
+    std::unordered_map<ui64, std::pair<const Bitbase*, Color>> byKey;
+    std::atomic<ui32> generation = 0;
+} s_Registry;
+
+int loadBitbases(const std::filesystem::path& directory) {
+    std::error_code ec;
+    std::filesystem::directory_iterator it(directory, ec);
+    if (ec) {
+        unloadBitbases();
+        return 0;
+    }
+
+    std::unique_lock lock(s_Registry.mutex);
+    s_Registry.byKey.clear();
+    s_Registry.bitbases.clear();
+
+    int count = 0;
+    for (const auto& entry: it) {
+        if (entry.path().extension() != ".lbb") {
+            continue;
+        }
+
+        auto bitbase = std::make_unique<Bitbase>();
+        if (!bitbase->open(entry.path())) {
+            continue;
+        }
+
+        const BitbaseMaterial& material = bitbase->getMaterial();
+        s_Registry.byKey[material.flipped().getMaterialKey()] = { bitbase.get(), CL_BLACK };
+        s_Registry.byKey[material.getMaterialKey()]           = { bitbase.get(), CL_WHITE };
+        s_Registry.bitbases.push_back(std::move(bitbase));
+        count++;
+    }
+
+    s_Registry.generation++;
+    return count;
+}
+
+void unloadBitbases() {
+    std::unique_lock lock(s_Registry.mutex);
+    s_Registry.byKey.clear();
+    s_Registry.bitbases.clear();
+    s_Registry.generation++;
+}
+
+const Bitbase* findBitbase(ui64 materialKey, Color& firstSide) {
+    std::unique_lock lock(s_Registry.mutex);
+    auto it = s_Registry.byKey.find(materialKey);
+    if (it == s_Registry.byKey.end()) {
+        return nullptr;
+    }
+    firstSide = it->second.second;
+    return it->second.first;
+}
+
+ui32 getGeneration() {
+    return s_Registry.generation;
+}
+
+//
+// Generation
+//
+
+namespace {
+
+/** Results of positions being solved. */
+enum State : ui8 {
+    ST_UNKNOWN,
+    ST_ILLEGAL,
+    ST_DRAW,
+    ST_WIN,
+    ST_LOSS,
+};
+
+/** Set in the move counter of positions in which a capture or promotion draws. */
+constexpr ui8 DRAWABLE_BIT = 0x80;
+
+/**
+ * A position being solved, as a list of piece squares.
+ */
+struct SolverPosition {
+    const std::vector<Piece>* pieces;
+    Square squares[BitbaseMaterial::MAX_PIECES];
+    Bitboard occ;
+    Bitboard colorOcc[CL_COUNT];
+
+    void refresh() {
+        occ = 0;
+        colorOcc[CL_WHITE] = colorOcc[CL_BLACK] = 0;
+        for (size_t i = 0; i < pieces->size(); ++i) {
+            occ.add(squares[i]);
+            colorOcc[(*pieces)[i].getColor()].add(squares[i]);
+        }
+    }
+
+    /**
+     * Squares attacked by a piece, with the given occupancy.
+     */
+    Bitboard getAttacks(size_t i, Bitboard occupancy) const {
+        Piece p = (*pieces)[i];
+        if (p.getType() == PT_PAWN) {
+            return bbs::getPawnAttacks(squares[i], p.getColor());
+        }
+        return bbs::getPieceAttacks(squares[i], occupancy, p);
+    }
+
+    /**
+     * Returns true if the king of color 'c' is attacked. The piece at index 'ignored',
+     * if any, is left out as if it had been captured.
+     */
+    bool isKingAttacked(Color c, size_t ignored = SIZE_MAX) const {
+        Square king = SQ_INVALID;
+        for (size_t i = 0; i < pieces->size(); ++i) {
+            if ((*pieces)[i] == Piece(c, PT_KING)) {
+                king = squares[i];
+            }
+        }
+        for (size_t i = 0; i < pieces->size(); ++i) {
+            if (i != ignored && (*pieces)[i].getColor() != c && getAttacks(i, occ).contains(king)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isLegal(Color colorToMove) const {
+        if (occ.count() != static_cast<int>(pieces->size())) {
+            return false;
+        }
+        for (size_t i = 0; i < pieces->size(); ++i) {
+            if ((*pieces)[i].getType() == PT_PAWN &&
+                (getRank(squares[i]) == RANK_1 || getRank(squares[i]) == RANK_8)) {
+                return false;
+            }
+        }
+        return !isKingAttacked(getOppositeColor(colorToMove));
+    }
+
+    /**
+     * Squares a piece can move to, including captures.
+     */
+    Bitboard getDestinations(size_t i) const {
+        Piece p  = (*pieces)[i];
+        Square s = squares[i];
+        Color c  = p.getColor();
+        if (p.getType() != PT_PAWN) {
+            return getAttacks(i, occ) & ~colorOcc[c];
+        }
+
+        Bitboard ret = bbs::getPawnAttacks(s, c) & colorOcc[getOppositeColor(c)];
+        Square step  = c == CL_WHITE ? s + 8 : s - 8;
+        if (!occ.contains(step)) {
+            ret.add(step);
+            Square doubleStep = c == CL_WHITE ? s + 16 : s - 16;
+            if (getRank(s) == (c == CL_WHITE ? RANK_2 : RANK_7) && !occ.contains(doubleStep)) {
+                ret.add(doubleStep);
+            }
+        }
+        return ret;
+    }
+
+    /**
+     * Squares a piece could have come from with a move that wasn't a capture or promotion.
+     */
+    Bitboard getOrigins(size_t i) const {
+        Piece p  = (*pieces)[i];
+        Square s = squares[i];
+        Color c  = p.getColor();
+        if (p.getType() != PT_PAWN) {
+            return getAttacks(i, occ) & ~occ;
+        }
+
+        Bitboard ret = 0;
+        Square step  = c == CL_WHITE ? s - 8 : s + 8;
+        if (!occ.contains(step) && getRank(step) != RANK_1 && getRank(step) != RANK_8) {
+            ret.add(step);
+            Square doubleStep = c == CL_WHITE ? s - 16 : s + 16;
+            if (getRank(s) == (c == CL_WHITE ? RANK_4 : RANK_5) && !occ.contains(doubleStep)) {
+                ret.add(doubleStep);
+            }
+        }
+        return ret;
+    }
+
+    int findPieceAt(Square s) const {
+        for (size_t i = 0; i < pieces->size(); ++i) {
+            if (squares[i] == s) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+};
+
+}
+
+WDL BitbaseGenerator::probeSolved(const BitbaseMaterial& material, const Square* squares, Color colorToMove) {
+    const std::vector<WDL>& results = generate(material);
+    return results[material.getIndex(squares, colorToMove)];
+}
+
+const std::vector<WDL>& BitbaseGenerator::generate(const BitbaseMaterial& material) {
+    std::string name = material.getName();
+    auto solved = m_Solved.find(name);
+    if (solved != m_Solved.end()) {
+        return solved->second;
+    }
+
+    if (m_Logger) {
+        m_Logger("Solving " + name + "...");
+    }
+
+    const std::vector<Piece>& pieces = material.getPieces();
+    size_t nPieces    = pieces.size();
+    size_t nPositions = material.getPositionCount();
+    std::vector<ui8> states(nPositions, ST_UNKNOWN);
+    std::vector<ui8> counters(nPositions, 0);
+    std::vector<ui32> queue;
+
+    // First pass: find illegal positions and positions solved by captures, promotions,
+    // mates and stalemates. Everything else waits for its moves to be solved.
+    for (size_t idx = 0; idx < nPositions; ++idx) {
+        SolverPosition pos;
+        pos.pieces = &pieces;
+        Color us   = material.decodeIndex(idx, pos.squares);
+        Color them = getOppositeColor(us);
+        pos.refresh();
+
+        if (!pos.isLegal(us)) {
+            states[idx] = ST_ILLEGAL;
+            continue;
+        }
+
+        int nMoves    = 0;
+        int nQuiet    = 0;
+        bool win      = false;
+        bool drawable = false;
+        for (size_t i = 0; i < nPieces && !win; ++i) {
+            if (pieces[i].getColor() != us) {
+                continue;
+            }
+
+            Piece piece = pieces[i];
+            for (Square to: pos.getDestinations(i)) {
+                int captured = pos.findPieceAt(to);
+
+                // The captured piece stays on the board, but it's ignored when looking for checks.
+                SolverPosition child = pos;
+                child.squares[i] = to;
+                child.refresh();
+                if (child.isKingAttacked(us, captured >= 0 ? captured : SIZE_MAX)) {
+                    continue;
+                }
+                nMoves++;
+
+                bool promotion = piece.getType() == PT_PAWN &&
+                                 (getRank(to) == RANK_1 || getRank(to) == RANK_8);
+                if (captured < 0 && !promotion) {
+                    nQuiet++;
+                    continue;
+                }
+
+                // Captures and promotions lead to other material, which is solved first.
+                Square childSquares[BitbaseMaterial::MAX_PIECES];
+                size_t n = 0;
+                for (size_t k = 0; k < nPieces; ++k) {
+                    if (static_cast<int>(k) != captured) {
+                        childSquares[n++] = child.squares[k];
+                    }
+                }
+
+                std::vector<PieceType> promotions;
+                if (promotion) {
+                    promotions = { PT_QUEEN, PT_ROOK, PT_BISHOP, PT_KNIGHT };
+                }
+                else {
+                    promotions = { piece.getType() };
+                }
+
+                for (PieceType pt: promotions) {
+                    BitbaseMaterial childMaterial = material.withPiece(i, Piece(us, pt));
+                    if (captured >= 0) {
+                        childMaterial = childMaterial.withoutPiece(captured);
+                    }
+
+                    WDL result = probeSolved(childMaterial, childSquares, them);
+                    if (result == WDL_LOSS) {
+                        win = true;
+                        break;
+                    }
+                    drawable |= result == WDL_DRAW;
+                }
+                if (win) {
+                    break;
+                }
+            }
+        }
+
+        if (win) {
+            states[idx] = ST_WIN;
+            queue.push_back(static_cast<ui32>(idx));
+        }
+        else if (nMoves == 0) {
+            // Mate or stalemate.
+            if (pos.isKingAttacked(us)) {
+                states[idx] = ST_LOSS;
+                queue.push_back(static_cast<ui32>(idx));
+            }
+            else {
+                states[idx] = ST_DRAW;
+            }
+        }
+        else if (nQuiet == 0) {
+            // Every move is a capture or promotion, and none of them wins.
+            states[idx] = drawable ? ST_DRAW : ST_LOSS;
+            if (!drawable) {
+                queue.push_back(static_cast<ui32>(idx));
+            }
+        }
+        else {
+            counters[idx] = static_cast<ui8>(nQuiet) | (drawable ? DRAWABLE_BIT : 0);
+        }
+    }
+
+    // Retrograde pass: go back from every won or lost position to the positions that
+    // lead to it. A position is won if any move loses for the opponent, and lost once
+    // all of its moves win for the opponent.
+    for (size_t head = 0; head < queue.size(); ++head) {
+        size_t idx = queue[head];
+        SolverPosition pos;
+        pos.pieces = &pieces;
+        Color stm  = material.decodeIndex(idx, pos.squares);
+        Color prev = getOppositeColor(stm);
+        pos.refresh();
+        bool lost = states[idx] == ST_LOSS;
+
+        for (size_t i = 0; i < nPieces; ++i) {
+            if (pieces[i].getColor() != prev) {
+                continue;
+            }
+
+            Square to = pos.squares[i];
+            for (Square from: pos.getOrigins(i)) {
+                pos.squares[i] = from;
+                size_t prevIdx = material.getIndex(pos.squares, prev);
+                pos.squares[i] = to;
+
+                if (states[prevIdx] != ST_UNKNOWN) {
+                    continue;
+                }
+
+                if (lost) {
+                    states[prevIdx] = ST_WIN;
+                    queue.push_back(static_cast<ui32>(prevIdx));
+                }
+                else if ((--counters[prevIdx] & ~DRAWABLE_BIT) == 0) {
+                    if (counters[prevIdx] & DRAWABLE_BIT) {
+                        states[prevIdx] = ST_DRAW;
+                    }
+                    else {
+                        states[prevIdx] = ST_LOSS;
+                        queue.push_back(static_cast<ui32>(prevIdx));
+                    }
+                }
+            }
+        }
+    }
+
+    // Whatever couldn't be solved can't be forced by either side.
+    std::vector<WDL> results(nPositions);
+    WDL last = WDL_DRAW;
+    for (size_t idx = 0; idx < nPositions; ++idx) {
+        switch (states[idx]) {
+            case ST_WIN:     last = WDL_WIN;  break;
+            case ST_LOSS:    last = WDL_LOSS; break;
+            case ST_ILLEGAL: break;
+            default:         last = WDL_DRAW; break;
+        }
+        results[idx] = last;
+    }
+
+    return m_Solved[name] = std::move(results);
+}
+
+}
@@ -0,0 +1,200 @@
+#ifndef LUNA_BITBASE_H
+#define LUNA_BITBASE_H
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedfile.h"
+#include "position.h"
+
+namespace lunachess::bitbase {
+
+/**
+ * Result of a position with perfect play, for the side to move.
+ * Bitbases don't take the fifty move rule into account.
+ */
+enum WDL : ui8 {
+    WDL_DRAW,
+    WDL_WIN,
+    WDL_LOSS,
+};
+
+inline constexpr WDL invertWDL(WDL wdl) {
+    return wdl == WDL_WIN ? WDL_LOSS : wdl == WDL_LOSS ? WDL_WIN : WDL_DRAW;
+}
+
+/**
+ * Returns true if the side with the pawn wins a KPK position. Exact, backed by
+ * a bitbase that is generated at build time and embedded in the binary.
+ */
+bool probeKPK(const Position& pos, Color strongSide);
+
+/**
+ * The pieces of a bitbase, such as KRKP for king and rook against king and pawn.
+ * The first side is the one played by white when generating and probing the
+ * bitbase. Positions of the opposite colors are probed by flipping the board.
+ */
+class BitbaseMaterial {
+public:
+    static constexpr int MAX_PIECES = 4;
+
+    /**
+     * Parses material such as "KRKP". Both sides must have a king, and at most
+     * one side may have pawns (en passant is not supported).
+     */
+    static std::optional<BitbaseMaterial> parse(std::string_view name);
+
+    /** White king, white pieces, black king and black pieces, in this order. */
+    inline const std::vector<Piece>& getPieces() const { return m_Pieces; }
+
+    std::string getName() const;
+
+    /** Material key of positions with exactly these pieces. */
+    ui64 getMaterialKey() const;
+
+    /** Same pieces with the colors swapped. */
+    BitbaseMaterial flipped() const;
+
+    /** Material left after removing or replacing the piece at the given index. */
+    BitbaseMaterial withoutPiece(size_t idx) const;
+    BitbaseMaterial withPiece(size_t idx, Piece newPiece) const;
+
+    /**
+     * Number of positions. Positions are indexed by the side to move and the square
+     * of each piece, so most of them are illegal.
+     */
+    inline size_t getPositionCount() const {
+        return size_t(2) << (6 * m_Pieces.size());
+    }
+
+    /**
+     * Index of a position given the square of each piece, in the order of getPieces().
+     * The side to move takes the most significant bit, so that positions next to each
+     * other tend to have the same result.
+     */
+    inline size_t getIndex(const Square* squares, Color colorToMove) const {
+        size_t idx = colorToMove;
+        for (size_t i = m_Pieces.size(); i-- > 0;) {
+            idx = idx * 64 + squares[i];
+        }
+        return idx;
+    }
+
+    /**
+     * Inverse of getIndex.
+     */
+    inline Color decodeIndex(size_t idx, Square* squares) const {
+        for (size_t i = 0; i < m_Pieces.size(); ++i) {
+            squares[i] = static_cast<Square>(idx % 64);
+            idx /= 64;
+        }
+        return static_cast<Color>(idx);
+    }
+
+private:
+    std::vector<Piece> m_Pieces;
+};
+
+/**
+ * A bitbase stored in a file. Files are split into blocks of positions, and each
+ * block is compressed on its own so that positions can be probed without
+ * decompressing the whole file.
+ */
+class Bitbase {
+public:
+    /** Positions per compressed block. */
+    static constexpr size_t BLOCK_SIZE = 1024;
+
+    /**
+     * Maps a bitbase file. Returns false if it couldn't be read or isn't a bitbase.
+     */
+    bool open(const std::filesystem::path& path);
+
+    inline const BitbaseMaterial& getMaterial() const { return *m_Material; }
+
+    /**
+     * Returns the result of the position with the given index, for the side to move.
+     */
+    WDL probe(size_t idx) const;
+
+    /**
+     * Returns the result of a position with this bitbase's material for the side
+     * to move. 'firstSide' is the color that has the first side of the material.
+     */
+    WDL probe(const Position& pos, Color firstSide) const;
+
+    /**
+     * Compresses the results of every position of a material and writes them to a file.
+     */
+    static bool write(const std::filesystem::path& path, const BitbaseMaterial& material,
+                      const std::vector<WDL>& results);
+
+private:
+    MappedFile m_File;
+    std::optional<BitbaseMaterial> m_Material;
+    size_t m_NBlocks = 0;
+    const ui8* m_BlockOffsets = nullptr;
+    const ui8* m_Data = nullptr;
+};
+
+/**
+ * Loads every bitbase (.lbb) file of a directory, replacing the ones loaded before,
+ * which are unmapped. Returns the number of bitbases loaded.
+ *
+ * Must not be called while positions are being evaluated. Evaluators drop their
+ * pointers to unloaded bitbases the next time their position is set (see getGeneration).
+ */
+int loadBitbases(const std::filesystem::path& directory);
+
+/**
+ * Unmaps every loaded bitbase. Same restrictions as loadBitbases.
+ */
+void unloadBitbases();
+
+/**
+ * Finds a loaded bitbase for a material key, in any of its color orientations.
+ * Sets 'firstSide' to the color that plays the first side of its material.
+ */
+const Bitbase* findBitbase(ui64 materialKey, Color& firstSide);
+
+/**
+ * Incremented every time bitbases are loaded. Caches that hold pointers to
+ * bitbases must be cleared when it changes.
+ */
+ui32 getGeneration();
+
+/**
+ * Solves every position of a material configuration with retrograde analysis. Material
+ * reached through captures and promotions is solved first, and kept for later calls.
+ */
+class BitbaseGenerator {
+public:
+    /**
+     * Returns the result of every position of the material, by index. Illegal
+     * positions are set to the result of the position before them, which makes
+     * them cheap to compress. They are never probed.
+     */
+    const std::vector<WDL>& generate(const BitbaseMaterial& material);
+
+    /**
+     * Called with a description of each material as it starts being solved.
+     */
+    inline void setLogger(std::function<void(const std::string&)> logger) {
+        m_Logger = std::move(logger);
+    }
+
+private:
+    std::unordered_map<std::string, std::vector<WDL>> m_Solved;
+    std::function<void(const std::string&)> m_Logger;
+
+    WDL probeSolved(const BitbaseMaterial& material, const Square* squares, Color colorToMove);
+};
+
+}
+
+#endif // LUNA_BITBASE_H
@@ -55,12 +55,23 @@ void initialize() {
                     buildEgMask(0, 0, 0, 1, 0)
                     );
 
-    registerEndgame(EG_KR_KR,
+    registerEndgame(EG_KQ_KQ,
                     buildEgMask(0, 0, 0, 0, 1),
                     buildEgMask(0, 0, 0, 0, 1)
                     );
 }
 
+/**
+ * Returns true if the piece counts of a color fit in an endgame mask.
+ */
+static bool fitsEgMask(const Position& pos, Color c) {
+    return pos.getBitboard(Piece(c, PT_PAWN)).count()   <= 7 &&
+           pos.getBitboard(Piece(c, PT_BISHOP)).count() <= 3 &&
+           pos.getBitboard(Piece(c, PT_KNIGHT)).count() <= 1 &&
+           pos.getBitboard(Piece(c, PT_ROOK)).count()   <= 1 &&
+           pos.getBitboard(Piece(c, PT_QUEEN)).count()  <= 1;
+}
+
 EndgameData identify(const Position& pos) {
     EndgameData ret;
     Bitboard occ = pos.getCompositeBitboard();
@@ -69,6 +80,11 @@ EndgameData identify(const Position& pos) {
         return ret;
     }
 
+    // Counts that don't fit would wrap around and be mistaken for other material.
+    if (!fitsEgMask(pos, CL_WHITE) || !fitsEgMask(pos, CL_BLACK)) {
+        return ret;
+    }
+
     ui64 whiteMask = buildEgMask(pos.getBitboard(WHITE_PAWN).count(),
                                pos.getBitboard(WHITE_KNIGHT).count(),
                                pos.getBitboard(WHITE_BISHOP).count(),
@@ -0,0 +1,123 @@
+#include "epd.h"
+
+#include <cctype>
+
+namespace lunachess {
+
+const std::vector<std::string>* EpdRecord::getOperands(std::string_view opcode) const {
+    for (const EpdOperation& op: operations) {
+        if (op.opcode == opcode) {
+            return &op.operands;
+        }
+    }
+    return nullptr;
+}
+
+std::string EpdRecord::getOperand(std::string_view opcode) const {
+    const std::vector<std::string>* operands = getOperands(opcode);
+    if (operands == nullptr || operands->empty()) {
+        return "";
+    }
+    return (*operands)[0];
+}
+
+static void skipSpaces(std::string_view str, size_t& i) {
+    while (i < str.size() && std::isspace(static_cast<unsigned char>(str[i]))) {
+        i++;
+    }
+}
+
+/**
+ * Reads a token delimited by spaces or, if 'stopAtSemicolon' is set, semicolons.
+ * Quoted tokens are read up to the closing quote, which is dropped along with
+ * the opening one.
+ */
+static std::string readToken(std::string_view str, size_t& i, bool stopAtSemicolon) {
+    std::string token;
+    if (i < str.size() && str[i] == '"') {
+        i++;
+        while (i < str.size() && str[i] != '"') {
+            token += str[i++];
+        }
+        if (i < str.size()) {
+            i++;
+        }
+        return token;
+    }
+
+    while (i < str.size() && !std::isspace(static_cast<unsigned char>(str[i])) &&
+           (!stopAtSemicolon || str[i] != ';')) {
+        token += str[i++];
+    }
+    return token;
+}
+
+static bool isNumber(std::string_view str) {
+    if (str.empty()) {
+        return false;
+    }
+    for (char c: str) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<EpdRecord> parseEpd(std::string_view line) {
+    // The first four fields are the ones of a FEN, without the move counters.
+    size_t i = 0;
+    std::string fen;
+    for (int field = 0; field < 4; ++field) {
+        skipSpaces(line, i);
+        std::string token = readToken(line, i, false);
+        if (token.empty()) {
+            return std::nullopt;
+        }
+        fen += (field > 0 ? " " : "") + token;
+    }
+
+    // Full FENs have the halfmove clock and fullmove number next.
+    size_t afterFen = i;
+    skipSpaces(line, afterFen);
+    size_t afterCounters = afterFen;
+    std::string halfmoveClock  = readToken(line, afterCounters, true);
+    skipSpaces(line, afterCounters);
+    std::string fullmoveNumber = readToken(line, afterCounters, true);
+    if (isNumber(halfmoveClock) && isNumber(fullmoveNumber)) {
+        fen += " " + halfmoveClock + " " + fullmoveNumber;
+        i = afterCounters;
+    }
+
+    std::optional<Position> pos = Position::fromFen(fen);
+    if (!pos.has_value()) {
+        return std::nullopt;
+    }
+
+    EpdRecord record { std::move(*pos), {} };
+    while (true) {
+        skipSpaces(line, i);
+        if (i >= line.size()) {
+            break;
+        }
+
+        EpdOperation op;
+        op.opcode = readToken(line, i, true);
+        while (true) {
+            skipSpaces(line, i);
+            if (i >= line.size() || line[i] == ';') {
+                i++;
+                break;
+            }
+            op.operands.push_back(readToken(line, i, true));
+        }
+
+        if (!op.opcode.empty()) {
+            record.operations.push_back(std::move(op));
+        }
+    }
+
+    return record;
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef LUNA_EPD_H
+#define LUNA_EPD_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "position.h"
+
+namespace lunachess {
+
+/**
+ * An EPD operation, such as 'bm Nf3 Qd2;' or 'id "WAC.001";'.
+ * Quotes around operands are removed.
+ */
+struct EpdOperation {
+    std::string opcode;
+    std::vector<std::string> operands;
+};
+
+/**
+ * A line of an EPD file: a position followed by a list of operations.
+ */
+struct EpdRecord {
+    Position position;
+    std::vector<EpdOperation> operations;
+
+    /**
+     * Returns the operands of the first operation with the given opcode,
+     * or nullptr if there's no such operation.
+     */
+    const std::vector<std::string>* getOperands(std::string_view opcode) const;
+
+    /**
+     * Returns the first operand of the given operation, or an empty string.
+     */
+    std::string getOperand(std::string_view opcode) const;
+};
+
+/**
+ * Parses a line of an EPD file. Lines with a full FEN (including the halfmove
+ * clock and fullmove number) are accepted as well, with or without operations.
+ * Returns std::nullopt if the position is malformed.
+ */
+std::optional<EpdRecord> parseEpd(std::string_view line);
+
+}
+
+#endif // LUNA_EPD_H
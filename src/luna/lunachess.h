@@ -1,18 +1,24 @@
 #ifndef LUNACHESS_H
 #define LUNACHESS_H
 
+#include "bitbase.h"
 #include "bitboard.h"
 #include "bits.h"
 #include "clock.h"
 #include "debug.h"
 #include "endgame.h"
+#include "epd.h"
+#include "mappedfile.h"
 #include "move.h"
 #include "movegen.h"
 #include "openingbook.h"
+#include "packedposition.h"
 #include "perft.h"
+#include "polyglot.h"
 #include "piece.h"
 #include "position.h"
 #include "pst.h"
+#include "spscqueue.h"
 #include "staticanalysis.h"
 #include "staticlist.h"
 #include "strutils.h"
@@ -23,6 +29,7 @@
 
 #include "ai/evaluator.h"
 #include "ai/search.h"
+#include "ai/searchstats.h"
 #include "ai/timemanager.h"
 #include "ai/transpositiontable.h"
 #include "ai/hce/hce.h"
@@ -0,0 +1,100 @@
+#include "mappedfile.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LUNA_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lunachess {
+
+bool MappedFile::open(const std::filesystem::path& path) {
+    close();
+
+#ifdef LUNA_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    m_Size = static_cast<size_t>(st.st_size);
+    if (m_Size > 0) {
+        void* addr = ::mmap(nullptr, m_Size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            m_Data   = static_cast<const ui8*>(addr);
+            m_Mapped = true;
+        }
+    }
+    ::close(fd);
+
+    if (m_Mapped) {
+        return true;
+    }
+#endif
+
+    // Fall back to reading the whole file.
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!stream) {
+        m_Size = 0;
+        return false;
+    }
+    m_Size = static_cast<size_t>(stream.tellg());
+    m_Buffer.resize(m_Size + 1);
+    stream.seekg(0);
+    if (!stream.read(reinterpret_cast<char*>(m_Buffer.data()), m_Size)) {
+        m_Buffer.clear();
+        m_Size = 0;
+        return false;
+    }
+    m_Data = m_Buffer.data();
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef LUNA_HAS_MMAP
+    if (m_Mapped) {
+        ::munmap(const_cast<ui8*>(m_Data), m_Size);
+    }
+#endif
+    m_Buffer.clear();
+    m_Buffer.shrink_to_fit();
+    m_Data   = nullptr;
+    m_Size   = 0;
+    m_Mapped = false;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    close();
+
+    m_Data   = other.m_Data;
+    m_Size   = other.m_Size;
+    m_Mapped = other.m_Mapped;
+    m_Buffer = std::move(other.m_Buffer);
+    if (!m_Mapped) {
+        m_Data = m_Buffer.empty() ? nullptr : m_Buffer.data();
+    }
+
+    other.m_Data   = nullptr;
+    other.m_Size   = 0;
+    other.m_Mapped = false;
+    return *this;
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef LUNA_MAPPEDFILE_H
+#define LUNA_MAPPEDFILE_H
+
+#include <filesystem>
+#include <vector>
+
+#include "types.h"
+
+namespace lunachess {
+
+/**
+ * Read-only view of a file's contents, backed by a memory mapping where the
+ * platform supports it. Pages are loaded lazily by the OS and shared between
+ * every process that maps the same file.
+ *
+ * On platforms without mmap support, the file is read into memory instead.
+ */
+class MappedFile {
+public:
+    /**
+     * Maps the file at the given path, closing any previously mapped file.
+     * Returns false if the file couldn't be opened or mapped.
+     */
+    bool open(const std::filesystem::path& path);
+
+    void close();
+
+    inline bool isOpen() const { return m_Data != nullptr; }
+
+    inline const ui8* data() const { return m_Data; }
+
+    inline size_t size() const { return m_Size; }
+
+    MappedFile() = default;
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    inline ~MappedFile() {
+        close();
+    }
+
+private:
+    const ui8* m_Data = nullptr;
+    size_t     m_Size = 0;
+    bool       m_Mapped = false;
+
+    /** Used when the file couldn't be mapped. */
+    std::vector<ui8> m_Buffer;
+};
+
+}
+
+#endif // LUNA_MAPPEDFILE_H
@@ -1,8 +1,10 @@
 #include "move.h"
 
+#include <cctype>
 #include <new>
 
 #include "bitboard.h"
+#include "movegen.h"
 #include "position.h"
 
 namespace lunachess {
@@ -127,21 +129,25 @@ std::string Move::toAlgebraic(const Position& pos) const {
 
         // Check if another piece of the same type can move to the
         // specified square
-        Bitboard atks = bbs::getPieceAttacks(dest, 0, srcPiece) & pos.getBitboard(srcPiece);
+        Bitboard atks = bbs::getPieceAttacks(dest, pos.getCompositeBitboard(), srcPiece) & pos.getBitboard(srcPiece);
         if (atks.count() > 1) {
             // We have another piece that could've done the same move as our.
-            // Try to differentiate it with file name.
+            // Try to differentiate it with file name, then with rank name,
+            // and use both if neither is enough.
             BoardFile srcFile = getFile(src);
+            BoardRank srcRank = getRank(src);
             Bitboard fileBB = bbs::getFileBitboard(srcFile) & atks;
+            Bitboard rankBB = bbs::getRankBitboard(srcRank) & atks;
 
             if (fileBB.count() == 1) {
-                // Other piece is on another file, use the file to differentiate.
                 ret[idx++] = std::tolower(getFileIdentifier(srcFile));
             }
+            else if (rankBB.count() == 1) {
+                ret[idx++] = std::tolower(getRankIdentifier(srcRank));
+            }
             else {
-                // There is another piece on the same file as the sourcePiece.
-                // Use the rank to differentiate.
-                ret[idx++] = std::tolower(getRankIdentifier(getRank(src)));
+                ret[idx++] = std::tolower(getFileIdentifier(srcFile));
+                ret[idx++] = std::tolower(getRankIdentifier(srcRank));
             }
         }
 
@@ -170,4 +176,97 @@ std::string Move::toAlgebraic(const Position& pos) const {
     return std::string(ret);
 }
 
-}
\ No newline at end of file
+Move Move::fromAlgebraic(const Position& pos, std::string_view m) {
+    // Strip check, checkmate and annotation suffixes (ex. "Nf3+", "e4!?").
+    while (!m.empty() && (m.back() == '+' || m.back() == '#' || m.back() == '!' || m.back() == '?')) {
+        m.remove_suffix(1);
+    }
+    if (m.empty()) {
+        return MOVE_INVALID;
+    }
+
+    MoveList moves;
+    movegen::generate(pos, moves);
+
+    // Some PGN writers use zeroes instead of the letter O.
+    if (m == "O-O" || m == "0-0" || m == "O-O-O" || m == "0-0-0") {
+        MoveType type = m.size() == 3 ? MT_CASTLES_SHORT : MT_CASTLES_LONG;
+        for (Move move: moves) {
+            if (move.getType() == type) {
+                return move;
+            }
+        }
+        return MOVE_INVALID;
+    }
+
+    PieceType pt = PT_PAWN;
+    if (std::isupper(m[0])) {
+        pt = Piece::fromIdentifier(m[0]).getType();
+        if (pt == PT_NONE || pt == PT_PAWN) {
+            return MOVE_INVALID;
+        }
+        m.remove_prefix(1);
+    }
+
+    // Promotions are usually written as "e8=Q", but "e8Q" is also seen in the wild.
+    PieceType promPt = PT_NONE;
+    size_t promIdx = m.find('=');
+    if (promIdx != std::string_view::npos) {
+        if (promIdx + 1 >= m.size()) {
+            return MOVE_INVALID;
+        }
+        promPt = Piece::fromIdentifier(std::toupper(m[promIdx + 1])).getType();
+        m = m.substr(0, promIdx);
+    }
+    else if (pt == PT_PAWN && m.size() > 2 && std::isupper(m.back())) {
+        promPt = Piece::fromIdentifier(m.back()).getType();
+        m.remove_suffix(1);
+    }
+
+    // The destination square comes last. Whatever is left before it is
+    // either a capture sign or disambiguation of the source square.
+    if (m.size() < 2) {
+        return MOVE_INVALID;
+    }
+    Square dest = getSquare(m.substr(m.size() - 2));
+    if (dest == SQ_INVALID) {
+        return MOVE_INVALID;
+    }
+    m.remove_suffix(2);
+
+    int srcFile = -1;
+    int srcRank = -1;
+    for (char c: m) {
+        if (c >= 'a' && c <= 'h') {
+            srcFile = c - 'a';
+        }
+        else if (c >= '1' && c <= '8') {
+            srcRank = c - '1';
+        }
+        else if (c != 'x' && c != ':') {
+            return MOVE_INVALID;
+        }
+    }
+
+    Move ret = MOVE_INVALID;
+    for (Move move: moves) {
+        if (move.is<MTM_CASTLES>() ||
+            move.getSourcePiece().getType() != pt ||
+            move.getDest() != dest ||
+            move.getPromotionPiece() != promPt) {
+            continue;
+        }
+        if ((srcFile >= 0 && getFile(move.getSource()) != srcFile) ||
+            (srcRank >= 0 && getRank(move.getSource()) != srcRank)) {
+            continue;
+        }
+        if (ret != MOVE_INVALID) {
+            // Ambiguous move.
+            return MOVE_INVALID;
+        }
+        ret = move;
+    }
+    return ret;
+}
+
+}
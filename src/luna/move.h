@@ -78,6 +78,11 @@ public:
     }
 
     std::string toAlgebraic(const Position& pos) const;
+
+    /**
+     * Parses a move in standard algebraic notation (ex. Nbd7, exd6, O-O, e8=Q+).
+     * Returns MOVE_INVALID unless it matches exactly one legal move of the position.
+     */
     static Move fromAlgebraic(const Position& pos, std::string_view m);
 
     inline Move(ui32 raw = 0)
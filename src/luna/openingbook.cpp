@@ -303,6 +303,13 @@ Move OpeningBook::getRandomMoveForPosition(ui64 posKey) const {
     return vec[utils::random(C64(0), vec.size())];
 }
 
+Move OpeningBook::getRandomMoveForPosition(const Position& pos) const {
+    if (m_File != nullptr) {
+        return m_File->getWeightedMove(pos);
+    }
+    return getRandomMoveForPosition(pos.getZobrist());
+}
+
 void OpeningBook::addMove(ui64 posKey, Move move) {
     auto& vec = m_Moves[posKey];
     vec.push_back(move);
@@ -335,4 +342,19 @@ void OpeningBook::clear() {
     m_Moves.clear();
 }
 
+bool OpeningBook::openFile(const std::filesystem::path& path) {
+    closeFile();
+
+    auto file = std::make_shared<PolyglotBook>();
+    if (!file->open(path)) {
+        return false;
+    }
+    m_File = std::move(file);
+    return true;
+}
+
+void OpeningBook::closeFile() {
+    m_File = nullptr;
+}
+
 }
\ No newline at end of file
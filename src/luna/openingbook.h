@@ -1,12 +1,15 @@
 #ifndef  LUNA_OPENINGBOOK_H
 #define  LUNA_OPENINGBOOK_H
 
+#include <filesystem>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
 #include <nlohmann/json.hpp>
 
 #include "debug.h"
+#include "polyglot.h"
 #include "position.h"
 
 namespace lunachess {
@@ -21,9 +24,12 @@ public:
     }
 
     Move getRandomMoveForPosition(ui64 posKey) const;
-    inline Move getRandomMoveForPosition(const Position& pos) const {
-        return getRandomMoveForPosition(pos.getZobrist());
-    }
+
+    /**
+     * Picks a book move for the position. If a book file is open, the move is
+     * picked from it with chances proportional to the move weights.
+     */
+    Move getRandomMoveForPosition(const Position& pos) const;
 
     void addMove(ui64 posKey, Move move);
     inline void addMove(const Position& pos, Move move) {
@@ -42,10 +48,26 @@ public:
 
     void clear();
 
+    /**
+     * Opens a book file in the Polyglot format, such as the ones built by lunabook.
+     * While it is open, positions are looked up in the file instead of in the moves
+     * added to this book. Returns false if the file couldn't be opened.
+     */
+    bool openFile(const std::filesystem::path& path);
+
+    void closeFile();
+
+    inline bool isFileOpen() const {
+        return m_File != nullptr;
+    }
+
     static const OpeningBook& getDefault();
 
 private:
     std::unordered_map<ui64, std::vector<Move>> m_Moves;
+
+    /** Shared by copies of the book, the file is mapped only once. */
+    std::shared_ptr<const PolyglotBook> m_File;
 };
 
 class OpeningBookBuilder {
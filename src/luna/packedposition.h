@@ -0,0 +1,55 @@
+#ifndef LUNA_PACKEDPOSITION_H
+#define LUNA_PACKEDPOSITION_H
+
+#include "types.h"
+
+namespace lunachess {
+
+/**
+ * Fixed size binary encoding of a position, for storing positions in files and passing
+ * them around without going through FEN. Encoded with Position::toPacked() and decoded
+ * with Position::fromPacked().
+ *
+ * Pieces are listed in the order of the squares set in 'occupancy', from a1 to h8,
+ * each one as its raw Piece value in a nibble (low nibble first). A position has at
+ * most 32 pieces, so 16 bytes are always enough. Multi-byte fields are stored in the
+ * host's byte order.
+ */
+struct PackedPosition {
+    ui64 occupancy;
+    ui8  pieces[16];
+
+    /** Bit 0 is the color to move, bits 1 to 4 are the CastlingRightsMask. */
+    ui8  flags;
+
+    /** SQ_INVALID if there's no en passant square. */
+    ui8  epSquare;
+
+    /** Plies since the last capture or pawn move, saturated at 255. */
+    ui8  fiftyMoveCounter;
+
+    ui8  reserved0;
+    ui16 plyCount;
+    ui16 reserved1;
+
+    inline bool operator==(const PackedPosition& other) const {
+        for (int i = 0; i < 16; ++i) {
+            if (pieces[i] != other.pieces[i]) {
+                return false;
+            }
+        }
+        return occupancy == other.occupancy && flags == other.flags &&
+               epSquare == other.epSquare && fiftyMoveCounter == other.fiftyMoveCounter &&
+               plyCount == other.plyCount;
+    }
+
+    inline bool operator!=(const PackedPosition& other) const {
+        return !(*this == other);
+    }
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition is expected to be 32 bytes long.");
+
+}
+
+#endif // LUNA_PACKEDPOSITION_H
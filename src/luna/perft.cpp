@@ -8,7 +8,7 @@
 namespace lunachess {
 
 template <bool PSEUDO_LEGAL, bool ALG_NOTATION, bool LOG>
-static ui64 perftInternal(Position& pos, int depth) {
+static ui64 perftInternal(Position& pos, int depth, std::ostream& out) {
     MoveList moves;
 
     ui64 n;
@@ -18,13 +18,13 @@ static ui64 perftInternal(Position& pos, int depth) {
         if constexpr (LOG) {
             for (auto m: moves) {
                 if constexpr (ALG_NOTATION) {
-                    std::cout << m.toAlgebraic(pos) << ": 1" << std::endl;
+                    out << m.toAlgebraic(pos) << ": 1" << std::endl;
                 }
                 else {
-                    std::cout << m << ": 1"  << std::endl;
+                    out << m << ": 1"  << std::endl;
                 }
             }
-            std::cout << (pos.isCheck() ? "check" : "not check") << std::endl;
+            out << (pos.isCheck() ? "check" : "not check") << std::endl;
         }
         return n;
     }
@@ -34,28 +34,28 @@ static ui64 perftInternal(Position& pos, int depth) {
 
     for (auto m : moves) {
         pos.makeMove(m);
-        ui64 count = perftInternal<PSEUDO_LEGAL, ALG_NOTATION, false>(pos, depth);
+        ui64 count = perftInternal<PSEUDO_LEGAL, ALG_NOTATION, false>(pos, depth, out);
         ret += count;
         pos.undoMove();
 
         if constexpr (LOG) {
             if constexpr (ALG_NOTATION) {
-                std::cout << m.toAlgebraic(pos) << ": " << count << std::endl;
+                out << m.toAlgebraic(pos) << ": " << count << std::endl;
             }
             else {
-                std::cout << m << ": " << count << std::endl;
+                out << m << ": " << count << std::endl;
             }
         }
     }
 
     if constexpr (LOG) {
-        std::cout << std::endl;
+        out << std::endl;
     }
 
     return ret;
 }
 
-ui64 perft(const Position& pos, int depth, bool log, bool pseudoLegal, bool algNotation) {
+ui64 perft(const Position& pos, int depth, bool log, bool pseudoLegal, bool algNotation, std::ostream& out) {
     Position repl = pos;
 
     ui64 ret;
@@ -63,23 +63,23 @@ ui64 perft(const Position& pos, int depth, bool log, bool pseudoLegal, bool algN
     if (log) {
         if (algNotation) {
             if (pseudoLegal) {
-                ret = perftInternal<true, true, true>(repl, depth);
+                ret = perftInternal<true, true, true>(repl, depth, out);
             } else {
-                ret = perftInternal<false, true, true>(repl, depth);
+                ret = perftInternal<false, true, true>(repl, depth, out);
             }
         } else {
             if (pseudoLegal) {
-                ret = perftInternal<true, false, true>(repl, depth);
+                ret = perftInternal<true, false, true>(repl, depth, out);
             } else {
-                ret = perftInternal<false, false, true>(repl, depth);
+                ret = perftInternal<false, false, true>(repl, depth, out);
             }
         }
     }
     else {
         if (pseudoLegal) {
-            ret = perftInternal<true, true, false>(repl, depth);
+            ret = perftInternal<true, true, false>(repl, depth, out);
         } else {
-            ret = perftInternal<false, true, false>(repl, depth);
+            ret = perftInternal<false, true, false>(repl, depth, out);
         }
     }
 
@@ -1,11 +1,14 @@
 #ifndef LUNA_PERFT_H
 #define LUNA_PERFT_H
 
+#include <iostream>
+
 #include "position.h"
 
 namespace lunachess {
 
-ui64 perft(const Position& pos, int depth, bool log = true, bool pseudoLegal = false, bool algNotation = false);
+ui64 perft(const Position& pos, int depth, bool log = true, bool pseudoLegal = false, bool algNotation = false,
+           std::ostream& out = std::cout);
 
 } // lunachess
 
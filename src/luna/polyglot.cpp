@@ -0,0 +1,177 @@
+#include "polyglot.h"
+
+#include "bitboard.h"
+#include "movegen.h"
+#include "utils.h"
+
+namespace lunachess {
+
+// The 781 keys Polyglot hashes positions with. They're defined by the Polyglot
+// book format and must match it exactly, see scripts/polyglot/genkeys.py.
+static constexpr ui64 RANDOM64[781] = {
+#include "polyglotkeys.inc"
+};
+
+// Offsets of each kind of key in RANDOM64.
+static constexpr int RANDOM_PIECE      = 0;
+static constexpr int RANDOM_CASTLE     = 768;
+static constexpr int RANDOM_EN_PASSANT = 772;
+static constexpr int RANDOM_TURN       = 780;
+
+ui64 getPolyglotKey(const Position& pos) {
+    ui64 key = 0;
+
+    Bitboard occ = pos.getCompositeBitboard();
+    for (Square s: occ) {
+        Piece p = pos.getPieceAt(s);
+
+        // Polyglot orders pieces as black pawn, white pawn, black knight, white knight...
+        int kind = (p.getType() - PT_PAWN) * 2 + (p.getColor() == CL_WHITE ? 1 : 0);
+        key ^= RANDOM64[RANDOM_PIECE + 64 * kind + s];
+    }
+
+    constexpr CastlingRightsMask CASTLE_ORDER[] = { CR_WHITE_OO, CR_WHITE_OOO, CR_BLACK_OO, CR_BLACK_OOO };
+    for (int i = 0; i < 4; ++i) {
+        if (pos.getCastleRights() & CASTLE_ORDER[i]) {
+            key ^= RANDOM64[RANDOM_CASTLE + i];
+        }
+    }
+
+    Square epSquare = pos.getEnPassantSquare();
+    if (epSquare != SQ_INVALID) {
+        Color us   = pos.getColorToMove();
+        Color them = getOppositeColor(us);
+        if (bbs::getPawnAttacks(epSquare, them) & pos.getBitboard(Piece(us, PT_PAWN))) {
+            key ^= RANDOM64[RANDOM_EN_PASSANT + getFile(epSquare)];
+        }
+    }
+
+    if (pos.getColorToMove() == CL_WHITE) {
+        key ^= RANDOM64[RANDOM_TURN];
+    }
+
+    return key;
+}
+
+ui16 encodePolyglotMove(Move move) {
+    Square src = move.getSource();
+    Square dst = move.getDest();
+    if (move.getType() == MT_CASTLES_SHORT) {
+        dst = getSquare(FL_H, getRank(src));
+    }
+    else if (move.getType() == MT_CASTLES_LONG) {
+        dst = getSquare(FL_A, getRank(src));
+    }
+
+    ui16 ret = getFile(dst)
+             | (getRank(dst) << 3)
+             | (getFile(src) << 6)
+             | (getRank(src) << 9);
+
+    PieceType promPt = move.getPromotionPiece();
+    if (move.is<MTM_PROMOTION>() && promPt != PT_NONE) {
+        ret |= (promPt - PT_KNIGHT + 1) << 12;
+    }
+    return ret;
+}
+
+Move decodePolyglotMove(const Position& pos, ui16 move) {
+    MoveList moves;
+    movegen::generate(pos, moves);
+    for (Move m: moves) {
+        if (encodePolyglotMove(m) == move) {
+            return m;
+        }
+    }
+    return MOVE_INVALID;
+}
+
+template <typename T>
+static T readBigEndian(const ui8* data) {
+    T ret = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        ret = (ret << 8) | data[i];
+    }
+    return ret;
+}
+
+bool PolyglotBook::open(const std::filesystem::path& path) {
+    close();
+    if (!m_File.open(path)) {
+        return false;
+    }
+    if (m_File.size() % PolyglotEntry::SIZE != 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PolyglotBook::close() {
+    m_File.close();
+}
+
+ui64 PolyglotBook::getEntryKey(size_t idx) const {
+    return readBigEndian<ui64>(m_File.data() + idx * PolyglotEntry::SIZE);
+}
+
+PolyglotEntry PolyglotBook::getEntry(size_t idx) const {
+    const ui8* data = m_File.data() + idx * PolyglotEntry::SIZE;
+
+    PolyglotEntry entry;
+    entry.key    = readBigEndian<ui64>(data);
+    entry.move   = readBigEndian<ui16>(data + 8);
+    entry.weight = readBigEndian<ui16>(data + 10);
+    entry.learn  = readBigEndian<ui32>(data + 12);
+    return entry;
+}
+
+size_t PolyglotBook::findFirstEntry(ui64 key) const {
+    size_t lo = 0;
+    size_t hi = getEntryCount();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (getEntryKey(mid) < key) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+Move PolyglotBook::getWeightedMove(const Position& pos) const {
+    if (!isOpen()) {
+        return MOVE_INVALID;
+    }
+
+    ui64 key      = getPolyglotKey(pos);
+    size_t first  = findFirstEntry(key);
+    size_t last   = first;
+    ui64 totalWeight = 0;
+    while (last < getEntryCount() && getEntryKey(last) == key) {
+        totalWeight += getEntry(last).weight;
+        last++;
+    }
+    if (first == last) {
+        return MOVE_INVALID;
+    }
+
+    // Books may contain entries with no weight at all, pick any of them in that case.
+    if (totalWeight == 0) {
+        return decodePolyglotMove(pos, getEntry(utils::random(ui64(first), ui64(last))).move);
+    }
+
+    ui64 pick = utils::random(ui64(0), totalWeight);
+    for (size_t i = first; i < last; ++i) {
+        PolyglotEntry entry = getEntry(i);
+        if (pick < entry.weight) {
+            return decodePolyglotMove(pos, entry.move);
+        }
+        pick -= entry.weight;
+    }
+    return MOVE_INVALID;
+}
+
+}
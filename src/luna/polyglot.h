@@ -0,0 +1,89 @@
+#ifndef LUNA_POLYGLOT_H
+#define LUNA_POLYGLOT_H
+
+#include <filesystem>
+
+#include "mappedfile.h"
+#include "position.h"
+
+namespace lunachess {
+
+/**
+ * Computes the Polyglot hash of a position. Note that, unlike Luna's own Zobrist keys,
+ * the en passant square only changes the key if the side to move can capture on it.
+ */
+ui64 getPolyglotKey(const Position& pos);
+
+/**
+ * Encodes a move in the Polyglot format. Castling moves are encoded as the king
+ * capturing its own rook (ex. e1h1).
+ */
+ui16 encodePolyglotMove(Move move);
+
+/**
+ * Finds the legal move of 'pos' that matches a Polyglot move. Returns MOVE_INVALID
+ * if there is none.
+ */
+Move decodePolyglotMove(const Position& pos, ui16 move);
+
+/**
+ * An entry of a Polyglot book. In the file, entries are stored in big-endian byte
+ * order and sorted by key.
+ */
+struct PolyglotEntry {
+    static constexpr size_t SIZE = 16;
+
+    ui64 key    = 0;
+    ui16 move   = 0;
+    ui16 weight = 0;
+    ui32 learn  = 0;
+};
+
+/**
+ * An opening book in the Polyglot (.bin) format.
+ *
+ * The book file is memory mapped and probed in place with a binary search, so
+ * opening even large books is nearly instantaneous and doesn't allocate memory
+ * for the entries.
+ */
+class PolyglotBook {
+public:
+    /**
+     * Opens the book at the given path, closing any previously opened book.
+     * Returns false if the file couldn't be opened or doesn't look like a Polyglot book.
+     */
+    bool open(const std::filesystem::path& path);
+
+    void close();
+
+    inline bool isOpen() const {
+        return m_File.isOpen();
+    }
+
+    inline size_t getEntryCount() const {
+        return m_File.size() / PolyglotEntry::SIZE;
+    }
+
+    PolyglotEntry getEntry(size_t idx) const;
+
+    /**
+     * Returns the index of the first entry with the given key. If there is none,
+     * returns the index of the first entry with a greater key.
+     */
+    size_t findFirstEntry(ui64 key) const;
+
+    /**
+     * Picks one of the book moves for the given position, with chances proportional
+     * to their weights. Returns MOVE_INVALID if the position is not in the book.
+     */
+    Move getWeightedMove(const Position& pos) const;
+
+private:
+    MappedFile m_File;
+
+    ui64 getEntryKey(size_t idx) const;
+};
+
+}
+
+#endif // LUNA_POLYGLOT_H
@@ -3,6 +3,7 @@
 #include "staticanalysis.h"
 #include "movegen.h"
 
+#include <algorithm>
 #include <sstream>
 
 
@@ -1004,6 +1005,57 @@ std::optional<Position> Position::fromFen(std::string_view fen) {
     }
 }
 
+PackedPosition Position::toPacked() const {
+    PackedPosition packed = {};
+    packed.occupancy = m_Composite;
+
+    int i = 0;
+    Bitboard occ = m_Composite;
+    for (Square s: occ) {
+        packed.pieces[i / 2] |= m_Pieces[s].getRaw() << ((i % 2) * 4);
+        i++;
+    }
+
+    packed.flags            = static_cast<ui8>(m_ColorToMove | (m_Status.castleRights << 1));
+    packed.epSquare         = static_cast<ui8>(m_Status.epSquare);
+    packed.fiftyMoveCounter = static_cast<ui8>(std::min(m_Status.fiftyMoveCounter, 255));
+    packed.plyCount         = static_cast<ui16>(std::min(m_PlyCount, 65535));
+
+    return packed;
+}
+
+std::optional<Position> Position::fromPacked(const PackedPosition& packed) {
+    Bitboard occupancy = packed.occupancy;
+    if (occupancy.count() > 32 || (packed.flags >> 5) != 0 ||
+        (packed.epSquare >= 64 && packed.epSquare != SQ_INVALID)) {
+        return std::nullopt;
+    }
+
+    Position pos;
+
+    int i = 0;
+    for (Square s: occupancy) {
+        Piece p = Piece((packed.pieces[i / 2] >> ((i % 2) * 4)) & 0xf);
+        if (p.getType() <= PT_NONE || p.getType() >= PT_COUNT) {
+            return std::nullopt;
+        }
+        pos.setPieceAt<true, false>(s, p);
+        i++;
+    }
+
+    pos.updateAttacks();
+    pos.updatePins();
+
+    pos.setColorToMove(static_cast<Color>(packed.flags & 1));
+    pos.setCastleRights(static_cast<CastlingRightsMask>(packed.flags >> 1));
+    pos.refreshCastles();
+    pos.setEnPassantSquare(static_cast<Square>(packed.epSquare));
+    pos.m_Status.fiftyMoveCounter = packed.fiftyMoveCounter;
+    pos.m_PlyCount                = packed.plyCount;
+
+    return pos;
+}
+
 std::ostream& operator<<(std::ostream& stream, const Position& pos) {
     stream << "    A B C D E F G H" << std::endl;
 
@@ -11,6 +11,7 @@
 #include "debug.h"
 #include "zobrist.h"
 #include "move.h"
+#include "packedposition.h"
 #include "types.h"
 #include "bitboard.h"
 #include "staticlist.h"
@@ -57,6 +58,12 @@ public:
 
     inline ui64 getZobrist() const { return m_Status.zobrist; }
 
+    /**
+     * Returns a key that identifies the position's material, regardless of where
+     * the pieces are. Positions with the same piece counts share the same key.
+     */
+    inline ui64 getMaterialKey() const { return m_Status.materialKey; }
+
     inline int getPlyCount() const { return m_PlyCount; }
 
     /**
@@ -225,6 +232,12 @@ public:
      */
     std::string toFen() const;
 
+    /**
+     * Returns the compact binary encoding of this position. Much cheaper than toFen()
+     * and fromFen(), meant for files and for passing positions between threads.
+     */
+    PackedPosition toPacked() const;
+
     ChessResult getResult(Color pov, bool colorToMoveHasTime = true) const;
 
     Position();
@@ -236,10 +249,17 @@ public:
     static Position getInitialPosition();
     static std::optional<Position> fromFen(std::string_view fen);
 
+    /**
+     * Decodes a position encoded with toPacked(). Returns std::nullopt if the
+     * encoding is malformed.
+     */
+    static std::optional<Position> fromPacked(const PackedPosition& packed);
+
 private:
     struct Status {
         Move lastMove = MOVE_INVALID;
         ui64 zobrist = 5454;
+        ui64 materialKey = 0;
         int fiftyMoveCounter = 0;
         CastlingRightsMask castleRights = CR_NONE;
         Bitboard attacks[PT_COUNT][CL_COUNT];
@@ -297,7 +317,8 @@ void Position::setPieceAt(Square s, Piece p) {
         m_BBs[PT_NONE][prev.getColor()].remove(s);
 
         if constexpr (DO_ZOBRIST) {
-            m_Status.zobrist ^= zobrist::getPieceSquareKey(prev, s);
+            m_Status.zobrist     ^= zobrist::getPieceSquareKey(prev, s);
+            m_Status.materialKey ^= zobrist::getMaterialKey(prev, m_BBs[prev.getType()][prev.getColor()].count());
         }
     }
 
@@ -310,7 +331,8 @@ void Position::setPieceAt(Square s, Piece p) {
         m_BBs[PT_NONE][p.getColor()].add(s);
 
         if constexpr (DO_ZOBRIST) {
-            m_Status.zobrist ^= zobrist::getPieceSquareKey(p, s);
+            m_Status.zobrist     ^= zobrist::getPieceSquareKey(p, s);
+            m_Status.materialKey ^= zobrist::getMaterialKey(p, m_BBs[p.getType()][p.getColor()].count() - 1);
         }
     }
     else {
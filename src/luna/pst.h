@@ -21,6 +21,10 @@ public:
         return m_Values[squareToIdx(s, pov)];
     }
 
+    inline const int& valueRefAt(Square s, Color pov) const {
+        return m_Values[squareToIdx(s, pov)];
+    }
+
     inline PieceSquareTable() noexcept {
         std::fill(m_Values.begin(), m_Values.end(), 0);
     }
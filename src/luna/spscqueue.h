@@ -0,0 +1,128 @@
+#ifndef LUNA_SPSCQUEUE_H
+#define LUNA_SPSCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "debug.h"
+#include "types.h"
+
+namespace lunachess {
+
+/**
+ * Bounded, lock-free queue for exactly one producer thread and one consumer thread.
+ * Neither side ever blocks: pushing to a full queue or popping from an empty one
+ * simply fails.
+ *
+ * The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : m_Capacity(roundUpToPowerOfTwo(capacity)),
+          m_Mask(m_Capacity - 1),
+          m_Slots(std::make_unique<std::optional<T>[]>(m_Capacity)) {
+    }
+
+    SpscQueue(const SpscQueue& other) = delete;
+    SpscQueue& operator=(const SpscQueue& other) = delete;
+
+    inline size_t getCapacity() const {
+        return m_Capacity;
+    }
+
+    /**
+     * Producer only. Moves 'val' into the queue and returns true, or returns false
+     * (leaving 'val' untouched) if the queue is full.
+     */
+    inline bool tryPush(T&& val) {
+        size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail - m_CachedHead == m_Capacity) {
+            m_CachedHead = m_Head.load(std::memory_order_acquire);
+            if (tail - m_CachedHead == m_Capacity) {
+                return false;
+            }
+        }
+
+        m_Slots[tail & m_Mask].emplace(std::move(val));
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer only. Returns the oldest value of the queue without removing it,
+     * or nullptr if the queue is empty.
+     */
+    inline T* front() {
+        size_t head = m_Head.load(std::memory_order_relaxed);
+        if (head == m_CachedTail) {
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+            if (head == m_CachedTail) {
+                return nullptr;
+            }
+        }
+        return &*m_Slots[head & m_Mask];
+    }
+
+    /**
+     * Consumer only. Removes the value returned by front().
+     */
+    inline void pop() {
+        size_t head = m_Head.load(std::memory_order_relaxed);
+        LUNA_ASSERT(head != m_CachedTail, "Popping from an empty queue.");
+        m_Slots[head & m_Mask].reset();
+        m_Head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * Consumer only. Moves the oldest value of the queue into 'val' and returns true,
+     * or returns false if the queue is empty.
+     */
+    inline bool tryPop(T& val) {
+        T* f = front();
+        if (f == nullptr) {
+            return false;
+        }
+        val = std::move(*f);
+        pop();
+        return true;
+    }
+
+    /**
+     * Whether the queue is empty. Exact on the consumer's thread, a snapshot anywhere else.
+     */
+    inline bool empty() const {
+        return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+    }
+
+private:
+    /** Keeps the indices of each side on their own cache line. */
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    size_t m_Capacity;
+    size_t m_Mask;
+    std::unique_ptr<std::optional<T>[]> m_Slots;
+
+    // Consumer side. 'm_CachedTail' is the last tail seen by the consumer.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_Head { 0 };
+    size_t m_CachedTail = 0;
+
+    // Producer side. 'm_CachedHead' is the last head seen by the producer.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_Tail { 0 };
+    size_t m_CachedHead = 0;
+
+    static size_t roundUpToPowerOfTwo(size_t n) {
+        size_t ret = 1;
+        while (ret < n) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+};
+
+}
+
+#endif // LUNA_SPSCQUEUE_H
@@ -1,31 +1,42 @@
 #include "threadpool.h"
 
+#include "debug.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace lunachess {
 
-ThreadPool::ThreadPool(size_t numThreads) : m_Stop(false) {
+// Pool and index of the worker running on the current thread, if any.
+static thread_local const ThreadPool* t_Pool = nullptr;
+static thread_local int t_WorkerIdx = -1;
+
+static void pinCurrentThread(size_t cpu) {
+#if defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu % std::max(1u, std::thread::hardware_concurrency()), &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+    // Pinning is not supported on this platform, let the OS schedule the thread.
+    (void)cpu;
+#endif
+}
+
+ThreadPool::ThreadPool(size_t numThreads, bool pinThreads) {
     for (size_t i = 0; i < numThreads; ++i) {
-        m_Workers.emplace_back([this] {
-            while (true) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(m_QueueMutex);
-                    m_Condition.wait(lock, [this] { return m_Stop || !m_Tasks.empty(); });
-
-                    if (m_Stop && m_Tasks.empty())
-                        return;
-
-                    task = std::move(m_Tasks.front());
-                    m_Tasks.pop();
-                }
-                task();
-            }
-        });
+        m_Queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < numThreads; ++i) {
+        m_Workers.emplace_back([this, i, pinThreads] { workerMain(i, pinThreads); });
     }
 }
 
 ThreadPool::~ThreadPool() {
     {
-        std::unique_lock<std::mutex> lock(m_QueueMutex);
+        std::unique_lock<std::mutex> lock(m_SleepMutex);
         m_Stop = true;
     }
     m_Condition.notify_all();
@@ -35,4 +46,190 @@ ThreadPool::~ThreadPool() {
     }
 }
 
-}
\ No newline at end of file
+void ThreadPool::workerMain(size_t idx, bool pin) {
+    t_Pool      = this;
+    t_WorkerIdx = static_cast<int>(idx);
+    if (pin) {
+        pinCurrentThread(idx);
+    }
+
+    while (true) {
+        Task task;
+        if (tryPopTask(t_WorkerIdx, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_SleepMutex);
+        m_SleepingWorkers++;
+        m_Condition.wait(lock, [this] { return m_Stop || m_PendingTasks > 0 || m_PendingWakeups > 0; });
+
+        // Whoever woke us up already took us out of the sleeping workers. Any worker
+        // may consume a wakeup: the one it was meant for is still counted as sleeping then.
+        if (m_PendingWakeups > 0) {
+            m_PendingWakeups--;
+        }
+        else {
+            m_SleepingWorkers--;
+        }
+
+        // Queued tasks are still run when the pool is being destroyed.
+        if (m_Stop && m_PendingTasks == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::pushTask(Task task) {
+    LUNA_ASSERT(!m_Queues.empty(), "Cannot queue tasks in a pool without workers.");
+
+    int workerIdx = getCurrentWorkerIndex();
+    size_t queueIdx = workerIdx >= 0
+                      ? workerIdx
+                      : m_NextQueue.fetch_add(1, std::memory_order_relaxed) % m_Queues.size();
+
+    // Counted before the task is visible, so it never gets taken before
+    // being counted. A worker may wake up a bit too early because of that,
+    // in which case it simply waits again.
+    m_PendingTasks++;
+    {
+        WorkerQueue& queue = *m_Queues[queueIdx];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.pushBack(std::move(task));
+    }
+
+    // A worker about to sleep either sees the new pending task or is seen
+    // here, so no wakeup is lost by skipping the notification when nobody sleeps.
+    // Workers that were already woken up are not counted, so a burst of tasks
+    // only notifies once per sleeping worker.
+    if (m_SleepingWorkers > 0) {
+        std::unique_lock<std::mutex> lock(m_SleepMutex);
+        if (m_SleepingWorkers > 0) {
+            m_SleepingWorkers--;
+            m_PendingWakeups++;
+            m_Condition.notify_one();
+        }
+    }
+}
+
+bool ThreadPool::tryPopTask(int idx, Task& task) {
+    if (idx >= 0) {
+        // Our own newest task is the most likely to have its data in the cache.
+        WorkerQueue& queue = *m_Queues[idx];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.popBack(task)) {
+            m_PendingTasks--;
+            return true;
+        }
+    }
+
+    // Steal the oldest task of someone else.
+    size_t nQueues = m_Queues.size();
+    for (size_t i = 1; i <= nQueues; ++i) {
+        size_t victim = (idx + i) % nQueues;
+        if (static_cast<int>(victim) == idx) {
+            continue;
+        }
+        WorkerQueue& queue = *m_Queues[victim];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.popFront(task)) {
+            m_PendingTasks--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::WorkerQueue::pushBack(Task&& task) {
+    if (count == slots.size()) {
+        // Full, double the capacity. Tasks are moved to the front of the new buffer.
+        std::vector<Task> grown(slots.size() * 2);
+        for (size_t i = 0; i < count; ++i) {
+            grown[i] = std::move(slots[(head + i) & (slots.size() - 1)]);
+        }
+        slots = std::move(grown);
+        head  = 0;
+    }
+    slots[(head + count) & (slots.size() - 1)] = std::move(task);
+    count++;
+}
+
+bool ThreadPool::WorkerQueue::popBack(Task& task) {
+    if (count == 0) {
+        return false;
+    }
+    count--;
+    task = std::move(slots[(head + count) & (slots.size() - 1)]);
+    return true;
+}
+
+bool ThreadPool::WorkerQueue::popFront(Task& task) {
+    if (count == 0) {
+        return false;
+    }
+    task = std::move(slots[head]);
+    head = (head + 1) & (slots.size() - 1);
+    count--;
+    return true;
+}
+
+int ThreadPool::getCurrentWorkerIndex() const {
+    return t_Pool == this ? t_WorkerIdx : -1;
+}
+
+void ThreadPool::runChunks(ParallelForJob& job) {
+    while (true) {
+        size_t chunk = job.nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= job.chunkCount || job.failed.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        size_t first = job.begin + chunk * job.grain;
+        size_t last  = std::min(first + job.grain, job.end);
+        try {
+            job.invoke(job.fn, first, last);
+        }
+        catch (...) {
+            if (!job.failed.exchange(true)) {
+                job.exception = std::current_exception();
+            }
+        }
+    }
+}
+
+void ThreadPool::runParallelFor(ParallelForJob& job) {
+    // The calling thread takes a share of the chunks too, so one helper less is needed.
+    size_t nHelpers = std::min(m_Workers.size(), job.chunkCount - 1);
+    job.helpersLeft = nHelpers;
+
+    // Helpers only capture a pointer to the job.
+    ParallelForJob* jobPtr = &job;
+    for (size_t i = 0; i < nHelpers; ++i) {
+        pushTask(Task([jobPtr] {
+            runChunks(*jobPtr);
+            jobPtr->helpersLeft.fetch_sub(1, std::memory_order_release);
+        }));
+    }
+
+    runChunks(job);
+
+    // Helpers reference the job, so we can't return before all of them ran.
+    // Instead of blocking, run other queued tasks in the meantime (possibly our own
+    // helpers). This also prevents deadlocks when parallelFor is called from a worker.
+    int workerIdx = getCurrentWorkerIndex();
+    while (job.helpersLeft.load(std::memory_order_acquire) > 0) {
+        Task task;
+        if (tryPopTask(workerIdx, task)) {
+            task();
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    if (job.exception) {
+        std::rethrow_exception(job.exception);
+    }
+}
+
+}
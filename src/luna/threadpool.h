@@ -1,53 +1,250 @@
 #ifndef LUNA_THREADPOOL_H
 #define LUNA_THREADPOOL_H
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
 #include <future>
-#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <thread>
+#include <type_traits>
 #include <vector>
-#include <queue>
-#include <functional>
-#include <mutex>
-#include <condition_variable>
+
+#include "types.h"
 
 namespace lunachess {
 
+/**
+ * A pool of worker threads. Each worker owns a deque of tasks: it runs its own
+ * tasks newest first, and steals the oldest tasks of other workers when its deque
+ * is empty.
+ *
+ * Tasks submitted by a worker go to its own deque. Tasks submitted by other
+ * threads are spread over the workers in a round-robin fashion.
+ *
+ * Tasks are stored inline in fixed-size slots (see Task::SLOT_SIZE), so queuing
+ * one doesn't allocate. Callables that don't fit are rejected at compile time;
+ * capture large state by reference or through a pointer instead.
+ *
+ * Bulk work should go through parallelFor, which only queues one small task per
+ * worker, regardless of the number of items.
+ */
 class ThreadPool {
 public:
-    ThreadPool(size_t numThreads);
+    /**
+     * Creates a pool with 'numThreads' workers. If 'pinThreads' is set, each worker
+     * is pinned to a CPU (where supported).
+     * A pool with no workers is valid: parallelFor runs everything on the caller's thread.
+     */
+    explicit ThreadPool(size_t numThreads, bool pinThreads = false);
 
     ~ThreadPool();
 
+    inline size_t getThreadCount() const {
+        return m_Workers.size();
+    }
+
     template<class F, class... Args>
     void enqueue(F&& f, Args&& ... args) {
-        {
-            std::unique_lock<std::mutex> lock(m_QueueMutex);
-            m_Tasks.emplace([f, args...] { f(args...); });
-        }
-        m_Condition.notify_one();
+        pushTask(Task([f, args...] { f(args...); }));
     }
 
+    /**
+     * Queues f(args...) and returns a future for its result. The only allocation
+     * is the shared state of the future.
+     */
     template<class F, class... Args>
     auto submit(F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
         using TRet = decltype(f(args...));
-        auto task = std::make_shared<std::packaged_task<TRet()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-        std::future<TRet> result = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(m_QueueMutex);
-            m_Tasks.emplace([task]() { (*task)(); });
-        }
-        m_Condition.notify_one();
+        std::packaged_task<TRet()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<TRet> result = task.get_future();
+        pushTask(Task([task = std::move(task)]() mutable { task(); }));
         return result;
     }
 
+    /**
+     * Calls fn(first, last) for consecutive ranges [first, last) that cover [begin, end).
+     * Ranges have 'grain' items, except for the last one, which may be shorter.
+     * Range i starts at begin + i * grain.
+     *
+     * The calling thread takes part in the work and returns once every range was
+     * processed. If fn throws, the remaining ranges are skipped and the first exception
+     * is rethrown here.
+     *
+     * No allocations are made: the ranges are claimed from a counter that lives in the
+     * caller's stack frame.
+     */
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, F&& fn) {
+        if (begin >= end) {
+            return;
+        }
+        using TFn = std::remove_reference_t<F>;
+
+        ParallelForJob job;
+        job.begin      = begin;
+        job.end        = end;
+        job.grain      = std::max(grain, size_t(1));
+        job.chunkCount = (end - begin + job.grain - 1) / job.grain;
+        job.fn         = const_cast<void*>(static_cast<const void*>(&fn));
+        job.invoke     = [](void* fn, size_t first, size_t last) {
+            (*static_cast<TFn*>(fn))(first, last);
+        };
+        runParallelFor(job);
+    }
+
 private:
+    /**
+     * A move-only callable stored inline, in a slot of a fixed size.
+     */
+    class Task {
+    public:
+        static constexpr size_t SLOT_SIZE = 56;
+
+        Task() = default;
+
+        template <typename F>
+        explicit Task(F&& fn) {
+            using TFn = std::decay_t<F>;
+            static_assert(sizeof(TFn) <= SLOT_SIZE && alignof(TFn) <= alignof(std::max_align_t),
+                          "Task does not fit in a slot. Capture large state by reference or through a pointer.");
+            static_assert(std::is_nothrow_move_constructible_v<TFn>,
+                          "Tasks must be nothrow move constructible.");
+
+            new (m_Storage) TFn(std::forward<F>(fn));
+            m_Ops = &OPS<TFn>;
+        }
+
+        inline Task(Task&& other) noexcept {
+            moveFrom(other);
+        }
+
+        inline Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        inline ~Task() {
+            reset();
+        }
+
+        inline void operator()() {
+            m_Ops->invoke(m_Storage);
+        }
+
+    private:
+        struct Ops {
+            void (*invoke)(void* fn);
+            void (*move)(void* dst, void* src);
+            void (*destroy)(void* fn);
+        };
+
+        template <typename TFn>
+        static constexpr Ops OPS = {
+            [](void* fn) { (*static_cast<TFn*>(fn))(); },
+            [](void* dst, void* src) { new (dst) TFn(std::move(*static_cast<TFn*>(src))); },
+            [](void* fn) { static_cast<TFn*>(fn)->~TFn(); },
+        };
+
+        alignas(std::max_align_t) unsigned char m_Storage[SLOT_SIZE];
+        const Ops* m_Ops = nullptr;
+
+        inline void moveFrom(Task& other) {
+            m_Ops = other.m_Ops;
+            if (m_Ops != nullptr) {
+                m_Ops->move(m_Storage, other.m_Storage);
+                other.reset();
+            }
+        }
+
+        inline void reset() {
+            if (m_Ops != nullptr) {
+                m_Ops->destroy(m_Storage);
+                m_Ops = nullptr;
+            }
+        }
+    };
+
+    /**
+     * Ring buffer of task slots, with a power of two capacity. It only grows (when
+     * a worker has more than INITIAL_CAPACITY tasks queued), so queuing tasks doesn't
+     * allocate in the steady state.
+     */
+    struct WorkerQueue {
+        static constexpr size_t INITIAL_CAPACITY = 256;
+
+        std::mutex mutex;
+        std::vector<Task> slots = std::vector<Task>(INITIAL_CAPACITY);
+        size_t head  = 0;
+        size_t count = 0;
+
+        void pushBack(Task&& task);
+        bool popBack(Task& task);
+        bool popFront(Task& task);
+    };
+
+    struct ParallelForJob {
+        size_t begin;
+        size_t end;
+        size_t grain;
+        size_t chunkCount;
+        void* fn;
+        void (*invoke)(void* fn, size_t first, size_t last);
+
+        std::atomic<size_t> nextChunk   = 0;
+        std::atomic<size_t> helpersLeft = 0;
+        std::atomic<bool> failed        = false;
+        std::exception_ptr exception;
+    };
+
     std::vector<std::thread> m_Workers;
-    std::queue<std::function<void()>> m_Tasks;
-    std::mutex m_QueueMutex;
+    std::vector<std::unique_ptr<WorkerQueue>> m_Queues;
+
+    /** Queue that receives the next task submitted from outside the pool. */
+    std::atomic<size_t> m_NextQueue = 0;
+
+    /** Number of tasks that were queued but not taken by anyone yet. */
+    std::atomic<size_t> m_PendingTasks = 0;
+
+    /**
+     * Number of workers waiting for tasks that no one has woken up yet. A worker is
+     * removed from it by whoever wakes it, so that tasks queued before it gets to run
+     * don't notify it again.
+     */
+    std::atomic<size_t> m_SleepingWorkers = 0;
+
+    std::mutex m_SleepMutex;
     std::condition_variable m_Condition;
-    bool m_Stop;
+
+    /** Wakeups sent to sleeping workers and not consumed yet. Guarded by m_SleepMutex. */
+    size_t m_PendingWakeups = 0;
+    bool m_Stop = false;
+
+    void workerMain(size_t idx, bool pin);
+
+    void pushTask(Task task);
+
+    /**
+     * Takes a task from the worker's own deque, or steals one from another worker.
+     * A negative 'idx' only steals (used by threads outside the pool).
+     */
+    bool tryPopTask(int idx, Task& task);
+
+    /** Index of the calling thread in this pool, or -1 if it is not a worker of it. */
+    int getCurrentWorkerIndex() const;
+
+    void runParallelFor(ParallelForJob& job);
+    static void runChunks(ParallelForJob& job);
 };
 
 }
 
-#endif  // LUNA_THREADPOOL_H
\ No newline at end of file
+#endif  // LUNA_THREADPOOL_H
@@ -51,6 +51,17 @@ inline void writeToFile(std::filesystem::path path, const std::string& data) {
     stream << data;
 }
 
+/**
+ * Writes data to a temporary file next to 'path' and then renames it to 'path',
+ * so readers never observe a partially written file.
+ */
+inline void writeToFileAtomically(std::filesystem::path path, const std::string& data) {
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    writeToFile(tmpPath, data);
+    std::filesystem::rename(tmpPath, path);
+}
+
 inline std::string readFromFile(std::filesystem::path path) {
     std::ifstream stream(path);
     stream.exceptions(std::ifstream::badbit);
@@ -59,6 +70,23 @@ inline std::string readFromFile(std::filesystem::path path) {
     return buffer.str();
 }
 
+constexpr ui64 FNV1A_OFFSET_BASIS = 0xcbf29ce484222325;
+constexpr ui64 FNV1A_PRIME        = 0x100000001b3;
+
+/**
+ * Computes the 64-bit FNV-1a hash of a block of memory.
+ * Larger inputs can be hashed in parts by passing the previous
+ * result as 'hash'.
+ */
+inline ui64 fnv1a(const void* data, size_t size, ui64 hash = FNV1A_OFFSET_BASIS) {
+    const ui8* bytes = static_cast<const ui8*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
 template <typename T> int sign(T val) {
     return (T(0) < val) - (val < T(0));
 }
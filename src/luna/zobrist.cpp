@@ -8,6 +8,7 @@ ui64 g_PieceSquareKeys[PT_COUNT][CL_COUNT][64];
 ui64 g_CastlingRightsKey[16];
 ui64 g_ColorToMoveKey[2];
 ui64 g_EnPassantSquareKey[256];
+ui64 g_MaterialKeys[PT_COUNT][CL_COUNT][16];
 
 static struct {
 
@@ -57,6 +58,7 @@ void initialize() {
     fillKeysArray(g_CastlingRightsKey, sizeof(g_CastlingRightsKey));
     fillKeysArray(g_ColorToMoveKey, sizeof(g_ColorToMoveKey));
     fillKeysArray(g_EnPassantSquareKey, sizeof(g_EnPassantSquareKey));
+    fillKeysArray(g_MaterialKeys, sizeof(g_MaterialKeys));
 }
 
 }
\ No newline at end of file
@@ -28,6 +28,15 @@ inline ui64 getEnPassantSquareKey(Square sqr) {
     return g_EnPassantSquareKey[sqr];
 }
 
+/**
+ * Key of the n-th (zero based) piece of a kind. Material keys are the xor of
+ * the keys of every piece on the board, so they only depend on piece counts.
+ */
+inline ui64 getMaterialKey(Piece piece, int n) {
+    extern ui64 g_MaterialKeys[PT_COUNT][CL_COUNT][16];
+    return g_MaterialKeys[piece.getType()][piece.getColor()][n];
+}
+
 } // lunachess
 
 #endif // LUNA_ZOBRIST_H
@@ -0,0 +1,119 @@
+#include <lunachess.h>
+
+#include <popl/popl.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace lunachess;
+
+struct Settings {
+    int threads   = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    size_t tasks  = 1000000;
+    bool pin      = false;
+};
+
+static Settings processArgs(int argc, char* argv[]) {
+    try {
+        Settings settings;
+
+        popl::OptionParser op("Measures the overhead of running tasks on Luna's thread pool.\nUsage");
+
+        auto optHelp = op.add<popl::Switch>("h", "help", "Explains lunabench's usage.");
+
+        auto optThreads = op.add<popl::Value<int>>("t", "threads",
+                                                   "Number of worker threads.", settings.threads);
+
+        auto optTasks = op.add<popl::Value<size_t>>("n", "tasks",
+                                                    "Number of tasks (or parallelFor items) per benchmark.", settings.tasks);
+
+        auto optPin = op.add<popl::Switch>("p", "pin", "Pins each worker thread to a CPU.");
+
+        op.parse(argc, argv);
+
+        if (optHelp->value()) {
+            // Display help and exit
+            std::cout << op << std::endl;
+            std::exit(EXIT_SUCCESS);
+        }
+
+        settings.threads = optThreads->value();
+        settings.tasks   = optTasks->value();
+        settings.pin     = optPin->value();
+
+        if (settings.threads < 1) {
+            throw std::runtime_error("At least one thread is required.");
+        }
+        if (settings.tasks == 0) {
+            throw std::runtime_error("At least one task is required.");
+        }
+
+        return settings;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Usage error: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Runs 'fn' and reports how long it took per task.
+ */
+template <typename F>
+static void benchmark(const std::string& name, size_t nTasks, F&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << std::left << std::setw(32) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(1) << (ns / nTasks) << " ns/task"
+              << std::setw(12) << std::setprecision(0) << (ns / 1000000) << " ms total" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    Settings settings = processArgs(argc, argv);
+
+    std::cout << "Running " << settings.tasks << " tasks per benchmark on "
+              << settings.threads << " threads" << (settings.pin ? " (pinned)" : "") << "." << std::endl;
+
+    ThreadPool pool(settings.threads, settings.pin);
+    std::atomic<size_t> counter = 0;
+
+    benchmark("enqueue", settings.tasks, [&]() {
+        counter = 0;
+        for (size_t i = 0; i < settings.tasks; ++i) {
+            pool.enqueue([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while (counter.load(std::memory_order_relaxed) < settings.tasks) {
+            std::this_thread::yield();
+        }
+    });
+
+    benchmark("submit", settings.tasks, [&]() {
+        std::vector<std::future<size_t>> results;
+        results.reserve(settings.tasks);
+        for (size_t i = 0; i < settings.tasks; ++i) {
+            results.push_back(pool.submit([i]() { return i; }));
+        }
+        for (auto& res: results) {
+            res.get();
+        }
+    });
+
+    for (size_t grain: { size_t(1), size_t(64), size_t(4096) }) {
+        benchmark("parallelFor (grain " + std::to_string(grain) + ")", settings.tasks, [&]() {
+            counter = 0;
+            pool.parallelFor(0, settings.tasks, grain, [&counter](size_t first, size_t last) {
+                counter.fetch_add(last - first, std::memory_order_relaxed);
+            });
+        });
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include <lunachess.h>
+
+#include <popl/popl.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace lunachess;
+using namespace lunachess::bitbase;
+
+struct Settings {
+    std::vector<BitbaseMaterial> materials;
+    fs::path outDir = ".";
+};
+
+static Settings processArgs(int argc, char* argv[]) {
+    try {
+        Settings settings;
+
+        popl::OptionParser op("Generates bitbases for small endings, such as KRKP or KQKP.\nUsage");
+
+        auto optHelp = op.add<popl::Switch>("h", "help", "Explains lunabitbase's usage.");
+
+        auto optMaterial = op.add<popl::Value<std::string>>("m", "material",
+                                                            "Material to generate, such as KRKP. Can be set multiple times.");
+
+        auto optOutDir = op.add<popl::Value<std::string>>("o", "o",
+                                                          "Directory the bitbases are written to.", settings.outDir.string());
+
+        op.parse(argc, argv);
+
+        if (optHelp->value()) {
+            // Display help and exit
+            std::cout << op << std::endl;
+            std::exit(EXIT_SUCCESS);
+        }
+
+        for (size_t i = 0; i < optMaterial->count(); ++i) {
+            auto material = BitbaseMaterial::parse(optMaterial->value(i));
+            if (!material.has_value()) {
+                throw std::runtime_error("Invalid material '" + optMaterial->value(i) + "'. Expected up to " +
+                                         std::to_string(BitbaseMaterial::MAX_PIECES) +
+                                         " pieces, such as KRKP, with pawns on at most one side.");
+            }
+            settings.materials.push_back(*material);
+        }
+        settings.outDir = optOutDir->value();
+
+        if (settings.materials.empty()) {
+            throw std::runtime_error("At least one material is required.");
+        }
+
+        return settings;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Usage error: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    lunachess::initializeEverything();
+
+    Settings settings = processArgs(argc, argv);
+
+    std::error_code ec;
+    fs::create_directories(settings.outDir, ec);
+
+    BitbaseGenerator generator;
+    generator.setLogger([](const std::string& msg) {
+        std::cout << msg << std::endl;
+    });
+
+    for (const BitbaseMaterial& material: settings.materials) {
+        auto start = std::chrono::steady_clock::now();
+
+        const std::vector<WDL>& results = generator.generate(material);
+
+        size_t counts[3] = {};
+        for (WDL wdl: results) {
+            counts[wdl]++;
+        }
+
+        fs::path path = settings.outDir / (material.getName() + ".lbb");
+        if (!Bitbase::write(path, material, results)) {
+            std::cerr << "Failed to write " << path.string() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Wrote " << path.string() << " (" << fs::file_size(path) << " bytes, "
+                  << counts[WDL_WIN] << " wins, " << counts[WDL_DRAW] << " draws and "
+                  << counts[WDL_LOSS] << " losses for the side to move, counting illegal positions) in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms." << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include "book.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace lunachess::book {
+
+void addGame(const BookSettings& settings, const PgnGame& game, RecordBuffer& buffer, BookStats& stats) {
+    stats.games++;
+
+    // Games with no result say nothing about their moves, and games that don't start
+    // from the initial position would fill the book with unreachable positions.
+    if (game.result == RESULT_UNKNOWN || game.fen.has_value()) {
+        stats.skippedGames++;
+        return;
+    }
+
+    Position pos = Position::getInitialPosition();
+    int nPlies = std::min(settings.maxPly, static_cast<int>(game.moves.size()));
+    for (int i = 0; i < nPlies; ++i) {
+        Move move = Move::fromAlgebraic(pos, game.moves[i]);
+        if (move == MOVE_INVALID) {
+            // Keep the moves up to here, they're still good.
+            stats.illegalMoves++;
+            break;
+        }
+
+        Color us = pos.getColorToMove();
+        bool won = (game.result == RESULT_WHITE_WINS && us == CL_WHITE) ||
+                   (game.result == RESULT_BLACK_WINS && us == CL_BLACK);
+
+        BookRecord record;
+        record.key   = getPolyglotKey(pos);
+        record.move  = encodePolyglotMove(move);
+        record.games = 1;
+        record.wins  = won ? 1 : 0;
+        record.draws = game.result == RESULT_DRAW ? 1 : 0;
+        buffer.add(record);
+        stats.records++;
+
+        pos.makeMove(move);
+    }
+}
+
+template <typename T>
+static void writeBigEndian(std::ostream& stream, T val) {
+    ui8 data[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        data[i] = (val >> ((sizeof(T) - 1 - i) * 8)) & 0xff;
+    }
+    stream.write(reinterpret_cast<const char*>(data), sizeof(data));
+}
+
+/**
+ * Writes the entries of a position, heaviest first. Returns the number of entries written.
+ */
+static size_t writePosition(const BookSettings& settings, std::vector<BookRecord>& records, std::ostream& stream) {
+    struct Scored {
+        ui16 move;
+        ui64 score;
+    };
+    std::vector<Scored> scored;
+    ui64 maxScore = 0;
+    for (const BookRecord& r: records) {
+        // Wins are worth two points and draws one, so that scores are integers.
+        ui64 score = ui64(r.wins) * 2 + r.draws;
+        if (r.games < ui32(settings.minGames) || score == 0) {
+            continue;
+        }
+        scored.push_back({ r.move, score });
+        maxScore = std::max(maxScore, score);
+    }
+
+    std::sort(scored.begin(), scored.end(), [](const Scored& a, const Scored& b) {
+        return a.score > b.score;
+    });
+
+    for (const Scored& s: scored) {
+        // Weights are 16 bits wide, scale them down if needed.
+        ui64 weight = maxScore > UINT16_MAX
+                      ? std::max(ui64(1), s.score * UINT16_MAX / maxScore)
+                      : s.score;
+
+        writeBigEndian<ui64>(stream, records[0].key);
+        writeBigEndian<ui16>(stream, s.move);
+        writeBigEndian<ui16>(stream, static_cast<ui16>(weight));
+        writeBigEndian<ui32>(stream, 0);
+    }
+    return scored.size();
+}
+
+void writeBook(const BookSettings& settings, RunSet& runs, std::ostream& stream, BookStats& stats) {
+    // Runs are merged in key order, so all moves of a position come together.
+    std::vector<BookRecord> positionRecords;
+    auto flushPosition = [&]() {
+        if (positionRecords.empty()) {
+            return;
+        }
+        size_t n = writePosition(settings, positionRecords, stream);
+        if (n > 0) {
+            stats.positions++;
+            stats.entries += n;
+        }
+        positionRecords.clear();
+    };
+
+    runs.merge([&](const BookRecord& record) {
+        if (!positionRecords.empty() && positionRecords[0].key != record.key) {
+            flushPosition();
+        }
+        positionRecords.push_back(record);
+    });
+    flushPosition();
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef LUNABOOK_BOOK_H
+#define LUNABOOK_BOOK_H
+
+#include <lunachess.h>
+
+#include "pgn.h"
+#include "records.h"
+
+#include <atomic>
+#include <ostream>
+
+namespace lunachess::book {
+
+struct BookSettings {
+    int maxPly   = 20;
+    int minGames = 3;
+};
+
+struct BookStats {
+    std::atomic<ui64> games        = 0;
+    std::atomic<ui64> skippedGames = 0;
+    std::atomic<ui64> illegalMoves = 0;
+    std::atomic<ui64> records      = 0;
+    ui64 positions = 0;
+    ui64 entries   = 0;
+};
+
+/**
+ * Adds a record for each of the first moves of a game.
+ */
+void addGame(const BookSettings& settings, const PgnGame& game, RecordBuffer& buffer, BookStats& stats);
+
+/**
+ * Merges all runs into a Polyglot book, which OpeningBook::openFile can open. Moves that were played too rarely or that
+ * never scored are dropped, and the rest are weighted by the points they scored.
+ */
+void writeBook(const BookSettings& settings, RunSet& runs, std::ostream& stream, BookStats& stats);
+
+}
+
+#endif // LUNABOOK_BOOK_H
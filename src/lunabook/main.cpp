@@ -0,0 +1,237 @@
+#include <lunachess.h>
+
+#include "book.h"
+#include "pgn.h"
+#include "records.h"
+
+#include <popl/popl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace lunachess;
+using namespace lunachess::book;
+
+/** Size of the pieces PGN files are split into, so that a single file can be read in parallel. */
+constexpr ui64 CHUNK_SIZE = 32 * 1024 * 1024;
+
+struct Settings {
+    std::vector<fs::path> inputPaths;
+    fs::path outPath;
+    fs::path tmpDir  = fs::temp_directory_path();
+    BookSettings book;
+    int threads      = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    size_t memoryMB  = 1024;
+};
+
+static Settings processArgs(int argc, char* argv[]) {
+    try {
+        Settings settings;
+
+        popl::OptionParser op("Builds a Polyglot opening book from PGN files.\nUsage");
+
+        auto optHelp = op.add<popl::Switch>("h", "help", "Explains lunabook's usage.");
+
+        auto optInput = op.add<popl::Value<std::string>>("i", "input",
+                                                         "Path to a PGN file. Can be set multiple times.");
+
+        auto optOutPath = op.add<popl::Value<std::string>>("o", "o",
+                                                           "Path to the output book file.");
+
+        auto optMaxPly = op.add<popl::Value<int>>("p", "max-ply",
+                                                  "Number of plies of each game added to the book.", settings.book.maxPly);
+
+        auto optMinGames = op.add<popl::Value<int>>("g", "min-games",
+                                                    "Moves played in fewer games than this are left out of the book.", settings.book.minGames);
+
+        auto optThreads = op.add<popl::Value<int>>("t", "threads", "Number of threads to be used.", settings.threads);
+
+        auto optMemory = op.add<popl::Value<size_t>>("m", "memory",
+                                                     "Approximate amount of memory used to count moves, in megabytes. "
+                                                     "Counts that don't fit are sorted into temporary files.", settings.memoryMB);
+
+        auto optTmpDir = op.add<popl::Value<std::string>>("", "tmp",
+                                                          "Directory of the temporary files. Defaults to the system's temporary directory.");
+
+        op.parse(argc, argv);
+
+        if (optHelp->value()) {
+            // Display help and exit
+            std::cout << op << std::endl;
+            std::exit(EXIT_SUCCESS);
+        }
+
+        for (size_t i = 0; i < optInput->count(); ++i) {
+            settings.inputPaths.emplace_back(optInput->value(i));
+        }
+        settings.book.maxPly   = optMaxPly->value();
+        settings.book.minGames = optMinGames->value();
+        settings.threads  = optThreads->value();
+        settings.memoryMB = optMemory->value();
+        if (optTmpDir->is_set()) {
+            settings.tmpDir = optTmpDir->value();
+        }
+
+        if (settings.inputPaths.empty()) {
+            throw std::runtime_error("At least one input PGN file is required.");
+        }
+        if (!optOutPath->is_set()) {
+            throw std::runtime_error("An output path is required.");
+        }
+        settings.outPath = optOutPath->value();
+
+        if (settings.book.maxPly < 1) {
+            throw std::runtime_error("Max ply must be at least 1.");
+        }
+        if (settings.book.minGames < 1) {
+            throw std::runtime_error("Min games must be at least 1.");
+        }
+        if (settings.threads < 1) {
+            throw std::runtime_error("At least one thread is required.");
+        }
+        if (settings.memoryMB == 0) {
+            throw std::runtime_error("Memory must be at least 1 megabyte.");
+        }
+
+        return settings;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Usage error: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * A range of bytes of a PGN file.
+ */
+struct Chunk {
+    fs::path path;
+    ui64 begin;
+    ui64 end;
+};
+
+/**
+ * Splits the input files into chunks. Files are only split if their games start
+ * with an Event tag, since that's what chunks synchronize on.
+ */
+static std::vector<Chunk> splitInputs(const Settings& settings) {
+    std::vector<Chunk> chunks;
+    for (const fs::path& path: settings.inputPaths) {
+        std::ifstream stream(path);
+        if (!stream) {
+            throw std::runtime_error("Failed to open " + path.string());
+        }
+
+        ui64 size = fs::file_size(path);
+        std::string firstLine;
+        std::getline(stream, firstLine);
+        if (firstLine.rfind("[Event ", 0) != 0) {
+            chunks.push_back({ path, 0, size });
+            continue;
+        }
+
+        for (ui64 begin = 0; begin < size; begin += CHUNK_SIZE) {
+            chunks.push_back({ path, begin, std::min(begin + CHUNK_SIZE, size) });
+        }
+    }
+    return chunks;
+}
+
+/**
+ * Reads all games and writes their moves as sorted runs.
+ */
+static void countMoves(const Settings& settings, RunSet& runs, BookStats& stats) {
+    std::vector<Chunk> chunks = splitInputs(settings);
+
+    // Each thread takes a buffer from here while it reads a chunk. Reusing buffers
+    // across chunks keeps the number of runs down.
+    size_t bufferCapacity = settings.memoryMB * 1024 * 1024 / sizeof(BookRecord) / settings.threads;
+    std::vector<std::unique_ptr<RecordBuffer>> freeBuffers;
+    for (int i = 0; i < settings.threads; ++i) {
+        freeBuffers.push_back(std::make_unique<RecordBuffer>(bufferCapacity, runs));
+    }
+    std::mutex mutex;
+    size_t chunksDone = 0;
+
+    ThreadPool pool(settings.threads - 1);
+    pool.parallelFor(0, chunks.size(), 1, [&](size_t first, size_t last) {
+        std::unique_ptr<RecordBuffer> buffer;
+        {
+            std::unique_lock lock(mutex);
+            buffer = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
+        }
+
+        for (size_t i = first; i < last; ++i) {
+            const Chunk& chunk = chunks[i];
+            std::ifstream stream(chunk.path, std::ios::binary);
+            PgnReader reader(stream, chunk.begin, chunk.end);
+            reader.setMaxMoves(settings.book.maxPly);
+
+            PgnGame game;
+            while (reader.readGame(game)) {
+                addGame(settings.book, game, *buffer, stats);
+            }
+        }
+
+        std::unique_lock lock(mutex);
+        freeBuffers.push_back(std::move(buffer));
+        chunksDone += last - first;
+        std::cout << "Read " << chunksDone << "/" << chunks.size() << " chunks ("
+                  << stats.games << " games)." << std::endl;
+    });
+
+    for (auto& buffer: freeBuffers) {
+        buffer->flush();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    lunachess::initializeEverything();
+
+    Settings settings = processArgs(argc, argv);
+
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        RunSet runs(settings.tmpDir);
+        BookStats stats;
+        countMoves(settings, runs, stats);
+
+        std::cout << "Read " << stats.games << " games (" << stats.skippedGames << " skipped, "
+                  << stats.illegalMoves << " cut short by unreadable moves), "
+                  << stats.records << " moves counted in " << runs.getRunCount() << " runs." << std::endl;
+
+        std::ofstream stream(settings.outPath, std::ios::binary);
+        if (!stream) {
+            throw std::runtime_error("Failed to open " + settings.outPath.string());
+        }
+        writeBook(settings.book, runs, stream, stats);
+        stream.close();
+        if (!stream) {
+            throw std::runtime_error("Failed to write " + settings.outPath.string());
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Wrote " << stats.entries << " entries for " << stats.positions << " positions to "
+                  << settings.outPath.string() << " in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms." << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,215 @@
+#include "pgn.h"
+
+#include <cctype>
+
+namespace lunachess::book {
+
+PgnReader::PgnReader(std::istream& stream, ui64 begin, ui64 end)
+    : m_Stream(stream), m_Offset(begin), m_End(end), m_Synchronized(begin == 0) {
+    m_Stream.seekg(std::streamoff(begin));
+}
+
+bool PgnReader::nextLine(std::string& line, ui64& lineOffset) {
+    if (m_PendingLine.has_value()) {
+        line       = std::move(*m_PendingLine);
+        lineOffset = m_PendingOffset;
+        m_PendingLine.reset();
+        return true;
+    }
+
+    if (!std::getline(m_Stream, line)) {
+        return false;
+    }
+    lineOffset = m_Offset;
+    m_Offset  += line.size() + 1;
+
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return true;
+}
+
+static bool isTagLine(const std::string& line) {
+    return !line.empty() && line[0] == '[';
+}
+
+static bool isGameStart(const std::string& line) {
+    return line.rfind("[Event ", 0) == 0;
+}
+
+static void parseTag(const std::string& line, PgnGame& game) {
+    // [Name "Value"]
+    size_t nameEnd    = line.find(' ');
+    size_t valueBegin = line.find('"');
+    size_t valueEnd   = line.rfind('"');
+    if (nameEnd == std::string::npos || valueBegin == std::string::npos || valueEnd <= valueBegin) {
+        return;
+    }
+
+    std::string_view name  = std::string_view(line).substr(1, nameEnd - 1);
+    std::string_view value = std::string_view(line).substr(valueBegin + 1, valueEnd - valueBegin - 1);
+
+    if (name == "Result") {
+        if (value == "1-0") {
+            game.result = RESULT_WHITE_WINS;
+        }
+        else if (value == "0-1") {
+            game.result = RESULT_BLACK_WINS;
+        }
+        else if (value == "1/2-1/2") {
+            game.result = RESULT_DRAW;
+        }
+    }
+    else if (name == "FEN") {
+        game.fen = std::string(value);
+    }
+}
+
+namespace {
+
+/**
+ * State of the movetext parser, kept across lines.
+ */
+struct MovetextState {
+    bool inComment     = false;
+    int variationDepth = 0;
+};
+
+}
+
+static bool isResultToken(std::string_view token) {
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+static void addToken(std::string_view token, PgnGame& game, size_t maxMoves) {
+    if (token.empty() || token[0] == '$' || isResultToken(token)) {
+        return;
+    }
+
+    // Move numbers may be glued to the move that follows them, as in "1.e4".
+    size_t i = 0;
+    while (i < token.size() && std::isdigit(static_cast<unsigned char>(token[i]))) {
+        i++;
+    }
+    if (i > 0 && i < token.size() && token[i] == '.') {
+        while (i < token.size() && token[i] == '.') {
+            i++;
+        }
+        token = token.substr(i);
+    }
+    if (token.empty()) {
+        return;
+    }
+
+    if (maxMoves == 0 || game.moves.size() < maxMoves) {
+        game.moves.emplace_back(token);
+    }
+}
+
+static void parseMovetext(const std::string& line, MovetextState& state,
+                          PgnGame& game, size_t maxMoves) {
+    size_t tokenBegin = 0;
+    size_t tokenSize  = 0;
+
+    auto flushToken = [&]() {
+        if (tokenSize > 0 && state.variationDepth == 0) {
+            addToken(std::string_view(line).substr(tokenBegin, tokenSize), game, maxMoves);
+        }
+        tokenSize = 0;
+    };
+
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (state.inComment) {
+            if (c == '}') {
+                state.inComment = false;
+            }
+            continue;
+        }
+
+        switch (c) {
+            case '{':
+                flushToken();
+                state.inComment = true;
+                break;
+
+            case ';':
+                // Comment up to the end of the line.
+                flushToken();
+                return;
+
+            case '(':
+                flushToken();
+                state.variationDepth++;
+                break;
+
+            case ')':
+                flushToken();
+                if (state.variationDepth > 0) {
+                    state.variationDepth--;
+                }
+                break;
+
+            default:
+                if (std::isspace(static_cast<unsigned char>(c))) {
+                    flushToken();
+                }
+                else {
+                    if (tokenSize == 0) {
+                        tokenBegin = i;
+                    }
+                    tokenSize++;
+                }
+                break;
+        }
+    }
+    flushToken();
+}
+
+bool PgnReader::readGame(PgnGame& game) {
+    game = PgnGame();
+
+    std::string line;
+    ui64 lineOffset;
+    bool started = false;
+    bool inMovetext = false;
+    MovetextState state;
+
+    while (nextLine(line, lineOffset)) {
+        // A '[' at the start of a line inside a multi-line comment is not a tag.
+        bool tag = isTagLine(line) && !state.inComment;
+
+        if (!m_Synchronized) {
+            // The range may start in the middle of a game, which belongs to the previous
+            // range. Skip everything up to the first game that starts in this one.
+            if (!isGameStart(line)) {
+                continue;
+            }
+            m_Synchronized = true;
+        }
+
+        if (tag) {
+            if (inMovetext) {
+                // First line of the next game.
+                m_PendingLine   = std::move(line);
+                m_PendingOffset = lineOffset;
+                return true;
+            }
+            if (!started) {
+                if (lineOffset >= m_End) {
+                    return false;
+                }
+                started = true;
+            }
+            parseTag(line, game);
+        }
+        else if (started && !line.empty()) {
+            inMovetext = true;
+            parseMovetext(line, state, game, m_MaxMoves);
+        }
+    }
+
+    return started;
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef LUNABOOK_PGN_H
+#define LUNABOOK_PGN_H
+
+#include <lunachess.h>
+
+#include <istream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lunachess::book {
+
+enum GameResult {
+    RESULT_UNKNOWN,
+    RESULT_WHITE_WINS,
+    RESULT_BLACK_WINS,
+    RESULT_DRAW
+};
+
+struct PgnGame {
+    GameResult result = RESULT_UNKNOWN;
+
+    /** Set if the game doesn't start from the initial position. */
+    std::optional<std::string> fen;
+
+    /** Moves of the main line, in standard algebraic notation. */
+    std::vector<std::string> moves;
+};
+
+/**
+ * Reads the games of a PGN file, or of a range of it. Only the main line of each game
+ * is kept: comments, variations, NAGs and move numbers are skipped.
+ *
+ * When reading a range, the games that start inside it are read, even if they end
+ * after it. A range that doesn't start at the beginning of the file is read from its
+ * first Event tag, so that files whose games all start with one (as required by the
+ * PGN standard) can be split at any offset.
+ */
+class PgnReader {
+public:
+    /**
+     * Reads the range [begin, end) of 'stream'. The stream must support seeking.
+     */
+    PgnReader(std::istream& stream, ui64 begin = 0, ui64 end = UINT64_MAX);
+
+    /**
+     * Moves past 'maxMoves' are not stored. Zero means no limit.
+     */
+    inline void setMaxMoves(size_t maxMoves) {
+        m_MaxMoves = maxMoves;
+    }
+
+    /**
+     * Reads the next game. Returns false if there are no more games in the range.
+     */
+    bool readGame(PgnGame& game);
+
+private:
+    std::istream& m_Stream;
+    ui64 m_Offset;
+    ui64 m_End;
+    size_t m_MaxMoves = 0;
+
+    /** First line of the next game, read while looking for the end of the previous one. */
+    std::optional<std::string> m_PendingLine;
+    ui64 m_PendingOffset = 0;
+
+    /** Set once the part of the range that belongs to a previous game was skipped. */
+    bool m_Synchronized;
+
+    bool nextLine(std::string& line, ui64& lineOffset);
+};
+
+}
+
+#endif // LUNABOOK_PGN_H
@@ -0,0 +1,225 @@
+#include "records.h"
+
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace lunachess::book {
+
+//
+// RunSet
+//
+
+RunSet::RunSet(std::filesystem::path directory)
+    : m_Directory(std::move(directory)) {
+    // Lets several instances share the same directory.
+    m_Id = std::random_device()();
+}
+
+RunSet::~RunSet() {
+    std::error_code ec;
+    for (const std::filesystem::path& path: m_Runs) {
+        std::filesystem::remove(path, ec);
+    }
+}
+
+std::filesystem::path RunSet::newRunPath() {
+    std::stringstream name;
+    name << "lunabook_" << m_Id << "_" << m_NextRunId++ << ".run";
+    return m_Directory / name.str();
+}
+
+void RunSet::addRun(const std::filesystem::path& path) {
+    std::unique_lock lock(m_Mutex);
+    m_Runs.push_back(path);
+}
+
+void RunSet::write(const std::vector<BookRecord>& records) {
+    std::filesystem::path path = newRunPath();
+
+    std::ofstream stream(path, std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(records.data()),
+                 std::streamsize(records.size() * sizeof(BookRecord)));
+    if (!stream) {
+        throw std::runtime_error("Failed to write run file " + path.string());
+    }
+
+    addRun(path);
+}
+
+namespace {
+
+/**
+ * Reads the records of a run file through a small buffer.
+ */
+class RunReader {
+public:
+    static constexpr size_t BUFFER_RECORDS = 4096;
+
+    explicit RunReader(const std::filesystem::path& path)
+        : m_Stream(path, std::ios::binary) {
+        if (!m_Stream) {
+            throw std::runtime_error("Failed to open run file " + path.string());
+        }
+        m_Buffer.resize(BUFFER_RECORDS);
+        fill();
+    }
+
+    inline bool done() const {
+        return m_Pos >= m_Count;
+    }
+
+    inline const BookRecord& current() const {
+        return m_Buffer[m_Pos];
+    }
+
+    void next() {
+        m_Pos++;
+        if (m_Pos >= m_Count) {
+            fill();
+        }
+    }
+
+private:
+    std::ifstream m_Stream;
+    std::vector<BookRecord> m_Buffer;
+    size_t m_Pos   = 0;
+    size_t m_Count = 0;
+
+    void fill() {
+        m_Stream.read(reinterpret_cast<char*>(m_Buffer.data()),
+                      std::streamsize(m_Buffer.size() * sizeof(BookRecord)));
+        m_Count = size_t(m_Stream.gcount()) / sizeof(BookRecord);
+        m_Pos   = 0;
+    }
+};
+
+}
+
+static void mergeRuns(const std::vector<std::filesystem::path>& runs,
+                      const std::function<void(const BookRecord&)>& fn) {
+    std::vector<RunReader> readers;
+    readers.reserve(runs.size());
+    for (const std::filesystem::path& path: runs) {
+        readers.emplace_back(path);
+    }
+
+    // Min-heap of reader indices, ordered by their current record.
+    auto greater = [&readers](size_t a, size_t b) {
+        return readers[b].current() < readers[a].current();
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < readers.size(); ++i) {
+        if (!readers[i].done()) {
+            heap.push(i);
+        }
+    }
+
+    bool hasRecord = false;
+    BookRecord record {};
+    while (!heap.empty()) {
+        size_t idx = heap.top();
+        heap.pop();
+
+        const BookRecord& next = readers[idx].current();
+        if (hasRecord && record.sameMove(next)) {
+            record.add(next);
+        }
+        else {
+            if (hasRecord) {
+                fn(record);
+            }
+            record    = next;
+            hasRecord = true;
+        }
+
+        readers[idx].next();
+        if (!readers[idx].done()) {
+            heap.push(idx);
+        }
+    }
+
+    if (hasRecord) {
+        fn(record);
+    }
+}
+
+void RunSet::merge(const std::function<void(const BookRecord&)>& fn) {
+    // Merging opens every run at once. If there are too many of them,
+    // merge them in groups into bigger runs first.
+    while (m_Runs.size() > MAX_MERGE_WIDTH) {
+        std::vector<std::filesystem::path> group(m_Runs.begin(), m_Runs.begin() + MAX_MERGE_WIDTH);
+        m_Runs.erase(m_Runs.begin(), m_Runs.begin() + MAX_MERGE_WIDTH);
+
+        std::filesystem::path path = newRunPath();
+        addRun(path);
+        {
+            std::ofstream stream(path, std::ios::binary);
+            mergeRuns(group, [&stream](const BookRecord& record) {
+                stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            });
+            if (!stream) {
+                throw std::runtime_error("Failed to write run file " + path.string());
+            }
+        }
+
+        std::error_code ec;
+        for (const std::filesystem::path& run: group) {
+            std::filesystem::remove(run, ec);
+        }
+    }
+
+    mergeRuns(m_Runs, fn);
+}
+
+//
+// RecordBuffer
+//
+
+RecordBuffer::RecordBuffer(size_t capacity, RunSet& runs)
+    : m_Capacity(std::max(capacity, size_t(1))), m_Runs(runs) {
+    m_Records.reserve(m_Capacity);
+}
+
+void RecordBuffer::add(const BookRecord& record) {
+    if (m_Records.size() >= m_Capacity) {
+        compact();
+
+        // Opening positions repeat a lot, so combining records usually frees
+        // most of the buffer. Only write a run once it stops doing so.
+        if (m_Records.size() >= m_Capacity / 2) {
+            m_Runs.write(m_Records);
+            m_Records.clear();
+        }
+    }
+    m_Records.push_back(record);
+}
+
+void RecordBuffer::compact() {
+    std::sort(m_Records.begin(), m_Records.end());
+
+    size_t n = 0;
+    for (size_t i = 0; i < m_Records.size(); ++i) {
+        if (n > 0 && m_Records[n - 1].sameMove(m_Records[i])) {
+            m_Records[n - 1].add(m_Records[i]);
+        }
+        else {
+            m_Records[n++] = m_Records[i];
+        }
+    }
+    m_Records.resize(n);
+}
+
+void RecordBuffer::flush() {
+    if (m_Records.empty()) {
+        return;
+    }
+    compact();
+    m_Runs.write(m_Records);
+    m_Records.clear();
+}
+
+}
@@ -0,0 +1,112 @@
+#ifndef LUNABOOK_RECORDS_H
+#define LUNABOOK_RECORDS_H
+
+#include <lunachess.h>
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace lunachess::book {
+
+/**
+ * Number of times a move was played in a position, and how those games ended
+ * for the side that played it.
+ */
+struct BookRecord {
+    ui64 key;   // Polyglot key of the position
+    ui16 move;  // Polyglot encoding of the move
+    ui16 unused = 0;
+    ui32 games;
+    ui32 wins;
+    ui32 draws;
+
+    inline bool sameMove(const BookRecord& other) const {
+        return key == other.key && move == other.move;
+    }
+
+    inline void add(const BookRecord& other) {
+        games += other.games;
+        wins  += other.wins;
+        draws += other.draws;
+    }
+
+    inline bool operator<(const BookRecord& other) const {
+        return key != other.key ? key < other.key : move < other.move;
+    }
+};
+
+static_assert(sizeof(BookRecord) == 24);
+
+/**
+ * Sorted runs of records stored in temporary files. Run files are removed
+ * when the set is destroyed.
+ */
+class RunSet {
+public:
+    /** Maximum number of runs merged at once. */
+    static constexpr size_t MAX_MERGE_WIDTH = 128;
+
+    explicit RunSet(std::filesystem::path directory);
+    ~RunSet();
+
+    RunSet(const RunSet&) = delete;
+    RunSet& operator=(const RunSet&) = delete;
+
+    /**
+     * Writes a sorted run of records to a new run file. Thread safe.
+     */
+    void write(const std::vector<BookRecord>& records);
+
+    inline size_t getRunCount() const {
+        return m_Runs.size();
+    }
+
+    /**
+     * Merges all runs in key order, calling 'fn' once for each distinct (position, move)
+     * pair with the counts of all runs added together.
+     * Every run being merged keeps a small read buffer in memory, so memory use doesn't
+     * depend on the size of the runs.
+     */
+    void merge(const std::function<void(const BookRecord&)>& fn);
+
+private:
+    std::filesystem::path m_Directory;
+    std::vector<std::filesystem::path> m_Runs;
+    std::mutex m_Mutex;
+    ui32 m_Id;
+    std::atomic<int> m_NextRunId = 0;
+
+    std::filesystem::path newRunPath();
+    void addRun(const std::filesystem::path& path);
+};
+
+/**
+ * Collects records in memory, up to a fixed number of them. When full, records are
+ * sorted and repeated ones are combined; if that doesn't free enough space, they
+ * are written as a new run.
+ */
+class RecordBuffer {
+public:
+    RecordBuffer(size_t capacity, RunSet& runs);
+
+    void add(const BookRecord& record);
+
+    /**
+     * Writes any records left as a new run.
+     */
+    void flush();
+
+private:
+    size_t m_Capacity;
+    RunSet& m_Runs;
+    std::vector<BookRecord> m_Records;
+
+    void compact();
+};
+
+}
+
+#endif // LUNABOOK_RECORDS_H
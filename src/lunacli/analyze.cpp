@@ -0,0 +1,187 @@
+#include "analyze.h"
+
+#include "batch.h"
+
+#include <nlohmann/json.hpp>
+#include <popl/popl.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace lunachess {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Settings {
+    fs::path inputPath;
+    std::optional<fs::path> outPath;
+    int depth = 0;
+    ui64 nodes = 0;
+    BatchSettings batch;
+};
+
+Settings processArgs(int argc, char* argv[]) {
+    try {
+        Settings settings;
+        settings.batch.threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+        popl::OptionParser op("Searches every position of an EPD or FEN file and writes the results as JSON lines.\n"
+                              "Usage: luna analyze");
+
+        auto optHelp = op.add<popl::Switch>("h", "help", "Explains luna analyze's usage.");
+
+        auto optInput = op.add<popl::Value<std::string>>("i", "input", "Path to an EPD or FEN file, one position per line.");
+
+        auto optOutPath = op.add<popl::Value<std::string>>("o", "out", "Path to the output file. Defaults to stdout.");
+
+        auto optDepth = op.add<popl::Value<int>>("d", "depth", "Depth to search each position to.");
+
+        auto optNodes = op.add<popl::Value<ui64>>("n", "nodes", "Number of nodes to search in each position.");
+
+        auto optThreads = op.add<popl::Value<int>>("t", "threads", "Number of positions searched at the same time.", settings.batch.threads);
+
+        auto optHash = op.add<popl::Value<size_t>>("", "hash", "Size of each thread's transposition table, in megabytes.", settings.batch.hashMB);
+
+        auto optKeepHash = op.add<popl::Switch>("", "keep-hash",
+                                                "Keep transposition tables between positions and search consecutive positions on the same thread. "
+                                                "Faster for positions of the same game, but results depend on the order positions are searched in.");
+
+        op.parse(argc, argv);
+
+        if (optHelp->value()) {
+            // Display help and exit
+            std::cout << op << std::endl;
+            std::exit(EXIT_SUCCESS);
+        }
+
+        if (!optInput->is_set()) {
+            throw std::runtime_error("An input file is required.");
+        }
+        settings.inputPath = optInput->value();
+        if (optOutPath->is_set()) {
+            settings.outPath = optOutPath->value();
+        }
+
+        if (!optDepth->is_set() && !optNodes->is_set()) {
+            throw std::runtime_error("A depth or node limit is required.");
+        }
+        if (optDepth->is_set()) {
+            settings.depth = optDepth->value();
+            if (settings.depth < 1 || settings.depth > ai::MAX_SEARCH_DEPTH) {
+                throw std::runtime_error("Depth must be between 1 and " + std::to_string(ai::MAX_SEARCH_DEPTH) + ".");
+            }
+        }
+        if (optNodes->is_set()) {
+            settings.nodes = optNodes->value();
+            if (settings.nodes == 0) {
+                throw std::runtime_error("Node limit must be at least 1.");
+            }
+        }
+
+        settings.batch.threads  = optThreads->value();
+        settings.batch.hashMB   = optHash->value();
+        settings.batch.keepHash = optKeepHash->value();
+        if (settings.batch.threads < 1) {
+            throw std::runtime_error("At least one thread is required.");
+        }
+        if (settings.batch.hashMB == 0) {
+            throw std::runtime_error("Hash must be at least 1 megabyte.");
+        }
+
+        return settings;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Usage error: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+nlohmann::json scoreToJson(int score) {
+    if (std::abs(score) < ai::FORCED_MATE_THRESHOLD) {
+        return { { "cp", score / 10 } };
+    }
+    int sign        = score < 0 ? -1 : 1;
+    int pliesToMate = ai::MATE_SCORE - std::abs(score);
+    return { { "mate", sign * (pliesToMate + 1) / 2 } };
+}
+
+nlohmann::json resultsToJson(const BatchPosition& position, const ai::SearchResults& results) {
+    nlohmann::json pv = nlohmann::json::array();
+    if (!results.searchedVariations.empty()) {
+        for (Move move: results.getPrincipalVariation().moves) {
+            pv.push_back(strutils::toString(move));
+        }
+    }
+
+    nlohmann::json json = {
+        { "line",     position.lineNumber },
+        { "fen",      position.record.position.toFen() },
+        { "bestmove", results.bestMove != MOVE_INVALID ? strutils::toString(results.bestMove) : "" },
+        { "score",    scoreToJson(results.bestScore) },
+        { "depth",    results.depth },
+        { "seldepth", results.selDepth },
+        { "nodes",    results.visitedNodes },
+        { "time",     results.searchTime },
+        { "pv",       pv },
+    };
+
+    std::string id = position.record.getOperand("id");
+    if (!id.empty()) {
+        json["id"] = id;
+    }
+    return json;
+}
+
+}
+
+int analyzeMain(int argc, char* argv[]) {
+    Settings settings = processArgs(argc, argv);
+
+    try {
+        std::vector<BatchPosition> positions = readEpdFile(settings.inputPath);
+
+        std::ofstream outFile;
+        if (settings.outPath.has_value()) {
+            outFile.open(*settings.outPath);
+            if (!outFile) {
+                throw std::runtime_error("Failed to open " + settings.outPath->string());
+            }
+        }
+        OrderedWriter writer(settings.outPath.has_value() ? outFile : std::cout);
+
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<ui64> totalNodes = 0;
+
+        searchInParallel(positions.size(), settings.batch, [&](ai::AlphaBetaSearcher& searcher, size_t i) {
+            ai::SearchSettings searchSettings;
+            if (settings.depth > 0) {
+                searchSettings.maxDepth = settings.depth;
+            }
+            searchSettings.maxNodes = settings.nodes;
+
+            ai::SearchResults results = searcher.search(positions[i].record.position, searchSettings);
+            totalNodes += results.visitedNodes;
+            writer.write(i, resultsToJson(positions[i], results).dump());
+        });
+
+        auto end = std::chrono::steady_clock::now();
+        i64 elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        std::cerr << "Analyzed " << positions.size() << " positions in " << elapsed << " ms ("
+                  << totalNodes * 1000 / std::max(elapsed, i64(1)) << " nodes per second)." << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+}
@@ -0,0 +1,14 @@
+#ifndef LUNA_ANALYZE_H
+#define LUNA_ANALYZE_H
+
+namespace lunachess {
+
+/**
+ * Entry point of 'luna analyze', which searches every position of an EPD file and
+ * writes the results as JSON lines. 'argv[0]' is expected to be "analyze".
+ */
+int analyzeMain(int argc, char* argv[]);
+
+}
+
+#endif // LUNA_ANALYZE_H
@@ -0,0 +1,85 @@
+#include "batch.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+namespace lunachess {
+
+/** Number of consecutive positions a thread takes at once when keeping its hash. */
+static constexpr size_t KEEP_HASH_GRAIN = 64;
+
+std::vector<BatchPosition> readEpdFile(const std::filesystem::path& path) {
+    std::ifstream stream(path);
+    if (!stream) {
+        throw std::runtime_error("Failed to open " + path.string());
+    }
+
+    std::vector<BatchPosition> positions;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(stream, line)) {
+        lineNumber++;
+
+        size_t start = line.find_first_not_of(" \t\r\n");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+
+        std::optional<EpdRecord> record = parseEpd(std::string_view(line).substr(start));
+        if (!record.has_value()) {
+            std::cerr << path.string() << ":" << lineNumber << ": invalid position, skipping it." << std::endl;
+            continue;
+        }
+        positions.push_back({ lineNumber, std::move(*record) });
+    }
+    return positions;
+}
+
+void searchInParallel(size_t count, const BatchSettings& settings,
+                      const std::function<void(ai::AlphaBetaSearcher& searcher, size_t i)>& fn) {
+    // Threads take a searcher from here for each range of positions they search.
+    std::vector<std::unique_ptr<ai::AlphaBetaSearcher>> freeSearchers;
+    for (int i = 0; i < settings.threads; ++i) {
+        auto searcher = std::make_unique<ai::AlphaBetaSearcher>();
+        searcher->getTT().resize(settings.hashMB * 1024 * 1024);
+        freeSearchers.push_back(std::move(searcher));
+    }
+    std::mutex mutex;
+
+    ThreadPool pool(settings.threads - 1);
+    pool.parallelFor(0, count, settings.keepHash ? KEEP_HASH_GRAIN : 1, [&](size_t first, size_t last) {
+        std::unique_ptr<ai::AlphaBetaSearcher> searcher;
+        {
+            std::unique_lock lock(mutex);
+            searcher = std::move(freeSearchers.back());
+            freeSearchers.pop_back();
+        }
+
+        for (size_t i = first; i < last; ++i) {
+            if (!settings.keepHash) {
+                searcher->getTT().clear();
+            }
+            fn(*searcher, i);
+        }
+
+        std::unique_lock lock(mutex);
+        freeSearchers.push_back(std::move(searcher));
+    });
+}
+
+void OrderedWriter::write(size_t index, std::string line) {
+    std::unique_lock lock(m_Mutex);
+    m_Pending.emplace(index, std::move(line));
+
+    auto it = m_Pending.begin();
+    while (it != m_Pending.end() && it->first == m_Next) {
+        m_Stream << it->second << '\n';
+        it = m_Pending.erase(it);
+        m_Next++;
+    }
+    m_Stream.flush();
+}
+
+}
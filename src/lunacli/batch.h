@@ -0,0 +1,72 @@
+#ifndef LUNA_BATCH_H
+#define LUNA_BATCH_H
+
+#include <lunachess.h>
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lunachess {
+
+/**
+ * A position read from an EPD or FEN file.
+ */
+struct BatchPosition {
+    /** Line of the file the position was read from, starting at 1. */
+    int lineNumber;
+    EpdRecord record;
+};
+
+/**
+ * Reads every position of an EPD file, one per line. Empty lines and lines starting
+ * with '#' are skipped, and malformed lines are reported to stderr and skipped.
+ */
+std::vector<BatchPosition> readEpdFile(const std::filesystem::path& path);
+
+struct BatchSettings {
+    int threads   = 1;
+    size_t hashMB = 16;
+
+    /**
+     * If set, searchers keep their transposition table between positions, and consecutive
+     * positions are searched by the same thread. Meant for positions of the same game,
+     * which share a lot of their trees. Otherwise, each search starts with an empty table,
+     * so that results don't depend on how positions were spread over the threads.
+     */
+    bool keepHash = false;
+};
+
+/**
+ * Calls fn(searcher, i) for every i in [0, count), over a pool of threads with one
+ * searcher per thread.
+ */
+void searchInParallel(size_t count, const BatchSettings& settings,
+                      const std::function<void(ai::AlphaBetaSearcher& searcher, size_t i)>& fn);
+
+/**
+ * Writes results in the order of the input file as soon as all results before
+ * them are written, so that the output can be followed while positions are searched.
+ */
+class OrderedWriter {
+public:
+    inline explicit OrderedWriter(std::ostream& stream)
+        : m_Stream(stream) {
+    }
+
+    void write(size_t index, std::string line);
+
+private:
+    std::ostream& m_Stream;
+    std::mutex m_Mutex;
+    std::map<size_t, std::string> m_Pending;
+    size_t m_Next = 0;
+};
+
+}
+
+#endif // LUNA_BATCH_H
@@ -0,0 +1,308 @@
+#include "epdtest.h"
+
+#include "batch.h"
+
+#include <popl/popl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace lunachess {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Settings {
+    fs::path inputPath;
+    int depth = 0;
+    ui64 nodes = 0;
+    int timeMs = 0;
+    int stableIterations = 3;
+    BatchSettings batch;
+};
+
+Settings processArgs(int argc, char* argv[]) {
+    try {
+        Settings settings;
+        settings.batch.threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+        popl::OptionParser op("Runs a suite of EPD positions with 'bm' and/or 'am' operations and reports how many were solved.\n"
+                              "Usage: luna epdtest");
+
+        auto optHelp = op.add<popl::Switch>("h", "help", "Explains luna epdtest's usage.");
+
+        auto optInput = op.add<popl::Value<std::string>>("i", "input", "Path to the EPD test suite.");
+
+        auto optTime = op.add<popl::Value<int>>("", "time", "Time budget of each position, in milliseconds.");
+
+        auto optNodes = op.add<popl::Value<ui64>>("n", "nodes", "Node budget of each position.");
+
+        auto optDepth = op.add<popl::Value<int>>("d", "depth", "Maximum depth to search each position to.");
+
+        auto optStable = op.add<popl::Value<int>>("k", "stable",
+                                                  "Stop searching a position once the expected move was found in this many iterations in a row.",
+                                                  settings.stableIterations);
+
+        auto optThreads = op.add<popl::Value<int>>("t", "threads", "Number of positions searched at the same time.", settings.batch.threads);
+
+        auto optHash = op.add<popl::Value<size_t>>("", "hash", "Size of each thread's transposition table, in megabytes.", settings.batch.hashMB);
+
+        op.parse(argc, argv);
+
+        if (optHelp->value()) {
+            // Display help and exit
+            std::cout << op << std::endl;
+            std::exit(EXIT_SUCCESS);
+        }
+
+        if (!optInput->is_set()) {
+            throw std::runtime_error("An input file is required.");
+        }
+        settings.inputPath = optInput->value();
+
+        if (!optTime->is_set() && !optNodes->is_set() && !optDepth->is_set()) {
+            throw std::runtime_error("A time, node or depth limit is required.");
+        }
+        if (optTime->is_set()) {
+            settings.timeMs = optTime->value();
+            if (settings.timeMs < 1) {
+                throw std::runtime_error("Time limit must be at least 1 millisecond.");
+            }
+        }
+        if (optNodes->is_set()) {
+            settings.nodes = optNodes->value();
+            if (settings.nodes == 0) {
+                throw std::runtime_error("Node limit must be at least 1.");
+            }
+        }
+        if (optDepth->is_set()) {
+            settings.depth = optDepth->value();
+            if (settings.depth < 1 || settings.depth > ai::MAX_SEARCH_DEPTH) {
+                throw std::runtime_error("Depth must be between 1 and " + std::to_string(ai::MAX_SEARCH_DEPTH) + ".");
+            }
+        }
+
+        settings.stableIterations = optStable->value();
+        settings.batch.threads    = optThreads->value();
+        settings.batch.hashMB     = optHash->value();
+        if (settings.stableIterations < 1) {
+            throw std::runtime_error("At least one stable iteration is required.");
+        }
+        if (settings.batch.threads < 1) {
+            throw std::runtime_error("At least one thread is required.");
+        }
+        if (settings.batch.hashMB == 0) {
+            throw std::runtime_error("Hash must be at least 1 megabyte.");
+        }
+
+        return settings;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Usage error: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * A position of the suite along with the moves it expects.
+ */
+struct TestPosition {
+    const BatchPosition* position;
+    std::string name;
+    std::vector<Move> bestMoves;
+    std::vector<Move> avoidMoves;
+
+    inline bool isCorrect(Move move) const {
+        if (move == MOVE_INVALID) {
+            return false;
+        }
+        if (!bestMoves.empty() && std::find(bestMoves.begin(), bestMoves.end(), move) == bestMoves.end()) {
+            return false;
+        }
+        return std::find(avoidMoves.begin(), avoidMoves.end(), move) == avoidMoves.end();
+    }
+};
+
+/**
+ * Parses the 'bm' and 'am' operands of a position. Returns false if the position
+ * has none of them or any of them isn't a legal move.
+ */
+bool parseExpectedMoves(const fs::path& path, TestPosition& test) {
+    const EpdRecord& record = test.position->record;
+
+    for (auto [opcode, moves]: { std::pair { "bm", &test.bestMoves }, std::pair { "am", &test.avoidMoves } }) {
+        const std::vector<std::string>* operands = record.getOperands(opcode);
+        if (operands == nullptr) {
+            continue;
+        }
+        for (const std::string& san: *operands) {
+            Move move = Move::fromAlgebraic(record.position, san);
+            if (move == MOVE_INVALID) {
+                std::cerr << path.string() << ":" << test.position->lineNumber << ": '" << san
+                          << "' is not a legal move, skipping position." << std::endl;
+                return false;
+            }
+            moves->push_back(move);
+        }
+    }
+
+    if (test.bestMoves.empty() && test.avoidMoves.empty()) {
+        std::cerr << path.string() << ":" << test.position->lineNumber
+                  << ": no 'bm' or 'am' operation, skipping position." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+struct TestResult {
+    bool solved = false;
+    Move playedMove = MOVE_INVALID;
+
+    /** Time, nodes and depth of the iteration in which the expected move was found for good. */
+    ui64 solveTime = 0;
+    ui64 solveNodes = 0;
+    int solveDepth = 0;
+};
+
+std::string formatResult(const TestPosition& test, const TestResult& result) {
+    const Position& pos = test.position->record.position;
+    std::ostringstream stream;
+    stream << std::left << std::setw(16) << test.name << std::right;
+    if (result.solved) {
+        stream << " solved      " << std::setw(8) << result.playedMove.toAlgebraic(pos)
+               << std::setw(8) << result.solveTime << " ms"
+               << std::setw(12) << result.solveNodes << " nodes"
+               << "  depth " << result.solveDepth;
+    }
+    else {
+        stream << " not solved  "
+               << std::setw(8) << (result.playedMove != MOVE_INVALID ? result.playedMove.toAlgebraic(pos) : "none");
+        if (!test.bestMoves.empty()) {
+            stream << "  bm";
+            for (Move move: test.bestMoves) {
+                stream << " " << move.toAlgebraic(pos);
+            }
+        }
+        if (!test.avoidMoves.empty()) {
+            stream << "  am";
+            for (Move move: test.avoidMoves) {
+                stream << " " << move.toAlgebraic(pos);
+            }
+        }
+    }
+    return stream.str();
+}
+
+}
+
+int epdTestMain(int argc, char* argv[]) {
+    Settings settings = processArgs(argc, argv);
+
+    try {
+        std::vector<BatchPosition> positions = readEpdFile(settings.inputPath);
+
+        std::vector<TestPosition> tests;
+        for (const BatchPosition& position: positions) {
+            TestPosition test;
+            test.position = &position;
+            test.name     = position.record.getOperand("id");
+            if (test.name.empty()) {
+                test.name = "line " + std::to_string(position.lineNumber);
+            }
+            if (parseExpectedMoves(settings.inputPath, test)) {
+                tests.push_back(std::move(test));
+            }
+        }
+
+        std::vector<TestResult> results(tests.size());
+        OrderedWriter writer(std::cout);
+
+        auto start = std::chrono::steady_clock::now();
+        searchInParallel(tests.size(), settings.batch, [&](ai::AlphaBetaSearcher& searcher, size_t i) {
+            const TestPosition& test = tests[i];
+            TestResult& result = results[i];
+
+            ai::SearchSettings searchSettings;
+            if (settings.depth > 0) {
+                searchSettings.maxDepth = settings.depth;
+            }
+            searchSettings.maxNodes = settings.nodes;
+            if (settings.timeMs > 0) {
+                searchSettings.ourTimeControl = TimeControl(settings.timeMs, 0, TC_MOVETIME);
+                searchSettings.moveOverhead   = 0;
+            }
+
+            // Remember when the expected move was first found in the current streak
+            // of iterations, and stop once it survived enough of them.
+            int streak = 0;
+            searchSettings.onDepthFinish = [&](const ai::SearchResults& res) {
+                if (!test.isCorrect(res.bestMove)) {
+                    streak = 0;
+                    return;
+                }
+                if (streak == 0) {
+                    result.solveTime  = res.searchTime;
+                    result.solveNodes = res.visitedNodes;
+                    result.solveDepth = res.depth;
+                }
+                if (++streak >= settings.stableIterations) {
+                    searcher.stop();
+                }
+            };
+
+            ai::SearchResults searchResults = searcher.search(test.position->record.position, searchSettings);
+            result.playedMove = searchResults.bestMove;
+            result.solved     = test.isCorrect(searchResults.bestMove);
+            if (result.solved && streak == 0) {
+                // The move changed after the last finished iteration.
+                result.solveTime  = searchResults.searchTime;
+                result.solveNodes = searchResults.visitedNodes;
+                result.solveDepth = searchResults.depth;
+            }
+
+            writer.write(i, formatResult(test, result));
+        });
+        auto end = std::chrono::steady_clock::now();
+        i64 elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+        size_t solved = 0;
+        ui64 totalSolveTime = 0;
+        ui64 totalSolveNodes = 0;
+        for (const TestResult& result: results) {
+            if (result.solved) {
+                solved++;
+                totalSolveTime  += result.solveTime;
+                totalSolveNodes += result.solveNodes;
+            }
+        }
+
+        std::cout << std::endl;
+        std::cout << "Solved " << solved << " of " << tests.size() << " positions";
+        if (!tests.empty()) {
+            std::cout << " (" << std::fixed << std::setprecision(1)
+                      << 100.0 * static_cast<double>(solved) / static_cast<double>(tests.size()) << "%)";
+        }
+        std::cout << "." << std::endl;
+        if (solved > 0) {
+            std::cout << "Average solve time: " << totalSolveTime / solved << " ms" << std::endl;
+            std::cout << "Average nodes to solve: " << totalSolveNodes / solved << std::endl;
+        }
+        std::cout << "Total time: " << elapsed << " ms" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+}
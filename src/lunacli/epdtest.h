@@ -0,0 +1,15 @@
+#ifndef LUNA_EPDTEST_H
+#define LUNA_EPDTEST_H
+
+namespace lunachess {
+
+/**
+ * Entry point of 'luna epdtest', which runs a test suite of EPD positions with
+ * 'bm' (best move) and/or 'am' (avoid move) operations and reports how many of them
+ * were solved and how fast. 'argv[0]' is expected to be "epdtest".
+ */
+int epdTestMain(int argc, char* argv[]);
+
+}
+
+#endif // LUNA_EPDTEST_H
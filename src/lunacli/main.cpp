@@ -1,15 +1,26 @@
 #include <iostream>
+#include <string_view>
 
 #include <lunachess.h>
 
 #include <rang/rang.h>
 
+#include "analyze.h"
+#include "epdtest.h"
 #include "uci.h"
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
         lunachess::initializeEverything();
 
+        // Batch modes are selected with a subcommand, everything else runs UCI.
+        if (argc > 1 && std::string_view(argv[1]) == "analyze") {
+            return lunachess::analyzeMain(argc - 1, argv + 1);
+        }
+        if (argc > 1 && std::string_view(argv[1]) == "epdtest") {
+            return lunachess::epdTestMain(argc - 1, argv + 1);
+        }
+
         std::ios_base::sync_with_stdio(false);
         std::cin.tie();
         std::cout << std::boolalpha;
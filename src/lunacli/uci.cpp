@@ -6,11 +6,15 @@
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include <lunachess.h>
 
+#include "ucioutput.h"
+
 namespace lunachess {
 
 using CommandArgs = std::vector<std::string_view>;
@@ -22,15 +26,24 @@ enum UCIState {
 };
 
 struct UCIContext {
+    // Output, declared first so that it is destroyed after everything that writes to it.
+    UCIOutput output { std::cout };
+
     // Chess state
     Position pos = Position::getInitialPosition();
 
     // UCI settings
     bool debugMode = false;
     int multiPvCount = 1;
+    i64 moveOverhead = ai::TimeManager::DEFAULT_MOVE_OVERHEAD;
+    size_t hashSizeMB = ai::TranspositionTable::DEFAULT_SIZE_MB;
+
+    /** File backing the transposition table, set with the HashFile option. Empty if none. */
+    std::string hashFile;
 
-    // Internal state
-    UCIState state = IDLE;
+    // Internal state, written by both the command and the search thread.
+    std::atomic<UCIState> state { IDLE };
+    bool pondering = false;
 
     // HCE settings
     std::shared_ptr<ai::HandCraftedEvaluator> hce = std::make_shared<ai::HandCraftedEvaluator>();
@@ -40,7 +53,15 @@ struct UCIContext {
     std::unique_ptr<std::thread> workThread = nullptr;
     ai::AlphaBetaSearcher searcher = ai::AlphaBetaSearcher(hce);
     bool useOpBook = false;
+
+    /** Book set with the BookFile option. If no file is open, the default book is used. */
+    OpeningBook fileBook;
+
     bool trace = false;
+    ai::SearchTraceFilter traceFilter;
+
+    /** Root move whose subtree is traced. Only parsed on 'go', since it depends on the position. */
+    std::string traceRootMove;
 };
 
 using UCICommandFunction = std::function<void(UCIContext&, const CommandArgs&)>;
@@ -64,6 +85,25 @@ struct Command {
     ~Command() = default;
 };
 
+/**
+ * Writes a line from the command thread.
+ */
+static void postLine(UCIContext& ctx, std::string line) {
+    ctx.output.post(UCIOutput::PRODUCER_COMMANDS, std::move(line));
+}
+
+/**
+ * Writes the text of 'stream' from the command thread. Text spanning several
+ * lines (boards, tables) is posted at once, so search output never splits it.
+ */
+static void postText(UCIContext& ctx, const std::ostringstream& stream) {
+    std::string text = stream.str();
+    if (!text.empty() && text.back() == '\n') {
+        text.pop_back();
+    }
+    postLine(ctx, std::move(text));
+}
+
 static void errorWrongArg(std::string_view cmdName, std::string_view wrongArg) {
     std::cerr << "Unexpected argument '" << wrongArg << "' for command '" << cmdName << "'." << std::endl;
 }
@@ -75,34 +115,48 @@ static void errorWrongArg(std::string_view cmdName, std::string_view wrongArg) {
 static void displayOption(UCIContext& ctx, std::string_view optName,
                           std::string_view optType, std::string_view defaultVal = "",
                           std::string_view minVal = "", std::string_view maxVal = "") {
-    std::cout << "option name " << optName << " type " << optType;
+    std::ostringstream line;
+    line << "option name " << optName << " type " << optType;
 
     if (!defaultVal.empty()) {
-        std::cout << " default " << defaultVal;
+        line << " default " << defaultVal;
     }
     if (!minVal.empty()) {
-        std::cout << " min " << minVal;
+        line << " min " << minVal;
     }
     if (!maxVal.empty()) {
-        std::cout << " max " << maxVal;
+        line << " max " << maxVal;
     }
 
-    std::cout << std::endl;
+    postLine(ctx, line.str());
 }
 
 static void cmdUci(UCIContext& ctx, const CommandArgs& args) {
-    std::cout << "id name Luna " << LUNA_VERSION_NAME << std::endl;
-    std::cout << "id author Thomas Mergener" << std::endl;
+    postLine(ctx, std::string("id name Luna ") + LUNA_VERSION_NAME);
+    postLine(ctx, "id author Thomas Mergener");
     displayOption(ctx, "MultiPV", "spin", "1", "1", "500");
     displayOption(ctx, "Hash", "spin", strutils::toString(ai::TranspositionTable::DEFAULT_SIZE_MB), "1", "1048576");
     displayOption(ctx, "Contempt", "spin", strutils::toString(lunachess::ai::HandCraftedEvaluator::DEFAULT_CONTEMPT), strutils::toString(INT32_MIN), strutils::toString(INT32_MAX));
+    displayOption(ctx, "HashFile", "string", "<empty>");
     displayOption(ctx, "UseOwnBook", "check", "false");
+    displayOption(ctx, "BookFile", "string", "<empty>");
+    displayOption(ctx, "BitbasePath", "string", "<empty>");
+    displayOption(ctx, "Ponder", "check", "false");
+    displayOption(ctx, "MoveOverhead", "spin", strutils::toString(ai::TimeManager::DEFAULT_MOVE_OVERHEAD), "0", "5000");
     displayOption(ctx, "TraceSearchTree", "check", "false");
+    displayOption(ctx, "TracePVNodesOnly", "check", "false");
+    displayOption(ctx, "TraceRootMove", "string", "<empty>");
+    displayOption(ctx, "TraceMaxPly", "spin", "0", "0", "255");
+    displayOption(ctx, "TraceSampleRate", "spin", "1", "1", "1000000");
 
-    std::cout << "uciok" << std::endl;
+    postLine(ctx, "uciok");
 }
 
 static void cmdQuit(UCIContext& ctx, const CommandArgs& args) {
+    if (ctx.pondering) {
+        // A ponder search only returns after a ponderhit or stop.
+        ctx.searcher.stop();
+    }
     if (ctx.workThread != nullptr) {
         ctx.workThread->join();
     }
@@ -122,7 +176,16 @@ static void cmdDebug(UCIContext& ctx, const CommandArgs& args) {
 }
 
 static void cmdIsready(UCIContext& ctx, const CommandArgs& args) {
-    std::cout << "readyok" << std::endl;
+    postLine(ctx, "readyok");
+}
+
+/**
+ * Reports the size of the transposition table and the memory backing it.
+ */
+static void reportHashMemory(UCIContext& ctx) {
+    const ai::TranspositionTable& tt = ctx.searcher.getTT();
+    postLine(ctx, "info string Hash " + strutils::toString(ctx.hashSizeMB) + " MB, "
+                  + std::string(ai::TranspositionTable::getPageModeName(tt.getPageMode())));
 }
 
 static void processOption(UCIContext& ctx, std::string_view option, std::string_view value) {
@@ -141,7 +204,33 @@ static void processOption(UCIContext& ctx, std::string_view option, std::string_
     else if (option == "Hash") {
         size_t size;
         if (strutils::tryParseInteger(value, size)) {
-            ctx.searcher.getTT().resize(size * 1024 * 1024);
+            ctx.hashSizeMB = size;
+            if (!ctx.hashFile.empty() && !ctx.searcher.getTT().mapFile(ctx.hashFile, size * 1024 * 1024)) {
+                postLine(ctx, "info string Could not map the transposition table to '" + ctx.hashFile +
+                              "', using memory instead.");
+                ctx.hashFile.clear();
+            }
+            if (ctx.hashFile.empty()) {
+                ctx.searcher.getTT().resize(size * 1024 * 1024);
+            }
+            reportHashMemory(ctx);
+        }
+    }
+    else if (option == "HashFile") {
+        if (value == "<empty>" || value.empty()) {
+            ctx.hashFile.clear();
+            if (ctx.searcher.getTT().isFileBacked()) {
+                ctx.searcher.getTT().resize(ctx.hashSizeMB * 1024 * 1024);
+                reportHashMemory(ctx);
+            }
+        }
+        else if (ctx.searcher.getTT().mapFile(std::filesystem::path(value), ctx.hashSizeMB * 1024 * 1024)) {
+            ctx.hashFile = value;
+            reportHashMemory(ctx);
+        }
+        else {
+            postLine(ctx, "info string Could not map the transposition table to '" + std::string(value) +
+                          "'. It must be a new or empty file, or a hash file written by Luna.");
         }
     }
     else if (option == "UseOwnBook") {
@@ -155,6 +244,34 @@ static void processOption(UCIContext& ctx, std::string_view option, std::string_
             std::cerr << "Invalid value '" << value << "'. Expected 'true' or 'false'." << std::endl;
         }
     }
+    else if (option == "BookFile") {
+        if (value == "<empty>" || value.empty()) {
+            ctx.fileBook.closeFile();
+        }
+        else if (!ctx.fileBook.openFile(std::filesystem::path(value))) {
+            std::cerr << "Could not open the Polyglot book at '" << value << "'." << std::endl;
+        }
+    }
+    else if (option == "BitbasePath") {
+        if (value == "<empty>" || value.empty()) {
+            bitbase::unloadBitbases();
+        }
+        else if (bitbase::loadBitbases(std::filesystem::path(value)) == 0) {
+            std::cerr << "Could not find any bitbase at '" << value << "'." << std::endl;
+        }
+    }
+    else if (option == "MoveOverhead") {
+        i64 overhead;
+        if (strutils::tryParseInteger(value, overhead) && overhead >= 0) {
+            ctx.moveOverhead = overhead;
+        }
+    }
+    else if (option == "Ponder") {
+        // Nothing to configure, the GUI tells us when to ponder with 'go ponder'.
+        if (value != "true" && value != "false") {
+            std::cerr << "Invalid value '" << value << "'. Expected 'true' or 'false'." << std::endl;
+        }
+    }
     else if (option == "TraceSearchTree") {
         if (value == "true") {
             ctx.trace = true;
@@ -166,6 +283,38 @@ static void processOption(UCIContext& ctx, std::string_view option, std::string_
             std::cerr << "Invalid value '" << value << "'. Expected 'true' or 'false'." << std::endl;
         }
     }
+    else if (option == "TracePVNodesOnly") {
+        if (value == "true") {
+            ctx.traceFilter.pvNodesOnly = true;
+        }
+        else if (value == "false") {
+            ctx.traceFilter.pvNodesOnly = false;
+        }
+        else {
+            std::cerr << "Invalid value '" << value << "'. Expected 'true' or 'false'." << std::endl;
+        }
+    }
+    else if (option == "TraceRootMove") {
+        ctx.traceRootMove = value == "<empty>" ? "" : std::string(value);
+    }
+    else if (option == "TraceMaxPly") {
+        int maxPly;
+        if (strutils::tryParseInteger(value, maxPly) && maxPly >= 0) {
+            ctx.traceFilter.maxPly = maxPly;
+        }
+        else {
+            std::cerr << "Invalid value '" << value << "'. Expected a non-negative integer." << std::endl;
+        }
+    }
+    else if (option == "TraceSampleRate") {
+        int sampleRate;
+        if (strutils::tryParseInteger(value, sampleRate) && sampleRate >= 1) {
+            ctx.traceFilter.sampleRate = sampleRate;
+        }
+        else {
+            std::cerr << "Invalid value '" << value << "'. Expected a positive integer." << std::endl;
+        }
+    }
 }
 
 static void cmdSetoption(UCIContext& ctx, const CommandArgs& args) {
@@ -303,97 +452,96 @@ static bool readTime(std::string_view sv, int& dest) {
 }
 
 static void goSearch(UCIContext& ctx, const Position& pos, ai::SearchSettings& searchSettings) {
-    if (ctx.useOpBook) {
+    if (ctx.useOpBook && !searchSettings.ponder) {
         // Use opening book if position is covered in it
-        const auto& book = OpeningBook::getDefault();
-        Move move = book.getRandomMoveForPosition(pos);
+        Move move = ctx.fileBook.isFileOpen()
+                    ? ctx.fileBook.getRandomMoveForPosition(pos)
+                    : OpeningBook::getDefault().getRandomMoveForPosition(pos);
         if (move != MOVE_INVALID) {
             // We found a book move
-            std::cout << "bestmove " << move << std::endl;
             ctx.state = IDLE;
+            postLine(ctx, "bestmove " + strutils::toString(move));
             return;
         }
     }
 
+    // Search output is queued from the search thread and written by the output
+    // thread, so a slow reader never holds the search up. Info lines are dropped
+    // rather than waited for if the reader is that far behind, newer ones follow.
     TimePoint startTime = Clock::now();
     searchSettings.onPvFinish = [startTime, &ctx](const ai::SearchResults& res, int pv) {
         const ai::SearchedVariation& var = res.searchedVariations[pv];
+        std::ostringstream line;
 
-        std::cout << "info depth " << res.depth;
+        line << "info depth " << res.depth;
 
-        std::cout << " seldepth " << res.selDepth;
+        line << " seldepth " << res.selDepth;
 
-        std::cout << " multipv " << pv + 1;
+        line << " multipv " << pv + 1;
 
         // Print score
         if (std::abs(var.score) < ai::FORCED_MATE_THRESHOLD) {
-            std::cout << " score cp " << var.score / 10;
+            line << " score cp " << var.score / 10;
         }
         else {
             // Forced checkmate found
             int sign        = var.score < 0 ? -1 : 1;
             int mateScore   = ai::MATE_SCORE;
             int pliesToMate = mateScore - std::abs(var.score);
-            std::cout << " score mate " << sign * (pliesToMate + 1) / 2;
+            line << " score mate " << sign * (pliesToMate + 1) / 2;
         }
 
         // Is it lowerbound, upperbound, or exact (do nothing)?
         if (var.type == ai::TranspositionTable::LOWERBOUND) {
-            std::cout << " lowerbound";
+            line << " lowerbound";
         }
         else if (var.type == ai::TranspositionTable::UPPERBOUND) {
-            std::cout << " upperbound";
+            line << " upperbound";
         }
 
         // Show the line itself
-        std::cout << " pv";
+        line << " pv";
         for (Move m: var.moves) {
-            std::cout << " " << m;
+            line << " " << m;
         }
 
         const auto& tt = ctx.searcher.getTT();
         size_t hashFull = (tt.getCount() * 1000) / tt.getCapacity();
 
-        std::cout << " hashfull " << hashFull;
-        std::cout << " nodes "    << res.visitedNodes;
-        std::cout << " nps "      << res.getNPS();
-        std::cout << " time "     << deltaMs(Clock::now(), startTime);
-        std::cout << std::endl;
+        line << " hashfull " << hashFull;
+        line << " nodes "    << res.visitedNodes;
+        line << " nps "      << res.getNPS();
+        line << " time "     << deltaMs(Clock::now(), startTime);
+        ctx.output.tryPost(UCIOutput::PRODUCER_SEARCH, line.str());
     };
 
-    searchSettings.onNewMove = [](const ai::SearchResults& res, Move move, int moveNum) {
-        std::cout << "info depth " << res.depth << " currmove " << move << " currmovenumber " << moveNum << std::endl;
+    searchSettings.onNewMove = [&ctx](const ai::SearchResults& res, Move move, int moveNum) {
+        std::ostringstream line;
+        line << "info depth " << res.depth << " currmove " << move << " currmovenumber " << moveNum;
+        ctx.output.tryPost(UCIOutput::PRODUCER_SEARCH, line.str());
     };
 
     ctx.workThread = std::make_unique<std::thread>([&ctx, searchSettings, pos]() {
         try {
             ai::SearchResults res = ctx.searcher.search(pos, searchSettings);
-            std::cout << "bestmove " << res.bestMove;
+
+            std::ostringstream line;
+            line << "bestmove " << res.bestMove;
             Move ponderMove = res.getPonderMove();
             if (ponderMove != MOVE_INVALID) {
-                std::cout << " ponder " << ponderMove;
+                line << " ponder " << ponderMove;
             }
-            std::cout << std::endl;
 
-            if (res.traceTree != nullptr && ctx.trace) {
-                try {
-                    namespace fs = std::filesystem;
-                    std::cout << "Saving traced tree..." << std::endl;
-
-                    fs::path outPath = "trace_depth-" + strutils::toString(res.depth) + ".json";
-                    std::ofstream traceResult(outPath);
-                    traceResult.exceptions(std::ios::badbit | std::ios::failbit);
-
-                    traceResult << *res.traceTree << std::endl;
+            // The GUI may send 'go' as soon as it reads the best move, so we
+            // must be idle before reporting it.
+            ctx.state = IDLE;
+            ctx.output.post(UCIOutput::PRODUCER_SEARCH, line.str());
 
-                    std::cout << "Saved traced tree succesfully to " << fs::absolute(outPath) << "." << std::endl;
-                }
-                catch (const std::exception& e) {
-                    std::cerr << "Failed to save traced tree: " << e.what() << std::endl;
-                }
+            if (searchSettings.trace) {
+                ctx.output.post(UCIOutput::PRODUCER_SEARCH,
+                                "Saved search trace to " + std::filesystem::absolute(searchSettings.traceFile).string()
+                                + ". Use lunatrace to convert it to JSON.");
             }
-
-            ctx.state = IDLE;
         }
         catch (const std::exception& e) {
             std::cerr << "Unhandled exception during search: " << std::endl
@@ -404,7 +552,8 @@ static void goSearch(UCIContext& ctx, const Position& pos, ai::SearchSettings& s
 }
 
 static void cmdGo(UCIContext& ctx, const CommandArgs& args) {
-    if (ctx.state != IDLE) {
+    UCIState expected = IDLE;
+    if (!ctx.state.compare_exchange_strong(expected, BUSY)) {
         std::cerr << "Cannot call go while a search is currently running. Call 'stop' first." << std::endl;
         return;
     }
@@ -414,7 +563,6 @@ static void cmdGo(UCIContext& ctx, const CommandArgs& args) {
     if (ctx.workThread != nullptr) {
         ctx.workThread->join();
     }
-    ctx.state = BUSY;
 
     TimeControl timeControl[CL_COUNT];
 
@@ -447,6 +595,28 @@ static void cmdGo(UCIContext& ctx, const CommandArgs& args) {
                 std::cerr << "Unexpected depth value '" << args[i] << "'." << std::endl;
             }
         }
+        else if (arg == "nodes") {
+            // User wants to limit the number of nodes searched
+            ui64 nodes;
+            bool succ = strutils::tryParseInteger(args[++i], nodes);
+            if (succ && nodes >= 1) {
+                searchSettings.maxNodes = nodes;
+            }
+            else {
+                std::cerr << "Unexpected nodes value '" << args[i] << "'." << std::endl;
+            }
+        }
+        else if (arg == "mate") {
+            // User wants a mate in at most the given number of moves
+            int mateIn;
+            bool succ = strutils::tryParseInteger(args[++i], mateIn);
+            if (succ && mateIn >= 1) {
+                searchSettings.mateIn = mateIn;
+            }
+            else {
+                std::cerr << "Unexpected mate value '" << args[i] << "'." << std::endl;
+            }
+        }
         else if (arg == "wtime") {
             // Defines white color base time
             readTime(args[++i], timeControl[CL_WHITE].time);
@@ -475,6 +645,11 @@ static void cmdGo(UCIContext& ctx, const CommandArgs& args) {
         else if (arg == "infinite") {
             timeControl[pos.getColorToMove()].mode = TC_INFINITE;
         }
+        else if (arg == "ponder") {
+            // Search the position on the opponent's time. The time controls
+            // only start counting after 'ponderhit'.
+            searchSettings.ponder = true;
+        }
     }
 
     // Check if searchmoves option was used
@@ -491,7 +666,19 @@ static void cmdGo(UCIContext& ctx, const CommandArgs& args) {
     searchSettings.ourTimeControl = timeControl[pos.getColorToMove()];
     searchSettings.theirTimeControl = timeControl[getOppositeColor(pos.getColorToMove())];
     searchSettings.multiPvCount = ctx.multiPvCount;
+    searchSettings.moveOverhead = ctx.moveOverhead;
     searchSettings.trace = ctx.trace;
+    searchSettings.traceFilter = ctx.traceFilter;
+    if (ctx.trace && !ctx.traceRootMove.empty()) {
+        Move rootMove = Move(pos, ctx.traceRootMove);
+        if (rootMove != MOVE_INVALID && pos.isMovePseudoLegal(rootMove) && pos.isMoveLegal(rootMove)) {
+            searchSettings.traceFilter.rootMove = rootMove;
+        }
+        else {
+            std::cerr << "Trace root move '" << ctx.traceRootMove << "' is not legal in this position, tracing all root moves." << std::endl;
+        }
+    }
+    ctx.pondering = searchSettings.ponder;
 
     goSearch(ctx, pos, searchSettings);
 }
@@ -518,13 +705,15 @@ static void cmdLunaPerft(UCIContext& ctx, const CommandArgs& args) {
 
     auto before = Clock::now();
 
-    ui64 res = perft(ctx.pos, depth, true, pseudoLegal, algNotation);
+    std::ostringstream out;
+    ui64 res = perft(ctx.pos, depth, true, pseudoLegal, algNotation, out);
 
     i64 elapsed = deltaMs(Clock::now(), before);
 
-    std::cout << "Nodes: " << res << std::endl;
-    std::cout << "Time: " << elapsed << "ms" << std::endl;
-    std::cout << "NPS: " << ui64(double(res) / double(elapsed + 1) * 1000) << std::endl;
+    out << "Nodes: " << res << std::endl;
+    out << "Time: " << elapsed << "ms" << std::endl;
+    out << "NPS: " << ui64(double(res) / double(elapsed + 1) * 1000) << std::endl;
+    postText(ctx, out);
 }
 
 static void cmdDoMoves(UCIContext& ctx, const CommandArgs& args) {
@@ -558,11 +747,21 @@ static void cmdTakeback(UCIContext& ctx, const CommandArgs& args) {
         ctx.pos.undoMove();
     }
 
-    std::cout << ctx.pos << std::endl;
+    std::ostringstream out;
+    out << ctx.pos;
+    postText(ctx, out);
 }
 
 static void stopSearch(UCIContext& ctx) {
     ctx.searcher.stop();
+    ctx.pondering = false;
+
+    // Wait for the best move to be reported, so that a 'go' right after
+    // 'stop' (e.g. after a ponder miss) finds us idle.
+    if (ctx.workThread != nullptr) {
+        ctx.workThread->join();
+        ctx.workThread = nullptr;
+    }
 }
 
 static void cmdStop(UCIContext& ctx, const CommandArgs& args) {
@@ -575,12 +774,24 @@ static void cmdStop(UCIContext& ctx, const CommandArgs& args) {
     stopSearch(ctx);
 }
 
+static void cmdPonderhit(UCIContext& ctx, const CommandArgs& args) {
+    if (ctx.state != BUSY || !ctx.pondering) {
+        std::cerr << "Not pondering at the moment." << std::endl;
+        return;
+    }
+
+    ctx.pondering = false;
+    ctx.searcher.ponderhit();
+}
+
 static void cmdGetpos(UCIContext& ctx, const CommandArgs& args) {
-    std::cout << ctx.pos << std::endl;
+    std::ostringstream out;
+    out << ctx.pos;
+    postText(ctx, out);
 }
 
 static void cmdGetfen(UCIContext& ctx, const CommandArgs& args) {
-    std::cout << ctx.pos.toFen() << std::endl;
+    postLine(ctx, ctx.pos.toFen());
 }
 
 static int doEval(UCIContext& ctx, int depth) {
@@ -638,11 +849,88 @@ static void cmdEval(UCIContext& ctx, const CommandArgs& args) {
         pst.valueAt(s, CL_WHITE) = delta;
     }
 
-    std::cout << pst << std::endl;
-    std::cout << "Total evaluation: "
+    std::ostringstream out;
+    out << pst << std::endl;
+    out << "Total evaluation: "
+        << std::setprecision(2)
+        << double(currentEval) / 1000;
+    postText(ctx, out);
+}
+
+static void cmdEvaltrace(UCIContext& ctx, const CommandArgs& args) {
+    ai::HCETrace trace;
+    ctx.hce->setPosition(ctx.pos);
+    int eval = ctx.hce->evaluate(trace);
+
+    // Display everything in white's perspective, like 'eval'.
+    int sign = ctx.pos.getColorToMove() == CL_WHITE ? 1 : -1;
+    std::ostringstream out;
+    if (!trace.isLinear()) {
+        out << "Position is a known endgame, its evaluation is not based on the weights." << std::endl;
+        out << "Total evaluation: " << std::setprecision(2) << double(eval * sign) / 1000;
+        postText(ctx, out);
+        return;
+    }
+
+    // Group terms by their evaluation feature, which is the first
+    // component of the weight name (ex: "/material/1/mg" -> "material").
+    std::map<std::string, int> featureScores;
+    const ai::HCEWeightTable& weights = ctx.hce->getWeights();
+
+    out << std::left;
+    for (const auto& term: trace.getTerms()) {
+        const std::string& name = ai::getHCEWeightSlotName(term.mgSlot);
+        int score = trace.getTermScore(term, weights) * sign;
+
+        std::string displayName = name;
+        if (term.isTapered()) {
+            displayName += " " + ai::getHCEWeightSlotName(term.egSlot);
+        }
+
+        out << std::setw(64) << displayName
+            << " white " << std::setw(4) << term.count[CL_WHITE]
+            << " black " << std::setw(4) << term.count[CL_BLACK]
+            << " score " << score << std::endl;
+
+        std::string feature = name.substr(1, name.find('/', 1) - 1);
+        featureScores[feature] += score;
+    }
+
+    out << std::endl;
+    for (const auto& [feature, score]: featureScores) {
+        out << std::setw(32) << feature << score << std::endl;
+    }
+    out << std::right;
+
+    out << std::endl << "Total evaluation: "
         << std::setprecision(2)
-        << double(currentEval) / 1000
-        << std::endl;
+        << double(eval * sign) / 1000;
+    postText(ctx, out);
+}
+
+static void cmdSearchstats(UCIContext& ctx, const CommandArgs& args) {
+    if (ctx.state != IDLE) {
+        std::cerr << "Cannot read search statistics while a search is running. Call 'stop' first." << std::endl;
+        return;
+    }
+    if (args.size() > 1 || (args.size() == 1 && args[0] != "json")) {
+        errorWrongArg("searchstats", args[0]);
+        return;
+    }
+
+    if (!ai::SearchStats::ENABLED) {
+        std::cerr << "Search statistics are disabled in this build. Build with LUNA_SEARCH_STATS to enable them." << std::endl;
+    }
+
+    const ai::SearchStats& stats = ctx.searcher.getStats();
+    if (args.size() == 1) {
+        postLine(ctx, nlohmann::json(stats).dump());
+    }
+    else {
+        std::ostringstream out;
+        out << stats;
+        postText(ctx, out);
+    }
 }
 
 static void cmdLoadweights(UCIContext& ctx, const CommandArgs& args) {
@@ -660,7 +948,9 @@ static void cmdLoadweights(UCIContext& ctx, const CommandArgs& args) {
         }
         ctx.hceWeights = weights;
 
-        std::cout << "Succesfully loaded weights from " << fs::absolute(path) << std::endl;
+        std::ostringstream out;
+        out << "Succesfully loaded weights from " << fs::absolute(path);
+        postText(ctx, out);
     }
     catch (const std::exception& e) {
         std::cerr << "Failed to load weights from " << fs::absolute(path) << ":\n" << e.what() << std::endl;
@@ -674,13 +964,60 @@ static void cmdSaveweights(UCIContext& ctx, const CommandArgs& args) {
     try {
         nlohmann::json weightsJson = ctx.hce->getWeights();
         utils::writeToFile(path, weightsJson.dump(2));
-        std::cout << "Succesfully saved weights to " << fs::absolute(path) << std::endl;
+        std::ostringstream out;
+        out << "Succesfully saved weights to " << fs::absolute(path);
+        postText(ctx, out);
     }
     catch (const std::exception& e) {
         std::cerr << "Failed to saved weights to " << fs::absolute(path) << ":\n" << e.what() << std::endl;
     }
 }
 
+static void cmdSavehash(UCIContext& ctx, const CommandArgs& args) {
+    namespace fs = std::filesystem;
+
+    if (ctx.state != IDLE) {
+        std::cerr << "Cannot save the hash while a search is running. Call 'stop' first." << std::endl;
+        return;
+    }
+
+    fs::path path = args[0];
+    if (ctx.searcher.getTT().save(path)) {
+        std::ostringstream out;
+        out << "Succesfully saved hash to " << fs::absolute(path);
+        postText(ctx, out);
+    }
+    else {
+        std::cerr << "Failed to save hash to " << fs::absolute(path) << std::endl;
+    }
+}
+
+static void cmdLoadhash(UCIContext& ctx, const CommandArgs& args) {
+    namespace fs = std::filesystem;
+
+    if (ctx.state != IDLE) {
+        std::cerr << "Cannot load a hash while a search is running. Call 'stop' first." << std::endl;
+        return;
+    }
+
+    fs::path path = args[0];
+    ai::TranspositionTable& tt = ctx.searcher.getTT();
+    if (tt.load(path)) {
+        if (!tt.isFileBacked()) {
+            // The loaded table has a size of its own and replaced the mapping, if any.
+            ctx.hashFile.clear();
+        }
+        // Rounded, since the capacity is a whole number of buckets rather than megabytes.
+        ctx.hashSizeMB = (tt.getSizeBytes() + 512 * 1024) / (1024 * 1024);
+        std::ostringstream out;
+        out << "Succesfully loaded " << tt.getCount() << " hash entries from " << fs::absolute(path);
+        postText(ctx, out);
+    }
+    else {
+        std::cerr << "Failed to load hash from " << fs::absolute(path) << std::endl;
+    }
+}
+
 #ifndef NDEBUG
 static void cmdAttacks(UCIContext& ctx, const CommandArgs& args) {
     Color c = ctx.pos.getColorToMove();
@@ -723,30 +1060,36 @@ static void cmdAttacks(UCIContext& ctx, const CommandArgs& args) {
         }
     }
 
-    std::cout << ctx.pos.getAttacks(c, pt) << std::endl;
+    std::ostringstream out;
+    out << ctx.pos.getAttacks(c, pt);
+    postText(ctx, out);
 }
 
 static void cmdPins(UCIContext& ctx, const CommandArgs& args) {
     Bitboard pinned = ctx.pos.getPinned();
-    std::cout << "Pinned pieces:\n" << pinned << std::endl;
+    std::ostringstream out;
+    out << "Pinned pieces:\n" << pinned << std::endl;
 
     for (auto s : pinned) {
         Piece pinnedPiece = ctx.pos.getPieceAt(s);
         Square pinnerSqr = ctx.pos.getPinner(s);
         Piece pinnerPiece = ctx.pos.getPieceAt(pinnerSqr);
 
-        std::cout << getPieceTypeName(pinnedPiece.getType()) << " on " << getSquareName(s)
-                  << " is pinned by a " << getPieceTypeName(pinnerPiece.getType()) << " on " << getSquareName(pinnerSqr)
-                  << std::endl;
+        out << getPieceTypeName(pinnedPiece.getType()) << " on " << getSquareName(s)
+            << " is pinned by a " << getPieceTypeName(pinnerPiece.getType()) << " on " << getSquareName(pinnerSqr)
+            << std::endl;
     }
+    postText(ctx, out);
 }
 
 static void cmdBetween(UCIContext& ctx, const CommandArgs& args) {
     Square a = getSquare(args[0]);
     Square b = getSquare(args[1]);
 
-    std::cout << "Between " << getSquareName(a) << " and " << getSquareName(b) << ":" << std::endl;
-    std::cout << bbs::getSquaresBetween(a, b) << std::endl;
+    std::ostringstream out;
+    out << "Between " << getSquareName(a) << " and " << getSquareName(b) << ":" << std::endl;
+    out << bbs::getSquaresBetween(a, b);
+    postText(ctx, out);
 }
 #endif
 
@@ -764,6 +1107,7 @@ static std::unordered_map<std::string, Command> generateCommands() {
     cmds["position"] = Command(cmdPosition, 1, false);
     cmds["go"] = Command(cmdGo, 0, false);
     cmds["stop"] = Command(cmdStop, 0);
+    cmds["ponderhit"] = Command(cmdPonderhit, 0);
 
     // Luna commands:
     cmds["domoves"] = Command(cmdDoMoves, 1, false);
@@ -772,9 +1116,14 @@ static std::unordered_map<std::string, Command> generateCommands() {
     cmds["perft"] = Command(cmdLunaPerft, 1, false);
     cmds["takeback"] = Command(cmdTakeback, 0, false);
     cmds["eval"] = Command(cmdEval, 0, false);
+    cmds["evaltrace"] = Command(cmdEvaltrace, 0);
+    cmds["searchstats"] = Command(cmdSearchstats, 0, false);
     cmds["saveweights"] = Command(cmdSaveweights, 1);
     cmds["loadweights"] = Command(cmdLoadweights, 1);
 
+    cmds["savehash"] = Command(cmdSavehash, 1);
+    cmds["loadhash"] = Command(cmdLoadhash, 1);
+
 #ifndef NDEBUG
     // Debug commands
     cmds["db_between"] = Command(cmdBetween, 2);
@@ -843,6 +1192,10 @@ static void inputThreadMain(UCIContext& ctx) {
 int uciMain() {
     std::shared_ptr<UCIContext> ctx = std::make_shared<UCIContext>();
 
+    // Reading from cin would otherwise flush cout from the input thread while
+    // the search thread is writing to it.
+    std::cin.tie(nullptr);
+
     inputThreadMain(*ctx);
 
     return 0;
@@ -0,0 +1,107 @@
+#include "ucioutput.h"
+
+#include <chrono>
+
+namespace lunachess {
+
+UCIOutput::UCIOutput(std::ostream& stream)
+    : m_Stream(stream),
+      m_Queues { SpscQueue<Line>(QUEUE_CAPACITY), SpscQueue<Line>(QUEUE_CAPACITY) } {
+    m_Thread = std::thread([this]() { writerMain(); });
+}
+
+UCIOutput::~UCIOutput() {
+    m_Stopping = true;
+    {
+        std::unique_lock lock(m_Mutex);
+        m_WakeUp.notify_one();
+    }
+    m_Thread.join();
+}
+
+void UCIOutput::post(Producer producer, std::string line) {
+    Line l { m_NextSeq.fetch_add(1, std::memory_order_relaxed), std::move(line) };
+    while (!m_Queues[producer].tryPush(std::move(l))) {
+        // The writer is behind, it will make room eventually.
+        wakeUpWriter();
+        std::this_thread::yield();
+    }
+    wakeUpWriter();
+}
+
+bool UCIOutput::tryPost(Producer producer, std::string line) {
+    Line l { m_NextSeq.fetch_add(1, std::memory_order_relaxed), std::move(line) };
+    if (!m_Queues[producer].tryPush(std::move(l))) {
+        m_Dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    wakeUpWriter();
+    return true;
+}
+
+void UCIOutput::wakeUpWriter() {
+    // Pairs with the fence in writerMain: either we see the writer sleeping,
+    // or it sees our line before going to sleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_Sleeping.load(std::memory_order_relaxed)) {
+        std::unique_lock lock(m_Mutex);
+        m_WakeUp.notify_one();
+    }
+}
+
+bool UCIOutput::allQueuesEmpty() const {
+    for (const SpscQueue<Line>& queue: m_Queues) {
+        if (!queue.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void UCIOutput::writerMain() {
+    std::string buffer;
+
+    while (true) {
+        // Take every available line, oldest first across both queues.
+        while (true) {
+            Line* next = nullptr;
+            SpscQueue<Line>* nextQueue = nullptr;
+            for (SpscQueue<Line>& queue: m_Queues) {
+                Line* front = queue.front();
+                if (front != nullptr && (next == nullptr || front->seq < next->seq)) {
+                    next      = front;
+                    nextQueue = &queue;
+                }
+            }
+            if (next == nullptr) {
+                break;
+            }
+            buffer += next->text;
+            buffer += '\n';
+            nextQueue->pop();
+        }
+
+        if (!buffer.empty()) {
+            m_Stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            m_Stream.flush();
+            buffer.clear();
+        }
+
+        if (allQueuesEmpty()) {
+            if (m_Stopping) {
+                break;
+            }
+
+            std::unique_lock lock(m_Mutex);
+            m_Sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (allQueuesEmpty() && !m_Stopping) {
+                // The timeout is only a safety net, producers wake us up.
+                m_WakeUp.wait_for(lock, std::chrono::milliseconds(100));
+            }
+            m_Sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+}
+
+}
@@ -0,0 +1,95 @@
+#ifndef LUNA_UCIOUTPUT_H
+#define LUNA_UCIOUTPUT_H
+
+#include <lunachess.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace lunachess {
+
+/**
+ * Writes UCI lines to a stream from a dedicated thread, so that a slow reader
+ * (a busy GUI, a full pipe) never stalls the threads producing them.
+ *
+ * Lines are queued on one lock-free queue per producer: one for the search thread
+ * and one for the thread that handles commands. Each line gets a sequence number
+ * from an atomic counter, and the writer thread merges both queues by always taking
+ * the lowest numbered line at their fronts, writing every line available at once
+ * with a single flush.
+ *
+ * A line posted after a line of the other producer was queued is always written
+ * after it. Lines posted by both producers at the same time may be written in
+ * either order, and numbers of dropped lines are simply never seen.
+ */
+class UCIOutput {
+public:
+    enum Producer {
+        PRODUCER_COMMANDS,
+        PRODUCER_SEARCH,
+
+        PRODUCER_COUNT
+    };
+
+    /** Number of lines each producer may have waiting to be written. */
+    static constexpr size_t QUEUE_CAPACITY = 4096;
+
+    explicit UCIOutput(std::ostream& stream);
+
+    /**
+     * Writes the remaining lines and stops the writer thread.
+     */
+    ~UCIOutput();
+
+    /**
+     * Queues a line to be written. If the queue of the producer is full, waits
+     * for the writer to make room, so the line is never lost.
+     * Must only be called from the thread of the given producer.
+     */
+    void post(Producer producer, std::string line);
+
+    /**
+     * Queues a line to be written, unless the queue of the producer is full, in which
+     * case the line is dropped and false is returned. Meant for lines that are soon
+     * superseded, like search info.
+     * Must only be called from the thread of the given producer.
+     */
+    bool tryPost(Producer producer, std::string line);
+
+    /** Number of lines dropped by tryPost so far. */
+    inline ui64 getDroppedCount() const {
+        return m_Dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Line {
+        ui64 seq;
+        std::string text;
+    };
+
+    std::ostream& m_Stream;
+    SpscQueue<Line> m_Queues[PRODUCER_COUNT];
+    std::atomic<ui64> m_NextSeq { 0 };
+    std::atomic<ui64> m_Dropped { 0 };
+
+    // The writer sleeps on 'm_WakeUp' when there is nothing to write. Producers
+    // only take the lock to wake it up, never while it's busy writing.
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeUp;
+    std::atomic<bool> m_Sleeping { false };
+    std::atomic<bool> m_Stopping { false };
+
+    std::thread m_Thread;
+
+    void wakeUpWriter();
+    bool allQueuesEmpty() const;
+    void writerMain();
+};
+
+}
+
+#endif // LUNA_UCIOUTPUT_H
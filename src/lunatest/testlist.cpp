@@ -5,7 +5,21 @@
 
 #include "tests/movegen/perft.cpp"
 #include "tests/movegen/pseudolegal.cpp"
+#include "tests/movegen/san.cpp"
+#include "tests/packedposition.cpp"
+#include "tests/epd.cpp"
 #include "tests/endgame.cpp"
+#include "tests/bitbase.cpp"
+#include "tests/hce/hcetrace.cpp"
+#include "tests/hce/material.cpp"
+#include "tests/movecursor.cpp"
+#include "tests/search.cpp"
+#include "tests/timemanager.cpp"
+#include "tests/transpositiontable.cpp"
+#include "tests/polyglot.cpp"
+#include "tests/book.cpp"
+#include "tests/threadpool.cpp"
+#include "tests/spscqueue.cpp"
 #include "tests/staticanalysis/outposts.cpp"
 #include "tests/staticanalysis/backwardpawns.cpp"
 #include "tests/staticanalysis/blockingpawns.cpp"
@@ -20,12 +34,31 @@ void createTests() {
     testGroups = {
         { "perft",          perftTests },
         { "pseudoLegality", pseudoLegalityTests },
+        { "san",            sanTests },
+        { "packedPosition", packedPositionTests },
+        { "epd",            epdTests },
         { "outposts",       outpostTests },
         { "backwardPawns",  backwardPawnsTests },
         { "blockingPawns",  blockingPawnsTests },
         { "connectedPawns", connectedPawnsTests },
         { "passedPawns",    passedPawnsTests },
         { "endgame",        endgameTests },
+        { "hceTrace",       hceTraceTests },
+        { "material",       materialTests },
+        { "bitbase",        bitbaseTests },
+        { "moveCursor",     moveCursorTests },
+        { "nodeLimit",      nodeLimitTests },
+        { "timeManager",    timeManagerTests },
+        { "mateSearch",     mateSearchTests },
+        { "pvLength",       pvLengthTests },
+        { "searchTrace",    searchTraceTests },
+        { "traceFilter",    searchTraceFilterTests },
+        { "ttPersistence",  ttPersistenceTests },
+        { "ttClear",        ttClearTests },
+        { "parallelFor",    parallelForTests },
+        { "spscQueue",      spscQueueTests },
+        { "polyglot",       polyglotTests },
+        { "book",           bookTests },
     };
 }
 
@@ -0,0 +1,187 @@
+#include "../lunatest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace lunachess::tests {
+
+/**
+ * Solves KPK with the bitbase generator and checks every legal position against
+ * the KPK bitbase embedded at build time, with the pawn on each side.
+ */
+struct KPKBitbaseTest {
+    void operator()() {
+        bitbase::BitbaseGenerator generator;
+        for (std::string_view name: { "KPK", "KKP" }) {
+            bitbase::BitbaseMaterial material = bitbase::BitbaseMaterial::parse(name).value();
+            const std::vector<bitbase::WDL>& results = generator.generate(material);
+            const std::vector<Piece>& pieces = material.getPieces();
+            Color strongSide = pieces[1].getType() == PT_PAWN ? CL_WHITE : CL_BLACK;
+
+            size_t nChecked = 0;
+            for (size_t idx = 0; idx < material.getPositionCount(); ++idx) {
+                Square squares[bitbase::BitbaseMaterial::MAX_PIECES];
+                Color stm = material.decodeIndex(idx, squares);
+                if (squares[0] == squares[1] || squares[0] == squares[2] || squares[1] == squares[2]) {
+                    continue;
+                }
+
+                Position pos;
+                bool pawnOnBackRank = false;
+                for (size_t i = 0; i < pieces.size(); ++i) {
+                    pos.setPieceAt(squares[i], pieces[i]);
+                    pawnOnBackRank |= pieces[i].getType() == PT_PAWN &&
+                                      (getRank(squares[i]) == RANK_1 || getRank(squares[i]) == RANK_8);
+                }
+                pos.setColorToMove(stm);
+                if (pawnOnBackRank || pos.isSquareAttacked(pos.getKingSquare(getOppositeColor(stm)), stm)) {
+                    continue;
+                }
+
+                bitbase::WDL expected = bitbase::probeKPK(pos, strongSide)
+                                        ? (stm == strongSide ? bitbase::WDL_WIN : bitbase::WDL_LOSS)
+                                        : bitbase::WDL_DRAW;
+                LUNA_ASSERT(results[idx] == expected,
+                            "Expected " << int(expected) << ", got " << int(results[idx]) << " in " << pos);
+                nChecked++;
+            }
+            LUNA_ASSERT(nChecked > 100000, "Expected more legal KPK positions, got " << nChecked);
+        }
+    }
+};
+
+/**
+ * Writes a bitbase, loads it back and probes positions of both colors.
+ */
+struct BitbaseFileTest {
+    std::vector<std::pair<std::string, bitbase::WDL>> expected;
+
+    BitbaseFileTest(std::vector<std::pair<std::string, bitbase::WDL>> expected)
+        : expected(std::move(expected)) {}
+
+    void operator()() {
+        namespace fs = std::filesystem;
+
+        bitbase::BitbaseMaterial material = bitbase::BitbaseMaterial::parse("KRK").value();
+        bitbase::BitbaseGenerator generator;
+
+        fs::path dir = fs::temp_directory_path() / "lunatest_bitbases";
+        fs::create_directories(dir);
+        LUNA_ASSERT(bitbase::Bitbase::write(dir / "KRK.lbb", material, generator.generate(material)),
+                    "Failed to write the bitbase");
+        int nLoaded = bitbase::loadBitbases(dir);
+        fs::remove_all(dir);
+        LUNA_ASSERT(nLoaded == 1, "Expected one bitbase to be loaded, got " << nLoaded);
+
+        for (const auto& [fen, wdl]: expected) {
+            Position pos = Position::fromFen(fen).value();
+
+            Color firstSide;
+            const bitbase::Bitbase* bb = bitbase::findBitbase(pos.getMaterialKey(), firstSide);
+            LUNA_ASSERT(bb != nullptr, "Expected a bitbase for " << fen);
+
+            bitbase::WDL result = bb->probe(pos, firstSide);
+            LUNA_ASSERT(result == wdl,
+                        "Expected " << int(wdl) << ", got " << int(result) << " for " << fen);
+        }
+    }
+};
+
+/**
+ * Corrupts the block offsets of a bitbase file in various ways and checks that
+ * the bitbase is rejected, then checks that unloading bitbases forgets them.
+ */
+struct BitbaseCorruptFileTest {
+    void operator()() {
+        namespace fs = std::filesystem;
+
+        bitbase::BitbaseMaterial material = bitbase::BitbaseMaterial::parse("KRK").value();
+        bitbase::BitbaseGenerator generator;
+
+        fs::path dir = fs::temp_directory_path() / "lunatest_corrupt_bitbases";
+        fs::create_directories(dir);
+        fs::path path = dir / "KRK.lbb";
+        LUNA_ASSERT(bitbase::Bitbase::write(path, material, generator.generate(material)),
+                    "Failed to write the bitbase");
+
+        std::vector<ui8> original;
+        {
+            std::ifstream stream(path, std::ios::binary);
+            original.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        }
+
+        // Header: magic, material name, block count, then the offsets.
+        constexpr size_t OFFSETS_BEGIN = 16;
+        auto readOffset = [&](size_t i) {
+            const ui8* p = original.data() + OFFSETS_BEGIN + i * 4;
+            return ui32(p[0]) | (ui32(p[1]) << 8) | (ui32(p[2]) << 16) | (ui32(p[3]) << 24);
+        };
+        auto withOffset = [&](size_t i, ui32 offset) {
+            std::vector<ui8> ret = original;
+            ui8* p = ret.data() + OFFSETS_BEGIN + i * 4;
+            p[0] = ui8(offset);
+            p[1] = ui8(offset >> 8);
+            p[2] = ui8(offset >> 16);
+            p[3] = ui8(offset >> 24);
+            return ret;
+        };
+
+        size_t nBlocks = (material.getPositionCount() + bitbase::Bitbase::BLOCK_SIZE - 1) / bitbase::Bitbase::BLOCK_SIZE;
+        std::vector<ui8> truncated(original.begin(), original.end() - 1);
+        std::vector<std::pair<std::string, std::vector<ui8>>> corruptFiles = {
+            { "decreasing offset", withOffset(nBlocks / 2, readOffset(nBlocks / 2 + 1) + 1) },
+            { "offset past the data", withOffset(1, 0xFFFFFFFF) },
+            { "truncated data", truncated },
+        };
+
+        bitbase::Bitbase bb;
+        LUNA_ASSERT(bb.open(path), "Expected the intact bitbase to open");
+        for (const auto& [desc, contents]: corruptFiles) {
+            fs::path corruptPath = dir / "corrupt.lbb";
+            {
+                std::ofstream stream(corruptPath, std::ios::binary);
+                stream.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+            }
+
+            bitbase::Bitbase corrupt;
+            LUNA_ASSERT(!corrupt.open(corruptPath), "Expected a bitbase with a " << desc << " to be rejected");
+            fs::remove(corruptPath);
+        }
+
+        // Only the intact file is left.
+        int nLoaded = bitbase::loadBitbases(dir);
+        fs::remove_all(dir);
+        LUNA_ASSERT(nLoaded == 1, "Expected one bitbase to be loaded, got " << nLoaded);
+
+        Color firstSide;
+        ui64 key = material.getMaterialKey();
+        ui32 generation = bitbase::getGeneration();
+        LUNA_ASSERT(bitbase::findBitbase(key, firstSide) != nullptr, "Expected the loaded bitbase to be found");
+        bitbase::unloadBitbases();
+        LUNA_ASSERT(bitbase::findBitbase(key, firstSide) == nullptr, "Expected unloaded bitbases to be gone");
+        LUNA_ASSERT(bitbase::getGeneration() != generation, "Expected unloading to start a new generation");
+    }
+};
+
+inline std::vector<TestCase> bitbaseTests = {
+    KPKBitbaseTest(),
+    BitbaseFileTest({
+        // White to move always wins.
+        { "k7/1R6/8/8/8/8/8/K7 w - - 0 1",    bitbase::WDL_WIN },
+        { "8/8/3k4/8/8/2K5/8/7R w - - 0 1",   bitbase::WDL_WIN },
+        // Mate, stalemate and a hanging rook.
+        { "R1k5/8/2K5/8/8/8/8/8 b - - 0 1",   bitbase::WDL_LOSS },
+        { "8/8/8/8/8/8/1RK5/k7 b - - 0 1",    bitbase::WDL_DRAW },
+        { "k7/1R6/8/8/8/8/8/K7 b - - 0 1",    bitbase::WDL_DRAW },
+        { "8/8/3k4/8/8/2K5/8/7R b - - 0 1",   bitbase::WDL_LOSS },
+        // Same positions with the colors swapped.
+        { "k7/8/8/8/8/8/1r6/K7 w - - 0 1",    bitbase::WDL_DRAW },
+        { "K7/1rk5/8/8/8/8/8/8 w - - 0 1",    bitbase::WDL_DRAW },
+        { "8/8/8/8/8/2k5/8/r1K5 w - - 0 1",   bitbase::WDL_LOSS },
+        { "7r/8/2K5/8/8/3k4/8/8 b - - 0 1",   bitbase::WDL_WIN },
+    }),
+    BitbaseCorruptFileTest(),
+};
+
+}
@@ -0,0 +1,297 @@
+#include "../lunatest.h"
+
+#include "../../lunabook/book.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+
+namespace lunachess::tests {
+
+using namespace lunachess::book;
+
+static std::vector<PgnGame> readPgnRange(const std::string& pgn, ui64 begin, ui64 end) {
+    std::istringstream stream(pgn);
+    PgnReader reader(stream, begin, end);
+
+    std::vector<PgnGame> games;
+    PgnGame game;
+    while (reader.readGame(game)) {
+        games.push_back(game);
+    }
+    return games;
+}
+
+/**
+ * Splits a PGN in two at every possible offset, and checks that each game is
+ * read exactly once, by the chunk in which it starts.
+ */
+struct PgnChunkTest {
+    std::string pgn;
+
+    PgnChunkTest(std::string pgn)
+        : pgn(std::move(pgn)) {}
+
+    void operator()() {
+        std::vector<PgnGame> expected = readPgnRange(pgn, 0, UINT64_MAX);
+        LUNA_ASSERT(!expected.empty(), "Expected the PGN to have games.");
+
+        for (ui64 split = 0; split <= pgn.size(); ++split) {
+            std::vector<PgnGame> games = readPgnRange(pgn, 0, split);
+            std::vector<PgnGame> second = readPgnRange(pgn, split, pgn.size());
+            games.insert(games.end(), second.begin(), second.end());
+
+            LUNA_ASSERT(games.size() == expected.size(),
+                        "Expected " << expected.size() << " games when splitting at " << split
+                        << ", got " << games.size());
+            for (size_t i = 0; i < games.size(); ++i) {
+                LUNA_ASSERT(games[i].moves == expected[i].moves && games[i].result == expected[i].result,
+                            "Game " << i << " was not read back the same when splitting at " << split);
+            }
+        }
+    }
+};
+
+/**
+ * Merges random runs with repeated (key, move) pairs, and checks that each pair
+ * comes out once, in order, with the counts of all runs added together.
+ */
+struct RunSetMergeTest {
+    size_t nRuns;
+
+    RunSetMergeTest(size_t nRuns)
+        : nRuns(nRuns) {}
+
+    void operator()() {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "lunatest_runs";
+        std::filesystem::create_directories(dir);
+
+        std::mt19937 random(static_cast<ui32>(nRuns));
+        std::map<std::pair<ui64, ui16>, BookRecord> expected;
+        std::vector<BookRecord> merged;
+        {
+            RunSet runs(dir);
+            for (size_t i = 0; i < nRuns; ++i) {
+                std::vector<BookRecord> run(random() % 32);
+                for (BookRecord& r: run) {
+                    // Few keys and moves, so that pairs repeat within and across runs.
+                    r.key   = random() % 16;
+                    r.move  = random() % 4;
+                    r.games = 1 + random() % 3;
+                    r.wins  = random() % (r.games + 1);
+                    r.draws = random() % (r.games - r.wins + 1);
+
+                    auto [it, inserted] = expected.try_emplace({ r.key, r.move }, r);
+                    if (!inserted) {
+                        it->second.add(r);
+                    }
+                }
+                std::sort(run.begin(), run.end());
+                runs.write(run);
+            }
+            LUNA_ASSERT(runs.getRunCount() == nRuns, "Expected " << nRuns << " runs, got " << runs.getRunCount());
+
+            runs.merge([&merged](const BookRecord& r) {
+                merged.push_back(r);
+            });
+        }
+
+        LUNA_ASSERT(merged.size() == expected.size(),
+                    "Expected " << expected.size() << " merged records, got " << merged.size());
+        size_t i = 0;
+        for (const auto& [pair, r]: expected) {
+            const BookRecord& m = merged[i++];
+            LUNA_ASSERT(m.sameMove(r), "Expected merged record " << i - 1 << " to be in key order.");
+            LUNA_ASSERT(m.games == r.games && m.wins == r.wins && m.draws == r.draws,
+                        "Expected the counts of key " << r.key << ", move " << r.move << " to be added together.");
+        }
+
+        LUNA_ASSERT(std::filesystem::is_empty(dir), "Expected the run files to be removed.");
+        std::filesystem::remove(dir);
+    }
+};
+
+static const std::string BOOK_TEST_PGN =
+    "[Event \"a\"]\n[Result \"1-0\"]\n\n1. e4 e5 2. Nf3 {comment} Nc6 (2... d6 3. d4) 1-0\n\n"
+    "[Event \"b\"]\n[Result \"1-0\"]\n\n1. e4 c5 1-0\n\n"
+    "[Event \"c\"]\n[Result \"1-0\"]\n\n1. e4 c5 1-0\n\n"
+    "[Event \"d\"]\n[Result \"1/2-1/2\"]\n\n1. e4 e5 2. Nf3 1/2-1/2\n\n"
+    "[Event \"e\"]\n[Result \"1/2-1/2\"]\n\n1. d4 d5 1/2-1/2\n\n"
+    "[Event \"f\"]\n[Result \"1-0\"]\n\n1. d4 d5 1-0\n\n"
+    "[Event \"g\"]\n[Result \"*\"]\n\n1. e4 e5 *\n\n"
+    "[Event \"h\"]\n[Result \"1-0\"]\n[FEN \"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1\"]\n\n1. e4 1-0\n";
+
+/**
+ * Builds a book from BOOK_TEST_PGN, read in two chunks, the same way lunabook does.
+ */
+static void buildTestBook(const std::filesystem::path& path, BookStats& stats) {
+    BookSettings settings;
+    settings.maxPly   = 3;
+    settings.minGames = 2;
+
+    RunSet runs(std::filesystem::temp_directory_path());
+
+    // A tiny buffer, so that records of the same move end up in different runs.
+    RecordBuffer buffer(4, runs);
+    const std::string& pgn = BOOK_TEST_PGN;
+    ui64 split = pgn.size() / 2;
+    for (auto [begin, end]: { std::pair<ui64, ui64>(0, split), { split, pgn.size() } }) {
+        std::istringstream stream(pgn);
+        PgnReader reader(stream, begin, end);
+        reader.setMaxMoves(settings.maxPly);
+
+        PgnGame game;
+        while (reader.readGame(game)) {
+            addGame(settings, game, buffer, stats);
+        }
+    }
+    buffer.flush();
+    LUNA_ASSERT(runs.getRunCount() > 1, "Expected the records to be split in several runs.");
+
+    std::ofstream stream(path, std::ios::binary);
+    writeBook(settings, runs, stream, stats);
+}
+
+static Position playLine(const std::vector<std::string>& line) {
+    Position pos = Position::getInitialPosition();
+    for (const std::string& m: line) {
+        pos.makeMove(Move::fromAlgebraic(pos, m));
+    }
+    return pos;
+}
+
+/**
+ * Builds a book, reads it back and checks its entries.
+ */
+struct BookBuildTest {
+    void operator()() {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "lunatest_built_book.bin";
+        BookStats stats;
+        buildTestBook(path, stats);
+
+        LUNA_ASSERT(stats.games == 8, "Expected 8 games, got " << stats.games);
+        LUNA_ASSERT(stats.skippedGames == 2, "Expected 2 skipped games, got " << stats.skippedGames);
+
+        // Wins score two points and draws one. Moves played in a single game, or
+        // that never scored (1. e4 c5), are left out.
+        struct ExpectedPosition {
+            std::vector<std::string> line;
+            std::vector<std::pair<std::string, ui16>> moves;
+        };
+        std::vector<ExpectedPosition> expected = {
+            { { },                 { { "e4", 7 }, { "d4", 3 } } },
+            { { "e4" },            { { "e5", 1 } } },
+            { { "e4", "e5" },      { { "Nf3", 3 } } },
+            { { "d4" },            { { "d5", 1 } } },
+        };
+
+        PolyglotBook book;
+        bool opened = book.open(path);
+        LUNA_ASSERT(opened, "Expected the book to be opened.");
+        LUNA_ASSERT(book.getEntryCount() == 5, "Expected 5 entries, got " << book.getEntryCount());
+        LUNA_ASSERT(stats.entries == 5 && stats.positions == 4,
+                    "Expected 5 entries for 4 positions, got " << stats.entries << " for " << stats.positions);
+
+        for (size_t i = 1; i < book.getEntryCount(); ++i) {
+            LUNA_ASSERT(book.getEntry(i - 1).key <= book.getEntry(i).key, "Expected entries to be sorted by key.");
+        }
+
+        for (const ExpectedPosition& e: expected) {
+            Position pos = playLine(e.line);
+
+            ui64 key   = getPolyglotKey(pos);
+            size_t idx = book.findFirstEntry(key);
+            for (const auto& [san, weight]: e.moves) {
+                LUNA_ASSERT(idx < book.getEntryCount() && book.getEntry(idx).key == key,
+                            "Expected an entry for " << san << " in " << pos.toFen());
+
+                PolyglotEntry entry = book.getEntry(idx++);
+                ui16 move = encodePolyglotMove(Move::fromAlgebraic(pos, san));
+                LUNA_ASSERT(entry.move == move && entry.weight == weight,
+                            "Expected " << san << " with weight " << weight << " in " << pos.toFen()
+                            << ", got move " << entry.move << " with weight " << entry.weight);
+            }
+            LUNA_ASSERT(idx == book.getEntryCount() || book.getEntry(idx).key != key,
+                        "Expected no more entries in " << pos.toFen());
+        }
+
+        book.close();
+        std::filesystem::remove(path);
+    }
+};
+
+/**
+ * Builds a book and plays from it through OpeningBook, the way the engine does
+ * when the BookFile option is set.
+ */
+struct BookProbeTest {
+    void operator()() {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "lunatest_probed_book.bin";
+        BookStats stats;
+        buildTestBook(path, stats);
+
+        OpeningBook book;
+        bool opened = book.openFile(path);
+        LUNA_ASSERT(opened, "Expected the built book to be opened.");
+
+        struct ExpectedPosition {
+            std::vector<std::string> line;
+            std::vector<std::string> moves;
+        };
+        std::vector<ExpectedPosition> expected = {
+            { { },                 { "e4", "d4" } },
+            { { "e4" },            { "e5" } },
+            { { "e4", "e5" },      { "Nf3" } },
+            { { "d4" },            { "d5" } },
+            { { "e4", "c5" },      { } },
+            { { "e4", "e5", "Nf3", "Nc6" }, { } },
+        };
+
+        for (const ExpectedPosition& e: expected) {
+            Position pos = playLine(e.line);
+
+            std::vector<Move> bookMoves;
+            for (const std::string& san: e.moves) {
+                bookMoves.push_back(Move::fromAlgebraic(pos, san));
+            }
+
+            for (int i = 0; i < 20; ++i) {
+                Move move = book.getRandomMoveForPosition(pos);
+                if (bookMoves.empty()) {
+                    LUNA_ASSERT(move == MOVE_INVALID, "Expected no book move in " << pos.toFen() << ", got " << move);
+                }
+                else {
+                    LUNA_ASSERT(std::find(bookMoves.begin(), bookMoves.end(), move) != bookMoves.end(),
+                                "Expected a book move in " << pos.toFen() << ", got " << move);
+                }
+            }
+        }
+
+        book.closeFile();
+        LUNA_ASSERT(book.getRandomMoveForPosition(Position::getInitialPosition()) == MOVE_INVALID,
+                    "Expected no book move once the file is closed.");
+        std::filesystem::remove(path);
+    }
+};
+
+static const std::string CHUNK_TEST_PGN =
+    "[Event \"a\"]\n[Site \"?\"]\n[Result \"1-0\"]\n\n1. e4 e5 2. Nf3 {a comment\nover two lines} Nc6 1-0\n\n"
+    "[Event \"b\"]\r\n[Result \"0-1\"]\r\n\r\n1. d4 (1. c4 e5) 1... d5 0-1\r\n\r\n"
+    "[Event \"c\"]\n[Result \"1/2-1/2\"]\n\n1.c4 c5 2.Nc3 $1 Nc6\n3. g3 1/2-1/2\n\n"
+    "[Event \"d\"]\n[Result \"*\"]\n\n1. Nf3 ; a comment up to the end of the line\nd5 *\n";
+
+std::vector<TestCase> bookTests = {
+    PgnChunkTest(CHUNK_TEST_PGN),
+
+    RunSetMergeTest(1),
+    RunSetMergeTest(8),
+    RunSetMergeTest(RunSet::MAX_MERGE_WIDTH * 2 + 5),
+
+    BookBuildTest(),
+    BookProbeTest(),
+};
+
+}
@@ -39,6 +39,10 @@ std::vector<TestCase> endgameTests = {
     EndgameTest("8/8/3k4/8/7Q/8/4K3/8 w - - 0 1", EG_KQ_K, CL_WHITE),
     EndgameTest("8/8/3k4/8/7q/8/4K3/8 w - - 0 1", EG_KQ_K, CL_BLACK),
     EndgameTest("8/8/3k4/8/6pq/8/4K3/8 w - - 0 1", EG_UNKNOWN, CL_ANY),
+    EndgameTest("8/8/3k4/8/6q1/8/4K3/7Q w - - 0 1", EG_KQ_KQ, CL_ANY),
+
+    // Eight pawns don't fit in the endgame masks, and must not be mistaken for no pawns.
+    EndgameTest("4k3/8/8/8/8/8/PPPPPPPP/R3K3 w - - 0 1", EG_UNKNOWN, CL_ANY),
 };
 
 }
\ No newline at end of file
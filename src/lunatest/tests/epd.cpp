@@ -0,0 +1,60 @@
+#include "../lunatest.h"
+
+#include <lunachess.h>
+
+namespace lunachess::tests {
+
+/**
+ * Parses an EPD line and checks its position and operations.
+ */
+struct EpdParseTest {
+    std::string line;
+    std::string expectedFen;
+    std::vector<EpdOperation> expectedOps;
+
+    EpdParseTest(std::string_view line, std::string_view expectedFen, std::vector<EpdOperation> expectedOps)
+        : line(line), expectedFen(expectedFen), expectedOps(std::move(expectedOps)) {}
+
+    void operator()() {
+        std::optional<EpdRecord> record = parseEpd(line);
+        if (expectedFen.empty()) {
+            LUNA_ASSERT(!record.has_value(), "Expected '" << line << "' to be rejected");
+            return;
+        }
+
+        LUNA_ASSERT(record.has_value(), "Failed to parse '" << line << "'");
+        std::string expectedPositionFen = Position::fromFen(expectedFen)->toFen();
+        LUNA_ASSERT(record->position.toFen() == expectedPositionFen,
+                    "Expected position " << expectedPositionFen << ", got " << record->position.toFen());
+
+        LUNA_ASSERT(record->operations.size() == expectedOps.size(),
+                    "Expected " << expectedOps.size() << " operations, got " << record->operations.size());
+        for (size_t i = 0; i < expectedOps.size(); ++i) {
+            const EpdOperation& op = record->operations[i];
+            LUNA_ASSERT(op.opcode == expectedOps[i].opcode,
+                        "Expected opcode '" << expectedOps[i].opcode << "', got '" << op.opcode << "'");
+            LUNA_ASSERT(op.operands == expectedOps[i].operands,
+                        "Operands of '" << op.opcode << "' don't match");
+        }
+    }
+};
+
+std::vector<TestCase> epdTests = {
+    EpdParseTest("2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - bm Qg6; id \"WAC.001\";",
+                 "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - -",
+                 { { "bm", { "Qg6" } }, { "id", { "WAC.001" } } }),
+    EpdParseTest("r1b1kb1r/3q1ppp/pBp1pn2/8/Np3P2/5B2/PPP3PP/R2Q1RK1 w kq - bm Nb6 Bc5; am Qd4; id \"quoted; id\"",
+                 "r1b1kb1r/3q1ppp/pBp1pn2/8/Np3P2/5B2/PPP3PP/R2Q1RK1 w kq -",
+                 { { "bm", { "Nb6", "Bc5" } }, { "am", { "Qd4" } }, { "id", { "quoted; id" } } }),
+    EpdParseTest("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+                 "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+                 {}),
+    EpdParseTest("8/8/8/8/8/8/8/K6k w - - 12 40 bm Kb2;",
+                 "8/8/8/8/8/8/8/K6k w - - 12 40",
+                 { { "bm", { "Kb2" } } }),
+    EpdParseTest("8/8/8/8/8/8/8/K6k w -",
+                 "",
+                 {}),
+};
+
+}
@@ -0,0 +1,59 @@
+#include "../../lunatest.h"
+
+namespace lunachess::tests {
+
+struct HCETraceTest {
+    std::string fen;
+
+    HCETraceTest(std::string_view fen)
+        : fen(fen) {}
+
+    void operator()() {
+        using namespace ai;
+
+        Position pos = Position::fromFen(fen).value();
+
+        HandCraftedEvaluator hce;
+        hce.setPosition(pos);
+
+        HCETrace trace;
+        i32 eval       = hce.evaluate();
+        i32 tracedEval = hce.evaluate(trace);
+
+        LUNA_ASSERT(eval == tracedEval,
+                    "Traced evaluation (" << tracedEval << ") differs from evaluation (" << eval << ")");
+        LUNA_ASSERT(trace.isLinear(), "Expected a linear trace.");
+        LUNA_ASSERT(trace.computeScore(hce.getWeights()) == eval,
+                    "Expected rebuilt score " << eval << ", got " << trace.computeScore(hce.getWeights()));
+
+        // The trace must also rebuild the score for a different set of weights.
+        HCEWeightTable weights = hce.getWeights();
+        int* slots = reinterpret_cast<int*>(&weights);
+        for (size_t i = 0; i < HCE_WEIGHT_SLOT_COUNT; ++i) {
+            slots[i] += static_cast<int>(i % 7) - 3;
+        }
+
+        // King attack powers only select which king attack weight is applied,
+        // keep them unchanged so the same weight gets selected.
+        weights.pieceCheckPower = hce.getWeights().pieceCheckPower;
+        weights.queenTouchPower = hce.getWeights().queenTouchPower;
+
+        HandCraftedEvaluator modifiedHce(&weights);
+        modifiedHce.setPosition(pos);
+        i32 modifiedEval = modifiedHce.evaluate();
+
+        LUNA_ASSERT(trace.computeScore(weights) == modifiedEval,
+                    "Expected rebuilt score " << modifiedEval << " for modified weights, got " << trace.computeScore(weights));
+    }
+};
+
+std::vector<TestCase> hceTraceTests = {
+    HCETraceTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"),
+    HCETraceTest("r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4"),
+    HCETraceTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"),
+    HCETraceTest("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"),
+    HCETraceTest("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 b - - 0 10"),
+    HCETraceTest("6k1/5ppp/8/3P4/8/8/2R2PPP/6K1 b - - 0 1"),
+};
+
+}
@@ -0,0 +1,134 @@
+#include "../../lunatest.h"
+
+namespace lunachess::tests {
+
+/**
+ * Checks that the material key kept by the position matches the key of the same
+ * position set up from scratch, after every move up to some depth.
+ */
+struct MaterialKeyTest {
+    std::string fen;
+    int depth;
+
+    MaterialKeyTest(std::string_view fen, int depth)
+        : fen(fen), depth(depth) {}
+
+    void testMoves(Position& pos, int d) {
+        if (d <= 0) {
+            return;
+        }
+
+        ui64 key = pos.getMaterialKey();
+        MoveList moves;
+        movegen::generate(pos, moves);
+        for (Move move: moves) {
+            pos.makeMove(move);
+
+            ui64 expected = Position::fromFen(pos.toFen()).value().getMaterialKey();
+            LUNA_ASSERT(pos.getMaterialKey() == expected,
+                        "Wrong material key after " << move << " in " << pos.toFen());
+
+            testMoves(pos, d - 1);
+            pos.undoMove();
+
+            LUNA_ASSERT(pos.getMaterialKey() == key, "Material key not restored after undoing " << move);
+        }
+    }
+
+    void operator()() {
+        Position pos = Position::fromFen(fen).value();
+        testMoves(pos, depth);
+    }
+};
+
+/**
+ * Material keys only depend on piece counts.
+ */
+struct SameMaterialTest {
+    std::string fenA;
+    std::string fenB;
+    bool same;
+
+    SameMaterialTest(std::string_view fenA, std::string_view fenB, bool same)
+        : fenA(fenA), fenB(fenB), same(same) {}
+
+    void operator()() {
+        ui64 a = Position::fromFen(fenA).value().getMaterialKey();
+        ui64 b = Position::fromFen(fenB).value().getMaterialKey();
+        LUNA_ASSERT((a == b) == same,
+                    "Expected material keys of " << fenA << " and " << fenB << " to be " << (same ? "equal" : "different"));
+    }
+};
+
+/**
+ * Checks that drawn material is evaluated as a draw.
+ */
+struct ScaledDrawTest {
+    std::string fen;
+
+    ScaledDrawTest(std::string_view fen)
+        : fen(fen) {}
+
+    void operator()() {
+        ai::HandCraftedEvaluator hce;
+        hce.setPosition(Position::fromFen(fen).value());
+        i32 eval = hce.evaluate();
+        LUNA_ASSERT(eval == 0, "Expected a draw score, got " << eval << " in " << fen);
+    }
+};
+
+/**
+ * Checks that the side ahead in a drawish position gets a lower score than in
+ * a similar position that isn't drawish.
+ */
+struct ScaledScoreTest {
+    std::string drawishFen;
+    std::string normalFen;
+
+    ScaledScoreTest(std::string_view drawishFen, std::string_view normalFen)
+        : drawishFen(drawishFen), normalFen(normalFen) {}
+
+    void operator()() {
+        ai::HandCraftedEvaluator hce;
+        hce.setPosition(Position::fromFen(drawishFen).value());
+        i32 drawishEval = hce.evaluate();
+        hce.setPosition(Position::fromFen(normalFen).value());
+        i32 normalEval = hce.evaluate();
+
+        LUNA_ASSERT(normalEval > 0, "Expected " << normalFen << " to be winning, got " << normalEval);
+        LUNA_ASSERT(drawishEval >= 0 && drawishEval < normalEval,
+                    "Expected " << drawishFen << " (" << drawishEval << ") to be scaled down compared to "
+                    << normalFen << " (" << normalEval << ")");
+    }
+};
+
+std::vector<TestCase> materialTests = {
+    MaterialKeyTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 3),
+    MaterialKeyTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 2),
+    MaterialKeyTest("n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1", 3),
+    MaterialKeyTest("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 2),
+
+    SameMaterialTest("4k3/8/8/8/8/8/4P3/R3K3 w - - 0 1", "R3k3/8/8/8/8/4P3/8/4K3 b - - 0 1", true),
+    SameMaterialTest("4k3/8/8/8/8/8/4P3/R3K3 w - - 0 1", "4k3/8/8/8/8/8/4p3/R3K3 w - - 0 1", false),
+    SameMaterialTest("4k3/8/8/8/8/8/4P3/R3K3 w - - 0 1", "4k3/8/8/8/8/8/4P3/r3K3 w - - 0 1", false),
+    SameMaterialTest("4k3/8/8/8/8/8/4P3/R3K3 w - - 0 1", "4k3/8/8/8/8/8/3PP3/R3K3 w - - 0 1", false),
+
+    // Lone minor pieces
+    ScaledDrawTest("8/8/4k3/8/8/3BK3/8/8 w - - 0 1"),
+    ScaledDrawTest("8/8/4k3/8/8/3nK3/8/8 w - - 0 1"),
+    ScaledDrawTest("8/8/4k3/8/8/3NK3/4N3/8 w - - 0 1"),
+    ScaledDrawTest("8/8/4k3/4p3/8/3BK3/8/8 w - - 0 1"),
+
+    // Rook pawns with the defending king in the corner, with or without the wrong bishop
+    ScaledDrawTest("k7/8/8/P7/8/8/P7/4K3 w - - 0 1"),
+    ScaledDrawTest("k7/8/8/P7/8/8/P7/2B1K3 w - - 0 1"),
+    ScaledDrawTest("8/7p/8/7p/8/4k3/8/7K b - - 0 1"),
+
+    // Opposite colored bishops
+    ScaledScoreTest("4k3/5b2/8/8/2PP4/8/8/2B1K3 w - - 0 1", "4k3/4b3/8/8/2PP4/8/8/2B1K3 w - - 0 1"),
+
+    // Rook pawns with the right bishop, or the defending king away from the corner
+    ScaledScoreTest("k7/8/8/P7/8/8/P7/4K3 w - - 0 1", "8/8/8/P7/8/4k3/P7/1B2K3 w - - 0 1"),
+};
+
+}
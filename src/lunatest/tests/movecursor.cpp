@@ -0,0 +1,123 @@
+#include "../lunatest.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace lunachess::tests {
+
+/**
+ * Runs move cursors over a position and its children, with and without a hash move
+ * and with killers set, and checks that MoveCursor<false> yields every legal move
+ * exactly once and that MoveCursor<true> yields exactly the legal noisy moves.
+ */
+struct MoveCursorTest {
+    std::string fen;
+
+    explicit MoveCursorTest(std::string_view fen)
+        : fen(fen) {}
+
+    static constexpr int PLY = 1;
+
+    template <bool NOISY_ONLY>
+    static void expectMoves(const Position& pos, const ai::MoveOrderingData& data,
+                            Move hashMove, const std::vector<Move>& expected) {
+        std::vector<Move> yielded;
+        ai::MoveCursor<NOISY_ONLY> cursor;
+        Move move;
+        while ((move = cursor.next(pos, data, PLY, hashMove)) != MOVE_INVALID) {
+            yielded.push_back(move);
+            LUNA_ASSERT(yielded.size() <= expected.size() + 1,
+                        "Cursor yields more moves than expected in " << pos.toFen());
+        }
+
+        if (hashMove != MOVE_INVALID) {
+            LUNA_ASSERT(!yielded.empty() && yielded[0] == hashMove,
+                        "Expected the hash move " << hashMove << " first in " << pos.toFen());
+        }
+        for (Move m: yielded) {
+            LUNA_ASSERT(std::count(expected.begin(), expected.end(), m) == 1,
+                        "Unexpected move " << m << " (noisy only: " << NOISY_ONLY << ") in " << pos.toFen());
+            LUNA_ASSERT(std::count(yielded.begin(), yielded.end(), m) == 1,
+                        "Move " << m << " yielded twice (noisy only: " << NOISY_ONLY << ") in " << pos.toFen());
+        }
+        LUNA_ASSERT(yielded.size() == expected.size(),
+                    "Expected " << expected.size() << " moves, got " << yielded.size()
+                    << " (noisy only: " << NOISY_ONLY << ") in " << pos.toFen());
+    }
+
+    /**
+     * Checks both cursors over a position, with 'otherMove' being a move of another
+     * position, which may or may not be pseudo legal here.
+     */
+    static void checkPosition(const Position& pos, ai::MoveOrderingData& data, Move otherMove) {
+        MoveList legalMoves;
+        movegen::generate(pos, legalMoves);
+        std::vector<Move> legal(legalMoves.begin(), legalMoves.end());
+        std::vector<Move> noisy, quiet;
+        for (Move m: legal) {
+            (m.is<MTM_NOISY>() ? noisy : quiet).push_back(m);
+        }
+
+        // Hash moves to try with each cursor. The noisy cursor is only given noisy
+        // hash moves, like the quiescence search.
+        std::vector<Move> hashMoves = { MOVE_INVALID };
+        std::vector<Move> noisyHashMoves = { MOVE_INVALID };
+        if (!quiet.empty()) {
+            hashMoves.push_back(quiet.back());
+        }
+        if (!noisy.empty()) {
+            hashMoves.push_back(noisy.front());
+            noisyHashMoves.push_back(noisy.front());
+        }
+
+        // Killers are quiet moves, possibly equal to the hash move, or moves of
+        // other positions.
+        std::vector<std::pair<Move, Move>> killerSets = { { MOVE_INVALID, MOVE_INVALID } };
+        if (quiet.size() >= 2) {
+            killerSets.push_back({ quiet[0], quiet[1] });
+        }
+        if (!quiet.empty()) {
+            killerSets.push_back({ quiet.back(), quiet.front() });
+            killerSets.push_back({ otherMove, quiet.front() });
+        }
+
+        for (const auto& [first, second]: killerSets) {
+            data.resetKillers();
+            data.storeKillerMove(second, PLY);
+            data.storeKillerMove(first, PLY);
+
+            for (Move hashMove: hashMoves) {
+                expectMoves<false>(pos, data, hashMove, legal);
+            }
+            for (Move hashMove: noisyHashMoves) {
+                expectMoves<true>(pos, data, hashMove, noisy);
+            }
+        }
+    }
+
+    void operator()() {
+        Position pos = Position::fromFen(fen).value();
+        auto data = std::make_unique<ai::MoveOrderingData>();
+
+        MoveList moves;
+        movegen::generate(pos, moves);
+        checkPosition(pos, *data, MOVE_INVALID);
+        for (Move move: moves) {
+            pos.makeMove(move);
+            checkPosition(pos, *data, move);
+            pos.undoMove();
+        }
+    }
+};
+
+std::vector<TestCase> moveCursorTests = {
+    MoveCursorTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"),
+    MoveCursorTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"),
+    MoveCursorTest("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"),
+    MoveCursorTest("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"),
+    MoveCursorTest("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"),
+    MoveCursorTest("n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1"),
+    MoveCursorTest("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1"),
+};
+
+}
@@ -0,0 +1,73 @@
+#include "../../lunatest.h"
+
+#include <lunachess.h>
+
+#include <vector>
+
+namespace lunachess::tests {
+
+/**
+ * Checks that every legal move of a position is parsed back from its algebraic notation.
+ */
+struct SanRoundTripTest {
+    std::string fen;
+
+    SanRoundTripTest(std::string_view fen)
+        : fen(fen) {}
+
+    void operator()() {
+        Position pos = Position::fromFen(fen).value();
+
+        MoveList moves;
+        movegen::generate(pos, moves);
+        for (Move move: moves) {
+            std::string san = move.toAlgebraic(pos);
+            Move parsed = Move::fromAlgebraic(pos, san);
+            LUNA_ASSERT(parsed == move,
+                        "Expected '" << san << "' to be parsed as " << move << ", got " << parsed << " in " << fen);
+        }
+    }
+};
+
+/**
+ * Parses a single move, as written by PGN files.
+ */
+struct SanParseTest {
+    std::string fen;
+    std::string san;
+    std::string expected;
+
+    SanParseTest(std::string_view fen, std::string_view san, std::string_view expected)
+        : fen(fen), san(san), expected(expected) {}
+
+    void operator()() {
+        Position pos = Position::fromFen(fen).value();
+        Move parsed = Move::fromAlgebraic(pos, san);
+        Move expectedMove = expected.empty() ? MOVE_INVALID : Move(pos, expected);
+        LUNA_ASSERT(parsed == expectedMove,
+                    "Expected '" << san << "' to be parsed as " << expectedMove << ", got " << parsed << " in " << fen);
+    }
+};
+
+std::vector<TestCase> sanTests = {
+    SanRoundTripTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"),
+    SanRoundTripTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"),
+    SanRoundTripTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1"),
+    SanRoundTripTest("n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1"),
+    SanRoundTripTest("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"),
+    SanRoundTripTest("1k6/8/8/2N3N1/8/2N3N1/8/1K6 w - - 0 1"),
+
+    SanParseTest("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "O-O", "e1g1"),
+    SanParseTest("r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1", "0-0-0", "e8c8"),
+    SanParseTest("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", "exf6", "e5f6"),
+    SanParseTest("8/4P3/8/8/8/8/k7/4K3 w - - 0 1", "e8=Q+", "e7e8q"),
+    SanParseTest("8/4P3/8/8/8/8/k7/4K3 w - - 0 1", "e8N", "e7e8n"),
+    SanParseTest("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3", "Bb5!?", "f1b5"),
+    SanParseTest("rn1qkbnr/pppbpppp/8/3p4/8/8/PPPPPPPP/RNBQKBNR b KQkq - 0 1", "Nxd7", ""),
+    SanParseTest("1k6/8/8/2N3N1/8/2N3N1/8/1K6 w - - 0 1", "Ne4", ""),
+    SanParseTest("1k6/8/8/2N3N1/8/2N3N1/8/1K6 w - - 0 1", "N5e4", ""),
+    SanParseTest("1k6/8/8/2N3N1/8/2N3N1/8/1K6 w - - 0 1", "Nc3e4", "c3e4"),
+    SanParseTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "e5", ""),
+};
+
+}
@@ -0,0 +1,96 @@
+#include "../lunatest.h"
+
+#include <lunachess.h>
+
+#include <random>
+
+namespace lunachess::tests {
+
+static void checkPackedRoundTrip(const Position& pos) {
+    PackedPosition packed = pos.toPacked();
+    std::optional<Position> decoded = Position::fromPacked(packed);
+    LUNA_ASSERT(decoded.has_value(), "Failed to decode " << pos.toFen());
+
+    LUNA_ASSERT(decoded->toFen() == pos.toFen(),
+                "Expected " << pos.toFen() << ", got " << decoded->toFen());
+    LUNA_ASSERT(decoded->getZobrist() == pos.getZobrist(),
+                "Zobrist keys don't match for " << pos.toFen());
+    LUNA_ASSERT(decoded->getMaterialKey() == pos.getMaterialKey(),
+                "Material keys don't match for " << pos.toFen());
+    LUNA_ASSERT(decoded->isCheck() == pos.isCheck(),
+                "Check status doesn't match for " << pos.toFen());
+    LUNA_ASSERT(decoded->toPacked() == packed,
+                "Encoding of " << pos.toFen() << " changed after decoding it");
+}
+
+/**
+ * Encodes and decodes a position given as FEN.
+ */
+struct PackedFenTest {
+    std::string fen;
+
+    PackedFenTest(std::string_view fen)
+        : fen(fen) {}
+
+    void operator()() {
+        checkPackedRoundTrip(Position::fromFen(fen).value());
+    }
+};
+
+/**
+ * Encodes and decodes every position of random games, which covers en passant squares,
+ * lost castling rights and promotions along the way.
+ */
+struct PackedRandomGamesTest {
+    void operator()() {
+        std::mt19937 rng(1234);
+        for (int game = 0; game < 50; ++game) {
+            Position pos = Position::getInitialPosition();
+            for (int ply = 0; ply < 200; ++ply) {
+                checkPackedRoundTrip(pos);
+
+                MoveList moves;
+                movegen::generate(pos, moves);
+                if (moves.size() == 0) {
+                    break;
+                }
+                pos.makeMove(moves[rng() % moves.size()]);
+            }
+        }
+    }
+};
+
+/**
+ * Malformed encodings must be rejected.
+ */
+struct PackedInvalidTest {
+    void operator()() {
+        PackedPosition packed = Position::getInitialPosition().toPacked();
+
+        PackedPosition badPiece = packed;
+        badPiece.pieces[0] = 0xf;
+        LUNA_ASSERT(!Position::fromPacked(badPiece).has_value(), "Expected an invalid piece to be rejected");
+
+        PackedPosition badFlags = packed;
+        badFlags.flags |= 0x80;
+        LUNA_ASSERT(!Position::fromPacked(badFlags).has_value(), "Expected invalid flags to be rejected");
+
+        PackedPosition badEpSquare = packed;
+        badEpSquare.epSquare = 100;
+        LUNA_ASSERT(!Position::fromPacked(badEpSquare).has_value(), "Expected an invalid en passant square to be rejected");
+    }
+};
+
+std::vector<TestCase> packedPositionTests = {
+    PackedFenTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"),
+    PackedFenTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"),
+    PackedFenTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq - 12 40"),
+    PackedFenTest("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"),
+    PackedFenTest("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"),
+    PackedFenTest("n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 99 120"),
+    PackedFenTest("8/8/8/8/8/8/8/K6k w - - 0 1"),
+    PackedRandomGamesTest(),
+    PackedInvalidTest(),
+};
+
+}
@@ -0,0 +1,136 @@
+#include "../lunatest.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace lunachess::tests {
+
+struct PolyglotMoveTest {
+    std::string fen;
+
+    PolyglotMoveTest(std::string_view fen)
+        : fen(fen) {}
+
+    void operator()() {
+        Position pos = Position::fromFen(fen).value();
+
+        MoveList moves;
+        movegen::generate(pos, moves);
+        for (Move move: moves) {
+            ui16 encoded = encodePolyglotMove(move);
+            Move decoded = decodePolyglotMove(pos, encoded);
+            LUNA_ASSERT(decoded == move,
+                        "Expected " << move << " to be decoded back, got " << decoded << " (encoded as " << encoded << ")");
+        }
+    }
+};
+
+/** Polyglot key of the initial position, as listed by the book format specification. */
+constexpr ui64 INITIAL_POSITION_KEY = 0x463b96181691fc9c;
+
+/**
+ * Checks hashes against the reference keys of the Polyglot book format specification.
+ */
+struct PolyglotKeyTest {
+    std::vector<std::string> moves;
+    ui64 expectedKey;
+
+    PolyglotKeyTest(std::vector<std::string> moves, ui64 expectedKey)
+        : moves(std::move(moves)), expectedKey(expectedKey) {}
+
+    void operator()() {
+        Position pos = Position::getInitialPosition();
+        for (const std::string& m: moves) {
+            pos.makeMove(Move(pos, m));
+        }
+
+        ui64 key = getPolyglotKey(pos);
+        LUNA_ASSERT(key == expectedKey,
+                    "Expected key " << std::hex << expectedKey << ", got " << key << std::dec);
+    }
+};
+
+/**
+ * Writes a small book, reads it back and probes it.
+ */
+struct PolyglotBookTest {
+    void operator()() {
+        Position pos      = Position::getInitialPosition();
+        Move bookMove     = Move(pos, "e2e4");
+        ui64 key          = INITIAL_POSITION_KEY;
+        ui16 encodedMove  = encodePolyglotMove(bookMove);
+
+        // Entries must be sorted by key. Our position is surrounded by entries
+        // of other positions, and has a zero weight entry that must never be picked.
+        struct RawEntry { ui64 key; ui16 move; ui16 weight; };
+        std::vector<RawEntry> entries = {
+            { key - 1, encodedMove, 10 },
+            { key,     encodePolyglotMove(Move(pos, "d2d4")), 0 },
+            { key,     encodedMove, 5 },
+            { key + 1, encodedMove, 10 },
+        };
+
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "lunatest_book.bin";
+        {
+            std::ofstream stream(path, std::ios::binary);
+            for (const RawEntry& e: entries) {
+                ui8 data[PolyglotEntry::SIZE] = {};
+                for (int i = 0; i < 8; ++i) {
+                    data[i] = (e.key >> (56 - i * 8)) & 0xff;
+                }
+                data[8]  = e.move >> 8;
+                data[9]  = e.move & 0xff;
+                data[10] = e.weight >> 8;
+                data[11] = e.weight & 0xff;
+                stream.write(reinterpret_cast<const char*>(data), sizeof(data));
+            }
+        }
+
+        PolyglotBook book;
+        bool opened = book.open(path);
+        LUNA_ASSERT(opened, "Expected the book to be opened.");
+        LUNA_ASSERT(book.getEntryCount() == entries.size(),
+                    "Expected " << entries.size() << " entries, got " << book.getEntryCount());
+        LUNA_ASSERT(book.findFirstEntry(key) == 1, "Expected the position's first entry at index 1.");
+        LUNA_ASSERT(book.findFirstEntry(key + 2) == entries.size(), "Expected no entry after the last key.");
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            PolyglotEntry entry = book.getEntry(i);
+            LUNA_ASSERT(entry.key == entries[i].key && entry.move == entries[i].move && entry.weight == entries[i].weight,
+                        "Entry " << i << " was not read back as written.");
+        }
+
+        for (int i = 0; i < 20; ++i) {
+            Move move = book.getWeightedMove(pos);
+            LUNA_ASSERT(move == bookMove, "Expected book move " << bookMove << ", got " << move);
+        }
+
+        pos.makeMove(bookMove);
+        LUNA_ASSERT(book.getWeightedMove(pos) == MOVE_INVALID, "Expected no book move after 1. e4.");
+
+        book.close();
+        std::filesystem::remove(path);
+    }
+};
+
+std::vector<TestCase> polyglotTests = {
+    PolyglotMoveTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"),
+    PolyglotMoveTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"),
+    PolyglotMoveTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1"),
+    PolyglotMoveTest("n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1"),
+    PolyglotMoveTest("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"),
+
+    PolyglotKeyTest({ }, INITIAL_POSITION_KEY),
+    PolyglotKeyTest({ "e2e4" }, 0x823c9b50fd114196),
+    PolyglotKeyTest({ "e2e4", "d7d5" }, 0x0756b94461c50fb0),
+    PolyglotKeyTest({ "e2e4", "d7d5", "e4e5" }, 0x662fafb965db29d4),
+    PolyglotKeyTest({ "e2e4", "d7d5", "e4e5", "f7f5" }, 0x22a48b5a8e47ff78),
+    PolyglotKeyTest({ "e2e4", "d7d5", "e4e5", "f7f5", "e1e2" }, 0x652a607ca3f242c1),
+    PolyglotKeyTest({ "e2e4", "d7d5", "e4e5", "f7f5", "e1e2", "e8f7" }, 0x00fdd303c946bdd9),
+    PolyglotKeyTest({ "a2a4", "b7b5", "h2h4", "b5b4", "c2c4" }, 0x3c8123ea7b067637),
+    PolyglotKeyTest({ "a2a4", "b7b5", "h2h4", "b5b4", "c2c4", "b4c3", "a1a3" }, 0x5c3f9b829b279560),
+
+    PolyglotBookTest(),
+};
+
+}
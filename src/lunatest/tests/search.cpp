@@ -0,0 +1,368 @@
+#include "../lunatest.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+namespace lunachess::tests {
+
+struct NodeLimitTest {
+    std::string fen;
+    ui64 nodes;
+
+    NodeLimitTest(std::string_view fen, ui64 nodes)
+        : fen(fen), nodes(nodes) {}
+
+    void operator()() {
+        using namespace ai;
+
+        Position pos = Position::fromFen(fen).value();
+
+        SearchSettings settings;
+        settings.maxNodes = nodes;
+
+        AlphaBetaSearcher first;
+        SearchResults firstRes = first.search(pos, settings);
+
+        AlphaBetaSearcher second;
+        SearchResults secondRes = second.search(pos, settings);
+
+        // A few nodes may be visited after the limit before the search notices it.
+        LUNA_ASSERT(firstRes.visitedNodes <= nodes + 16,
+                    "Expected at most " << nodes << " nodes, got " << firstRes.visitedNodes);
+        LUNA_ASSERT(firstRes.visitedNodes == secondRes.visitedNodes,
+                    "Expected the same node count, got " << firstRes.visitedNodes << " and " << secondRes.visitedNodes);
+        LUNA_ASSERT(firstRes.bestMove == secondRes.bestMove,
+                    "Expected the same best move, got " << firstRes.bestMove << " and " << secondRes.bestMove);
+        LUNA_ASSERT(firstRes.depth == secondRes.depth,
+                    "Expected the same depth, got " << firstRes.depth << " and " << secondRes.depth);
+    }
+};
+
+/**
+ * Checks that every PV is made of legal moves, and that the principal variation
+ * reaches the search depth even when TT cutoffs cut it short during the search.
+ */
+struct PvLengthTest {
+    std::string fen;
+    int depth;
+    int multiPvCount;
+
+    PvLengthTest(std::string_view fen, int depth, int multiPvCount)
+        : fen(fen), depth(depth), multiPvCount(multiPvCount) {}
+
+    void operator()() {
+        using namespace ai;
+
+        Position pos = Position::fromFen(fen).value();
+
+        SearchSettings settings;
+        settings.maxDepth     = depth;
+        settings.multiPvCount = multiPvCount;
+
+        AlphaBetaSearcher searcher;
+        SearchResults res = searcher.search(pos, settings);
+
+        for (const SearchedVariation& pv: res.searchedVariations) {
+            Position replay = pos;
+            for (Move move: pv.moves) {
+                LUNA_ASSERT(replay.isMovePseudoLegal(move) && replay.isMoveLegal(move),
+                            "Illegal move " << move << " in the PV of " << fen);
+                replay.makeMove(move);
+            }
+        }
+
+        size_t pvLength = res.getPrincipalVariation().moves.size();
+        LUNA_ASSERT(pvLength >= size_t(depth),
+                    "Expected a PV of at least " << depth << " moves, got " << pvLength);
+    }
+};
+
+struct MateSearchTest {
+    std::string fen;
+    int mateIn;
+
+    MateSearchTest(std::string_view fen, int mateIn)
+        : fen(fen), mateIn(mateIn) {}
+
+    void operator()() {
+        using namespace ai;
+
+        Position pos = Position::fromFen(fen).value();
+
+        SearchSettings settings;
+        settings.mateIn = mateIn;
+
+        AlphaBetaSearcher searcher;
+        SearchResults res = searcher.search(pos, settings);
+
+        LUNA_ASSERT(res.bestScore >= FORCED_MATE_THRESHOLD,
+                    "Expected a mate score, got " << res.bestScore);
+
+        int movesToMate = (MATE_SCORE - res.bestScore + 1) / 2;
+        LUNA_ASSERT(movesToMate <= mateIn,
+                    "Expected a mate in " << mateIn << ", got a mate in " << movesToMate);
+        LUNA_ASSERT(res.depth < MAX_SEARCH_DEPTH, "Expected the search to stop after finding the mate.");
+    }
+};
+
+struct SearchTraceTest {
+    std::string fen;
+    int depth;
+
+    SearchTraceTest(std::string_view fen, int depth)
+        : fen(fen), depth(depth) {}
+
+    void operator()() {
+        using namespace ai;
+
+        Position pos = Position::fromFen(fen).value();
+        std::filesystem::path tracePath = std::filesystem::temp_directory_path() / "lunatest.lunatrace";
+
+        SearchSettings settings;
+        settings.maxDepth  = depth;
+        settings.trace     = true;
+        settings.traceFile = tracePath;
+
+        AlphaBetaSearcher searcher;
+        SearchResults res = searcher.search(pos, settings);
+
+        std::ifstream stream(tracePath, std::ios::binary);
+        std::vector<SearchTree> trees = readSearchTrace(stream);
+        stream.close();
+        std::filesystem::remove(tracePath);
+
+        LUNA_ASSERT(!trees.empty(), "Expected at least one traced tree.");
+
+        const SearchTree& tree = trees.back();
+        const auto& nodes      = tree.getNodes();
+        LUNA_ASSERT(tree.getDepth() == res.depth,
+                    "Expected the last tree to have depth " << res.depth << ", got " << tree.getDepth());
+
+        // Children always come before their parents.
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            for (ui32 child = nodes[i].lastChild; child != SearchTraceNode::NO_NODE; child = nodes[child].prevSibling) {
+                LUNA_ASSERT(child < i, "Node " << i << " links to child " << child << ", which comes after it.");
+            }
+        }
+
+        // The best move must be a PV child of the root.
+        const SearchTraceNode& root = nodes.back();
+        LUNA_ASSERT(BIT_INTERSECTS(root.flags, STF_PV), "Expected the root to be flagged as a PV node.");
+
+        bool foundBestMove = false;
+        for (ui32 child = root.lastChild; child != SearchTraceNode::NO_NODE; child = nodes[child].prevSibling) {
+            if (decompressTraceMove(pos, nodes[child].lastMove) == res.bestMove &&
+                BIT_INTERSECTS(nodes[child].flags, STF_PV)) {
+                foundBestMove = true;
+            }
+        }
+        LUNA_ASSERT(foundBestMove, "Expected " << res.bestMove << " to be a PV child of the root.");
+    }
+};
+
+struct SearchTraceFilterTest {
+    std::string fen;
+    std::string rootMove;
+    int depth;
+
+    SearchTraceFilterTest(std::string_view fen, std::string_view rootMove, int depth)
+        : fen(fen), rootMove(rootMove), depth(depth) {}
+
+    void operator()() {
+        using namespace ai;
+
+        Position pos = Position::fromFen(fen).value();
+        std::filesystem::path tracePath = std::filesystem::temp_directory_path() / "lunatest_filter.lunatrace";
+
+        SearchSettings settings;
+        settings.maxDepth             = depth;
+        settings.trace                = true;
+        settings.traceFile            = tracePath;
+        settings.traceFilter.rootMove = Move(pos, rootMove);
+        settings.traceFilter.maxPly   = 3;
+
+        AlphaBetaSearcher searcher;
+        searcher.search(pos, settings);
+
+        std::ifstream stream(tracePath, std::ios::binary);
+        std::vector<SearchTree> trees = readSearchTrace(stream);
+        stream.close();
+        std::filesystem::remove(tracePath);
+
+        LUNA_ASSERT(!trees.empty(), "Expected at least one traced tree.");
+
+        for (const SearchTree& tree: trees) {
+            const auto& nodes = tree.getNodes();
+            const SearchTraceNode& root = nodes.back();
+
+            // Only the filtered root move may be recorded under the root.
+            for (ui32 child = root.lastChild; child != SearchTraceNode::NO_NODE; child = nodes[child].prevSibling) {
+                LUNA_ASSERT(decompressTraceMove(pos, nodes[child].lastMove) == settings.traceFilter.rootMove,
+                            "Expected only " << rootMove << " under the root, found "
+                            << decompressTraceMove(pos, nodes[child].lastMove));
+            }
+
+            // The root plus at most three plies below it.
+            std::vector<int> plies(nodes.size(), 0);
+            for (size_t i = nodes.size(); i-- > 0;) {
+                LUNA_ASSERT(plies[i] <= 3, "Found a node at ply " << plies[i] << ", expected at most 3.");
+                for (ui32 child = nodes[i].lastChild; child != SearchTraceNode::NO_NODE; child = nodes[child].prevSibling) {
+                    plies[child] = plies[i] + 1;
+                }
+            }
+        }
+    }
+};
+
+/**
+ * Runs a traced search with the given filter and reads the traced trees back.
+ */
+static std::vector<ai::SearchTree> traceSearch(const Position& pos, int depth, const ai::SearchTraceFilter& filter) {
+    using namespace ai;
+
+    std::filesystem::path tracePath = std::filesystem::temp_directory_path() / "lunatest_filter.lunatrace";
+
+    SearchSettings settings;
+    settings.maxDepth    = depth;
+    settings.trace       = true;
+    settings.traceFile   = tracePath;
+    settings.traceFilter = filter;
+
+    AlphaBetaSearcher searcher;
+    searcher.search(pos, settings);
+
+    std::ifstream stream(tracePath, std::ios::binary);
+    std::vector<SearchTree> trees = readSearchTrace(stream);
+    stream.close();
+    std::filesystem::remove(tracePath);
+
+    LUNA_ASSERT(!trees.empty(), "Expected at least one traced tree.");
+    return trees;
+}
+
+static size_t countNodes(const std::vector<ai::SearchTree>& trees) {
+    size_t count = 0;
+    for (const ai::SearchTree& tree: trees) {
+        count += tree.getNodes().size();
+    }
+    return count;
+}
+
+struct SearchTracePvFilterTest {
+    std::string fen;
+    int depth;
+
+    SearchTracePvFilterTest(std::string_view fen, int depth)
+        : fen(fen), depth(depth) {}
+
+    void operator()() {
+        using namespace ai;
+
+        Position pos = Position::fromFen(fen).value();
+
+        SearchTraceFilter filter;
+        filter.pvNodesOnly = true;
+        std::vector<SearchTree> trees = traceSearch(pos, depth, filter);
+
+        for (const SearchTree& tree: trees) {
+            const auto& nodes = tree.getNodes();
+            LUNA_ASSERT(nodes.back().lastChild != SearchTraceNode::NO_NODE,
+                        "Expected the root to have at least one PV child.");
+
+            // The root is always recorded, every other node must be a PV node.
+            for (size_t i = 0; i + 1 < nodes.size(); ++i) {
+                LUNA_ASSERT(BIT_INTERSECTS(nodes[i].flags, STF_OPEN_WINDOW),
+                            "Node " << i << " was searched with a null window but was recorded.");
+            }
+        }
+
+        size_t allNodes = countNodes(traceSearch(pos, depth, SearchTraceFilter()));
+        LUNA_ASSERT(countNodes(trees) < allNodes,
+                    "Expected fewer nodes than the " << allNodes << " of an unfiltered trace, got " << countNodes(trees));
+    }
+};
+
+struct SearchTraceSampleTest {
+    std::string fen;
+    int depth;
+    int sampleRate;
+
+    SearchTraceSampleTest(std::string_view fen, int depth, int sampleRate)
+        : fen(fen), depth(depth), sampleRate(sampleRate) {}
+
+    void operator()() {
+        using namespace ai;
+
+        Position pos = Position::fromFen(fen).value();
+
+        SearchTraceFilter filter;
+        filter.sampleRate = sampleRate;
+        std::vector<SearchTree> sampled = traceSearch(pos, depth, filter);
+        std::vector<SearchTree> again   = traceSearch(pos, depth, filter);
+        std::vector<SearchTree> all     = traceSearch(pos, depth, SearchTraceFilter());
+
+        // Sampling is seeded by the tree, so searching again records the same nodes.
+        LUNA_ASSERT(sampled.size() == again.size(), "Expected the same number of trees in both sampled traces.");
+        for (size_t i = 0; i < sampled.size(); ++i) {
+            LUNA_ASSERT(sampled[i].getNodes().size() == again[i].getNodes().size(),
+                        "Tree " << i << " recorded " << sampled[i].getNodes().size() << " nodes, then "
+                        << again[i].getNodes().size() << " nodes.");
+        }
+
+        // A node at ply p is in a sampled subtree with a 1 - (1 - 1/rate)^p chance. Its
+        // ancestors are recorded as well, so somewhat more nodes than that are expected.
+        double expected = 0;
+        for (const SearchTree& tree: all) {
+            const auto& nodes = tree.getNodes();
+            std::vector<int> plies(nodes.size(), 0);
+            expected += 1;
+            for (size_t i = nodes.size(); i-- > 0;) {
+                if (plies[i] > 0) {
+                    expected += 1 - std::pow(1 - 1.0 / sampleRate, plies[i]);
+                }
+                for (ui32 child = nodes[i].lastChild; child != SearchTraceNode::NO_NODE; child = nodes[child].prevSibling) {
+                    plies[child] = plies[i] + 1;
+                }
+            }
+        }
+
+        size_t recorded = countNodes(sampled);
+        LUNA_ASSERT(recorded < countNodes(all), "Expected sampling to leave nodes out.");
+        LUNA_ASSERT(recorded >= expected * 0.7 && recorded <= expected * 1.4,
+                    "Expected about " << expected << " of " << countNodes(all) << " nodes to be recorded, got " << recorded);
+    }
+};
+
+std::vector<TestCase> nodeLimitTests = {
+    NodeLimitTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 20000),
+    NodeLimitTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 50000),
+    NodeLimitTest("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 10000),
+};
+
+std::vector<TestCase> pvLengthTests = {
+    PvLengthTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 1),
+    PvLengthTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 3),
+};
+
+std::vector<TestCase> mateSearchTests = {
+    MateSearchTest("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 1),
+    MateSearchTest("k7/8/2K5/8/8/8/8/7R w - - 0 1", 2),
+    MateSearchTest("r1bqkbnr/pppp1ppp/2n5/4p3/2B1P3/5Q2/PPPP1PPP/RNB1K1NR w KQkq - 0 1", 1),
+};
+
+std::vector<TestCase> searchTraceTests = {
+    SearchTraceTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6),
+    SearchTraceTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5),
+};
+
+std::vector<TestCase> searchTraceFilterTests = {
+    SearchTraceFilterTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "d2d4", 6),
+    SearchTraceFilterTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", "e2a6", 5),
+    SearchTracePvFilterTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6),
+    SearchTracePvFilterTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5),
+    SearchTraceSampleTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 8),
+    SearchTraceSampleTest("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 16),
+};
+
+}
@@ -0,0 +1,58 @@
+#include "../lunatest.h"
+
+#include <thread>
+
+namespace lunachess::tests {
+
+struct SpscQueueTest {
+    size_t capacity;
+    size_t nItems;
+
+    SpscQueueTest(size_t capacity, size_t nItems)
+        : capacity(capacity), nItems(nItems) {}
+
+    void operator()() {
+        SpscQueue<std::string> queue(capacity);
+        LUNA_ASSERT(queue.getCapacity() >= capacity, "Expected a capacity of at least " << capacity);
+
+        // A full queue rejects values without taking them.
+        for (size_t i = 0; i < queue.getCapacity(); ++i) {
+            LUNA_ASSERT(queue.tryPush(std::to_string(i)), "Expected push " << i << " to succeed.");
+        }
+        std::string rejected = "rejected";
+        LUNA_ASSERT(!queue.tryPush(std::move(rejected)), "Expected push to a full queue to fail.");
+        LUNA_ASSERT(rejected == "rejected", "Expected a rejected value to be left untouched.");
+
+        std::string val;
+        for (size_t i = 0; i < queue.getCapacity(); ++i) {
+            LUNA_ASSERT(queue.tryPop(val) && val == std::to_string(i), "Expected to pop " << i);
+        }
+        LUNA_ASSERT(queue.empty() && queue.front() == nullptr, "Expected the queue to be empty.");
+
+        // Values pushed by another thread arrive once and in order.
+        std::thread producer([&]() {
+            for (size_t i = 0; i < nItems; ++i) {
+                std::string item = std::to_string(i);
+                while (!queue.tryPush(std::move(item))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        for (size_t i = 0; i < nItems; ++i) {
+            while (!queue.tryPop(val)) {
+                std::this_thread::yield();
+            }
+            LUNA_ASSERT(val == std::to_string(i), "Expected item " << i << ", got " << val);
+        }
+        producer.join();
+        LUNA_ASSERT(queue.empty(), "Expected the queue to be empty.");
+    }
+};
+
+std::vector<TestCase> spscQueueTests = {
+    SpscQueueTest(1, 1000),
+    SpscQueueTest(3, 10000),
+    SpscQueueTest(1024, 100000),
+};
+
+}
@@ -0,0 +1,77 @@
+#include "../lunatest.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace lunachess::tests {
+
+struct ParallelForTest {
+    size_t nThreads;
+    size_t nItems;
+    size_t grain;
+
+    ParallelForTest(size_t nThreads, size_t nItems, size_t grain)
+        : nThreads(nThreads), nItems(nItems), grain(grain) {}
+
+    void operator()() {
+        ThreadPool pool(nThreads);
+
+        // Every item must be visited exactly once.
+        std::vector<std::atomic<int>> visits(nItems);
+        pool.parallelFor(0, nItems, grain, [&](size_t first, size_t last) {
+            LUNA_ASSERT(last - first <= std::max(grain, size_t(1)),
+                        "Expected ranges of at most " << grain << " items, got " << (last - first));
+            for (size_t i = first; i < last; ++i) {
+                visits[i]++;
+            }
+        });
+
+        for (size_t i = 0; i < nItems; ++i) {
+            LUNA_ASSERT(visits[i] == 1, "Item " << i << " was visited " << visits[i] << " times.");
+        }
+
+        // Ranges may start a parallelFor of their own.
+        std::atomic<size_t> nestedCount = 0;
+        pool.parallelFor(0, nItems, grain, [&](size_t first, size_t last) {
+            pool.parallelFor(0, last - first, 1, [&](size_t nestedFirst, size_t nestedLast) {
+                nestedCount += nestedLast - nestedFirst;
+            });
+        });
+        LUNA_ASSERT(nestedCount == nItems, "Expected " << nItems << " nested items, got " << nestedCount);
+
+        // The first exception thrown by a range must reach the caller.
+        bool caught = false;
+        try {
+            pool.parallelFor(0, nItems, grain, [](size_t, size_t) {
+                throw std::runtime_error("range failed");
+            });
+        }
+        catch (const std::runtime_error&) {
+            caught = true;
+        }
+        LUNA_ASSERT(caught || nItems == 0, "Expected the exception thrown by a range to be rethrown.");
+
+        // Tasks submitted alongside still run.
+        if (nThreads > 0) {
+            std::vector<std::future<size_t>> results;
+            for (size_t i = 0; i < nItems; ++i) {
+                results.push_back(pool.submit([i]() { return i * 2; }));
+            }
+            for (size_t i = 0; i < nItems; ++i) {
+                size_t res = results[i].get();
+                LUNA_ASSERT(res == i * 2, "Expected task " << i << " to return " << (i * 2) << ", got " << res);
+            }
+        }
+    }
+};
+
+std::vector<TestCase> parallelForTests = {
+    ParallelForTest(0, 100, 7),
+    ParallelForTest(1, 1000, 1),
+    ParallelForTest(4, 0, 16),
+    ParallelForTest(4, 10000, 64),
+    ParallelForTest(8, 12345, 100),
+    ParallelForTest(3, 5, 1000),
+};
+
+}
@@ -0,0 +1,127 @@
+#include "../lunatest.h"
+
+#include <cmath>
+
+namespace lunachess::tests {
+
+/**
+ * Starts the time manager with a time control and checks the limits it computes.
+ */
+struct TimeLimitsTest {
+    TimeControl tc;
+    i64 moveOverhead;
+    i64 expectedSoft;
+    i64 expectedHard;
+
+    TimeLimitsTest(TimeControl tc, i64 moveOverhead, i64 expectedSoft, i64 expectedHard)
+        : tc(tc), moveOverhead(moveOverhead), expectedSoft(expectedSoft), expectedHard(expectedHard) {}
+
+    void operator()() {
+        ai::TimeManager tm;
+        tm.start(tc, moveOverhead);
+
+        LUNA_ASSERT(tm.getSoftLimit() == expectedSoft,
+                    "Expected a soft limit of " << expectedSoft << "ms, got " << tm.getSoftLimit() << "ms");
+        LUNA_ASSERT(tm.getHardLimit() == expectedHard,
+                    "Expected a hard limit of " << expectedHard << "ms, got " << tm.getHardLimit() << "ms");
+
+        // Whatever the clock, limits stay within the time we have.
+        i64 available = std::max<i64>(1, tc.time - moveOverhead);
+        LUNA_ASSERT(tm.getSoftLimit() <= tm.getHardLimit() && tm.getHardLimit() <= available,
+                    "Expected soft <= hard <= available, got " << tm.getSoftLimit() << ", "
+                    << tm.getHardLimit() << " and " << available);
+    }
+};
+
+/**
+ * Checks the factors the soft limit is scaled by.
+ */
+struct TimeScaleTest {
+    static void expectScale(double nodeFraction, int scoreDrop, double changes, double expected) {
+        double scale = ai::TimeManager::getSoftLimitScale(nodeFraction, scoreDrop, changes);
+        LUNA_ASSERT(std::abs(scale - expected) < 1e-9,
+                    "Expected a scale of " << expected << " for node fraction " << nodeFraction
+                    << ", score drop " << scoreDrop << " and " << changes << " changes, got " << scale);
+    }
+
+    void operator()() {
+        // Node fraction: from 2 when no effort went into the best move, to 0.5 when all of it did.
+        expectScale(0.0, 0, 0, 2.0);
+        expectScale(0.5, 0, 0, 1.25);
+        expectScale(1.0, 0, 0, 0.5);
+
+        // Score: a drop of one pawn doubles the time, and scaling stays within [0.75, 2].
+        expectScale(1.0, 500, 0, 0.5 * 1.5);
+        expectScale(1.0, 1000, 0, 0.5 * 2.0);
+        expectScale(1.0, 100000, 0, 0.5 * 2.0);
+        expectScale(1.0, -100, 0, 0.5 * 0.9);
+        expectScale(1.0, -100000, 0, 0.5 * 0.75);
+
+        // Instability: half of the time again per recent best move change.
+        expectScale(1.0, 0, 1, 0.5 * 1.5);
+        expectScale(1.0, 0, 2, 0.5 * 2.0);
+
+        // Bounds with a stable best move.
+        expectScale(1.0, -100000, 0, 0.375);
+        expectScale(0.0, 100000, 0, 4.0);
+    }
+};
+
+/**
+ * Feeds iterations to the time manager and checks that best move changes decay
+ * and scale the soft limit.
+ */
+struct TimeInstabilityTest {
+    void operator()() {
+        Position pos = Position::getInitialPosition();
+        MoveList moves;
+        movegen::generate(pos, moves);
+        Move first  = moves[0];
+        Move second = moves[1];
+
+        ai::TimeManager tm;
+        tm.start(TimeControl(600000, 0, TC_TOURNAMENT), 0);
+        double softLimit = static_cast<double>(tm.getSoftLimit());
+        LUNA_ASSERT(tm.getScaledSoftLimit() == softLimit, "Expected the soft limit to start unscaled");
+
+        // Half of the nodes go into the best move, and the score never changes.
+        auto iterate = [&](int depth, Move bestMove) {
+            ai::SearchResults res;
+            res.depth        = depth;
+            res.bestMove     = bestMove;
+            res.bestScore    = 0;
+            res.visitedNodes = 1000;
+            tm.onNewDepth(res, 500);
+        };
+
+        iterate(4, first);
+        LUNA_ASSERT(tm.getBestMoveChanges() == 0, "Expected no best move changes on the first iteration");
+        iterate(5, second);
+        LUNA_ASSERT(tm.getBestMoveChanges() == 1, "Expected one best move change, got " << tm.getBestMoveChanges());
+        LUNA_ASSERT(std::abs(tm.getScaledSoftLimit() - softLimit * 1.25 * 1.5) < 1e-6,
+                    "Expected the change to scale the soft limit, got " << tm.getScaledSoftLimit());
+
+        iterate(6, second);
+        iterate(7, second);
+        LUNA_ASSERT(tm.getBestMoveChanges() == 0.25, "Expected the change to decay, got " << tm.getBestMoveChanges());
+        LUNA_ASSERT(std::abs(tm.getScaledSoftLimit() - softLimit * 1.25 * 1.125) < 1e-6,
+                    "Expected the decayed change to scale the soft limit, got " << tm.getScaledSoftLimit());
+        LUNA_ASSERT(!tm.timeIsUp(), "Expected time to be left");
+    }
+};
+
+std::vector<TestCase> timeManagerTests = {
+    // time / 20 + increment * 3 / 4, and the hard limit at a third of the time plus increment.
+    TimeLimitsTest(TimeControl(60000, 0, TC_TOURNAMENT), 80, 3000, 15000),
+    TimeLimitsTest(TimeControl(10000, 1000, TC_TOURNAMENT), 50, 1250, 4316),
+    TimeLimitsTest(TimeControl(300000, 3000, TC_TOURNAMENT), 80, 17250, 86250),
+    // Clamped to the available time.
+    TimeLimitsTest(TimeControl(1000, 2000, TC_TOURNAMENT), 80, 920, 920),
+    TimeLimitsTest(TimeControl(50, 0, TC_TOURNAMENT), 80, 1, 1),
+    // Fixed time per move.
+    TimeLimitsTest(TimeControl(500, 0, TC_MOVETIME), 80, 420, 420),
+    TimeScaleTest(),
+    TimeInstabilityTest(),
+};
+
+}
@@ -0,0 +1,208 @@
+#include "../lunatest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace lunachess::tests {
+
+/**
+ * Saves, loads and file-maps transposition tables filled by a search, and checks
+ * that the entries survive.
+ */
+struct TTPersistenceTest {
+    std::string fen;
+    int depth;
+
+    TTPersistenceTest(std::string_view fen, int depth)
+        : fen(fen), depth(depth) {}
+
+    static void expectSameEntries(const ai::TranspositionTable& expected, const ai::TranspositionTable& actual,
+                                  const std::vector<ui64>& keys) {
+        LUNA_ASSERT(actual.getCount() == expected.getCount(),
+                    "Expected " << expected.getCount() << " entries, got " << actual.getCount());
+        for (ui64 key: keys) {
+            ai::TranspositionTable::Entry a, b;
+            bool foundA = expected.probe(key, a);
+            bool foundB = actual.probe(key, b);
+            LUNA_ASSERT(foundA == foundB, "Entry of key " << key << " was " << (foundA ? "lost" : "created"));
+            LUNA_ASSERT(!foundA || (a.move == b.move && a.score == b.score && a.depth == b.depth && a.type == b.type),
+                        "Entry of key " << key << " changed");
+        }
+    }
+
+    void operator()() {
+        namespace fs = std::filesystem;
+
+        Position pos = Position::fromFen(fen).value();
+        ai::AlphaBetaSearcher searcher;
+        searcher.getTT().resize(1024 * 1024);
+        ai::SearchSettings settings;
+        settings.maxDepth = depth;
+        searcher.search(pos, settings);
+        const ai::TranspositionTable& tt = searcher.getTT();
+        LUNA_ASSERT(tt.getCount() > 0, "Expected the search to fill the table");
+
+        // Keys of every position a few plies away from the root.
+        std::vector<ui64> keys;
+        std::function<void(int)> collectKeys = [&](int plies) {
+            keys.push_back(pos.getZobrist());
+            if (plies == 0) {
+                return;
+            }
+            MoveList moves;
+            movegen::generate(pos, moves);
+            for (Move move: moves) {
+                pos.makeMove(move);
+                collectKeys(plies - 1);
+                pos.undoMove();
+            }
+        };
+        collectKeys(2);
+
+        fs::path path = fs::temp_directory_path() / "lunatest.luntt";
+        LUNA_ASSERT(tt.save(path), "Failed to save the table");
+
+        // A table of any size takes the size of the saved one.
+        ai::TranspositionTable loaded(64 * 1024);
+        LUNA_ASSERT(loaded.load(path), "Failed to load the table");
+        LUNA_ASSERT(loaded.getCapacity() == tt.getCapacity(), "Expected the loaded table to keep its size");
+        expectSameEntries(tt, loaded, keys);
+
+        // File backed tables keep their entries between mappings of the same size.
+        fs::path mappedPath = fs::temp_directory_path() / "lunatest_mapped.luntt";
+        fs::remove(mappedPath);
+        {
+            ai::TranspositionTable mapped(64 * 1024);
+            if (!mapped.mapFile(mappedPath, 1024 * 1024)) {
+                // Platform without mappings.
+                fs::remove(path);
+                return;
+            }
+            LUNA_ASSERT(mapped.isFileBacked() && mapped.getCount() == 0, "Expected a new mapping to be empty");
+            LUNA_ASSERT(mapped.load(path) && mapped.isFileBacked(), "Expected a table of the same size to load into the mapping");
+        }
+        {
+            ai::TranspositionTable mapped;
+            LUNA_ASSERT(mapped.mapFile(mappedPath, 1024 * 1024), "Failed to map the table again");
+            expectSameEntries(tt, mapped, keys);
+
+            // Mapped files are in the format of saved tables.
+            ai::TranspositionTable fromMapping;
+            LUNA_ASSERT(fromMapping.load(mappedPath), "Failed to load a mapped table");
+            expectSameEntries(tt, fromMapping, keys);
+
+            // Moving the table back to memory drops the entries.
+            mapped.resize(1024 * 1024);
+            LUNA_ASSERT(!mapped.isFileBacked() && mapped.getCount() == 0, "Expected resize to unmap the table");
+        }
+        {
+            // Remapping the file a table is mapped to keeps the entries of the
+            // search that ran since it was mapped, along with their count.
+            fs::path searchedPath = fs::temp_directory_path() / "lunatest_searched.luntt";
+            fs::remove(searchedPath);
+            ai::AlphaBetaSearcher mappedSearcher;
+            ai::TranspositionTable& mapped = mappedSearcher.getTT();
+            LUNA_ASSERT(mapped.mapFile(searchedPath, 1024 * 1024), "Failed to map the table for a search");
+            ai::SearchSettings mappedSettings;
+            mappedSettings.maxDepth = depth;
+            mappedSearcher.search(pos, mappedSettings);
+            LUNA_ASSERT(mapped.getCount() > 0, "Expected the search to fill the mapped table");
+
+            fs::path copyPath = fs::temp_directory_path() / "lunatest_mapped_copy.luntt";
+            LUNA_ASSERT(mapped.save(copyPath), "Failed to save the mapped table");
+            ai::TranspositionTable copy;
+            LUNA_ASSERT(copy.load(copyPath), "Failed to load the copy of the mapped table");
+            fs::remove(copyPath);
+
+            LUNA_ASSERT(mapped.mapFile(searchedPath, 1024 * 1024), "Failed to remap the table");
+            expectSameEntries(copy, mapped, keys);
+
+            mapped.resize(1024 * 1024);
+            fs::remove(searchedPath);
+        }
+        {
+            // A mapping of a different size starts empty.
+            ai::TranspositionTable mapped;
+            LUNA_ASSERT(mapped.mapFile(mappedPath, 512 * 1024), "Failed to remap the table");
+            LUNA_ASSERT(mapped.getCount() == 0, "Expected a resized mapping to be empty");
+        }
+
+        // Invalid files are rejected without touching the table.
+        {
+            std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+            stream << "not a table";
+        }
+        LUNA_ASSERT(!loaded.load(path), "Expected an invalid file to be rejected");
+        expectSameEntries(tt, loaded, keys);
+
+        // Mapping a file that is neither empty nor a table fails, and leaves both
+        // the file and the table alone. Sizes below and above a header are tried.
+        std::string longText;
+        for (int i = 0; i < 200; ++i) {
+            longText += "1. e4 e5 2. Nf3 Nc6 ";
+        }
+        for (const std::string& text: { std::string("not a table"), longText }) {
+            {
+                std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+                stream << text;
+            }
+            LUNA_ASSERT(!loaded.mapFile(path, 1024 * 1024), "Expected mapping a file that isn't a table to fail");
+            LUNA_ASSERT(!loaded.isFileBacked(), "Expected the table to stay in memory");
+            expectSameEntries(tt, loaded, keys);
+
+            std::ifstream stream(path, std::ios::binary);
+            std::string contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+            LUNA_ASSERT(contents == text, "Expected a file that isn't a table to be left untouched");
+        }
+
+        fs::remove(path);
+        fs::remove(mappedPath);
+    }
+};
+
+/**
+ * Fills a table and clears it. Large tables are cleared by several threads.
+ */
+struct TTClearTest {
+    size_t sizeBytes;
+
+    TTClearTest(size_t sizeBytes)
+        : sizeBytes(sizeBytes) {}
+
+    void operator()() {
+        ai::TranspositionTable tt(sizeBytes);
+        size_t capacity = tt.getCapacity();
+
+        // Spread the keys over the whole table, so that every chunk gets entries.
+        std::vector<ui64> keys;
+        for (size_t i = 0; i < 4096; ++i) {
+            ai::TranspositionTable::Entry entry;
+            entry.zobristKey = i * (capacity / 4096) + 1;
+            entry.depth      = 1;
+            tt.maybeAdd(entry);
+            keys.push_back(entry.zobristKey);
+        }
+        LUNA_ASSERT(tt.getCount() == keys.size(), "Expected " << keys.size() << " entries, got " << tt.getCount());
+
+        tt.clear();
+        LUNA_ASSERT(tt.getCount() == 0, "Expected a cleared table to be empty");
+        LUNA_ASSERT(tt.getCapacity() == capacity, "Expected clear to keep the size of the table");
+        for (ui64 key: keys) {
+            ai::TranspositionTable::Entry entry;
+            LUNA_ASSERT(!tt.probe(key, entry), "Entry of key " << key << " survived the clear");
+        }
+    }
+};
+
+std::vector<TestCase> ttClearTests = {
+    TTClearTest(1024 * 1024),
+    TTClearTest(300 * 1024 * 1024),
+};
+
+std::vector<TestCase> ttPersistenceTests = {
+    TTPersistenceTest("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6),
+    TTPersistenceTest("r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", 5),
+};
+
+}
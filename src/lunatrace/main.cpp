@@ -0,0 +1,121 @@
+#include <lunachess.h>
+
+#include <popl/popl.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+
+namespace fs = std::filesystem;
+using namespace lunachess;
+using namespace lunachess::ai;
+
+struct Settings {
+    fs::path inPath;
+    std::optional<fs::path> outPath = std::nullopt;
+
+    /** Index of the tree to convert. Negative values count from the last tree. */
+    int tree = -1;
+
+    bool list = false;
+};
+
+static Settings processArgs(int argc, char* argv[]) {
+    try {
+        Settings settings;
+
+        popl::OptionParser op("Converts search traces recorded by Luna (see the TraceSearchTree option) to JSON.\nUsage");
+
+        auto optHelp = op.add<popl::Switch>("h", "help", "Explains lunatrace's usage.");
+
+        auto optIn = op.add<popl::Value<std::string>>("i", "input",
+                                                      "Path to the search trace file.");
+
+        auto optOut = op.add<popl::Value<std::string>>("o", "o",
+                                                       "Path to the output JSON file. If not set, the JSON is written to stdout.");
+
+        auto optTree = op.add<popl::Value<int>>("t", "tree",
+                                                "Index of the tree to convert. A search records one tree per iteration "
+                                                "and aspiration window. Negative indexes count from the last tree.", -1);
+
+        auto optList = op.add<popl::Switch>("l", "list",
+                                            "Lists the trees in the trace file instead of converting one.");
+
+        op.parse(argc, argv);
+
+        if (optHelp->value()) {
+            // Display help and exit
+            std::cout << op << std::endl;
+            std::exit(EXIT_SUCCESS);
+        }
+
+        if (!optIn->is_set()) {
+            throw std::runtime_error("An input path must be provided.");
+        }
+
+        settings.inPath = optIn->value();
+        settings.tree   = optTree->value();
+        settings.list   = optList->value();
+        if (optOut->is_set()) {
+            settings.outPath = optOut->value();
+        }
+
+        return settings;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Usage error: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    lunachess::initializeEverything();
+
+    Settings settings = processArgs(argc, argv);
+
+    try {
+        std::ifstream inStream(settings.inPath, std::ios::binary);
+        if (!inStream) {
+            throw std::runtime_error("Could not open " + settings.inPath.string() + ".");
+        }
+
+        std::vector<SearchTree> trees = readSearchTrace(inStream);
+        if (trees.empty()) {
+            throw std::runtime_error("The trace file doesn't contain any finished tree.");
+        }
+
+        if (settings.list) {
+            for (size_t i = 0; i < trees.size(); ++i) {
+                std::cout << i << ": depth " << trees[i].getDepth()
+                          << ", " << trees[i].getNodeCount() << " nodes" << std::endl;
+            }
+            return EXIT_SUCCESS;
+        }
+
+        int treeIdx = settings.tree < 0 ? static_cast<int>(trees.size()) + settings.tree : settings.tree;
+        if (treeIdx < 0 || treeIdx >= static_cast<int>(trees.size())) {
+            throw std::runtime_error("Tree " + std::to_string(settings.tree) + " not found, the trace has "
+                                     + std::to_string(trees.size()) + " trees.");
+        }
+
+        if (settings.outPath.has_value()) {
+            std::ofstream outStream(*settings.outPath);
+            outStream.exceptions(std::ios::badbit | std::ios::failbit);
+            outStream << trees[treeIdx] << std::endl;
+
+            std::cout << "Saved tree " << treeIdx << " to " << fs::absolute(*settings.outPath) << "." << std::endl;
+        }
+        else {
+            std::cout << trees[treeIdx] << std::endl;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
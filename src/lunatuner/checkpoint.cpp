@@ -0,0 +1,54 @@
+#include "checkpoint.h"
+
+namespace lunachess::tuner {
+
+void to_json(nlohmann::json& j, const Checkpoint& ckpt) {
+    j["version"]      = Checkpoint::VERSION;
+    j["weights"]      = ckpt.flatWeights;
+    j["k"]            = ckpt.k;
+    j["kFitted"]      = ckpt.kFitted;
+    j["iteration"]    = ckpt.iteration;
+    j["nextParam"]    = ckpt.nextParam;
+    j["parameters"]   = ckpt.parameters;
+    j["step"]         = ckpt.step;
+    j["lastError"]    = ckpt.lastError;
+    j["finished"]     = ckpt.finished;
+    j["dataset"]      = {
+        { "path",  ckpt.datasetPath },
+        { "size",  ckpt.datasetSize },
+        { "flags", ckpt.datasetFlags },
+    };
+}
+
+void from_json(const nlohmann::json& j, Checkpoint& ckpt) {
+    int version = j.at("version");
+    if (version != Checkpoint::VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version " + std::to_string(version) + ".");
+    }
+
+    ckpt.flatWeights  = j.at("weights");
+    ckpt.k            = j.at("k");
+    ckpt.kFitted      = j.at("kFitted");
+    ckpt.iteration    = j.at("iteration");
+    ckpt.nextParam    = j.at("nextParam");
+    ckpt.parameters   = j.at("parameters").get<std::vector<std::string>>();
+    ckpt.step         = j.at("step");
+    ckpt.lastError    = j.at("lastError");
+    ckpt.finished     = j.at("finished");
+
+    const auto& dataset = j.at("dataset");
+    ckpt.datasetPath  = dataset.at("path");
+    ckpt.datasetSize  = dataset.at("size");
+    ckpt.datasetFlags = dataset.at("flags");
+}
+
+void saveCheckpoint(const Checkpoint& ckpt, const fs::path& path) {
+    nlohmann::json j = ckpt;
+    utils::writeToFileAtomically(path, j.dump(2));
+}
+
+Checkpoint loadCheckpoint(const fs::path& path) {
+    return nlohmann::json::parse(utils::readFromFile(path)).get<Checkpoint>();
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef LUNATUNER_CHECKPOINT_H
+#define LUNATUNER_CHECKPOINT_H
+
+#include <lunachess.h>
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace lunachess::tuner {
+
+namespace fs = std::filesystem;
+
+/**
+ * Snapshot of a tuning run, written after every tuned parameter.
+ * Resuming from a checkpoint continues the run at the first parameter
+ * that wasn't tuned yet.
+ */
+struct Checkpoint {
+    static constexpr int VERSION = 1;
+
+    /** Flattened weights, as used by the tuning loop. */
+    nlohmann::json flatWeights;
+
+    double k = 0;
+
+    /** Whether 'k' was already fitted to the dataset. */
+    bool kFitted = false;
+
+    /** Index of the current repetition of the tuning process. */
+    int iteration = 0;
+
+    /** Index, in 'parameters', of the next parameter to be tuned. */
+    size_t nextParam = 0;
+
+    /** Ordered list of the parameters being tuned. */
+    std::vector<std::string> parameters;
+
+    int step = 0;
+
+    /** Mean squared error of the last tuned parameter. */
+    double lastError = 0;
+
+    bool finished = false;
+
+    // Used to detect attempts of resuming with a different dataset.
+    std::string datasetPath;
+    ui64 datasetSize  = 0;
+    ui32 datasetFlags = 0;
+};
+
+void to_json(nlohmann::json& j, const Checkpoint& ckpt);
+void from_json(const nlohmann::json& j, Checkpoint& ckpt);
+
+/**
+ * Atomically replaces the checkpoint file at the given path.
+ */
+void saveCheckpoint(const Checkpoint& ckpt, const fs::path& path);
+
+Checkpoint loadCheckpoint(const fs::path& path);
+
+}
+
+#endif // LUNATUNER_CHECKPOINT_H
@@ -0,0 +1,165 @@
+#include "dataset.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace lunachess::tuner {
+
+bool isBinaryDataset(const fs::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+    char magic[sizeof(DatasetHeader::MAGIC)];
+    if (!stream.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, DatasetHeader::MAGIC, sizeof(magic)) == 0;
+}
+
+fs::path getBinaryDatasetPath(const fs::path& csvPath) {
+    fs::path binPath = csvPath;
+    binPath += ".bin";
+    return binPath;
+}
+
+fs::path getQuiescedDatasetPath(const fs::path& dataPath, ui32 quiesceFlag, ui64 weightsHash) {
+    fs::path binPath = dataPath;
+    if (quiesceFlag == DSF_QUIESCED_SEARCH) {
+        std::stringstream ss;
+        ss << ".qsearch." << std::hex << std::setw(16) << std::setfill('0') << weightsHash << ".bin";
+        binPath += ss.str();
+    }
+    else {
+        binPath += ".qmaterial.bin";
+    }
+    return binPath;
+}
+
+InputData parseCsvDataset(const fs::path& path, size_t maxPositions) {
+    std::cout << "Parsing data from " << path << std::endl;
+    std::ifstream stream(path);
+    stream.exceptions(std::ios_base::badbit);
+
+    InputData inputData;
+
+    std::string line;
+    std::vector<std::string_view> tokens;
+    while (std::getline(stream, line)) {
+        if (inputData.entries.size() >= maxPositions) {
+            inputData.complete = false;
+            break;
+        }
+
+        tokens.clear();
+        strutils::split(line, tokens, ",");
+        if (tokens.size() < 2) {
+            continue;
+        }
+
+        std::string_view fen     = tokens[0];
+        std::string_view evalStr = tokens[1];
+
+        double eval  = std::stod(std::string(evalStr));
+        Position pos = Position::fromFen(fen).value();
+
+        inputData.entries.emplace_back(std::move(pos), eval);
+    }
+
+    std::cout << "Succesfully parsed " << inputData.entries.size()
+              << " positions from " << path << std::endl;
+
+    return inputData;
+}
+
+InputData loadBinaryDataset(const fs::path& path, size_t maxPositions) {
+    std::cout << "Loading binary dataset from " << path << std::endl;
+
+    MappedFile file;
+    if (!file.open(path)) {
+        throw std::runtime_error("Could not open dataset file.");
+    }
+    if (file.size() < sizeof(DatasetHeader)) {
+        throw std::runtime_error("Dataset file is too small.");
+    }
+
+    DatasetHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, DatasetHeader::MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not a binary tuning dataset.");
+    }
+    if (header.version != DatasetHeader::VERSION && header.version != FenDatasetRecord::VERSION) {
+        throw std::runtime_error("Unsupported dataset version " + std::to_string(header.version) + ".");
+    }
+    bool fenRecords   = header.version == FenDatasetRecord::VERSION;
+    size_t recordSize = fenRecords ? sizeof(FenDatasetRecord) : sizeof(DatasetRecord);
+    if (file.size() < sizeof(DatasetHeader) + header.count * recordSize) {
+        throw std::runtime_error("Dataset file is truncated.");
+    }
+
+    InputData inputData;
+    inputData.flags    = header.flags;
+    inputData.complete = header.count <= maxPositions;
+
+    size_t count = std::min(static_cast<size_t>(header.count), maxPositions);
+    inputData.entries.reserve(count);
+
+    const ui8* recordData = file.data() + sizeof(DatasetHeader);
+    for (size_t i = 0; i < count; ++i) {
+        std::optional<Position> pos;
+        double expectedScore;
+
+        if (fenRecords) {
+            FenDatasetRecord record;
+            std::memcpy(&record, recordData + i * recordSize, sizeof(record));
+            record.fen[FenDatasetRecord::MAX_FEN_LENGTH] = '\0';
+            pos           = Position::fromFen(record.fen);
+            expectedScore = record.expectedScore;
+        }
+        else {
+            DatasetRecord record;
+            std::memcpy(&record, recordData + i * recordSize, sizeof(record));
+            pos           = Position::fromPacked(record.position);
+            expectedScore = record.expectedScore;
+        }
+
+        if (!pos.has_value()) {
+            throw std::runtime_error("Invalid position in dataset record " + std::to_string(i) + ".");
+        }
+        inputData.entries.emplace_back(std::move(*pos), expectedScore);
+    }
+
+    std::cout << "Loaded " << inputData.entries.size() << " positions from " << path << std::endl;
+
+    return inputData;
+}
+
+void saveBinaryDataset(const InputData& data, const fs::path& path) {
+    fs::path tmpPath = path;
+    tmpPath += ".tmp";
+
+    {
+        std::ofstream stream(tmpPath, std::ios::binary | std::ios::trunc);
+        stream.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+
+        DatasetHeader header = {};
+        std::memcpy(header.magic, DatasetHeader::MAGIC, sizeof(header.magic));
+        header.version = DatasetHeader::VERSION;
+        header.flags   = data.flags;
+        header.count   = data.entries.size();
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        DatasetRecord record;
+        for (const DataEntry& entry: data.entries) {
+            std::memset(&record, 0, sizeof(record));
+            record.position      = entry.position.toPacked();
+            record.expectedScore = entry.expectedScore;
+
+            stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+    }
+
+    fs::rename(tmpPath, path);
+}
+
+}
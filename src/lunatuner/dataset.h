@@ -0,0 +1,120 @@
+#ifndef LUNATUNER_DATASET_H
+#define LUNATUNER_DATASET_H
+
+#include <lunachess.h>
+
+#include <filesystem>
+#include <vector>
+
+namespace lunachess::tuner {
+
+namespace fs = std::filesystem;
+
+enum DatasetFlags : ui32 {
+    DSF_NONE              = 0,
+
+    /** Positions were quiesced with the tuner's material-only quiescence search. */
+    DSF_QUIESCED_MATERIAL = BIT(0),
+
+    /** Positions were quiesced with the engine's quiescence search. */
+    DSF_QUIESCED_SEARCH   = BIT(1),
+};
+
+struct DataEntry {
+    Position position;
+    double   expectedScore;
+
+    inline DataEntry(Position pos, double expectedScore)
+        : position(std::move(pos)), expectedScore(expectedScore) {}
+};
+
+struct InputData {
+    std::vector<DataEntry> entries;
+
+    /** Combination of DatasetFlags describing how the entries were preprocessed. */
+    ui32 flags = DSF_NONE;
+
+    /**
+     * Whether every position of the dataset file is loaded. Partially loaded datasets
+     * are never written back, since that would discard the positions that were left out.
+     */
+    bool complete = true;
+};
+
+/**
+ * Binary tuning datasets start with this header, followed by 'count'
+ * fixed size records. This lets the tuner skip CSV parsing on subsequent
+ * runs, and 'flags' records the preprocessing steps (such as quiescing)
+ * the positions went through.
+ *
+ * Version 1 datasets store positions as FEN, which still has to be parsed
+ * on load. Version 2 datasets store packed positions, which skips FEN parsing
+ * as well. Both can be loaded, but only version 2 datasets are written.
+ */
+struct DatasetHeader {
+    static constexpr char MAGIC[4] = { 'L', 'T', 'D', 'S' };
+    static constexpr ui32 VERSION  = 2;
+
+    char magic[4];
+    ui32 version;
+    ui32 flags;
+    ui32 reserved;
+    ui64 count;
+};
+
+struct DatasetRecord {
+    PackedPosition position;
+    double         expectedScore;
+};
+
+/**
+ * Records of version 1 datasets.
+ */
+struct FenDatasetRecord {
+    static constexpr ui32   VERSION        = 1;
+    static constexpr size_t MAX_FEN_LENGTH = 95;
+
+    char   fen[MAX_FEN_LENGTH + 1];
+    double expectedScore;
+};
+
+/**
+ * Returns true if the file at the given path starts with a binary
+ * dataset header.
+ */
+bool isBinaryDataset(const fs::path& path);
+
+/**
+ * Returns the path of the binary dataset that caches a CSV dataset.
+ */
+fs::path getBinaryDatasetPath(const fs::path& csvPath);
+
+/**
+ * Returns the path of the binary dataset that holds the positions of a dataset
+ * after being quiesced as described by 'quiesceFlag' (one of the DSF_QUIESCED_*
+ * flags). Quiesced positions are kept apart from the CSV cache, so that runs
+ * that don't quiesce never load them.
+ *
+ * The engine's quiescence search depends on the weights it evaluates with, so
+ * positions it quiesced are stored per 'weightsHash'. The material-only search
+ * ignores it.
+ */
+fs::path getQuiescedDatasetPath(const fs::path& dataPath, ui32 quiesceFlag, ui64 weightsHash);
+
+/**
+ * Parses a CSV dataset in which each line is in the format 'fen,score'.
+ */
+InputData parseCsvDataset(const fs::path& path, size_t maxPositions);
+
+InputData loadBinaryDataset(const fs::path& path, size_t maxPositions);
+
+/**
+ * Writes the given data as a binary dataset. The file is first written
+ * to a temporary path and then renamed, so an interrupted write never
+ * leaves a truncated dataset behind.
+ */
+void saveBinaryDataset(const InputData& data, const fs::path& path);
+
+}
+
+#endif // LUNATUNER_DATASET_H
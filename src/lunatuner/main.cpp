@@ -1,5 +1,8 @@
 #include <lunachess.h>
 
+#include "checkpoint.h"
+#include "dataset.h"
+
 #include <popl/popl.h>
 #include <incbin/incbin.h>
 
@@ -11,46 +14,102 @@
 #include <cstdlib>
 #include <memory>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace fs = std::filesystem;
 using namespace lunachess;
 using namespace lunachess::ai;
+using namespace lunachess::tuner;
 
 /** If a parameter priority is set to this value, it will be skipped. */
 constexpr int PRIO_SKIP = -99999;
 
+enum class QuiesceMode {
+    NONE,
+
+    /** Quiesce with a fast qsearch that only takes material into account. */
+    MATERIAL,
+
+    /** Quiesce with the engine's qsearch, using the base weights. */
+    SEARCH,
+};
+
 struct Settings {
     fs::path tunerDataPath;
     fs::path outPath;
     std::optional<fs::path> baseWeightsPath = std::nullopt;
     int threads  = 1;
     double k     = 0.120;
-    bool quiesce = false;
+    QuiesceMode quiesceMode = QuiesceMode::NONE;
     int repeat   = 0;
     int step     = 2;
     size_t maxPos = 1000000000;
+    bool fitK    = true;
+
+    fs::path checkpointPath;
+    bool resume  = false;
+
+    std::optional<fs::path> jobsPath = std::nullopt;
+    std::string jobName;
+    int maxThreads = 1;
 
     std::unordered_map<std::string, int> paramPriorities;
 };
 
-struct DataEntry {
-    Position position;
-    double   expectedScore;
+static std::mutex s_LogMutex;
+
+/**
+ * Buffers a log line and writes it to stdout once destroyed, so that lines
+ * coming from concurrent jobs don't get mixed. Lines are prefixed with the
+ * name of the job that produced them.
+ */
+class LogLine {
+public:
+    inline explicit LogLine(const Settings& settings) {
+        if (!settings.jobName.empty()) {
+            m_Stream << '[' << settings.jobName << "] ";
+        }
+    }
 
-    inline DataEntry(Position pos, double expectedScore)
-        : position(std::move(pos)), expectedScore(expectedScore) {}
-};
+    template <typename T>
+    inline LogLine& operator<<(const T& val) {
+        m_Stream << val;
+        return *this;
+    }
+
+    inline ~LogLine() {
+        std::unique_lock lock(s_LogMutex);
+        std::cout << m_Stream.str() << std::endl;
+    }
 
-struct InputData {
-    std::vector<DataEntry> entries;
+private:
+    std::stringstream m_Stream;
 };
 
 INCTXT(_DefaultParamPriorities, PRIORITIES_FILE);
 
-static int quiescenceSearch(Position& pos,
-                            Move* pv,
-                            int alpha = INT_MIN,
-                            int beta = INT_MAX) {
+/** Maximum depth of the tuner's material-only quiescence search. */
+constexpr int MATERIAL_QS_MAX_PLY = 64;
+
+/**
+ * Per-thread state of the material-only quiescence search. Holds the triangular
+ * principal variation table, so quiescing a position doesn't allocate.
+ */
+struct MaterialQSearchContext {
+    MoveOrderingData moveOrderingData;
+    std::array<std::array<Move, MATERIAL_QS_MAX_PLY>, MATERIAL_QS_MAX_PLY> pv;
+    std::array<int, MATERIAL_QS_MAX_PLY> pvLength;
+};
+
+static int materialQuiescenceSearch(MaterialQSearchContext& ctx,
+                                    Position& pos,
+                                    int ply,
+                                    int alpha,
+                                    int beta) {
+    ctx.pvLength[ply] = ply;
+
     Color c = pos.getColorToMove();
     int standPat =
             100  * (pos.getBitboard(WHITE_PAWN).count()   - pos.getBitboard(BLACK_PAWN).count()) +
@@ -66,15 +125,24 @@ static int quiescenceSearch(Position& pos,
     }
     if (standPat > alpha) {
         alpha = standPat;
-        *(pv + 1) = MOVE_INVALID;
+    }
+    if (ply >= MATERIAL_QS_MAX_PLY - 1) {
+        return alpha;
     }
 
-    MoveList moves;
-    movegen::generate<MTM_NOISY>(pos, moves);
+    // Noisy moves come out of the cursor in MVV-LVA order, with captures
+    // that lose material (according to SEE) last. These are skipped, just
+    // like in the engine's quiescence search.
+    MoveCursor<true> moveCursor;
+    Move move;
+    while ((move = moveCursor.next(pos, ctx.moveOrderingData, ply))) {
+        if (move.getType() == MT_SIMPLE_CAPTURE &&
+            moveCursor.getCurrentStage() == MCS_BAD_CAPTURES) {
+            continue;
+        }
 
-    for (Move move: moves) {
         pos.makeMove(move);
-        int score = -quiescenceSearch(pos, pv + 1, -beta, -alpha);
+        int score = -materialQuiescenceSearch(ctx, pos, ply + 1, -beta, -alpha);
         pos.undoMove();
 
         if (score >= beta) {
@@ -83,57 +151,72 @@ static int quiescenceSearch(Position& pos,
 
         if (score > alpha) {
             alpha = score;
-            *pv   = move;
+
+            // Update the principal variation
+            ctx.pv[ply][ply] = move;
+            for (int i = ply + 1; i < ctx.pvLength[ply + 1]; ++i) {
+                ctx.pv[ply][i] = ctx.pv[ply + 1][i];
+            }
+            ctx.pvLength[ply] = ctx.pvLength[ply + 1];
         }
     }
 
     return alpha;
 }
 
-static void quiescePosition(Position& pos) {
-    std::array<Move, 128> pv;
-    std::fill(pv.begin(), pv.end(), MOVE_INVALID);
-    quiescenceSearch(pos, pv.data());
-
-    for (Move move: pv) {
-        if (move == MOVE_INVALID) {
-            break;
-        }
+static void quiescePosition(MaterialQSearchContext& ctx, Position& pos) {
+    materialQuiescenceSearch(ctx, pos, 0, -INT_MAX, INT_MAX);
 
-        pos.makeMove(move);
+    for (int i = 0; i < ctx.pvLength[0]; ++i) {
+        pos.makeMove(ctx.pv[0][i]);
     }
 }
 
-static InputData parseData(fs::path dataFilePath, size_t maxPositions) {
-    try {
-        std::cout << "Parsing data from " << dataFilePath << std::endl;
-        std::ifstream stream(dataFilePath);
-        stream.exceptions(std::ios_base::badbit);
+static void quiescePosition(AlphaBetaSearcher& searcher, std::vector<Move>& pv, Position& pos) {
+    searcher.quiescenceSearch(pos, &pv);
 
-        InputData inputData;
-
-        std::string line;
-        size_t nPositions = 0;
-        while (std::getline(stream, line) && nPositions < maxPositions) {
-            std::vector<std::string_view> tokens;
-            strutils::split(line, tokens, ",");
+    for (Move move: pv) {
+        pos.makeMove(move);
+    }
+}
 
-            std::string_view fen     = tokens[0];
-            std::string_view evalStr = tokens[1];
+static ui32 getQuiesceFlag(QuiesceMode mode) {
+    return mode == QuiesceMode::SEARCH ? DSF_QUIESCED_SEARCH : DSF_QUIESCED_MATERIAL;
+}
 
-            double eval  = std::stod(std::string(evalStr));
-            Position pos = Position::fromFen(fen).value();
+/**
+ * Returns true if 'cachePath' exists and was written after 'dataPath' was last modified.
+ */
+static bool isCacheUpToDate(const fs::path& cachePath, const fs::path& dataPath) {
+    return fs::exists(cachePath) && fs::last_write_time(cachePath) >= fs::last_write_time(dataPath);
+}
 
-            inputData.entries.emplace_back(std::move(pos), eval);
-            nPositions++;
+/**
+ * Loads the dataset as it is stored, without quiescing it.
+ */
+static InputData loadData(const Settings& settings) {
+    try {
+        const fs::path& dataPath = settings.tunerDataPath;
+        if (isBinaryDataset(dataPath)) {
+            return loadBinaryDataset(dataPath, settings.maxPos);
         }
 
-        std::cout << "Succesfully parsed data from " << dataFilePath << std::endl;
+        // Parsing CSV data is slow. Reuse the binary dataset we've created
+        // on a previous run, unless the CSV file was modified since then.
+        fs::path binPath = getBinaryDatasetPath(dataPath);
+        if (isCacheUpToDate(binPath, dataPath)) {
+            return loadBinaryDataset(binPath, settings.maxPos);
+        }
 
+        InputData inputData = parseCsvDataset(dataPath, settings.maxPos);
+        if (inputData.complete) {
+            LogLine(settings) << "Saving binary dataset at " << binPath;
+            saveBinaryDataset(inputData, binPath);
+        }
         return inputData;
     }
     catch (const std::exception& e) {
-        std::cerr << "Error parsing data file at " << dataFilePath << ": " << e.what();
+        std::cerr << "Error loading data file at " << settings.tunerDataPath << ": " << e.what() << std::endl;
         std::exit(EXIT_FAILURE);
     }
 }
@@ -145,31 +228,146 @@ static nlohmann::json loadWeightsJson(fs::path weightsJsonFilePath) {
     return weightsJson;
 }
 
-static void quiesceDataPositions(InputData& inputData, int threads) {
-    std::cout << "Quiescing positions...";
-    std::mutex quiescedCounterMutex;
-    int nQuiesced = 0;
-    {
-        ThreadPool threadPool(threads);
-        auto chunks = utils::splitIntoChunks(inputData.entries, threads);
-        for (auto chunk: chunks) {
-            threadPool.enqueue([chunk, &nQuiesced, &inputData, &quiescedCounterMutex]() {
-                for (int i = chunk.firstIdx; i <= chunk.lastIdx; ++i) {
-                    auto& entry = inputData.entries[i];
-                    quiescePosition(entry.position);
-
-                    {
-                        std::unique_lock lock(quiescedCounterMutex);
-                        if ((nQuiesced % 25000) == 0) {
-                            std::cout << nQuiesced << " positions quiesced..." << std::endl;
-                        }
-                        nQuiesced++;
-                    }
+/**
+ * Returns the weights the tuning starts from, as loaded from the base weights
+ * file if one was given.
+ */
+static nlohmann::json loadBaseWeightsJson(const Settings& settings) {
+    return settings.baseWeightsPath.has_value()
+        ? loadWeightsJson(settings.baseWeightsPath.value())
+        : nlohmann::json(*getDefaultHCEWeights());
+}
+
+static ui64 hashWeights(const nlohmann::json& flatWeightsJson) {
+    std::string str = flatWeightsJson.dump();
+    return utils::fnv1a(str.data(), str.size());
+}
+
+static void quiesceDataPositions(InputData& inputData,
+                                 const Settings& settings,
+                                 const HCEWeightTable& weights) {
+    constexpr size_t BATCH_SIZE     = 1024;
+    constexpr ui64 REPORT_INTERVAL  = 25000;
+
+    LogLine(settings) << "Quiescing positions...";
+
+    // Workers claim batches of positions by bumping an atomic cursor.
+    // Positions are independent from each other, so no further
+    // synchronization is needed.
+    const size_t nEntries = inputData.entries.size();
+    std::atomic<size_t> nextBatchStart = 0;
+    std::atomic<ui64> nQuiesced = 0;
+
+    auto reportProgress = [&nQuiesced, &settings](size_t batchSize) {
+        ui64 prev = nQuiesced.fetch_add(batchSize, std::memory_order_relaxed);
+        ui64 curr = prev + batchSize;
+        if (prev / REPORT_INTERVAL != curr / REPORT_INTERVAL) {
+            LogLine(settings) << (curr / REPORT_INTERVAL * REPORT_INTERVAL) << " positions quiesced...";
+        }
+    };
+
+    auto worker = [&]() {
+        std::unique_ptr<MaterialQSearchContext> ctx;
+        std::unique_ptr<AlphaBetaSearcher> searcher;
+        std::vector<Move> pv;
+
+        if (settings.quiesceMode == QuiesceMode::SEARCH) {
+            searcher = std::make_unique<AlphaBetaSearcher>(std::make_shared<HandCraftedEvaluator>(&weights));
+            // The quiescence search never probes the TT.
+            searcher->getTT().resize(1024 * 1024);
+            pv.reserve(MAX_SEARCH_DEPTH);
+        }
+        else {
+            ctx = std::make_unique<MaterialQSearchContext>();
+        }
+
+        while (true) {
+            size_t first = nextBatchStart.fetch_add(BATCH_SIZE, std::memory_order_relaxed);
+            if (first >= nEntries) {
+                break;
+            }
+            size_t last = std::min(first + BATCH_SIZE, nEntries);
+
+            for (size_t i = first; i < last; ++i) {
+                Position& pos = inputData.entries[i].position;
+                if (searcher != nullptr) {
+                    quiescePosition(*searcher, pv, pos);
                 }
-            });
+                else {
+                    quiescePosition(*ctx, pos);
+                }
+            }
+
+            reportProgress(last - first);
+        }
+    };
+
+    {
+        ThreadPool threadPool(settings.threads);
+        for (int i = 0; i < settings.threads; ++i) {
+            threadPool.enqueue(worker);
         }
     }
-    std::cout << nQuiesced << " positions quiesced." << std::endl;
+    LogLine(settings) << nQuiesced.load() << " positions quiesced.";
+
+    inputData.flags |= getQuiesceFlag(settings.quiesceMode);
+}
+
+/**
+ * Quiesces the dataset positions, unless this was already done on a previous
+ * run, and saves the results to the quiesced dataset of the current mode.
+ */
+static void maybeQuiesceData(InputData& inputData,
+                             const Settings& settings,
+                             const HCEWeightTable& weights,
+                             ui64 weightsHash) {
+    ui32 flag = getQuiesceFlag(settings.quiesceMode);
+    if (inputData.flags & flag) {
+        LogLine(settings) << "Dataset positions were already quiesced.";
+        return;
+    }
+
+    quiesceDataPositions(inputData, settings, weights);
+
+    if (!inputData.complete) {
+        LogLine(settings) << "Dataset was partially loaded, skipping write-back of quiesced positions.";
+        return;
+    }
+
+    fs::path quiescedPath = getQuiescedDatasetPath(settings.tunerDataPath, flag, weightsHash);
+    LogLine(settings) << "Saving quiesced positions at " << quiescedPath;
+    saveBinaryDataset(inputData, quiescedPath);
+}
+
+/**
+ * Loads the dataset and, if asked to, quiesces it with the base weights of 'settings'.
+ * Positions quiesced on a previous run with the same mode (and the same base weights,
+ * for the engine's qsearch) are reused.
+ */
+static InputData loadTuningData(const Settings& settings) {
+    if (settings.quiesceMode == QuiesceMode::NONE) {
+        return loadData(settings);
+    }
+
+    nlohmann::json weightsJSON = loadBaseWeightsJson(settings);
+    ui64 weightsHash = hashWeights(weightsJSON.flatten());
+
+    fs::path quiescedPath = getQuiescedDatasetPath(settings.tunerDataPath,
+                                                   getQuiesceFlag(settings.quiesceMode),
+                                                   weightsHash);
+    if (isCacheUpToDate(quiescedPath, settings.tunerDataPath)) {
+        try {
+            return loadBinaryDataset(quiescedPath, settings.maxPos);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error loading quiesced dataset at " << quiescedPath << ": " << e.what() << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    InputData inputData = loadData(settings);
+    maybeQuiesceData(inputData, settings, HCEWeightTable(weightsJSON), weightsHash);
+    return inputData;
 }
 
 static double sigmoid(double x, double k) {
@@ -201,21 +399,27 @@ static double squaredErrorSum(const HCEWeightTable& weights,
     return totalError;
 }
 
+/** Number of dataset entries handled by each parallelFor range. */
+constexpr size_t ENTRIES_PER_RANGE = 4096;
+
+static size_t getRangeCount(size_t nEntries) {
+    return (nEntries + ENTRIES_PER_RANGE - 1) / ENTRIES_PER_RANGE;
+}
+
 static double computeMSE(ThreadPool& threadPool,
                          const HCEWeightTable& weights,
                          const InputData& inputData,
                          double k) {
-    double sum = 0;
-    auto chunks = utils::splitIntoChunks(inputData.entries, inputData.entries.size() / 1000);
-    std::vector<std::future<double>> partialErrors;
-    for (auto chunk: chunks) {
-        partialErrors.emplace_back(threadPool.submit([&inputData, &weights, chunk, k]() {
-            return squaredErrorSum(weights, inputData, chunk.firstIdx, chunk.lastIdx, k);
-        }));
-    }
+    // Partial sums are added up in a fixed order, so that the result doesn't
+    // depend on how the ranges were scheduled.
+    std::vector<double> partialErrors(getRangeCount(inputData.entries.size()));
+    threadPool.parallelFor(0, inputData.entries.size(), ENTRIES_PER_RANGE, [&](size_t first, size_t last) {
+        partialErrors[first / ENTRIES_PER_RANGE] = squaredErrorSum(weights, inputData, first, last - 1, k);
+    });
 
-    for (auto& err: partialErrors) {
-        sum += err.get();
+    double sum = 0;
+    for (double err: partialErrors) {
+        sum += err;
     }
     return sum / static_cast<double>(inputData.entries.size());
 }
@@ -253,7 +457,7 @@ static std::tuple<int, double> tune(const Settings& settings,
             lowestError = mse;
             badIts      = 0;
 
-            std::cout << "Good iteration -- best value " << bestValue << "(err " << lowestError << ")" << std::endl;
+            LogLine(settings) << "Good iteration -- best value " << bestValue << "(err " << lowestError << ")";
         }
         else {
             badIts++;
@@ -263,73 +467,180 @@ static std::tuple<int, double> tune(const Settings& settings,
     return std::make_tuple(bestValue, lowestError);
 }
 
-static std::tuple<double, double> tuneK(const Settings& settings,
-                                        const InputData& inputData,
-                                        nlohmann::json flatWeightsJson,
-                                        ThreadPool& threadPool,
-                                        double step,
-                                        double lowestError = INFINITY) {
-    constexpr int MAX_BAD_ITERATIONS = 4;
-    constexpr double MIN_ERR_DELTA   = 0.00000001;
-
-    int badIts    = 0;
-    double k      = settings.k;
-    double bestK  = k;
+/**
+ * Evaluates every dataset position once with the given weights.
+ * Scores are in white's perspective.
+ */
+static std::vector<i32> computeStaticEvals(ThreadPool& threadPool,
+                                           const HCEWeightTable& weights,
+                                           const InputData& inputData) {
+    std::vector<i32> evals(inputData.entries.size());
+    threadPool.parallelFor(0, inputData.entries.size(), ENTRIES_PER_RANGE, [&](size_t first, size_t last) {
+        HandCraftedEvaluator hce(&weights);
+        for (size_t i = first; i < last; ++i) {
+            const Position& pos = inputData.entries[i].position;
+            hce.setPosition(pos);
+            int score = hce.evaluate();
+            evals[i] = pos.getColorToMove() == CL_BLACK ? -score : score;
+        }
+    });
+    return evals;
+}
 
-    auto unflattened = flatWeightsJson.unflatten();
-    HCEWeightTable weights(unflattened);
+static double computeMSE(ThreadPool& threadPool,
+                         const std::vector<i32>& evals,
+                         const InputData& inputData,
+                         double k) {
+    std::vector<double> partialErrors(getRangeCount(evals.size()));
+    threadPool.parallelFor(0, evals.size(), ENTRIES_PER_RANGE, [&](size_t first, size_t last) {
+        double totalError = 0;
+        for (size_t i = first; i < last; ++i) {
+            double error = inputData.entries[i].expectedScore - sigmoid(double(evals[i]), k);
+            totalError += error * error;
+        }
+        partialErrors[first / ENTRIES_PER_RANGE] = totalError;
+    });
 
-    while (badIts < MAX_BAD_ITERATIONS) {
-        k += step;
-        double mse = computeMSE(threadPool, weights,
-                                inputData,
-                                k);
+    double sum = 0;
+    for (double err: partialErrors) {
+        sum += err;
+    }
+    return sum / static_cast<double>(evals.size());
+}
 
-        double delta = lowestError - mse;
-        if (delta >= MIN_ERR_DELTA) {
-            bestK       = k;
-            lowestError = mse;
-            badIts      = 0;
+/**
+ * Finds the K that minimizes the mean squared error of the given static evals
+ * using a golden-section search. The error is unimodal on K for any reasonable
+ * dataset, so no bracketing other than the initial interval is needed.
+ */
+static double fitK(ThreadPool& threadPool,
+                   const std::vector<i32>& evals,
+                   const InputData& inputData) {
+    constexpr double MIN_K     = 0.0;
+    constexpr double MAX_K     = 4.0;
+    constexpr double TOLERANCE = 0.00001;
+    const double invPhi = (std::sqrt(5.0) - 1) / 2;
+
+    double a = MIN_K;
+    double b = MAX_K;
+    double c = b - (b - a) * invPhi;
+    double d = a + (b - a) * invPhi;
+    double fc = computeMSE(threadPool, evals, inputData, c);
+    double fd = computeMSE(threadPool, evals, inputData, d);
+
+    while (b - a > TOLERANCE) {
+        if (fc < fd) {
+            b  = d;
+            d  = c;
+            fd = fc;
+            c  = b - (b - a) * invPhi;
+            fc = computeMSE(threadPool, evals, inputData, c);
         }
         else {
-            badIts++;
+            a  = c;
+            c  = d;
+            fc = fd;
+            d  = a + (b - a) * invPhi;
+            fd = computeMSE(threadPool, evals, inputData, d);
         }
     }
 
-    return std::make_tuple(bestK, lowestError);
+    return (a + b) / 2;
 }
 
-static void computeK(Settings& settings,
-                    const InputData& inputData,
-                    nlohmann::json flatWeightsJson) {
-    std::cout << "Adjusting K... (initial guess: " << settings.k << ")" << std::endl;
+static ui64 hashDataset(const InputData& inputData) {
+    ui64 hash = utils::FNV1A_OFFSET_BASIS;
+    for (const DataEntry& entry: inputData.entries) {
+        ui64 key = entry.position.getZobrist();
+        hash = utils::fnv1a(&key, sizeof(key), hash);
+        hash = utils::fnv1a(&entry.expectedScore, sizeof(entry.expectedScore), hash);
+    }
+    return hash;
+}
 
-    ThreadPool threadPool(settings.threads);
-    auto [upK, upError]     = tuneK(settings, inputData, flatWeightsJson, threadPool, 0.01);
-    auto [downK, downError] = tuneK(settings, inputData, flatWeightsJson, threadPool, -0.01);
+static std::mutex s_KCacheMutex;
 
-    if (upError < downError) {
-        settings.k = upK;
+static fs::path getKCachePath(const Settings& settings) {
+    fs::path path = settings.tunerDataPath;
+    path += ".kcache.json";
+    return path;
+}
+
+static std::string getKCacheKey(const InputData& inputData, const nlohmann::json& flatWeightsJson) {
+    std::stringstream ss;
+    ss << std::hex << hashDataset(inputData) << ':' << hashWeights(flatWeightsJson);
+    return ss.str();
+}
+
+static std::optional<double> loadCachedK(const Settings& settings, const std::string& key) {
+    std::unique_lock lock(s_KCacheMutex);
+    fs::path path = getKCachePath(settings);
+    if (!fs::exists(path)) {
+        return std::nullopt;
     }
-    else {
-        settings.k = downK;
+    try {
+        nlohmann::json cache = nlohmann::json::parse(utils::readFromFile(path));
+        if (cache.contains(key)) {
+            return cache[key].get<double>();
+        }
+    }
+    catch (const std::exception& e) {
+        LogLine(settings) << "Ignoring invalid K cache at " << path << ": " << e.what();
     }
-    std::cout << "K = " << settings.k << std::endl;
+    return std::nullopt;
 }
 
-static int tuneParameter(const Settings& settings,
-                         const InputData& inputData,
-                         nlohmann::json flatWeightsJson,
-                         std::string parameter) {
+static void storeCachedK(const Settings& settings, const std::string& key, double k) {
+    std::unique_lock lock(s_KCacheMutex);
+    fs::path path = getKCachePath(settings);
+    nlohmann::json cache = nlohmann::json::object();
+    if (fs::exists(path)) {
+        try {
+            cache = nlohmann::json::parse(utils::readFromFile(path));
+        }
+        catch (const std::exception&) {
+            // Overwrite invalid caches.
+        }
+    }
+    cache[key] = k;
+    utils::writeToFileAtomically(path, cache.dump(2));
+}
+
+static void computeK(Settings& settings,
+                     ThreadPool& threadPool,
+                     const InputData& inputData,
+                     nlohmann::json flatWeightsJson) {
+    std::string cacheKey = getKCacheKey(inputData, flatWeightsJson);
+    if (auto cachedK = loadCachedK(settings, cacheKey); cachedK.has_value()) {
+        settings.k = cachedK.value();
+        LogLine(settings) << "K = " << settings.k << " (cached)";
+        return;
+    }
+
+    LogLine(settings) << "Adjusting K...";
+
+    HCEWeightTable weights(flatWeightsJson.unflatten());
+    std::vector<i32> evals = computeStaticEvals(threadPool, weights, inputData);
+    settings.k = fitK(threadPool, evals, inputData);
+
+    LogLine(settings) << "K = " << settings.k
+                      << " (err " << computeMSE(threadPool, evals, inputData, settings.k) << ")";
+    storeCachedK(settings, cacheKey, settings.k);
+}
+
+static std::tuple<int, double> tuneParameter(const Settings& settings,
+                                             ThreadPool& threadPool,
+                                             const InputData& inputData,
+                                             nlohmann::json flatWeightsJson,
+                                             std::string parameter) {
     auto paramJsonVal = flatWeightsJson[parameter];
     if (!paramJsonVal.is_number()) {
         throw std::runtime_error("Unsupported parameter type.");
     }
     int initialValue = paramJsonVal;
-    std::cout << "Tuning parameter " << parameter << std::endl;
+    LogLine(settings) << "Tuning parameter " << parameter;
 
-    ThreadPool threadPool(settings.threads);
-    double lowestErr = computeMSE(threadPool, flatWeightsJson.unflatten(),
+    double lowestErr = computeMSE(threadPool, HCEWeightTable(flatWeightsJson.unflatten()),
                                   inputData,
                                   settings.k);
 
@@ -352,7 +663,7 @@ static int tuneParameter(const Settings& settings,
 
     if (lowestErr < upError && lowestErr < downError) {
         // Our value was already tuned
-        return initialValue;
+        return std::make_tuple(initialValue, lowestErr);
     }
 
     // Figure out whether we want to go up or down.
@@ -366,25 +677,32 @@ static int tuneParameter(const Settings& settings,
         lowestErr = upError;
     }
 
-    std::cout << "Done tuning parameter " << parameter << ": "
+    LogLine(settings) << "Done tuning parameter " << parameter << ": "
               << initialValue << " -> " << bestValue
-              << " (err " << std::setprecision(6) << lowestErr << ")"
-              << std::endl;
+              << " (err " << std::setprecision(6) << lowestErr << ")";
 
-    return bestValue;
+    return std::make_tuple(bestValue, lowestErr);
 }
 
-static void tuneEvaluator(Settings& settings) {
-    std::cout << "Initializing tuning process" << std::endl;
+static Checkpoint makeCheckpoint(const Settings& settings,
+                                 const InputData& inputData,
+                                 const nlohmann::json& flatWeights,
+                                 const std::vector<std::string>& parameters) {
+    Checkpoint ckpt;
+    ckpt.flatWeights  = flatWeights;
+    ckpt.k            = settings.k;
+    ckpt.parameters   = parameters;
+    ckpt.step         = settings.step;
+    ckpt.datasetPath  = fs::weakly_canonical(settings.tunerDataPath).string();
+    ckpt.datasetSize  = inputData.entries.size();
+    ckpt.datasetFlags = inputData.flags;
+    return ckpt;
+}
 
-    InputData inputData = parseData(settings.tunerDataPath, settings.maxPos);
-    if (settings.quiesce) {
-        quiesceDataPositions(inputData, settings.threads);
-    }
+static void tuneEvaluator(Settings settings, const InputData& inputData) {
+    LogLine(settings) << "Initializing tuning process";
 
-    nlohmann::json weightsJSON = settings.baseWeightsPath.has_value()
-        ? loadWeightsJson(settings.baseWeightsPath.value())
-        : nlohmann::json(*getDefaultHCEWeights());
+    nlohmann::json weightsJSON = loadBaseWeightsJson(settings);
 
     // Flattening the weights allows us to get each field in the JSON
     // to be a single integer parameter. We can unflatten this later on
@@ -394,7 +712,7 @@ static void tuneEvaluator(Settings& settings) {
 //     Add all parameters.
 
     std::vector<std::string> parameters;
-    std::cout << "Registering parameters..." << std::endl;
+    LogLine(settings) << "Registering parameters...";
     for (const auto& item: flatWeights.items()) {
         const auto& key = item.key();
 
@@ -404,7 +722,7 @@ static void tuneEvaluator(Settings& settings) {
         if (it != settings.paramPriorities.end()) {
             int priority = it->second;
             if (priority <= PRIO_SKIP) {
-                std::cout << "Skipping parameter " << key << std::endl;
+                LogLine(settings) << "Skipping parameter " << key;
                 continue;
             }
         }
@@ -414,33 +732,198 @@ static void tuneEvaluator(Settings& settings) {
         }
 
         parameters.push_back(key);
-        std::cout << "Added parameter " << key << std::endl;
+        LogLine(settings) << "Added parameter " << key;
+    }
+
+    Checkpoint ckpt = makeCheckpoint(settings, inputData, flatWeights, parameters);
+    if (settings.resume && fs::exists(settings.checkpointPath)) {
+        LogLine(settings) << "Resuming from checkpoint " << settings.checkpointPath;
+        ckpt = loadCheckpoint(settings.checkpointPath);
+
+        if (ckpt.parameters != parameters) {
+            throw std::runtime_error("Checkpoint was created with a different set of parameters.");
+        }
+        if (ckpt.datasetPath  != fs::weakly_canonical(settings.tunerDataPath).string() ||
+            ckpt.datasetSize  != inputData.entries.size() ||
+            ckpt.datasetFlags != inputData.flags) {
+            throw std::runtime_error("Checkpoint was created with a different dataset.");
+        }
+        if (ckpt.finished) {
+            LogLine(settings) << "Checkpoint belongs to a finished tuning process, nothing to do.";
+            return;
+        }
+
+        flatWeights   = ckpt.flatWeights;
+        settings.k    = ckpt.k;
+        settings.step = ckpt.step;
     }
 
-    computeK(settings, inputData, flatWeights);
+    // One pool serves the whole job. parallelFor also runs work on the calling thread.
+    ThreadPool threadPool(std::max(0, settings.threads - 1));
+
+    if (!ckpt.kFitted) {
+        if (settings.fitK) {
+            computeK(settings, threadPool, inputData, flatWeights);
+        }
+        ckpt.k       = settings.k;
+        ckpt.kFitted = true;
+        saveCheckpoint(ckpt, settings.checkpointPath);
+    }
+
+    LogLine(settings) << "Starting tuning process.";
+    while (ckpt.iteration <= settings.repeat) {
+        while (ckpt.nextParam < parameters.size()) {
+            const auto& param = parameters[ckpt.nextParam];
 
-    std::cout << "Starting tuning process." << std::endl;
-    int it = 0;
-    do {
-        int nTunedParams = 0;
-        for (const auto& param: parameters) {
             // Tune each weight individually and save it on the flatWeights again.
             // By doing this we're making sure the following weights will take into consideration
             // the tuning that was done to the ones before them.
-            int newValue = tuneParameter(settings, inputData, nlohmann::json(flatWeights), param);
-            std::cout << ++nTunedParams << " of " << parameters.size() << " parameters tuned." << std::endl;
+            auto [newValue, err] = tuneParameter(settings, threadPool, inputData, nlohmann::json(flatWeights), param);
+            LogLine(settings) << (ckpt.nextParam + 1) << " of " << parameters.size() << " parameters tuned.";
             flatWeights[param] = newValue;
 
             // Save everything whenever we tune a parameter
             nlohmann::json unflattened = flatWeights.unflatten();
-            std::ofstream ofstream(settings.outPath);
-            ofstream << std::setw(2) << unflattened << std::endl;
-            ofstream.close();
+            utils::writeToFileAtomically(settings.outPath, unflattened.dump(2) + "\n");
+
+            ckpt.flatWeights = flatWeights;
+            ckpt.lastError   = err;
+            ckpt.nextParam++;
+            if (ckpt.nextParam < parameters.size()) {
+                saveCheckpoint(ckpt, settings.checkpointPath);
+            }
+        }
+
+        // Make sure the checkpoint already points to the next repetition.
+        ckpt.iteration++;
+        ckpt.nextParam = 0;
+        saveCheckpoint(ckpt, settings.checkpointPath);
+
+        LogLine(settings) << "Tuning finished. Saving at " << fs::absolute(settings.outPath);
+    }
+
+    ckpt.finished = true;
+    saveCheckpoint(ckpt, settings.checkpointPath);
+}
+
+/**
+ * Reads a JSON array of tuning jobs. Each job is an object whose fields
+ * override the settings provided in the command line:
+ *
+ * [
+ *   { "name": "low-k", "out": "low-k.json", "k": 0.08, "step": 1, "threads": 16 },
+ *   { "name": "prios", "out": "prios.json", "priorities": "prios.json", "repeat": 2 }
+ * ]
+ *
+ * Supported fields are "name", "out", "checkpoint", "k", "step", "threads",
+ * "repeat", "priorities" and "baseWeights". Setting "k" disables fitting it
+ * to the dataset.
+ */
+static std::vector<Settings> parseJobs(const Settings& baseSettings, const fs::path& jobsPath) {
+    nlohmann::json jobsJson = nlohmann::json::parse(utils::readFromFile(jobsPath));
+    if (!jobsJson.is_array()) {
+        throw std::runtime_error("Jobs file must contain an array of jobs.");
+    }
+
+    std::vector<Settings> jobs;
+    for (const auto& jobJson: jobsJson) {
+        Settings job = baseSettings;
+        job.jobName = jobJson.value("name", "job" + std::to_string(jobs.size()));
+        job.outPath = jobJson.value("out", job.jobName + ".json");
+        job.checkpointPath = jobJson.value("checkpoint", job.outPath.string() + ".ckpt.json");
+        job.step    = jobJson.value("step", job.step);
+        job.threads = jobJson.value("threads", job.threads);
+        job.repeat  = jobJson.value("repeat", job.repeat);
+
+        if (jobJson.contains("k")) {
+            job.k    = jobJson["k"];
+            job.fitK = false;
+        }
+        if (jobJson.contains("priorities")) {
+            job.paramPriorities = nlohmann::json::parse(utils::readFromFile(jobJson["priorities"].get<std::string>()))
+                    .get<std::unordered_map<std::string, int>>();
+        }
+        if (jobJson.contains("baseWeights")) {
+            job.baseWeightsPath = jobJson["baseWeights"].get<std::string>();
         }
 
-        std::cout << "Tuning finished. Saving at " << fs::absolute(settings.outPath) << std::endl;
-        it++;
-    } while (it <= settings.repeat);
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+/**
+ * Runs the given jobs concurrently, each of them with the dataset of the same index.
+ * A job is only started when the threads it requests fit in the thread budget
+ * left by the jobs that are currently running.
+ */
+static void runJobs(const std::vector<Settings>& jobs,
+                    const std::vector<std::shared_ptr<const InputData>>& datasets,
+                    int maxThreads) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    int threadsInUse = 0;
+
+    std::vector<std::thread> runners;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Settings job = jobs[i];
+        std::shared_ptr<const InputData> inputData = datasets[i];
+
+        // Jobs asking for more threads than the budget run with the whole budget.
+        int jobThreads = std::min(job.threads, maxThreads);
+        job.threads    = jobThreads;
+        {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&]() { return threadsInUse + jobThreads <= maxThreads; });
+            threadsInUse += jobThreads;
+        }
+
+        LogLine(job) << "Starting job with " << jobThreads << " threads.";
+        runners.emplace_back([&, job, inputData, jobThreads]() {
+            try {
+                tuneEvaluator(job, *inputData);
+            }
+            catch (const std::exception& e) {
+                LogLine(job) << "Job failed: " << e.what();
+            }
+
+            {
+                std::unique_lock lock(mutex);
+                threadsInUse -= jobThreads;
+            }
+            cv.notify_all();
+        });
+    }
+
+    for (auto& runner: runners) {
+        runner.join();
+    }
+}
+
+/**
+ * Loads the dataset of each job. The engine's qsearch quiesces positions with the
+ * base weights of the job, so jobs only share a dataset when they start from the
+ * same weights, or when the dataset doesn't depend on the weights at all.
+ * Datasets are prepared before any job starts, using the whole thread budget.
+ */
+static std::vector<std::shared_ptr<const InputData>> loadJobsData(const Settings& settings,
+                                                                  const std::vector<Settings>& jobs) {
+    std::unordered_map<ui64, std::shared_ptr<const InputData>> byWeights;
+    std::vector<std::shared_ptr<const InputData>> datasets;
+    for (const Settings& job: jobs) {
+        ui64 key = job.quiesceMode == QuiesceMode::SEARCH
+                   ? hashWeights(loadBaseWeightsJson(job).flatten())
+                   : 0;
+
+        auto it = byWeights.find(key);
+        if (it == byWeights.end()) {
+            Settings loadSettings = job;
+            loadSettings.threads  = std::max(settings.threads, settings.maxThreads);
+            it = byWeights.emplace(key, std::make_shared<const InputData>(loadTuningData(loadSettings))).first;
+        }
+        datasets.push_back(it->second);
+    }
+    return datasets;
 }
 
 static Settings processArgs(int argc, char* argv[]) {
@@ -465,12 +948,31 @@ static Settings processArgs(int argc, char* argv[]) {
         auto optBaseWeights = op.add<popl::Value<std::string>>("b", "base-weights",
                                                                "JSON file of base weights. If none is provided, uses the hardcoded base HCE weights.");
 
-        auto optQuiesce = op.add<popl::Switch>("q", "quiesce",
-                                               "If set, transforms positions with captures that yield positive material balance for the moving side into quiet positions before tuning.");
+        auto optQuiesce = op.add<popl::Implicit<std::string>>("q", "quiesce",
+                                               "If set, transforms positions with captures that yield positive material balance for the moving side into quiet positions before tuning. "
+                                               "Accepts 'material' (fast, material-only qsearch) or 'search' (engine qsearch), e.g. --quiesce=search. "
+                                               "Results are saved next to the dataset (<data>.qmaterial.bin, or <data>.qsearch.<weights hash>.bin since the engine qsearch depends on the base weights), so this is only done once per dataset, mode and weights.", "material");
 
         auto optRepeat = op.add<popl::Implicit<int>>("r", "repeat",
                                                "If set, repeats the tuning process by the specified number of times.", 0);
 
+        auto optK = op.add<popl::Value<double>>("k", "k",
+                                                "Sigmoid scaling constant. If set, K is not fitted to the dataset.");
+
+        auto optStep = op.add<popl::Value<int>>("s", "step",
+                                                "Amount by which parameters are changed on each tuning iteration.", 2);
+
+        auto optCheckpoint = op.add<popl::Value<std::string>>("c", "checkpoint",
+                                                              "Path to the checkpoint file. Defaults to the output path with a '.ckpt.json' suffix.");
+
+        auto optResume = op.add<popl::Switch>("", "resume",
+                                              "If set, resumes the tuning process from the checkpoint file, if it exists.");
+
+        auto optJobs = op.add<popl::Value<std::string>>("j", "jobs",
+                                                        "Path to a JSON file with multiple tuning jobs to be run concurrently on the same dataset.");
+
+        auto optMaxThreads = op.add<popl::Value<int>>("", "max-threads",
+                                                      "Maximum number of threads used by all concurrent jobs. Defaults to the number of hardware threads.");
 
         op.parse(argc, argv);
 
@@ -481,10 +983,45 @@ static Settings processArgs(int argc, char* argv[]) {
         }
 
         settings.tunerDataPath = optTunerData->value();
-        settings.outPath       = optOutPath->value();
         settings.threads       = optThreads->value();
-        settings.quiesce       = optQuiesce->value();
         settings.repeat        = optRepeat->value();
+        settings.step          = optStep->value();
+        settings.resume        = optResume->value();
+
+        if (optOutPath->is_set()) {
+            settings.outPath        = optOutPath->value();
+            settings.checkpointPath = settings.outPath.string() + ".ckpt.json";
+        }
+        if (optCheckpoint->is_set()) {
+            settings.checkpointPath = optCheckpoint->value();
+        }
+        if (optJobs->is_set()) {
+            settings.jobsPath = optJobs->value();
+        }
+        else if (!optOutPath->is_set()) {
+            throw std::runtime_error("An output path must be provided.");
+        }
+
+        settings.maxThreads = optMaxThreads->is_set()
+                              ? optMaxThreads->value()
+                              : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+        if (optK->is_set()) {
+            settings.k    = optK->value();
+            settings.fitK = false;
+        }
+
+        if (optQuiesce->is_set()) {
+            if (optQuiesce->value() == "material") {
+                settings.quiesceMode = QuiesceMode::MATERIAL;
+            }
+            else if (optQuiesce->value() == "search") {
+                settings.quiesceMode = QuiesceMode::SEARCH;
+            }
+            else {
+                throw std::runtime_error("Invalid quiesce mode '" + optQuiesce->value() + "'.");
+            }
+        }
 
         if (optBaseWeights->is_set()) {
             settings.baseWeightsPath = optBaseWeights->value();
@@ -512,7 +1049,20 @@ int main(int argc, char* argv[]) {
     lunachess::initializeEverything();
 
     Settings settings = processArgs(argc, argv);
-    tuneEvaluator(settings);
+
+    try {
+        if (settings.jobsPath.has_value()) {
+            std::vector<Settings> jobs = parseJobs(settings, settings.jobsPath.value());
+            runJobs(jobs, loadJobsData(settings, jobs), settings.maxThreads);
+        }
+        else {
+            tuneEvaluator(settings, loadTuningData(settings));
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Tuning error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
 
     return 0;
-}
\ No newline at end of file
+}